@@ -0,0 +1,212 @@
+#pragma once
+
+#include "Stdafx.h"
+
+/// <summary>
+/// The minimal duration, in milliseconds, of the single measurement.
+/// </summary>
+#define BENCHMARK_MIN_DURATION 100
+
+/// <summary>
+/// The count of the measurements of each benchmark, the fastest one is reported.
+/// </summary>
+#define BENCHMARK_REPETITIONS_COUNT 5
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The count of the calls of the global operator new made by the current process.
+		/// </summary>
+		/// <remarks>
+		/// Benchmarks are run by the single thread, so the counter is not synchronized.
+		/// </remarks>
+		extern volatile ULONG64 allocationsCount;
+
+		/// <summary>
+		/// Runs the benchmark for the specified number of operations and returns the checksum of the results, which keeps the compiler from removing the work.
+		/// </summary>
+		typedef ULONG64 (*BenchmarkKernel)(LPVOID state, ULONG64 operationsCount);
+
+		/// <summary>
+		/// Contains the result of the benchmark.
+		/// </summary>
+		struct BenchmarkResult
+		{
+			/// <summary>
+			/// The average time of the operation, in nanoseconds.
+			/// </summary>
+			double nanosecondsPerOperation;
+
+			/// <summary>
+			/// The average count of the cycles of the time stamp counter of the operation.
+			/// </summary>
+			double cyclesPerOperation;
+
+			/// <summary>
+			/// The average count of the heap allocations of the operation.
+			/// </summary>
+			double allocationsPerOperation;
+
+			/// <summary>
+			/// The count of the operations of the fastest measurement.
+			/// </summary>
+			ULONG64 operationsCount;
+		};
+
+		/// <summary>
+		/// Provides the measurement of the benchmarks.
+		/// </summary>
+		class Benchmark final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The frequency of the high resolution performance counter.
+			/// </summary>
+			LONG64 frequency;
+
+			/// <summary>
+			/// Accumulates the checksums of the kernels.
+			/// </summary>
+			volatile ULONG64 sink;
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the current time in the units of the high resolution performance counter.
+			/// </summary>
+			inline static LONG64 GetTimestamp()
+			{
+				LARGE_INTEGER value;
+
+				::QueryPerformanceCounter(&value);
+
+				return value.QuadPart;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="Benchmark" /> class.
+			/// </summary>
+			inline Benchmark()
+			{
+				::QueryPerformanceFrequency((LARGE_INTEGER*) &frequency);
+
+				sink = 0;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Measures the kernel.
+			/// </summary>
+			/// <param name="kernel">The kernel to measure.</param>
+			/// <param name="state">The state passed to the kernel.</param>
+			/// <returns>The result of the fastest measurement.</returns>
+			/// <remarks>
+			/// The count of the operations is doubled until the measurement takes at least <c>BENCHMARK_MIN_DURATION</c> milliseconds.
+			/// </remarks>
+			BenchmarkResult Measure(BenchmarkKernel kernel, LPVOID state)
+			{
+				// warm up caches and branch predictors
+				sink += kernel(state, 1024);
+
+				// find the count of the operations which takes long enough
+				ULONG64 operationsCount = 1024;
+
+				auto minTicks = frequency * BENCHMARK_MIN_DURATION / 1000;
+
+				while (true)
+				{
+					auto startTime = GetTimestamp();
+
+					sink += kernel(state, operationsCount);
+
+					if (GetTimestamp() - startTime >= minTicks)
+					{
+						break;
+					}
+
+					operationsCount *= 2;
+				}
+
+				// keep the fastest measurement, which is the least disturbed by the system
+				BenchmarkResult result;
+
+				result.operationsCount = operationsCount;
+
+				result.nanosecondsPerOperation = 1e300;
+
+				for (auto repetition = 0; repetition < BENCHMARK_REPETITIONS_COUNT; repetition++)
+				{
+					auto startAllocations = allocationsCount;
+
+					auto startCycles = __rdtsc();
+
+					auto startTime = GetTimestamp();
+
+					sink += kernel(state, operationsCount);
+
+					auto endTime = GetTimestamp();
+
+					auto endCycles = __rdtsc();
+
+					auto endAllocations = allocationsCount;
+
+					auto nanoseconds = (endTime - startTime) * 1e9 / frequency / operationsCount;
+
+					if (nanoseconds < result.nanosecondsPerOperation)
+					{
+						result.nanosecondsPerOperation = nanoseconds;
+
+						result.cyclesPerOperation = (double) (endCycles - startCycles) / operationsCount;
+
+						result.allocationsPerOperation = (double) (endAllocations - startAllocations) / operationsCount;
+					}
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Measures the kernel and prints the result.
+			/// </summary>
+			/// <param name="name">The name of the benchmark.</param>
+			/// <param name="kernel">The kernel to measure.</param>
+			/// <param name="state">The state passed to the kernel.</param>
+			void Run(const char* name, BenchmarkKernel kernel, LPVOID state)
+			{
+				auto result = Measure(kernel, state);
+
+				printf("%-40s %12.2f %12.1f %12.3f %14llu\n", name, result.nanosecondsPerOperation, result.cyclesPerOperation, result.allocationsPerOperation, result.operationsCount);
+			}
+
+			/// <summary>
+			/// Prints the header of the table of the results.
+			/// </summary>
+			inline static void PrintHeader()
+			{
+				printf("%-40s %12s %12s %12s %14s\n", "benchmark", "ns/op", "cycles/op", "allocs/op", "operations");
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -0,0 +1,22 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently,
+// but are changed infrequently
+
+#pragma once
+
+// the benchmarks are compiled against the same headers as the server
+#include "../TcpServerCli/Stdafx.h"
+
+#include "../TcpServerCli/HttpParser.h"
+
+#include "../TcpServerCli/HttpRouter.h"
+
+#include "../TcpServerCli/FrameCodec.h"
+
+#include "../TcpServerCli/RioBufferPool.h"
+
+#include <intrin.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
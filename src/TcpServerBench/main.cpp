@@ -0,0 +1,578 @@
+// Measures the hot paths of the server: buffer pools, completion dispatch, state transitions and request parsing.
+
+#include "Stdafx.h"
+#include "Benchmark.h"
+#include <new>
+
+#pragma unmanaged
+
+using namespace SXN::Net;
+
+namespace SXN
+{
+	namespace Net
+	{
+		volatile ULONG64 allocationsCount = 0;
+	}
+}
+
+#pragma region Allocation Counting
+
+void* operator new(size_t size)
+{
+	allocationsCount++;
+
+	auto result = malloc(size == 0 ? 1 : size);
+
+	if (result == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void operator delete(void* pointer)
+{
+	free(pointer);
+}
+
+#pragma endregion
+
+/// <summary>
+/// The count of the connections used by the dispatch and the state benchmarks.
+/// </summary>
+#define BENCH_CONNECTIONS_COUNT 4096
+
+/// <summary>
+/// The count of the completions within the single batch, equals the size of the batch dequeued by the worker.
+/// </summary>
+#define BENCH_BATCH_LENGTH 1024
+
+/// <summary>
+/// The count of the segments of the buffer pools.
+/// </summary>
+#define BENCH_SEGMENTS_COUNT 1024
+
+/// <summary>
+/// The count of the routes of the router.
+/// </summary>
+#define BENCH_ROUTES_COUNT 4096
+
+/// <summary>
+/// The count of the frames received by the single receive.
+/// </summary>
+#define BENCH_FRAMES_COUNT 64
+
+/// <summary>
+/// The length of the payload of the frame.
+/// </summary>
+#define BENCH_FRAME_PAYLOAD_LENGTH 60
+
+/// <summary>
+/// Contains the state shared by the benchmarks.
+/// </summary>
+struct BenchState
+{
+	RioBufferPool* bufferPool;
+
+	RioSizeClassPool* sizeClassPool;
+
+	ConnectionTable* connectionTable;
+
+	StatisticsRegion* statisticsRegion;
+
+	TraceRegion* traceRegion;
+
+	RIORESULT results[BENCH_BATCH_LENGTH];
+
+	RioSegment segments[BENCH_SEGMENTS_COUNT];
+
+	const char* request;
+
+	ULONG requestLength;
+
+	HttpRequest httpRequest;
+
+	HttpRouter* router;
+
+	HttpRouteMatch routeMatch;
+
+	FrameCodec* frameCodec;
+
+	char frames[BENCH_FRAMES_COUNT * (4 + BENCH_FRAME_PAYLOAD_LENGTH)];
+};
+
+#pragma region Kernels
+
+/// <summary>
+/// Gets the descriptor and the data of the buffer of the fixed size pool.
+/// </summary>
+static ULONG64 BufferPoolGet(LPVOID state, ULONG64 operationsCount)
+{
+	auto pool = ((BenchState*) state)->bufferPool;
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		auto bufferIndex = (ULONG) (index & (BENCH_SEGMENTS_COUNT - 1));
+
+		checksum += pool->GetBuffer(bufferIndex)->Offset + (ULONG_PTR) pool->GetBufferData(bufferIndex);
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Allocates and frees the segment on the owner thread.
+/// </summary>
+static ULONG64 SizeClassPoolLocal(LPVOID state, ULONG64 operationsCount)
+{
+	auto pool = ((BenchState*) state)->sizeClassPool;
+
+	ULONG64 checksum = 0;
+
+	RioSegment segment;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		pool->Allocate(512, segment);
+
+		checksum += segment.handle;
+
+		pool->Free(segment.handle);
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Allocates the batch of the segments, frees them through the remote list and allocates them again from the drained list.
+/// </summary>
+static ULONG64 SizeClassPoolRemote(LPVOID state, ULONG64 operationsCount)
+{
+	auto benchState = (BenchState*) state;
+
+	auto pool = benchState->sizeClassPool;
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index += BENCH_SEGMENTS_COUNT / 2)
+	{
+		for (auto segmentIndex = 0; segmentIndex < BENCH_SEGMENTS_COUNT / 2; segmentIndex++)
+		{
+			pool->Allocate(512, benchState->segments[segmentIndex]);
+		}
+
+		for (auto segmentIndex = 0; segmentIndex < BENCH_SEGMENTS_COUNT / 2; segmentIndex++)
+		{
+			checksum += benchState->segments[segmentIndex].handle;
+
+			pool->FreeRemote(benchState->segments[segmentIndex].handle);
+		}
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Dispatches the synthetic batches of completions the way the worker does, without the calls into the managed handlers.
+/// </summary>
+static ULONG64 CompletionDispatch(LPVOID state, ULONG64 operationsCount)
+{
+	auto benchState = (BenchState*) state;
+
+	auto connectionTable = benchState->connectionTable;
+
+	auto counters = benchState->statisticsRegion->GetWorkerCounters(0);
+
+	auto trace = benchState->traceRegion->GetRing(0);
+
+	for (ULONG64 index = 0; index < operationsCount; index += BENCH_BATCH_LENGTH)
+	{
+		counters->RecordDequeue(BENCH_BATCH_LENGTH);
+
+		auto now = LatencyHistogram::GetTimestamp();
+
+		for (auto resultIndex = 0; resultIndex < BENCH_BATCH_LENGTH; resultIndex++)
+		{
+			auto& rioResult = benchState->results[resultIndex];
+
+			auto connectionId = (ULONG) rioResult.RequestContext;
+
+			auto connection = connectionTable->GetConnection(connectionId);
+
+			auto timestamps = connectionTable->GetTimestamps(connectionId);
+
+			auto fromState = connection->state;
+
+			if (fromState == Receiving)
+			{
+				counters->receivesCount++;
+
+				counters->bytesReceived += rioResult.BytesTransferred;
+
+				timestamps->received = now;
+
+				connection->state = Received;
+			}
+			else if (fromState == Sending)
+			{
+				counters->sendsCount++;
+
+				counters->bytesSent += rioResult.BytesTransferred;
+
+				counters->latencies[LATENCY_STAGE_SEND].Record(now - timestamps->sendPosted);
+
+				connection->state = Sent;
+			}
+
+			trace->Record(connection, fromState, rioResult.BytesTransferred, rioResult.Status);
+
+			// restore the state, so the next batch takes the same path
+			connection->state = fromState;
+		}
+	}
+
+	return counters->completionsCount;
+}
+
+/// <summary>
+/// Moves the connections through the states of the request without tracing.
+/// </summary>
+static ULONG64 StateTransitions(LPVOID state, ULONG64 operationsCount)
+{
+	auto connectionTable = ((BenchState*) state)->connectionTable;
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		auto connection = connectionTable->GetConnection((ULONG) (index & (BENCH_CONNECTIONS_COUNT - 1)));
+
+		// Receiving -> Received -> Sending -> Sent -> Receiving
+		connection->state = (ConnectionState) (connection->state == Sent ? Receiving : connection->state + 1);
+
+		checksum += connection->state;
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Moves the connections through the states of the request and records each transition into the trace ring.
+/// </summary>
+static ULONG64 StateTransitionsTraced(LPVOID state, ULONG64 operationsCount)
+{
+	auto benchState = (BenchState*) state;
+
+	auto connectionTable = benchState->connectionTable;
+
+	auto trace = benchState->traceRegion->GetRing(0);
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		auto connection = connectionTable->GetConnection((ULONG) (index & (BENCH_CONNECTIONS_COUNT - 1)));
+
+		auto fromState = connection->state;
+
+		connection->state = (ConnectionState) (fromState == Sent ? Receiving : fromState + 1);
+
+		trace->Record(connection, fromState, 0, 0);
+
+		checksum += connection->state;
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Finds the end of the headers of the typical request.
+/// </summary>
+static ULONG64 RequestParse(LPVOID state, ULONG64 operationsCount)
+{
+	auto benchState = (BenchState*) state;
+
+	auto request = benchState->request;
+
+	auto requestLength = benchState->requestLength;
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		auto position = request;
+
+		auto end = request + requestLength;
+
+		ULONG headersLength = 0;
+
+		// each line ends with CRLF, so the empty line follows the line feed
+		while ((position = (const char*) memchr(position, '\n', end - position)) != nullptr)
+		{
+			position++;
+
+			if ((end - position >= 2) && (position[0] == '\r') && (position[1] == '\n'))
+			{
+				headersLength = (ULONG) (position + 2 - request);
+
+				break;
+			}
+		}
+
+		checksum += headersLength;
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Parses the request line and the headers of the typical request with the specified instruction set.
+/// </summary>
+static ULONG64 HttpParse(BenchState* benchState, ULONG64 operationsCount, HttpScanLevel level)
+{
+	HttpParser parser;
+
+	parser.Reset();
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		parser.Parse(benchState->request, benchState->requestLength, benchState->httpRequest, level);
+
+		checksum += benchState->httpRequest.headersLength + benchState->httpRequest.headersCount;
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Parses the typical request with the scalar code.
+/// </summary>
+static ULONG64 HttpParseScalar(LPVOID state, ULONG64 operationsCount)
+{
+	return HttpParse((BenchState*) state, operationsCount, HttpScanScalar);
+}
+
+/// <summary>
+/// Parses the typical request with the best instruction set of the processor.
+/// </summary>
+static ULONG64 HttpParseVector(LPVOID state, ULONG64 operationsCount)
+{
+	return HttpParse((BenchState*) state, operationsCount, HttpParser::GetScanLevel());
+}
+
+/// <summary>
+/// Finds the route of the typical request among the thousands of the routes.
+/// </summary>
+static ULONG64 HttpRoute(LPVOID state, ULONG64 operationsCount)
+{
+	auto benchState = (BenchState*) state;
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		benchState->router->Match(benchState->httpRequest, benchState->routeMatch);
+
+		checksum += benchState->routeMatch.routeIndex + benchState->routeMatch.parametersCount;
+	}
+
+	return checksum;
+}
+
+/// <summary>
+/// Reads the frames pipelined within the single receive, as the connection does.
+/// </summary>
+static ULONG64 FrameDecode(LPVOID state, ULONG64 operationsCount)
+{
+	auto benchState = (BenchState*) state;
+
+	ULONG64 checksum = 0;
+
+	for (ULONG64 index = 0; index < operationsCount; index++)
+	{
+		ULONG consumedLength = 0;
+
+		ULONG payloadLength;
+
+		while (benchState->frameCodec->Decode(benchState->frames + consumedLength, sizeof(benchState->frames) - consumedLength, payloadLength) == FrameDecodeComplete)
+		{
+			consumedLength += benchState->frameCodec->GetHeaderLength() + payloadLength;
+		}
+
+		checksum += consumedLength;
+	}
+
+	return checksum;
+}
+
+#pragma endregion
+
+/// <summary>
+/// Initializes the state and runs the benchmarks.
+/// </summary>
+static int RunBenchmarks()
+{
+	// initialize Winsock, the registered buffers require the function table of the Registered I/O extension
+	WSADATA data;
+
+	if (::WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		fprintf(stderr, "Winsock startup has failed\n");
+
+		return 1;
+	}
+
+	auto socket = ::WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+
+	auto winsock = socket == INVALID_SOCKET ? nullptr : Winsock::Initialize(socket);
+
+	if (winsock == nullptr)
+	{
+		fprintf(stderr, "Registered I/O is not available, error %d\n", ::WSAGetLastError());
+
+		return 2;
+	}
+
+	auto benchState = new BenchState();
+
+	DWORD kernelErrorCode;
+
+	int winsockErrorCode;
+
+	benchState->bufferPool = RioBufferPool::Create(*winsock, 512, BENCH_SEGMENTS_COUNT, kernelErrorCode, winsockErrorCode);
+
+	ULONG segmentLengths[] = { 512, 4096 };
+
+	ULONG segmentsCounts[] = { BENCH_SEGMENTS_COUNT, BENCH_SEGMENTS_COUNT / 4 };
+
+	benchState->sizeClassPool = RioSizeClassPool::Create(*winsock, segmentLengths, segmentsCounts, 2, kernelErrorCode, winsockErrorCode);
+
+	benchState->connectionTable = ConnectionTable::Create(BENCH_CONNECTIONS_COUNT, kernelErrorCode);
+
+	benchState->statisticsRegion = StatisticsRegion::Create(nullptr, 1, kernelErrorCode);
+
+	benchState->traceRegion = TraceRegion::Create(nullptr, 1, TRACE_DEFAULT_EVENTS_COUNT, kernelErrorCode);
+
+	if ((benchState->bufferPool == nullptr) || (benchState->sizeClassPool == nullptr) || (benchState->connectionTable == nullptr) || (benchState->statisticsRegion == nullptr) || (benchState->traceRegion == nullptr))
+	{
+		fprintf(stderr, "Can not initialize state, kernel error %lu, winsock error %d\n", kernelErrorCode, winsockErrorCode);
+
+		return 3;
+	}
+
+	benchState->sizeClassPool->SetOwnerThread();
+
+	// half of the connections wait for the receive, the other half for the send
+	for (ULONG connectionId = 0; connectionId < BENCH_CONNECTIONS_COUNT; connectionId++)
+	{
+		auto connection = benchState->connectionTable->GetConnection(connectionId);
+
+		connection->id = connectionId;
+
+		connection->state = (connectionId & 1) == 0 ? Receiving : Sending;
+	}
+
+	// completions hit the connections in the pseudo random order, as they do under the load
+	srand(1);
+
+	for (auto resultIndex = 0; resultIndex < BENCH_BATCH_LENGTH; resultIndex++)
+	{
+		auto& rioResult = benchState->results[resultIndex];
+
+		rioResult.Status = 0;
+
+		rioResult.BytesTransferred = 128 + rand() % 384;
+
+		rioResult.SocketContext = 0;
+
+		rioResult.RequestContext = ((ULONG) rand() * RAND_MAX + rand()) % BENCH_CONNECTIONS_COUNT;
+	}
+
+	benchState->request = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\nAccept: text/plain,text/html;q=0.9\r\nConnection: keep-alive\r\n\r\n";
+
+	benchState->requestLength = (ULONG) strlen(benchState->request);
+
+	// the routes of the typical application, the request matches the last one with the parameter
+	benchState->router = HttpRouter::Create(BENCH_ROUTES_COUNT);
+
+	char route[64];
+
+	for (ULONG routeIndex = 0; routeIndex < BENCH_ROUTES_COUNT; routeIndex++)
+	{
+		auto routeLength = sprintf_s(route, "%s /api/resource%lu/{id}", (routeIndex & 1) == 0 ? "GET" : "POST", routeIndex);
+
+		benchState->router->SetRoute(routeIndex, route, (ULONG) routeLength);
+	}
+
+	benchState->router->Build();
+
+	Benchmark benchmark;
+
+	Benchmark::PrintHeader();
+
+	benchmark.Run("RioBufferPool::GetBuffer+GetBufferData", &BufferPoolGet, benchState);
+
+	benchmark.Run("RioSizeClassPool::Allocate+Free", &SizeClassPoolLocal, benchState);
+
+	benchmark.Run("RioSizeClassPool::Allocate+FreeRemote", &SizeClassPoolRemote, benchState);
+
+	benchmark.Run("CompletionDispatch[1024]", &CompletionDispatch, benchState);
+
+	// dispatch benchmark leaves the states as they were, now reset them for the transitions
+	for (ULONG connectionId = 0; connectionId < BENCH_CONNECTIONS_COUNT; connectionId++)
+	{
+		benchState->connectionTable->GetConnection(connectionId)->state = Receiving;
+	}
+
+	benchmark.Run("ConnectionState transition", &StateTransitions, benchState);
+
+	benchmark.Run("ConnectionState transition+trace", &StateTransitionsTraced, benchState);
+
+	benchmark.Run("Request headers end", &RequestParse, benchState);
+
+	benchmark.Run("HttpParser::Parse scalar", &HttpParseScalar, benchState);
+
+	benchmark.Run("HttpParser::Parse vector", &HttpParseVector, benchState);
+
+	// the request of the parse benchmarks targets the route
+	benchState->request = "GET /api/resource1022/12345?format=json HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+	benchState->requestLength = (ULONG) strlen(benchState->request);
+
+	HttpParser parser;
+
+	parser.Reset();
+
+	parser.Parse(benchState->request, benchState->requestLength, benchState->httpRequest);
+
+	benchmark.Run("HttpRouter::Match[4096]", &HttpRoute, benchState);
+
+	// the frames of the typical RPC, the header is the length in the network byte order
+	benchState->frameCodec = new FrameCodec(4, 0, 4, TRUE, FALSE, BENCH_FRAME_PAYLOAD_LENGTH);
+
+	for (ULONG frameIndex = 0; frameIndex < BENCH_FRAMES_COUNT; frameIndex++)
+	{
+		auto frame = benchState->frames + frameIndex * (4 + BENCH_FRAME_PAYLOAD_LENGTH);
+
+		benchState->frameCodec->Encode(frame, BENCH_FRAME_PAYLOAD_LENGTH);
+
+		memset(frame + 4, (int) frameIndex, BENCH_FRAME_PAYLOAD_LENGTH);
+	}
+
+	benchmark.Run("FrameCodec::Decode[64]", &FrameDecode, benchState);
+
+	return 0;
+}
+
+#pragma managed
+
+int main()
+{
+	return RunBenchmarks();
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Stdafx.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Decides whether the accepted connection should be served or refused with the busy response.
+		/// </summary>
+		/// <remarks>
+		/// The connection is refused when any of the limits of the worker is exceeded:
+		/// the count of the active connections, the count of the available buffers or the depth of the completion queue.
+		/// The limit which value is zero is not checked.
+		/// </remarks>
+		private class AdmissionControl final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The maximum number of the connections served by the worker at once.
+			/// </summary>
+			ULONG maxActiveConnections;
+
+			/// <summary>
+			/// The minimum number of the connections the free buffer segments are enough for, required to admit a connection.
+			/// </summary>
+			ULONG minAvailableBuffers;
+
+			/// <summary>
+			/// The maximum number of completions dequeued by the worker at once, above which the worker is considered saturated.
+			/// </summary>
+			ULONG maxCompletionQueueDepth;
+
+			/// <summary>
+			/// The count of the connections served by the worker.
+			/// </summary>
+			volatile LONG activeConnectionsCount;
+
+			/// <summary>
+			/// The number of completions dequeued by the last call of the worker.
+			/// </summary>
+			/// <remarks>
+			/// Is written by the worker thread only.
+			/// </remarks>
+			volatile ULONG completionQueueDepth;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="AdmissionControl" /> class.
+			/// </summary>
+			/// <param name="maxActiveConnections">The maximum number of the connections served by the worker at once.</param>
+			/// <param name="minAvailableBuffers">The minimum number of the connections the free buffer segments are enough for, required to admit a connection.</param>
+			/// <param name="maxCompletionQueueDepth">The maximum number of completions dequeued by the worker at once.</param>
+			inline AdmissionControl(ULONG maxActiveConnections, ULONG minAvailableBuffers, ULONG maxCompletionQueueDepth)
+			{
+				this->maxActiveConnections = maxActiveConnections;
+
+				this->minAvailableBuffers = minAvailableBuffers;
+
+				this->maxCompletionQueueDepth = maxCompletionQueueDepth;
+
+				this->activeConnectionsCount = 0;
+
+				this->completionQueueDepth = 0;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Tries to admit the accepted connection.
+			/// </summary>
+			/// <param name="availableBuffers">The count of the connections the free buffer segments of the worker can be rented to.</param>
+			/// <returns><c>TRUE</c> if the connection should be served; <c>FALSE</c> if it should be refused.</returns>
+			/// <remarks>
+			/// Each admitted connection must be released by the call to <see cref="Release" />.
+			/// </remarks>
+			inline BOOL TryAdmit(ULONG availableBuffers)
+			{
+				// check if worker is saturated
+				if ((maxCompletionQueueDepth != 0) && (completionQueueDepth > maxCompletionQueueDepth))
+				{
+					return FALSE;
+				}
+
+				// check if buffers are about to run out
+				if (availableBuffers < minAvailableBuffers)
+				{
+					return FALSE;
+				}
+
+				// take the slot
+				auto activeCount = (ULONG) ::InterlockedIncrement(&activeConnectionsCount);
+
+				// check if limit of the active connections is exceeded
+				if ((maxActiveConnections != 0) && (activeCount > maxActiveConnections))
+				{
+					// return the slot
+					::InterlockedDecrement(&activeConnectionsCount);
+
+					return FALSE;
+				}
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Releases the admitted connection.
+			/// </summary>
+			inline void Release()
+			{
+				::InterlockedDecrement(&activeConnectionsCount);
+			}
+
+			/// <summary>
+			/// Sets the number of completions dequeued by the last call of the worker.
+			/// </summary>
+			inline void SetCompletionQueueDepth(ULONG value)
+			{
+				completionQueueDepth = value;
+			}
+
+			/// <summary>
+			/// Gets the count of the connections served by the worker.
+			/// </summary>
+			inline ULONG GetActiveConnectionsCount()
+			{
+				return (ULONG) activeConnectionsCount;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
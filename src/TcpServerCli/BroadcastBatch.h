@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Ovelapped.h"
+#include "SharedPayload.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Identifies the connection to which the payload is broadcast.
+		/// </summary>
+		/// <remarks>
+		/// The slot of the connection is reused by the next client, so the target is told apart by the generation of the slot as well.
+		/// </remarks>
+		private struct BroadcastTarget final
+		{
+			public:
+
+			/// <summary>
+			/// The identifier of the connection within the worker.
+			/// </summary>
+			ULONG connectionId;
+
+			/// <summary>
+			/// The generation of the slot when the connection was chosen as the target.
+			/// </summary>
+			USHORT generation;
+		};
+
+		/// <summary>
+		/// Contains the connections of the single worker to which the payload is broadcast.
+		/// </summary>
+		/// <remarks>
+		/// Is posted to the completion port of the worker, which sends the payload on its own thread, so the structure starts with the <see cref="Ovelapped" />.
+		/// </remarks>
+		private struct BroadcastBatch final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The structure which carries the batch through the completion port.
+			/// </summary>
+			Ovelapped overlapped;
+
+			/// <summary>
+			/// The payload to send, the batch holds the reference to it.
+			/// </summary>
+			SharedPayload* payload;
+
+			/// <summary>
+			/// The count of the connections.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// The connections to which the payload is sent.
+			/// </summary>
+			BroadcastTarget targets[1];
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Allocates the batch for the specified count of the connections.
+			/// </summary>
+			/// <param name="payload">The payload to send, the reference to which is taken over by the batch.</param>
+			/// <param name="connectionsCount">The count of the connections.</param>
+			/// <returns>A pointer to the batch, or <c>null</c> if the memory can not be allocated.</returns>
+			inline static BroadcastBatch* Create(SharedPayload* payload, ULONG connectionsCount)
+			{
+				auto batch = (BroadcastBatch*) malloc(sizeof(BroadcastBatch) + sizeof(BroadcastTarget) * (connectionsCount - 1));
+
+				if (batch == nullptr)
+				{
+					return nullptr;
+				}
+
+				memset(&batch->overlapped, 0, sizeof(Ovelapped));
+
+				batch->overlapped.action = SOCK_ACTION_BROADCAST;
+
+				batch->payload = payload;
+
+				batch->connectionsCount = connectionsCount;
+
+				return batch;
+			}
+
+			/// <summary>
+			/// Releases the reference to the payload and frees the batch.
+			/// </summary>
+			inline static void Destroy(BroadcastBatch* batch)
+			{
+				batch->payload->Release();
+
+				free(batch);
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
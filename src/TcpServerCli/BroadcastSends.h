@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "SharedPayload.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Keeps the payloads of the broadcast sends of the single worker in progress.
+		/// </summary>
+		/// <remarks>
+		/// The broadcast send runs beside the operation of the connection, so its request context holds the index of the slot instead of the connection,
+		/// the slot keeps the reference to the payload until the send is completed.
+		/// Is used by the worker thread only.
+		/// </remarks>
+		private class BroadcastSends final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The payloads of the slots.
+			/// </summary>
+			SharedPayload** payloads;
+
+			/// <summary>
+			/// The stack of the indexes of the free slots.
+			/// </summary>
+			ULONG* freeSlots;
+
+			/// <summary>
+			/// The count of the free slots.
+			/// </summary>
+			ULONG freeSlotsCount;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor and Destructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="BroadcastSends" /> class.
+			/// </summary>
+			/// <param name="slotsCount">The maximum count of the broadcast sends in progress.</param>
+			inline BroadcastSends(ULONG slotsCount)
+			{
+				payloads = new SharedPayload*[slotsCount];
+
+				freeSlots = new ULONG[slotsCount];
+
+				// the lower slots are taken first
+				for (ULONG slotIndex = 0; slotIndex < slotsCount; slotIndex++)
+				{
+					freeSlots[slotIndex] = slotsCount - 1 - slotIndex;
+				}
+
+				freeSlotsCount = slotsCount;
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~BroadcastSends()
+			{
+				delete[] payloads;
+
+				delete[] freeSlots;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Takes the free slot and the reference to the payload.
+			/// </summary>
+			/// <returns>The index of the slot, or <c>ULONG_MAX</c> if all slots are taken.</returns>
+			inline ULONG Take(SharedPayload* payload)
+			{
+				if (freeSlotsCount == 0)
+				{
+					return ULONG_MAX;
+				}
+
+				auto slotIndex = freeSlots[--freeSlotsCount];
+
+				payload->AddReference();
+
+				payloads[slotIndex] = payload;
+
+				return slotIndex;
+			}
+
+			/// <summary>
+			/// Releases the reference to the payload and returns the slot.
+			/// </summary>
+			inline void Return(ULONG slotIndex)
+			{
+				payloads[slotIndex]->Release();
+
+				freeSlots[freeSlotsCount++] = slotIndex;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "TcpConnection.h"
+#include "ConnectionTable.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The kind of the completion of the Registered I/O operation, by which it is dispatched.
+		/// </summary>
+		enum CompletionKind
+		{
+			/// <summary>
+			/// The broadcast send, the request context holds the index of its slot instead of the connection.
+			/// </summary>
+			CompletionBroadcastSend,
+
+			/// <summary>
+			/// The receive or the send of the forwarding connection, the request context holds the kind of the operation.
+			/// </summary>
+			CompletionForward,
+
+			/// <summary>
+			/// The operation posted by the previous connection of the slot, which completes after the slot is reused.
+			/// </summary>
+			CompletionStale,
+
+			/// <summary>
+			/// The receive of the connection.
+			/// </summary>
+			CompletionReceive,
+
+			/// <summary>
+			/// The send of the response.
+			/// </summary>
+			CompletionSend,
+
+			/// <summary>
+			/// The send of the portion of the stream.
+			/// </summary>
+			CompletionStreamSend,
+
+			/// <summary>
+			/// The send of the busy response to the refused connection.
+			/// </summary>
+			CompletionRefuse,
+
+			/// <summary>
+			/// The operation not expected by the state of the slot.
+			/// </summary>
+			CompletionUnexpected,
+		};
+
+		/// <summary>
+		/// Keeps the rules by which the completions of the Registered I/O operations are dispatched.
+		/// </summary>
+		/// <remarks>
+		/// Is shared by the <see cref="IocpWorker" /> and the simulation, so the simulation checks the rules the server actually runs.
+		/// </remarks>
+		private class CompletionDispatch final
+		{
+			public:
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Classifies the completion by its request context and the state of the slot.
+			/// </summary>
+			/// <param name="connectionTable">A pointer to the storage of the connections.</param>
+			/// <param name="requestContext">The request context of the completed operation.</param>
+			/// <param name="connection">A pointer to the connection of the slot, or <c>null</c> if the context does not hold the slot.</param>
+			/// <returns>The kind of the completion.</returns>
+			inline static CompletionKind Classify(ConnectionTable* connectionTable, ULONG requestContext, TcpConnection*& connection)
+			{
+				connection = nullptr;
+
+				if ((requestContext & TCP_CONNECTION_BROADCAST_SEND) != 0)
+				{
+					return CompletionBroadcastSend;
+				}
+
+				// the kind of the operation of the forwarding connection is held by the request context
+				if ((requestContext & (TCP_CONNECTION_FORWARD_RECEIVE | TCP_CONNECTION_FORWARD_SEND)) != 0)
+				{
+					return CompletionForward;
+				}
+
+				// get connection from the table, without touching the managed object
+				connection = connectionTable->GetConnection(requestContext & TCP_CONNECTION_ID_MASK);
+
+				if (!connection->IsCurrent(requestContext))
+				{
+					return CompletionStale;
+				}
+
+				auto state = connection->state;
+
+				if (state == Receiving)
+				{
+					return CompletionReceive;
+				}
+
+				if (state == Sending)
+				{
+					return CompletionSend;
+				}
+
+				if (state == Streaming)
+				{
+					return CompletionStreamSend;
+				}
+
+				if (state == Refusing)
+				{
+					return CompletionRefuse;
+				}
+
+				return CompletionUnexpected;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
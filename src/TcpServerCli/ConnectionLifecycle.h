@@ -0,0 +1,1104 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "RioSizeClassPool.h"
+#include "TcpConnection.h"
+#include "ConnectionTable.h"
+#include "AdmissionControl.h"
+#include "StatisticsRegion.h"
+#include "TraceRing.h"
+#include "TcpListener.h"
+#include "TcpUpstream.h"
+#include "UpstreamPool.h"
+#include "HttpParser.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Keeps the transitions of the slots of the worker which do not depend on the handler: the admission, the rent and the return of the segments,
+		/// the growth of the receive, the keep-alive and the idle close, the refusal, the forwarding and the return to accept.
+		/// </summary>
+		/// <remarks>
+		/// Is shared by the <see cref="IocpWorker" /> and the simulation, as the <see cref="CompletionDispatch" /> is, so the simulation runs the transitions the server runs.
+		/// The methods which rent the segments are called by the thread which owns the buffer pool, the others are noted.
+		/// The overlapped disconnect, connect and accept complete through the caller, which passes them to <see cref="EndDisconnect" />, <see cref="EndConnect" /> and <see cref="Admit" />.
+		/// </remarks>
+		private class ConnectionLifecycle final
+		{
+			public:
+
+			#pragma region Constant Fields
+
+			/// <summary>
+			/// The count of the size classes of the Registered I/O buffer pool.
+			/// </summary>
+			static const ULONG SizeClassesCount = 3;
+
+			/// <summary>
+			/// The length of the segment of the smallest size class, the served connection starts receiving into it.
+			/// </summary>
+			static const ULONG SmallSegmentLength = 512;
+
+			/// <summary>
+			/// The length of the segment of the medium size class.
+			/// </summary>
+			static const ULONG MediumSegmentLength = 4096;
+
+			/// <summary>
+			/// The length of the segment of the largest size class.
+			/// </summary>
+			static const ULONG LargeSegmentLength = 65536;
+
+			#pragma endregion
+
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The storage of the connections.
+			/// </summary>
+			ConnectionTable* connectionTable;
+
+			/// <summary>
+			/// The Registered I/O buffer pool.
+			/// </summary>
+			RioSizeClassPool* rioBufferPool;
+
+			/// <summary>
+			/// The admission control of the worker.
+			/// </summary>
+			AdmissionControl* admissionControl;
+
+			/// <summary>
+			/// The pool of the connections to the upstreams which are not in use, or <c>null</c> if there are no upstreams.
+			/// </summary>
+			UpstreamPool* upstreamPool;
+
+			/// <summary>
+			/// The collection of the listeners.
+			/// </summary>
+			const TcpListener* listeners;
+
+			/// <summary>
+			/// The collection of the upstreams.
+			/// </summary>
+			const TcpUpstream* upstreams;
+
+			/// <summary>
+			/// The counters of the worker.
+			/// </summary>
+			WorkerCounters* counters;
+
+			/// <summary>
+			/// The trace ring of the worker.
+			/// </summary>
+			TraceRing* trace;
+
+			/// <summary>
+			/// The descriptor of the portion of the registered buffer that contains the busy response.
+			/// </summary>
+			PRIO_BUF busyResponse;
+
+			/// <summary>
+			/// The length of the receive segment of the forwarded and the upstream connections, which do not parse requests.
+			/// </summary>
+			ULONG receiveSegmentLength;
+
+			/// <summary>
+			/// The length of the segment used for sending data.
+			/// </summary>
+			ULONG sendSegmentLength;
+
+			/// <summary>
+			/// The length of the largest segment the receive of the served connection can grow into.
+			/// </summary>
+			ULONG maxReceiveLength;
+
+			/// <summary>
+			/// The time the connection waits for the next request, in the units of the tick count passed to <see cref="ExpireIdle" />, or zero if it waits without limit.
+			/// </summary>
+			ULONG64 keepAliveTimeout;
+
+			/// <summary>
+			/// The maximum count of the requests served by the single connection, or zero if the count is not limited.
+			/// </summary>
+			ULONG maxKeepAliveRequests;
+
+			/// <summary>
+			/// Indicates whether the connections receive into the mirrored rings instead of the segments of the pool.
+			/// </summary>
+			BOOL useReceiveRings;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="ConnectionLifecycle" /> class.
+			/// </summary>
+			/// <param name="connectionTable">A pointer to the storage of the connections.</param>
+			/// <param name="rioBufferPool">A pointer to the buffer pool sized by the <see cref="GetSegmentsCounts" />.</param>
+			/// <param name="admissionControl">A pointer to the admission control of the worker.</param>
+			/// <param name="upstreamPool">A pointer to the pool of the connections to the upstreams, or <c>null</c> if there are no upstreams.</param>
+			/// <param name="listeners">A pointer to the collection of the listeners.</param>
+			/// <param name="upstreams">A pointer to the collection of the upstreams.</param>
+			/// <param name="counters">A pointer to the counters of the worker.</param>
+			/// <param name="trace">A pointer to the trace ring of the worker.</param>
+			/// <param name="busyResponse">The descriptor of the portion of the registered buffer that contains the busy response.</param>
+			/// <param name="receiveSegmentLength">The length of the receive segment of the forwarded and the upstream connections.</param>
+			/// <param name="sendSegmentLength">The length of the segment used for sending data.</param>
+			/// <param name="maxReceiveLength">The length of the largest segment the receive of the served connection can grow into.</param>
+			/// <param name="keepAliveTimeout">The time the connection waits for the next request, or zero if it waits without limit.</param>
+			/// <param name="maxKeepAliveRequests">The maximum count of the requests served by the single connection, or zero if the count is not limited.</param>
+			/// <param name="useReceiveRings">Indicates whether the connections receive into the mirrored rings instead of the segments of the pool.</param>
+			inline ConnectionLifecycle(ConnectionTable* connectionTable, RioSizeClassPool* rioBufferPool, AdmissionControl* admissionControl, UpstreamPool* upstreamPool, const TcpListener* listeners, const TcpUpstream* upstreams, WorkerCounters* counters, TraceRing* trace, PRIO_BUF busyResponse, ULONG receiveSegmentLength, ULONG sendSegmentLength, ULONG maxReceiveLength, ULONG64 keepAliveTimeout, ULONG maxKeepAliveRequests, BOOL useReceiveRings)
+			{
+				this->connectionTable = connectionTable;
+
+				this->rioBufferPool = rioBufferPool;
+
+				this->admissionControl = admissionControl;
+
+				this->upstreamPool = upstreamPool;
+
+				this->listeners = listeners;
+
+				this->upstreams = upstreams;
+
+				this->counters = counters;
+
+				this->trace = trace;
+
+				this->busyResponse = busyResponse;
+
+				this->receiveSegmentLength = receiveSegmentLength;
+
+				this->sendSegmentLength = sendSegmentLength;
+
+				this->maxReceiveLength = maxReceiveLength;
+
+				this->keepAliveTimeout = keepAliveTimeout;
+
+				this->maxKeepAliveRequests = maxKeepAliveRequests;
+
+				this->useReceiveRings = useReceiveRings;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods of the Buffer Pool
+
+			/// <summary>
+			/// Gets the lengths of the segments of the size classes.
+			/// </summary>
+			inline static const ULONG* GetSegmentLengths()
+			{
+				static const ULONG segmentLengths[SizeClassesCount] = { SmallSegmentLength, MediumSegmentLength, LargeSegmentLength };
+
+				return segmentLengths;
+			}
+
+			/// <summary>
+			/// Gets the index of the smallest size class which segments can hold the specified amount of bytes.
+			/// </summary>
+			inline static ULONG GetSizeClass(ULONG length)
+			{
+				return length <= SmallSegmentLength ? 0 : length <= MediumSegmentLength ? 1 : 2;
+			}
+
+			/// <summary>
+			/// Gets the counts of the segments of the size classes of the buffer pool.
+			/// </summary>
+			/// <param name="servedConnectionsCount">The count of the connections served by the handler.</param>
+			/// <param name="otherConnectionsCount">The count of the forwarded and the upstream connections.</param>
+			/// <param name="receiveSegmentLength">The average length of the receive memory per connection, by which the larger size classes are sized.</param>
+			/// <param name="sendSegmentLength">The length of the segment used for sending data.</param>
+			/// <param name="useReceiveRings">Indicates whether the connections receive into the mirrored rings instead of the segments of the pool.</param>
+			/// <param name="segmentsCounts">The array of <see cref="SizeClassesCount" /> elements to receive the counts.</param>
+			/// <returns>The length of the largest segment the receive of the served connection can grow into.</returns>
+			/// <remarks>
+			/// The accepted connection rents its segments on admit and returns them on disconnect, the upstream connection keeps them.
+			/// </remarks>
+			inline static ULONG GetSegmentsCounts(ULONG servedConnectionsCount, ULONG otherConnectionsCount, ULONG receiveSegmentLength, ULONG sendSegmentLength, BOOL useReceiveRings, ULONG* segmentsCounts)
+			{
+				for (ULONG classIndex = 0; classIndex < SizeClassesCount; classIndex++)
+				{
+					segmentsCounts[classIndex] = 0;
+				}
+
+				segmentsCounts[GetSizeClass(sendSegmentLength)] += servedConnectionsCount + otherConnectionsCount;
+
+				// the rings are mapped per connection
+				if (!useReceiveRings)
+				{
+					// the forwarded and the upstream connections do not parse requests, so their receive does not grow
+					segmentsCounts[GetSizeClass(receiveSegmentLength)] += otherConnectionsCount;
+
+					// the served connection starts with the smallest segment, the larger classes share the rest of the memory of the full length segments
+					segmentsCounts[0] += servedConnectionsCount;
+
+					if (receiveSegmentLength > SmallSegmentLength)
+					{
+						auto growLength = (ULONG64) servedConnectionsCount * (receiveSegmentLength - SmallSegmentLength) / 2;
+
+						segmentsCounts[1] += (ULONG) (growLength / MediumSegmentLength);
+
+						segmentsCounts[2] += (ULONG) (growLength / LargeSegmentLength);
+					}
+
+					// the request of the full length fits at least one connection at once
+					if ((servedConnectionsCount != 0) && (segmentsCounts[GetSizeClass(receiveSegmentLength)] == 0))
+					{
+						segmentsCounts[GetSizeClass(receiveSegmentLength)] = 1;
+					}
+				}
+
+				// the receive grows into the largest class which has segments
+				auto segmentLengths = GetSegmentLengths();
+
+				ULONG result = SmallSegmentLength;
+
+				for (ULONG classIndex = 0; classIndex < SizeClassesCount; classIndex++)
+				{
+					if (segmentsCounts[classIndex] != 0)
+					{
+						result = segmentLengths[classIndex];
+					}
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Gets the approximate count of the connections the free segments of the buffer pool can be rented to, may be called by any thread.
+			/// </summary>
+			inline ULONG GetAvailableBuffers()
+			{
+				auto sendClass = GetSizeClass(sendSegmentLength);
+
+				auto availableBuffers = rioBufferPool->GetAvailableCount(sendClass);
+
+				// the ring is not rented
+				if (useReceiveRings)
+				{
+					return availableBuffers;
+				}
+
+				// both segments of the connection are taken from the smallest class
+				if (sendClass == 0)
+				{
+					return availableBuffers / 2;
+				}
+
+				// the served connection starts receiving into the smallest segment
+				auto availableReceiveBuffers = rioBufferPool->GetAvailableCount(0);
+
+				return availableReceiveBuffers < availableBuffers ? availableReceiveBuffers : availableBuffers;
+			}
+
+			/// <summary>
+			/// Rents the receive and send segments of the connection, is called by the thread which owns the buffer pool.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <param name="receiveLength">The length of the receive segment, the larger segment is rented if the suitable size class is exhausted.</param>
+			/// <returns><c>TRUE</c> if the segments are rented; otherwise, <c>FALSE</c>, if the pool is exhausted.</returns>
+			inline BOOL RentSegments(TcpConnection* connection, ULONG receiveLength)
+			{
+				auto context = connection->context;
+
+				RioSegment receiveSegment;
+
+				// the ring is not rented
+				if (!useReceiveRings)
+				{
+					if (!rioBufferPool->Allocate(receiveLength, receiveSegment))
+					{
+						return FALSE;
+					}
+				}
+
+				RioSegment sendSegment;
+
+				if (!rioBufferPool->Allocate(sendSegmentLength, sendSegment))
+				{
+					if (!useReceiveRings)
+					{
+						rioBufferPool->Free(receiveSegment.handle);
+					}
+
+					return FALSE;
+				}
+
+				if (!useReceiveRings)
+				{
+					connection->rioReceiveBuffer = receiveSegment.rioBuffer;
+
+					context->receiveSegment = receiveSegment.handle;
+				}
+
+				connection->rioSendBuffer = sendSegment.rioBuffer;
+
+				context->sendSegment = sendSegment.handle;
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Returns the segments rented by the connection into the buffer pool, may be called by any thread.
+			/// </summary>
+			/// <remarks>
+			/// Should be called once the operations of the connection are completed or aborted by the disconnect, as the segments may be rented by the next connection at once.
+			/// The owner thread returns the segments into the local lists of the pool, the other threads through its remote lists.
+			/// </remarks>
+			inline void ReturnSegments(TcpConnection* connection)
+			{
+				auto context = connection->context;
+
+				if (context->receiveSegment != RIO_SEGMENT_NIL)
+				{
+					rioBufferPool->Release(context->receiveSegment);
+
+					context->receiveSegment = RIO_SEGMENT_NIL;
+				}
+
+				if (context->sendSegment != RIO_SEGMENT_NIL)
+				{
+					rioBufferPool->Release(context->sendSegment);
+
+					context->sendSegment = RIO_SEGMENT_NIL;
+				}
+			}
+
+			/// <summary>
+			/// Gets a pointer to the data of the buffer of the pool.
+			/// </summary>
+			inline PCHAR GetData(const RIO_BUF& rioBuffer)
+			{
+				return rioBufferPool->GetData(rioBuffer);
+			}
+
+			/// <summary>
+			/// Gets a pointer to the data of the receive buffer, which is the window of the ring if the connection receives into the mirrored ring.
+			/// </summary>
+			inline PCHAR GetReceiveData(TcpConnection* connection)
+			{
+				auto receiveRing = connection->context->receiveRing;
+
+				return receiveRing != nullptr ? receiveRing->GetData(connection->rioReceiveBuffer) : rioBufferPool->GetData(connection->rioReceiveBuffer);
+			}
+
+			/// <summary>
+			/// Gets the maximum length of the data the connection can receive at once, which bounds the length of the request.
+			/// </summary>
+			/// <remarks>
+			/// The ring does not grow, the segment grows up to the largest size class of the pool.
+			/// </remarks>
+			inline ULONG GetReceiveLimit(TcpConnection* connection)
+			{
+				return connection->context->receiveRing != nullptr ? connection->rioReceiveBuffer.Length : maxReceiveLength;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods of the Admission
+
+			/// <summary>
+			/// Decides whether the accepted connection should be served, refuses it otherwise, may be called by any thread.
+			/// </summary>
+			/// <param name="connection">A pointer to the accepted connection, which accept context is updated.</param>
+			/// <returns><c>TRUE</c> if the connection is admitted and should be passed to <see cref="EndAdmit" /> on the owner thread of the pool; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// The refused connection is sent the busy response from the shared buffer, then disconnected and returned to accept, nothing waits for the disconnect.
+			/// </remarks>
+			inline BOOL Admit(TcpConnection* connection)
+			{
+				counters->acceptsCount++;
+
+				// the slot holds the new connection
+				connection->generation++;
+
+				if (!admissionControl->TryAdmit(GetAvailableBuffers()))
+				{
+					counters->refusalsCount++;
+
+					Refuse(connection);
+
+					return FALSE;
+				}
+
+				connection->state = ConnectionState::Accepted;
+
+				trace->Record(connection, ConnectionState::Accepting, 0, 0);
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Rents the segments of the admitted connection and starts forwarding it, if its listener forwards the connections to the upstream.
+			/// </summary>
+			/// <param name="connection">A pointer to the admitted connection.</param>
+			/// <returns><c>TRUE</c> if the connection should be served by the handler; otherwise, <c>FALSE</c>, if it is forwarded or refused.</returns>
+			/// <remarks>
+			/// The connection the pool has no free segments for is refused.
+			/// </remarks>
+			inline BOOL EndAdmit(TcpConnection* connection)
+			{
+				auto forwards = listeners[connection->context->listenerIndex].upstreamIndex != ULONG_MAX;
+
+				// the served connection starts with the smallest receive segment, the forwarded one does not parse requests, so its receive does not grow
+				if (!RentSegments(connection, forwards ? receiveSegmentLength : SmallSegmentLength))
+				{
+					counters->bufferRefusalsCount++;
+
+					admissionControl->Release();
+
+					Refuse(connection);
+
+					return FALSE;
+				}
+
+				if (forwards)
+				{
+					StartForward(connection);
+
+					return FALSE;
+				}
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Sends the busy response to the connection, which is disconnected and returned to accept once the response is sent.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			inline void Refuse(TcpConnection* connection)
+			{
+				auto fromState = connection->state;
+
+				auto refuseResult = connection->StartRefuse(busyResponse);
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(refuseResult));
+
+				// check if operation has failed
+				if (!refuseResult)
+				{
+					// nothing to wait for, return connection to accept
+					ReturnToAccept(connection);
+				}
+			}
+
+			/// <summary>
+			/// Starts the disconnect of the connection which is not served, its slot is returned to accept once the disconnect completes.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <remarks>
+			/// The disconnect is overlapped, so the caller does not wait for it, see <see cref="EndDisconnect" />.
+			/// </remarks>
+			inline void ReturnToAccept(TcpConnection* connection)
+			{
+				auto fromState = connection->state;
+
+				auto error = TraceRing::GetError(connection->StartOverlappedDisconnect());
+
+				trace->Record(connection, fromState, 0, error);
+
+				// the failed disconnect is never completed
+				if (error != 0)
+				{
+					auto acceptResult = connection->StartAccept();
+
+					trace->Record(connection, ConnectionState::Disconnecting, 0, TraceRing::GetError(acceptResult));
+				}
+			}
+
+			/// <summary>
+			/// Processes the completion of the overlapped disconnect of the connection.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <param name="error">The error of the disconnect, or zero if it has succeed.</param>
+			/// <remarks>
+			/// The connection which has no peer, the refused or the abandoned one, is returned to accept;
+			/// the connection of the closing forwarding pair is released with its peer.
+			/// </remarks>
+			inline void EndDisconnect(TcpConnection* connection, ULONG error)
+			{
+				trace->Record(connection, ConnectionState::Disconnecting, 0, error);
+
+				if (connection->context->peerId == ULONG_MAX)
+				{
+					auto acceptResult = connection->StartAccept();
+
+					trace->Record(connection, ConnectionState::Disconnecting, 0, TraceRing::GetError(acceptResult));
+
+					return;
+				}
+
+				// the accepted connection keeps the state of the pair
+				auto client = connection->context->upstreamIndex == ULONG_MAX ? connection : connectionTable->GetConnection(connection->context->peerId);
+
+				client->context->forwardPendingCount--;
+
+				CloseForward(client);
+			}
+
+			/// <summary>
+			/// Disconnects the served connection, returns its segments and its admission and starts accept on its slot, is called by the handler.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			inline void Disconnect(TcpConnection* connection)
+			{
+				auto fromState = connection->state;
+
+				connection->state = ConnectionState::Disconnected;
+
+				auto res = connection->StartDisconnect();
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+				// return the segments and the slot admitted on accept
+				ReturnSegments(connection);
+
+				admissionControl->Release();
+
+				res = connection->StartAccept();
+
+				trace->Record(connection, ConnectionState::Disconnecting, 0, TraceRing::GetError(res));
+			}
+
+			#pragma endregion
+
+			#pragma region Methods of the Requests
+
+			/// <summary>
+			/// Ends the receive of the connection, the data received is appended to the data not consumed yet.
+			/// </summary>
+			inline static void EndReceive(TcpConnection* connection, ULONG bytesTransferred)
+			{
+				connection->context->receivedLength += bytesTransferred;
+
+				connection->state = ConnectionState::Received;
+			}
+
+			/// <summary>
+			/// Processes the completion of the receive of the served connection, the handler is resumed by the caller.
+			/// </summary>
+			inline void CompleteReceive(TcpConnection* connection, const RIORESULT& rioResult)
+			{
+				counters->receivesCount++;
+
+				counters->bytesReceived += rioResult.BytesTransferred;
+
+				EndReceive(connection, rioResult.BytesTransferred);
+
+				trace->Record(connection, ConnectionState::Receiving, rioResult.BytesTransferred, rioResult.Status);
+			}
+
+			/// <summary>
+			/// Processes the completion of the send of the response, the handler is resumed by the caller.
+			/// </summary>
+			inline void CompleteSend(TcpConnection* connection, const RIORESULT& rioResult)
+			{
+				counters->sendsCount++;
+
+				counters->bytesSent += rioResult.BytesTransferred;
+
+				// the payload is no longer read by the send
+				connection->ReleaseSendPayload();
+
+				connection->state = ConnectionState::Sent;
+
+				trace->Record(connection, ConnectionState::Sending, rioResult.BytesTransferred, rioResult.Status);
+			}
+
+			/// <summary>
+			/// Parses the request line and the headers of the next request, nothing is consumed.
+			/// </summary>
+			/// <returns>The result of the parse, the incomplete request which fills the whole buffer that can not grow is the error.</returns>
+			inline HttpParseResult ParseRequest(TcpConnection* connection, HttpRequest& request)
+			{
+				auto context = connection->context;
+
+				auto data = GetReceiveData(connection) + context->consumedLength;
+
+				auto length = context->receivedLength - context->consumedLength;
+
+				// the request which fills the whole buffer can not be received, unless the buffer can grow
+				auto bufferFull = (context->consumedLength == 0) && (context->receivedLength == GetReceiveLimit(connection));
+
+				auto result = context->httpParser.Parse(data, length, request);
+
+				return (result == HttpParseIncomplete) && bufferFull ? HttpParseError : result;
+			}
+
+			/// <summary>
+			/// Consumes the request of the specified length, counts it against the limit of the keep-alive.
+			/// </summary>
+			inline static void ConsumeRequest(TcpConnection* connection, ULONG length)
+			{
+				connection->context->consumedLength += length;
+
+				connection->context->requestsCount++;
+			}
+
+			/// <summary>
+			/// Determines whether the connection is kept alive after the response to the last request consumed.
+			/// </summary>
+			inline BOOL KeepsAlive(TcpConnection* connection, const HttpRequest& request)
+			{
+				return request.IsKeepAlive() && ((maxKeepAliveRequests == 0) || (connection->context->requestsCount < maxKeepAliveRequests));
+			}
+
+			/// <summary>
+			/// Moves the data not consumed yet to the beginning of the receive buffer, before the receive of the next request.
+			/// </summary>
+			/// <returns><c>TRUE</c> if the data fills the whole segment, which should be replaced by <see cref="EndGrowReceive" /> before the receive; otherwise, <c>FALSE</c>.</returns>
+			inline BOOL CompactReceive(TcpConnection* connection)
+			{
+				auto context = connection->context;
+
+				auto unconsumedLength = context->receivedLength - context->consumedLength;
+
+				if (context->receiveRing != nullptr)
+				{
+					// move the window of the ring to the beginning of the next request, the data stays in place
+					context->receiveRing->Advance(connection->rioReceiveBuffer, context->consumedLength);
+				}
+				else if ((context->consumedLength != 0) && (unconsumedLength != 0))
+				{
+					// move the beginning of the next request to the start of the buffer
+					auto data = GetReceiveData(connection);
+
+					memmove(data, data + context->consumedLength, unconsumedLength);
+				}
+
+				context->receivedLength = unconsumedLength;
+
+				context->consumedLength = 0;
+
+				return (context->receivedLength == connection->rioReceiveBuffer.Length) && (context->receivedLength < GetReceiveLimit(connection));
+			}
+
+			/// <summary>
+			/// Starts the receive of the rest of the request into the buffer, the connection which has served the request becomes idle.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <param name="tickCount">The current tick count.</param>
+			inline BOOL ReceiveNext(TcpConnection* connection, ULONG64 tickCount)
+			{
+				auto context = connection->context;
+
+				auto fromState = connection->state;
+
+				// the connection which has served the request waits for the next one
+				context->idleSince = context->requestsCount != 0 ? tickCount : 0;
+
+				auto res = connection->StartReceiveNext();
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+				return res;
+			}
+
+			/// <summary>
+			/// Marks the connection which receive segment is full as receiving, while the owner thread of the pool replaces the segment.
+			/// </summary>
+			inline static void BeginGrowReceive(TcpConnection* connection)
+			{
+				// the connection is not idle, while the segment is replaced
+				connection->context->idleSince = 0;
+
+				connection->state = ConnectionState::Receiving;
+			}
+
+			/// <summary>
+			/// Replaces the full receive segment of the connection with the segment of the next size class and receives the rest of the request into it.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <param name="tickCount">The current tick count.</param>
+			/// <returns><c>TRUE</c> if the receive is started; otherwise, <c>FALSE</c>, if the pool has no larger free segment and the receive is ended with zero bytes.</returns>
+			/// <remarks>
+			/// Is called by the thread which owns the pool. The data received is moved to the new segment, the old one is returned into the pool.
+			/// </remarks>
+			inline BOOL EndGrowReceive(TcpConnection* connection, ULONG64 tickCount)
+			{
+				auto context = connection->context;
+
+				RioSegment segment;
+
+				// the segment of the next size class, or of the larger one if it is exhausted
+				if (!rioBufferPool->Allocate(connection->rioReceiveBuffer.Length + 1, segment))
+				{
+					trace->Record(connection, ConnectionState::Receiving, 0, WSAENOBUFS);
+
+					EndReceive(connection, 0);
+
+					return FALSE;
+				}
+
+				memcpy(segment.data, rioBufferPool->GetData(connection->rioReceiveBuffer), context->receivedLength);
+
+				rioBufferPool->Free(context->receiveSegment);
+
+				context->receiveSegment = segment.handle;
+
+				connection->rioReceiveBuffer = segment.rioBuffer;
+
+				ReceiveNext(connection, tickCount);
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Ends the receive of the connection which has waited for the next request longer than the timeout.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <param name="tickCount">The current tick count.</param>
+			/// <returns><c>TRUE</c> if the receive is ended with zero bytes, so the handler should disconnect the connection as closed by the client; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// The receive posted to the system stays in progress until the socket is disconnected, so the generation of the slot is moved on
+			/// before the fake completion: the late completion of the real receive carries the previous generation and is dropped, whatever the slot does by then.
+			/// </remarks>
+			inline BOOL ExpireIdle(TcpConnection* connection, ULONG64 tickCount)
+			{
+				if (connection->state != ConnectionState::Receiving)
+				{
+					return FALSE;
+				}
+
+				auto context = connection->context;
+
+				if ((keepAliveTimeout == 0) || (context->idleSince == 0) || (tickCount - context->idleSince < keepAliveTimeout))
+				{
+					return FALSE;
+				}
+
+				context->idleSince = 0;
+
+				trace->Record(connection, ConnectionState::Receiving, 0, WSAETIMEDOUT);
+
+				// the real receive is abandoned
+				connection->generation++;
+
+				EndReceive(connection, 0);
+
+				return TRUE;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods of the Forwarding
+
+			/// <summary>
+			/// Pairs the accepted connection with the connection to the upstream, connects the latter if it is not idle.
+			/// </summary>
+			/// <param name="client">A pointer to the accepted connection.</param>
+			inline void StartForward(TcpConnection* client)
+			{
+				auto upstreamIndex = listeners[client->context->listenerIndex].upstreamIndex;
+
+				ULONG upstreamId;
+
+				BOOL connected;
+
+				// check if all connections to the upstream are in use
+				if (!upstreamPool->TryAcquire(upstreamIndex, upstreamId, connected))
+				{
+					counters->forwardRefusalsCount++;
+
+					AbandonForward(client);
+
+					return;
+				}
+
+				auto upstream = connectionTable->GetConnection(upstreamId);
+
+				client->context->peerId = upstreamId;
+
+				upstream->context->peerId = client->id;
+
+				if (connected)
+				{
+					BeginForward(client, upstream);
+
+					return;
+				}
+
+				// the slot holds the new connection
+				upstream->generation++;
+
+				auto upstreamAddress = upstreams + upstreamIndex;
+
+				auto connectResult = upstream->StartConnect((const sockaddr *)&upstreamAddress->address, upstreamAddress->addressLength);
+
+				auto error = TraceRing::GetError(connectResult);
+
+				trace->Record(upstream, ConnectionState::Disconnected, 0, error);
+
+				// check if operation has failed
+				if (error != 0)
+				{
+					upstream->state = ConnectionState::Disconnected;
+
+					upstream->context->peerId = ULONG_MAX;
+
+					upstreamPool->Release(upstreamIndex, upstreamId, FALSE);
+
+					AbandonForward(client);
+				}
+			}
+
+			/// <summary>
+			/// Processes the completion of the connect of the upstream connection.
+			/// </summary>
+			/// <param name="connection">A pointer to the upstream connection.</param>
+			/// <param name="winsockErrorCode">The error code of the connect, or zero if the connection is made.</param>
+			/// <returns><c>TRUE</c> if the connection has been made for forwarding and the completion is processed; otherwise, <c>FALSE</c>, if the handler waits for it.</returns>
+			inline BOOL EndConnect(TcpConnection* connection, int winsockErrorCode)
+			{
+				trace->Record(connection, ConnectionState::Connecting, 0, winsockErrorCode);
+
+				auto peerId = connection->context->peerId;
+
+				if (winsockErrorCode != 0)
+				{
+					// return the slot, the next use tries to connect again
+					connection->state = ConnectionState::Disconnected;
+
+					connection->context->peerId = ULONG_MAX;
+
+					upstreamPool->Release(connection->context->upstreamIndex, connection->id, FALSE);
+				}
+
+				// the connection made for forwarding has no task, the accepted connection waits for it instead
+				if (peerId == ULONG_MAX)
+				{
+					return FALSE;
+				}
+
+				auto client = connectionTable->GetConnection(peerId);
+
+				if (winsockErrorCode == 0)
+				{
+					BeginForward(client, connection);
+				}
+				else
+				{
+					AbandonForward(client);
+				}
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Starts receiving on both connections of the pair.
+			/// </summary>
+			/// <param name="client">A pointer to the accepted connection.</param>
+			/// <param name="upstream">A pointer to the connection to the upstream.</param>
+			inline void BeginForward(TcpConnection* client, TcpConnection* upstream)
+			{
+				auto context = client->context;
+
+				context->forwardPendingCount = 0;
+
+				context->forwardClosing = FALSE;
+
+				auto fromState = client->state;
+
+				client->state = ConnectionState::Forwarding;
+
+				trace->Record(client, fromState, 0, 0);
+
+				fromState = upstream->state;
+
+				upstream->state = ConnectionState::Forwarding;
+
+				trace->Record(upstream, fromState, 0, 0);
+
+				if (!client->StartForwardReceive())
+				{
+					CloseForward(client);
+
+					return;
+				}
+
+				context->forwardPendingCount++;
+
+				if (!upstream->StartForwardReceive())
+				{
+					CloseForward(client);
+
+					return;
+				}
+
+				context->forwardPendingCount++;
+			}
+
+			/// <summary>
+			/// Processes the completion of the operation of the forwarding connection.
+			/// </summary>
+			/// <param name="requestContext">The request context of the operation, which holds the identifier of the connection and the kind of the operation.</param>
+			/// <param name="rioResult">The result of the operation.</param>
+			/// <remarks>
+			/// The received data is sent to the peer from the receive buffer, and the connection receives again only when the send completes,
+			/// so the buffer is never overwritten while it is sent and each direction is paced by its slower side.
+			/// </remarks>
+			inline void ProcessForward(ULONG requestContext, const RIORESULT& rioResult)
+			{
+				auto connection = connectionTable->GetConnection(requestContext & TCP_CONNECTION_ID_MASK);
+
+				auto peer = connectionTable->GetConnection(connection->context->peerId);
+
+				// the accepted connection keeps the state of the pair
+				auto client = connection->context->upstreamIndex == ULONG_MAX ? connection : peer;
+
+				auto context = client->context;
+
+				context->forwardPendingCount--;
+
+				trace->Record(connection, ConnectionState::Forwarding, rioResult.BytesTransferred, rioResult.Status);
+
+				if ((requestContext & TCP_CONNECTION_FORWARD_RECEIVE) != 0)
+				{
+					counters->receivesCount++;
+
+					counters->bytesReceived += rioResult.BytesTransferred;
+
+					// check if the pair is closing, or the connection is closed by the other side
+					if (context->forwardClosing || (rioResult.Status != 0) || (rioResult.BytesTransferred == 0))
+					{
+						CloseForward(client);
+
+						return;
+					}
+
+					// send the data directly from the receive buffer of the connection
+					auto data = connection->rioReceiveBuffer;
+
+					data.Length = rioResult.BytesTransferred;
+
+					if (!peer->StartForwardSend(data))
+					{
+						CloseForward(client);
+
+						return;
+					}
+				}
+				else
+				{
+					counters->sendsCount++;
+
+					counters->bytesSent += rioResult.BytesTransferred;
+
+					if (context->forwardClosing || (rioResult.Status != 0))
+					{
+						CloseForward(client);
+
+						return;
+					}
+
+					// the data of the peer is sent, so its receive buffer can be reused
+					if (!peer->StartForwardReceive())
+					{
+						CloseForward(client);
+
+						return;
+					}
+				}
+
+				context->forwardPendingCount++;
+			}
+
+			/// <summary>
+			/// Closes both connections of the pair, releases them when all operations in progress are completed.
+			/// </summary>
+			/// <param name="client">A pointer to the accepted connection.</param>
+			/// <remarks>
+			/// The connection to the upstream is not kept alive, as the state of the stream forwarded through it is unknown.
+			/// </remarks>
+			inline void CloseForward(TcpConnection* client)
+			{
+				auto context = client->context;
+
+				auto upstream = connectionTable->GetConnection(context->peerId);
+
+				if (!context->forwardClosing)
+				{
+					context->forwardClosing = TRUE;
+
+					// disconnecting the sockets completes the operations in progress, nothing waits for the disconnects
+					auto error = TraceRing::GetError(client->StartOverlappedDisconnect());
+
+					trace->Record(client, ConnectionState::Forwarding, 0, error);
+
+					// the disconnect in progress is counted as the operation of the pair
+					if (error == 0)
+					{
+						context->forwardPendingCount++;
+					}
+
+					error = TraceRing::GetError(upstream->StartOverlappedDisconnect());
+
+					trace->Record(upstream, ConnectionState::Forwarding, 0, error);
+
+					if (error == 0)
+					{
+						context->forwardPendingCount++;
+					}
+				}
+
+				// check if there are operations which still refer to the buffers of the pair
+				if (context->forwardPendingCount != 0)
+				{
+					return;
+				}
+
+				upstream->state = ConnectionState::Disconnected;
+
+				upstream->context->peerId = ULONG_MAX;
+
+				upstreamPool->Release(upstream->context->upstreamIndex, upstream->id, FALSE);
+
+				context->peerId = ULONG_MAX;
+
+				// return the segments and the slot admitted on accept
+				ReturnSegments(client);
+
+				admissionControl->Release();
+
+				auto acceptResult = client->StartAccept();
+
+				trace->Record(client, ConnectionState::Disconnecting, 0, TraceRing::GetError(acceptResult));
+			}
+
+			/// <summary>
+			/// Returns the accepted connection which could not be paired with the connection to the upstream to accept.
+			/// </summary>
+			/// <param name="client">A pointer to the accepted connection.</param>
+			/// <remarks>
+			/// Nothing waits for the disconnect, the slot is returned to accept by the <see cref="EndDisconnect" />.
+			/// </remarks>
+			inline void AbandonForward(TcpConnection* client)
+			{
+				client->context->peerId = ULONG_MAX;
+
+				// return the segments and the slot admitted on accept, nothing refers to them as the pair was not made
+				ReturnSegments(client);
+
+				admissionControl->Release();
+
+				ReturnToAccept(client);
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
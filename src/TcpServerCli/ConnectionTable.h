@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "TcpConnection.h"
+#include "LatencyHistogram.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Provides storage of the connections of the single worker within one contiguous memory block.
+		/// </summary>
+		/// <remarks>
+		/// The block is split into three arrays: the array of the <see cref="TcpConnection" /> items, each of which occupies one cache line,
+		/// the array of the <see cref="TcpConnectionContext" /> items, which are accessed on accept and disconnect and by the handler reading the request,
+		/// and the array of the <see cref="ConnectionTimestamps" /> items, which are written once per stage of the request.
+		/// </remarks>
+		private class ConnectionTable final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The count of the connections.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// A pointer to the memory block.
+			/// </summary>
+			LPVOID memoryBlock;
+
+			/// <summary>
+			/// The collection of the items of the <see cref="TcpConnection" /> type.
+			/// </summary>
+			TcpConnection* connections;
+
+			/// <summary>
+			/// The collection of the items of the <see cref="TcpConnectionContext" /> type.
+			/// </summary>
+			TcpConnectionContext* contexts;
+
+			/// <summary>
+			/// The collection of the items of the <see cref="ConnectionTimestamps" /> type.
+			/// </summary>
+			ConnectionTimestamps* timestamps;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="ConnectionTable" /> class.
+			/// </summary>
+			/// <param name="connectionsCount">The count of the connections.</param>
+			/// <param name="memoryBlock">A pointer to the page aligned memory block.</param>
+			inline ConnectionTable(ULONG connectionsCount, LPVOID memoryBlock)
+			{
+				this->connectionsCount = connectionsCount;
+
+				this->memoryBlock = memoryBlock;
+
+				// hot items are placed at the start of the block, which is page aligned
+				this->connections = (TcpConnection*) memoryBlock;
+
+				// cold items follow the hot ones, the offset is a multiple of the cache line length
+				this->contexts = (TcpConnectionContext*) (connections + connectionsCount);
+
+				// timestamps follow the cold items
+				this->timestamps = (ConnectionTimestamps*) (contexts + connectionsCount);
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="ConnectionTable" /> class.
+			/// </summary>
+			/// <param name="connectionsCount">The count of the connections to store.</param>
+			/// <param name="kernelErrorCode">The error code of the kernel if operation has failed.</param>
+			/// <returns>A pointer to the instance of the class if operation has succeed; otherwise, <c>null</c>.</returns>
+			inline static ConnectionTable* Create(ULONG connectionsCount, DWORD& kernelErrorCode)
+			{
+				// calculate the length of the memory block
+				auto memoryBlockLength = (sizeof(TcpConnection) + sizeof(TcpConnectionContext) + sizeof(ConnectionTimestamps)) * connectionsCount;
+
+				// reserve and commit page aligned memory block, memory is zeroed by the kernel
+				auto memoryBlock = ::VirtualAlloc(nullptr, memoryBlockLength, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					return nullptr;
+				}
+
+				kernelErrorCode = 0;
+
+				// initialize and return result
+				return new ConnectionTable(connectionsCount, memoryBlock);
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~ConnectionTable()
+			{
+				// free allocated memory
+				// ignore result
+				::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the count of the connections.
+			/// </summary>
+			inline ULONG GetCount()
+			{
+				return connectionsCount;
+			}
+
+			/// <summary>
+			/// Gets a pointer to the connection.
+			/// </summary>
+			/// <param name="connectionId">The unique identifier of the connection within the worker.</param>
+			inline TcpConnection* GetConnection(ULONG connectionId)
+			{
+				return connections + connectionId;
+			}
+
+			/// <summary>
+			/// Gets a pointer to the state of the connection not needed to dispatch the completions.
+			/// </summary>
+			/// <param name="connectionId">The unique identifier of the connection within the worker.</param>
+			inline TcpConnectionContext* GetContext(ULONG connectionId)
+			{
+				return contexts + connectionId;
+			}
+
+			/// <summary>
+			/// Gets a pointer to the timestamps of the stages of the request processed by the connection.
+			/// </summary>
+			/// <param name="connectionId">The unique identifier of the connection within the worker.</param>
+			inline ConnectionTimestamps* GetTimestamps(ULONG connectionId)
+			{
+				return timestamps + connectionId;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "Stdafx.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The result of the decode of the frame.
+		/// </summary>
+		enum FrameDecodeResult
+		{
+			/// <summary>
+			/// The frame is received completely.
+			/// </summary>
+			FrameDecodeComplete,
+
+			/// <summary>
+			/// The header or the payload is not received yet.
+			/// </summary>
+			FrameDecodeIncomplete,
+
+			/// <summary>
+			/// The length within the header exceeds the maximum length of the payload.
+			/// </summary>
+			FrameDecodeTooLarge,
+		};
+
+		/// <summary>
+		/// Decodes and encodes the frames of the binary protocol, each of which is the fixed length header that holds the length of the payload, followed by the payload.
+		/// </summary>
+		/// <remarks>
+		/// The frames are decoded in place, within the buffer they are received into, and the length is checked against the limit as soon as the header is received,
+		/// so the frame above the limit is refused before its payload is waited for.
+		/// </remarks>
+		private class FrameCodec final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The length of the header.
+			/// </summary>
+			ULONG headerLength;
+
+			/// <summary>
+			/// The offset of the length within the header.
+			/// </summary>
+			ULONG lengthOffset;
+
+			/// <summary>
+			/// The size of the length, in bytes: 1, 2, 4 or 8.
+			/// </summary>
+			ULONG lengthSize;
+
+			/// <summary>
+			/// Indicates whether the length is in the network byte order; otherwise, the least significant byte is the first.
+			/// </summary>
+			BOOL bigEndian;
+
+			/// <summary>
+			/// Indicates whether the length counts the header together with the payload.
+			/// </summary>
+			BOOL lengthIncludesHeader;
+
+			/// <summary>
+			/// The maximum length of the payload.
+			/// </summary>
+			ULONG maxPayloadLength;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="FrameCodec" /> class.
+			/// </summary>
+			/// <remarks>
+			/// The length should fit within the header, which is checked by the settings.
+			/// </remarks>
+			inline FrameCodec(ULONG headerLength, ULONG lengthOffset, ULONG lengthSize, BOOL bigEndian, BOOL lengthIncludesHeader, ULONG maxPayloadLength)
+			{
+				this->headerLength = headerLength;
+
+				this->lengthOffset = lengthOffset;
+
+				this->lengthSize = lengthSize;
+
+				this->bigEndian = bigEndian;
+
+				this->lengthIncludesHeader = lengthIncludesHeader;
+
+				this->maxPayloadLength = maxPayloadLength;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the length of the header.
+			/// </summary>
+			inline ULONG GetHeaderLength() const
+			{
+				return headerLength;
+			}
+
+			/// <summary>
+			/// Gets the maximum length of the payload.
+			/// </summary>
+			inline ULONG GetMaxPayloadLength() const
+			{
+				return maxPayloadLength;
+			}
+
+			/// <summary>
+			/// Decodes the frame at the start of the data.
+			/// </summary>
+			/// <param name="data">A pointer to the received data.</param>
+			/// <param name="length">The length of the received data.</param>
+			/// <param name="payloadLength">The length of the payload, which follows the header, once the header is received.</param>
+			/// <returns>The result of the decode, the frame takes the header and the payload when it is <see cref="FrameDecodeComplete" />.</returns>
+			inline FrameDecodeResult Decode(const char* data, ULONG length, ULONG& payloadLength) const
+			{
+				payloadLength = 0;
+
+				if (length < headerLength)
+				{
+					return FrameDecodeIncomplete;
+				}
+
+				auto field = (const unsigned char*) data + lengthOffset;
+
+				ULONG64 value = 0;
+
+				for (ULONG index = 0; index < lengthSize; index++)
+				{
+					auto byteIndex = bigEndian ? index : lengthSize - 1 - index;
+
+					value = (value << 8) | field[byteIndex];
+				}
+
+				// the length which counts the header can not be less than it
+				if (lengthIncludesHeader)
+				{
+					if (value < headerLength)
+					{
+						return FrameDecodeTooLarge;
+					}
+
+					value -= headerLength;
+				}
+
+				if (value > maxPayloadLength)
+				{
+					return FrameDecodeTooLarge;
+				}
+
+				payloadLength = (ULONG) value;
+
+				return length - headerLength < payloadLength ? FrameDecodeIncomplete : FrameDecodeComplete;
+			}
+
+			/// <summary>
+			/// Writes the length of the payload into the header, the rest of the header is left as it is.
+			/// </summary>
+			/// <param name="header">A pointer to the header, which is followed by the payload.</param>
+			/// <param name="payloadLength">The length of the payload, should not exceed the maximum length.</param>
+			inline void Encode(char* header, ULONG payloadLength) const
+			{
+				auto field = (unsigned char*) header + lengthOffset;
+
+				ULONG64 value = payloadLength;
+
+				if (lengthIncludesHeader)
+				{
+					value += headerLength;
+				}
+
+				for (ULONG index = 0; index < lengthSize; index++)
+				{
+					auto byteIndex = bigEndian ? lengthSize - 1 - index : index;
+
+					field[byteIndex] = (unsigned char) value;
+
+					value >>= 8;
+				}
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies the result of the read of the frame from the connection.
+		/// </summary>
+		public enum class FrameStatus
+		{
+			/// <summary>
+			/// The frame is read and can be served.
+			/// </summary>
+			Complete = FrameDecodeComplete,
+
+			/// <summary>
+			/// The frame is not received completely, the connection should receive more data.
+			/// </summary>
+			Incomplete = FrameDecodeIncomplete,
+
+			/// <summary>
+			/// The frame is larger than the <see cref="FrameCodecSettings::MaxPayloadLength" />, the connection should be closed.
+			/// </summary>
+			TooLarge = FrameDecodeTooLarge
+		};
+	}
+}
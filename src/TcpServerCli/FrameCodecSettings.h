@@ -0,0 +1,162 @@
+#pragma once
+
+#include "Stdafx.h"
+
+using namespace System;
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies the layout of the frames of the length-prefixed binary protocol served by the TCP worker.
+		/// </summary>
+		/// <remarks>
+		/// The frame is the header of the fixed length followed by the payload, the header holds the length as the unsigned integer at the fixed offset.
+		/// The rest of the header, such as the type or the identifier of the message, is read and written by the handler.
+		/// </remarks>
+		public ref class FrameCodecSettings
+		{
+			private:
+
+			#pragma region Fields
+
+			UInt32 headerLength;
+
+			UInt32 lengthOffset;
+
+			UInt32 lengthSize;
+
+			UInt32 maxPayloadLength;
+
+			#pragma endregion
+
+			public:
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="FrameCodecSettings" /> class.
+			/// </summary>
+			/// <remarks>
+			/// By default the header is the single length of 4 bytes in the network byte order, which does not count the header.
+			/// </remarks>
+			FrameCodecSettings()
+			{
+				headerLength = 4;
+
+				lengthOffset = 0;
+
+				lengthSize = 4;
+
+				maxPayloadLength = 4096;
+
+				BigEndian = true;
+			}
+
+			#pragma region Properties
+
+			/// <summary>
+			/// The length of the header of the frame, in bytes.
+			/// </summary>
+			property UInt32 HeaderLength
+			{
+				UInt32 get()
+				{
+					return headerLength;
+				}
+
+				void set(UInt32 value)
+				{
+					if ((value == 0) || (value > 256))
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					headerLength = value;
+				}
+			}
+
+			/// <summary>
+			/// The offset of the length within the header, in bytes.
+			/// </summary>
+			/// <remarks>
+			/// The length should fit within the header, which is checked when the worker starts.
+			/// </remarks>
+			property UInt32 LengthOffset
+			{
+				UInt32 get()
+				{
+					return lengthOffset;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value >= 256)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					lengthOffset = value;
+				}
+			}
+
+			/// <summary>
+			/// The size of the length, in bytes: 1, 2, 4 or 8.
+			/// </summary>
+			property UInt32 LengthSize
+			{
+				UInt32 get()
+				{
+					return lengthSize;
+				}
+
+				void set(UInt32 value)
+				{
+					if ((value != 1) && (value != 2) && (value != 4) && (value != 8))
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					lengthSize = value;
+				}
+			}
+
+			/// <summary>
+			/// Determines whether the length is in the network byte order; otherwise, the least significant byte is the first.
+			/// </summary>
+			property Boolean BigEndian;
+
+			/// <summary>
+			/// Determines whether the length counts the header together with the payload.
+			/// </summary>
+			property Boolean LengthIncludesHeader;
+
+			/// <summary>
+			/// The maximum length of the payload, in bytes.
+			/// </summary>
+			/// <remarks>
+			/// The frame with the larger length is refused as soon as its header is received, before its payload is waited for.
+			/// The header and the payload of the largest frame should fit within the <see cref="TcpWorkerSettings::ReceiveBufferLength" />,
+			/// and its length within the <see cref="LengthSize" />, which is checked when the worker starts.
+			/// </remarks>
+			property UInt32 MaxPayloadLength
+			{
+				UInt32 get()
+				{
+					return maxPayloadLength;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					maxPayloadLength = value;
+				}
+			}
+
+			#pragma endregion
+		};
+	}
+}
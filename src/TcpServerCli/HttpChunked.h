@@ -0,0 +1,361 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "HttpParser.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The maximum length of the size line of the chunk: eight hexadecimal digits followed by the CRLF.
+		/// </summary>
+		#define HTTP_CHUNK_HEADER_MAX_LENGTH 10
+
+		/// <summary>
+		/// The maximum length of the framing of the chunk: the size line and the CRLF after the data.
+		/// </summary>
+		#define HTTP_CHUNK_FRAMING_MAX_LENGTH (HTTP_CHUNK_HEADER_MAX_LENGTH + 2)
+
+		/// <summary>
+		/// The header which switches the response to the chunked transfer coding, ends the headers.
+		/// </summary>
+		#define HTTP_CHUNKED_HEADER "Transfer-Encoding:chunked\r\n\r\n"
+
+		/// <summary>
+		/// The length of the <see cref="HTTP_CHUNKED_HEADER" />.
+		/// </summary>
+		#define HTTP_CHUNKED_HEADER_LENGTH 29
+
+		/// <summary>
+		/// The last chunk, which ends the body without the trailers.
+		/// </summary>
+		#define HTTP_LAST_CHUNK "0\r\n\r\n"
+
+		/// <summary>
+		/// The length of the <see cref="HTTP_LAST_CHUNK" />.
+		/// </summary>
+		#define HTTP_LAST_CHUNK_LENGTH 5
+
+		/// <summary>
+		/// The position of the decoder within the framing of the chunked body.
+		/// </summary>
+		enum HttpChunkState
+		{
+			HttpChunkSize,
+
+			HttpChunkExtension,
+
+			HttpChunkSizeLineFeed,
+
+			HttpChunkData,
+
+			HttpChunkDataReturn,
+
+			HttpChunkDataLineFeed,
+
+			HttpChunkTrailerStart,
+
+			HttpChunkTrailer,
+
+			HttpChunkEndLineFeed,
+
+			HttpChunkDone,
+		};
+
+		/// <summary>
+		/// Frames the data with the chunked transfer coding of HTTP/1.1.
+		/// </summary>
+		private class HttpChunked final
+		{
+			public:
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Frames the chunk in place: writes the size line right before the data, which is already there, and the CRLF after it.
+			/// </summary>
+			/// <param name="chunk">The buffer, the data starts at <see cref="HTTP_CHUNK_HEADER_MAX_LENGTH" /> and is followed by two free bytes.</param>
+			/// <param name="dataLength">The length of the data, should not be zero since the empty chunk ends the body.</param>
+			/// <param name="chunkOffset">The offset of the chunk within the buffer.</param>
+			/// <returns>The length of the chunk.</returns>
+			inline static ULONG Frame(char* chunk, ULONG dataLength, ULONG& chunkOffset)
+			{
+				static const char* digits = "0123456789abcdef";
+
+				auto data = chunk + HTTP_CHUNK_HEADER_MAX_LENGTH;
+
+				data[dataLength] = '\r';
+
+				data[dataLength + 1] = '\n';
+
+				// the size is written backwards, without the leading zeros
+				auto position = data;
+
+				*--position = '\n';
+
+				*--position = '\r';
+
+				for (auto size = dataLength; size != 0; size >>= 4)
+				{
+					*--position = digits[size & 0xF];
+				}
+
+				chunkOffset = (ULONG) (position - chunk);
+
+				return (ULONG) (data - position) + dataLength + 2;
+			}
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Decodes the chunked body in place, within the buffer it is received into.
+		/// </summary>
+		/// <remarks>
+		/// The decoder keeps its position within the framing between the receives, so the framing split by the receives is decoded byte by byte
+		/// and the data of the chunks is returned as the views of the buffer, never copied.
+		/// The extensions of the chunks and the trailers are skipped.
+		/// </remarks>
+		private struct HttpChunkedDecoder final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The position within the framing.
+			/// </summary>
+			HttpChunkState state;
+
+			/// <summary>
+			/// The count of the bytes of the data of the current chunk which are not decoded yet.
+			/// </summary>
+			ULONG64 chunkRemaining;
+
+			/// <summary>
+			/// The count of the digits of the size of the current chunk.
+			/// </summary>
+			ULONG sizeDigits;
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Prepares the decoder for the next body.
+			/// </summary>
+			inline void Reset()
+			{
+				state = HttpChunkSize;
+
+				chunkRemaining = 0;
+
+				sizeDigits = 0;
+			}
+
+			/// <summary>
+			/// Determines whether the last chunk and the trailers are decoded.
+			/// </summary>
+			inline BOOL IsDone() const
+			{
+				return state == HttpChunkDone;
+			}
+
+			/// <summary>
+			/// Decodes the framing up to the next piece of the data.
+			/// </summary>
+			/// <param name="data">A pointer to the received data.</param>
+			/// <param name="length">The length of the received data.</param>
+			/// <param name="consumed">The count of the bytes decoded, including the piece of the data.</param>
+			/// <param name="dataOffset">The offset of the piece of the data.</param>
+			/// <param name="dataLength">The length of the piece of the data, zero if there is none.</param>
+			/// <returns>
+			/// <see cref="HttpParseComplete" /> if the piece of the data or the end of the body is found,
+			/// <see cref="HttpParseIncomplete" /> if the framing takes all the data, <see cref="HttpParseError" /> if the framing is malformed.
+			/// </returns>
+			inline HttpParseResult Decode(const char* data, ULONG length, ULONG& consumed, ULONG& dataOffset, ULONG& dataLength)
+			{
+				dataOffset = 0;
+
+				dataLength = 0;
+
+				// the data after the body belongs to the next request
+				if (state == HttpChunkDone)
+				{
+					consumed = 0;
+
+					return HttpParseComplete;
+				}
+
+				ULONG position = 0;
+
+				while (position < length)
+				{
+					if (state == HttpChunkData)
+					{
+						// the piece of the data ends with the chunk or with the received data
+						dataOffset = position;
+
+						dataLength = length - position;
+
+						if (dataLength > chunkRemaining)
+						{
+							dataLength = (ULONG) chunkRemaining;
+						}
+
+						chunkRemaining -= dataLength;
+
+						if (chunkRemaining == 0)
+						{
+							state = HttpChunkDataReturn;
+						}
+
+						consumed = position + dataLength;
+
+						return HttpParseComplete;
+					}
+
+					auto c = data[position++];
+
+					switch (state)
+					{
+						case HttpChunkSize:
+						{
+							ULONG digit;
+
+							if ((c >= '0') && (c <= '9'))
+							{
+								digit = c - '0';
+							}
+							else if (((c | 0x20) >= 'a') && ((c | 0x20) <= 'f'))
+							{
+								digit = (c | 0x20) - 'a' + 10;
+							}
+							else if ((sizeDigits != 0) && ((c == ';') || (c == ' ') || (c == '\t')))
+							{
+								state = HttpChunkExtension;
+
+								break;
+							}
+							else if ((sizeDigits != 0) && (c == '\r'))
+							{
+								state = HttpChunkSizeLineFeed;
+
+								break;
+							}
+							else
+							{
+								return HttpParseError;
+							}
+
+							// the size above 60 bits is not sent by the sane client
+							if (++sizeDigits > 15)
+							{
+								return HttpParseError;
+							}
+
+							chunkRemaining = (chunkRemaining << 4) | digit;
+
+							break;
+						}
+
+						case HttpChunkExtension:
+						{
+							if (c == '\r')
+							{
+								state = HttpChunkSizeLineFeed;
+							}
+
+							break;
+						}
+
+						case HttpChunkSizeLineFeed:
+						{
+							if (c != '\n')
+							{
+								return HttpParseError;
+							}
+
+							sizeDigits = 0;
+
+							state = chunkRemaining == 0 ? HttpChunkTrailerStart : HttpChunkData;
+
+							break;
+						}
+
+						case HttpChunkDataReturn:
+						{
+							if (c != '\r')
+							{
+								return HttpParseError;
+							}
+
+							state = HttpChunkDataLineFeed;
+
+							break;
+						}
+
+						case HttpChunkDataLineFeed:
+						{
+							if (c != '\n')
+							{
+								return HttpParseError;
+							}
+
+							state = HttpChunkSize;
+
+							break;
+						}
+
+						case HttpChunkTrailerStart:
+						{
+							state = c == '\r' ? HttpChunkEndLineFeed : HttpChunkTrailer;
+
+							break;
+						}
+
+						case HttpChunkTrailer:
+						{
+							if (c == '\n')
+							{
+								state = HttpChunkTrailerStart;
+							}
+
+							break;
+						}
+
+						case HttpChunkEndLineFeed:
+						{
+							if (c != '\n')
+							{
+								return HttpParseError;
+							}
+
+							state = HttpChunkDone;
+
+							consumed = position;
+
+							return HttpParseComplete;
+						}
+
+						default:
+						{
+							return HttpParseError;
+						}
+					}
+				}
+
+				consumed = position;
+
+				return state == HttpChunkDone ? HttpParseComplete : HttpParseIncomplete;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
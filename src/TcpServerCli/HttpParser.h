@@ -0,0 +1,856 @@
+#pragma once
+
+#include "Stdafx.h"
+#include <intrin.h>
+#include <immintrin.h>
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The maximum count of the headers of the request.
+		/// </summary>
+		#define HTTP_MAX_HEADERS_COUNT 32
+
+		/// <summary>
+		/// The result of the parse of the request.
+		/// </summary>
+		enum HttpParseResult
+		{
+			/// <summary>
+			/// The request line and the headers are parsed.
+			/// </summary>
+			HttpParseComplete,
+
+			/// <summary>
+			/// The end of the headers is not received yet.
+			/// </summary>
+			HttpParseIncomplete,
+
+			/// <summary>
+			/// The request is malformed.
+			/// </summary>
+			HttpParseError,
+		};
+
+		/// <summary>
+		/// The instruction set used to scan the request.
+		/// </summary>
+		enum HttpScanLevel
+		{
+			HttpScanScalar,
+
+			HttpScanSse42,
+
+			HttpScanAvx2,
+		};
+
+		/// <summary>
+		/// Refers to the portion of the receive buffer, the data is not copied.
+		/// </summary>
+		private struct HttpStringView final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A pointer to the first character.
+			/// </summary>
+			const char* data;
+
+			/// <summary>
+			/// The count of the characters.
+			/// </summary>
+			ULONG length;
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Determines whether the view equals to the specified text, ignoring the case of the ASCII letters.
+			/// </summary>
+			inline BOOL EqualsIgnoreCase(const char* text, ULONG textLength) const
+			{
+				return (length == textLength) && (_strnicmp(data, text, textLength) == 0);
+			}
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Refers to the name and the value of the header of the request.
+		/// </summary>
+		private struct HttpHeader final
+		{
+			public:
+
+			HttpStringView name;
+
+			HttpStringView value;
+		};
+
+		/// <summary>
+		/// Contains the views of the parts of the request, which stay valid while the receive buffer is not reused.
+		/// </summary>
+		private struct HttpRequest final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The method of the request.
+			/// </summary>
+			HttpStringView method;
+
+			/// <summary>
+			/// The target of the request.
+			/// </summary>
+			HttpStringView path;
+
+			/// <summary>
+			/// The minor version of the protocol, <c>1</c> for HTTP/1.1.
+			/// </summary>
+			ULONG minorVersion;
+
+			/// <summary>
+			/// The count of the headers.
+			/// </summary>
+			ULONG headersCount;
+
+			/// <summary>
+			/// The length, in bytes, of the request line and the headers, including the empty line; the body starts there.
+			/// </summary>
+			ULONG headersLength;
+
+			/// <summary>
+			/// The headers, in the order they are received.
+			/// </summary>
+			HttpHeader headers[HTTP_MAX_HEADERS_COUNT];
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Finds the value of the first header with the specified name.
+			/// </summary>
+			/// <returns>A pointer to the value, or <c>null</c> if there is no such header.</returns>
+			inline const HttpStringView* FindHeader(const char* name, ULONG nameLength) const
+			{
+				for (ULONG headerIndex = 0; headerIndex < headersCount; headerIndex++)
+				{
+					if (headers[headerIndex].name.EqualsIgnoreCase(name, nameLength))
+					{
+						return &headers[headerIndex].value;
+					}
+				}
+
+				return nullptr;
+			}
+
+			/// <summary>
+			/// Gets the length of the body from the Content-Length headers.
+			/// </summary>
+			/// <param name="contentLength">The length of the body, zero if there is no header.</param>
+			/// <returns><c>TRUE</c> if the length is valid; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// The repeated headers should have the same value, otherwise the request is refused, RFC 7230 section 3.3.3,
+			/// so the intermediary which reads the other header can not see the different end of the request.
+			/// </remarks>
+			inline BOOL GetContentLength(ULONG64& contentLength) const
+			{
+				contentLength = 0;
+
+				auto found = FALSE;
+
+				for (ULONG headerIndex = 0; headerIndex < headersCount; headerIndex++)
+				{
+					if (!headers[headerIndex].name.EqualsIgnoreCase("Content-Length", 14))
+					{
+						continue;
+					}
+
+					auto& value = headers[headerIndex].value;
+
+					if ((value.length == 0) || (value.length > 19))
+					{
+						return FALSE;
+					}
+
+					ULONG64 length = 0;
+
+					for (ULONG index = 0; index < value.length; index++)
+					{
+						auto c = value.data[index];
+
+						if ((c < '0') || (c > '9'))
+						{
+							return FALSE;
+						}
+
+						length = length * 10 + (c - '0');
+					}
+
+					if (found && (length != contentLength))
+					{
+						return FALSE;
+					}
+
+					contentLength = length;
+
+					found = TRUE;
+				}
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Gets the value of the Transfer-Encoding header.
+			/// </summary>
+			/// <param name="value">A pointer to the value, or <c>null</c> if there is no header.</param>
+			/// <returns><c>TRUE</c> if the header is not repeated; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// The repeated header is refused as the different lengths are, since the intermediary may read the other one.
+			/// </remarks>
+			inline BOOL GetTransferEncoding(const HttpStringView*& value) const
+			{
+				value = nullptr;
+
+				for (ULONG headerIndex = 0; headerIndex < headersCount; headerIndex++)
+				{
+					if (headers[headerIndex].name.EqualsIgnoreCase("Transfer-Encoding", 17))
+					{
+						if (value != nullptr)
+						{
+							return FALSE;
+						}
+
+						value = &headers[headerIndex].value;
+					}
+				}
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Determines whether the client expects the connection to persist after the response.
+			/// </summary>
+			/// <remarks>
+			/// HTTP/1.1 connections persist unless the Connection header has the <c>close</c> option, HTTP/1.0 ones only if it has the <c>keep-alive</c> option.
+			/// </remarks>
+			inline BOOL IsKeepAlive() const
+			{
+				auto value = FindHeader("Connection", 10);
+
+				if (minorVersion == 0)
+				{
+					return (value != nullptr) && HasOption(*value, "keep-alive", 10);
+				}
+
+				return (value == nullptr) || !HasOption(*value, "close", 5);
+			}
+
+			/// <summary>
+			/// Determines whether the comma separated list contains the option, ignoring the case.
+			/// </summary>
+			inline static BOOL HasOption(const HttpStringView& value, const char* option, ULONG optionLength)
+			{
+				auto position = value.data;
+
+				auto end = value.data + value.length;
+
+				while (position < end)
+				{
+					// skip separators
+					while ((position < end) && ((*position == ',') || (*position == ' ') || (*position == '\t')))
+					{
+						position++;
+					}
+
+					auto optionStart = position;
+
+					while ((position < end) && (*position != ',') && (*position != ' ') && (*position != '\t'))
+					{
+						position++;
+					}
+
+					if (((ULONG) (position - optionStart) == optionLength) && (_strnicmp(optionStart, option, optionLength) == 0))
+					{
+						return TRUE;
+					}
+				}
+
+				return FALSE;
+			}
+
+			/// <summary>
+			/// Determines whether the last option of the comma separated list is the specified one, ignoring the case.
+			/// </summary>
+			/// <remarks>
+			/// The codings of the Transfer-Encoding are listed in the order they are applied, so the last one is removed first.
+			/// </remarks>
+			inline static BOOL IsLastOption(const HttpStringView& value, const char* option, ULONG optionLength)
+			{
+				auto start = value.data;
+
+				auto end = value.data + value.length;
+
+				// skip trailing separators
+				while ((end > start) && ((end[-1] == ',') || (end[-1] == ' ') || (end[-1] == '\t')))
+				{
+					end--;
+				}
+
+				auto optionStart = end;
+
+				while ((optionStart > start) && (optionStart[-1] != ',') && (optionStart[-1] != ' ') && (optionStart[-1] != '\t'))
+				{
+					optionStart--;
+				}
+
+				return ((ULONG) (end - optionStart) == optionLength) && (_strnicmp(optionStart, option, optionLength) == 0);
+			}
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Parses the HTTP/1.1 request in place, within the buffer it is received into.
+		/// </summary>
+		/// <remarks>
+		/// The parse is incremental: while the end of the headers is not received, the parser remembers how far the data is scanned,
+		/// so the data received by the next operation, which is appended to the previous, is scanned only once.
+		/// When the end of the headers is found the request line and the headers are parsed in the single pass.
+		/// The scans are vectorized with the AVX2 or the SSE4.2 instructions, chosen by the processor the code runs on, the scalar code is the fallback.
+		/// </remarks>
+		private class HttpParser final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The length of the data known to contain no end of the headers.
+			/// </summary>
+			ULONG scannedLength;
+
+			#pragma endregion
+
+			#pragma region Scalar Methods
+
+			/// <summary>
+			/// Determines whether the character can be the part of the method or the name of the header.
+			/// </summary>
+			inline static BOOL IsTokenChar(unsigned char c)
+			{
+				if ((c <= 0x20) || (c >= 0x7F))
+				{
+					return FALSE;
+				}
+
+				switch (c)
+				{
+					case '"': case '(': case ')': case ',': case '/': case ':': case ';': case '<': case '=': case '>': case '?': case '@': case '[': case '\\': case ']': case '{': case '}':
+					{
+						return FALSE;
+					}
+
+					default:
+					{
+						return TRUE;
+					}
+				}
+			}
+
+			/// <summary>
+			/// Determines whether the character can be the part of the target.
+			/// </summary>
+			inline static BOOL IsPathChar(unsigned char c)
+			{
+				return (c > 0x20) && (c < 0x7F);
+			}
+
+			/// <summary>
+			/// Determines whether the character can be the part of the value of the header.
+			/// </summary>
+			inline static BOOL IsValueChar(unsigned char c)
+			{
+				return (c == '\t') || ((c >= 0x20) && (c != 0x7F));
+			}
+
+			#pragma endregion
+
+			#pragma region Vector Methods
+
+			/// <summary>
+			/// Finds the first character out of the ranges, 16 characters at once.
+			/// </summary>
+			/// <param name="position">A pointer to the first character to check.</param>
+			/// <param name="end">A pointer past the last character.</param>
+			/// <param name="ranges">The pairs of the bounds of the ranges.</param>
+			/// <param name="rangesLength">The length of the ranges, in bytes.</param>
+			/// <returns>A pointer to the first character out of the ranges, or to the last block shorter than 16 characters, which should be checked by the scalar code.</returns>
+			inline static const char* SkipRangesSse42(const char* position, const char* end, __m128i ranges, int rangesLength)
+			{
+				while (end - position >= 16)
+				{
+					auto block = _mm_loadu_si128((const __m128i*) position);
+
+					auto index = _mm_cmpestri(ranges, rangesLength, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY);
+
+					if (index != 16)
+					{
+						return position + index;
+					}
+
+					position += 16;
+				}
+
+				return position;
+			}
+
+			/// <summary>
+			/// Finds the first control character except the tab, 32 characters at once.
+			/// </summary>
+			/// <returns>A pointer to the first control character, or to the last block shorter than 32 characters, which should be checked by the scalar code.</returns>
+			inline static const char* SkipValueAvx2(const char* position, const char* end)
+			{
+				auto controlMax = _mm256_set1_epi8(0x1F);
+
+				auto tab = _mm256_set1_epi8('\t');
+
+				auto del = _mm256_set1_epi8(0x7F);
+
+				while (end - position >= 32)
+				{
+					auto block = _mm256_loadu_si256((const __m256i*) position);
+
+					// the character is the control one if it is not greater than its minimum with the highest control character
+					auto control = _mm256_cmpeq_epi8(_mm256_min_epu8(block, controlMax), block);
+
+					control = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, tab), control);
+
+					control = _mm256_or_si256(control, _mm256_cmpeq_epi8(block, del));
+
+					auto mask = (unsigned int) _mm256_movemask_epi8(control);
+
+					if (mask != 0)
+					{
+						unsigned long index;
+
+						_BitScanForward(&index, mask);
+
+						return position + index;
+					}
+
+					position += 32;
+				}
+
+				return position;
+			}
+
+			/// <summary>
+			/// Finds the end of the headers.
+			/// </summary>
+			/// <param name="data">A pointer to the data.</param>
+			/// <param name="start">The offset to start the search from.</param>
+			/// <param name="length">The length of the data.</param>
+			/// <param name="level">The instruction set to use.</param>
+			/// <returns>The length of the headers including the empty line, or zero if the end is not found.</returns>
+			static ULONG FindHeadersEnd(const char* data, ULONG start, ULONG length, HttpScanLevel level)
+			{
+				auto position = data + start;
+
+				auto end = data + length;
+
+				// each line ends with the line feed, so the line feeds are found at once and the empty line is checked for each of them
+				if (level == HttpScanAvx2)
+				{
+					auto lineFeed = _mm256_set1_epi8('\n');
+
+					for (; end - position >= 32; position += 32)
+					{
+						auto mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) position), lineFeed));
+
+						unsigned long index;
+
+						while (_BitScanForward(&index, mask))
+						{
+							auto headersLength = CheckHeadersEnd(data, (ULONG) (position - data) + index);
+
+							if (headersLength != 0)
+							{
+								return headersLength;
+							}
+
+							mask &= mask - 1;
+						}
+					}
+				}
+				else if (level == HttpScanSse42)
+				{
+					auto lineFeed = _mm_set1_epi8('\n');
+
+					for (; end - position >= 16; position += 16)
+					{
+						auto mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) position), lineFeed));
+
+						unsigned long index;
+
+						while (_BitScanForward(&index, mask))
+						{
+							auto headersLength = CheckHeadersEnd(data, (ULONG) (position - data) + index);
+
+							if (headersLength != 0)
+							{
+								return headersLength;
+							}
+
+							mask &= mask - 1;
+						}
+					}
+				}
+
+				// scan the tail
+				while ((position = (const char*) memchr(position, '\n', end - position)) != nullptr)
+				{
+					auto headersLength = CheckHeadersEnd(data, (ULONG) (position - data));
+
+					if (headersLength != 0)
+					{
+						return headersLength;
+					}
+
+					position++;
+				}
+
+				return 0;
+			}
+
+			/// <summary>
+			/// Checks whether the line feed at the specified offset ends the empty line.
+			/// </summary>
+			/// <returns>The length of the headers including the empty line, or zero if the line is not empty.</returns>
+			inline static ULONG CheckHeadersEnd(const char* data, ULONG offset)
+			{
+				if ((offset >= 3) && (data[offset - 1] == '\r') && (data[offset - 2] == '\n') && (data[offset - 3] == '\r'))
+				{
+					return offset + 1;
+				}
+
+				return 0;
+			}
+
+			#pragma endregion
+
+			#pragma region Parse Methods
+
+			/// <summary>
+			/// Skips the characters of the token.
+			/// </summary>
+			inline static const char* SkipToken(const char* position, const char* end, HttpScanLevel level)
+			{
+				if (level != HttpScanScalar)
+				{
+					// the ranges of the allowed characters
+					static const char tokenRanges[16] = { '!', '!', '#', '\'', '*', '+', '-', '.', '0', '9', 'A', 'Z', '^', 'z', '|', '|' };
+
+					position = SkipRangesSse42(position, end, _mm_loadu_si128((const __m128i*) tokenRanges), 16);
+				}
+
+				while ((position < end) && IsTokenChar((unsigned char) *position))
+				{
+					position++;
+				}
+
+				return position;
+			}
+
+			/// <summary>
+			/// Skips the characters of the target.
+			/// </summary>
+			inline static const char* SkipPath(const char* position, const char* end, HttpScanLevel level)
+			{
+				if (level != HttpScanScalar)
+				{
+					static const char pathRanges[16] = { '!', '~' };
+
+					position = SkipRangesSse42(position, end, _mm_loadu_si128((const __m128i*) pathRanges), 2);
+				}
+
+				while ((position < end) && IsPathChar((unsigned char) *position))
+				{
+					position++;
+				}
+
+				return position;
+			}
+
+			/// <summary>
+			/// Skips the characters of the value of the header.
+			/// </summary>
+			inline static const char* SkipValue(const char* position, const char* end, HttpScanLevel level)
+			{
+				if (level == HttpScanAvx2)
+				{
+					position = SkipValueAvx2(position, end);
+				}
+				else if (level == HttpScanSse42)
+				{
+					static const char valueRanges[16] = { '\t', '\t', ' ', '~', '\x80', '\xFF' };
+
+					position = SkipRangesSse42(position, end, _mm_loadu_si128((const __m128i*) valueRanges), 6);
+				}
+
+				while ((position < end) && IsValueChar((unsigned char) *position))
+				{
+					position++;
+				}
+
+				return position;
+			}
+
+			/// <summary>
+			/// Parses the request line and the headers, which are known to be complete.
+			/// </summary>
+			static HttpParseResult ParseHeaders(const char* data, ULONG headersLength, HttpRequest& request, HttpScanLevel level)
+			{
+				auto position = data;
+
+				auto end = data + headersLength;
+
+				// method
+				auto tokenEnd = SkipToken(position, end, level);
+
+				if ((tokenEnd == position) || (*tokenEnd != ' '))
+				{
+					return HttpParseError;
+				}
+
+				request.method.data = position;
+
+				request.method.length = (ULONG) (tokenEnd - position);
+
+				position = tokenEnd + 1;
+
+				// target
+				auto pathEnd = SkipPath(position, end, level);
+
+				if ((pathEnd == position) || (*pathEnd != ' '))
+				{
+					return HttpParseError;
+				}
+
+				request.path.data = position;
+
+				request.path.length = (ULONG) (pathEnd - position);
+
+				position = pathEnd + 1;
+
+				// version, the line is followed at least by the empty line, so there is no need to check the end
+				if ((end - position < 10) || (memcmp(position, "HTTP/1.", 7) != 0) || (position[7] < '0') || (position[7] > '9') || (position[8] != '\r') || (position[9] != '\n'))
+				{
+					return HttpParseError;
+				}
+
+				request.minorVersion = position[7] - '0';
+
+				position += 10;
+
+				// headers
+				request.headersCount = 0;
+
+				while (position[0] != '\r')
+				{
+					if (request.headersCount == HTTP_MAX_HEADERS_COUNT)
+					{
+						return HttpParseError;
+					}
+
+					auto header = request.headers + request.headersCount;
+
+					auto nameEnd = SkipToken(position, end, level);
+
+					if ((nameEnd == position) || (*nameEnd != ':'))
+					{
+						return HttpParseError;
+					}
+
+					header->name.data = position;
+
+					header->name.length = (ULONG) (nameEnd - position);
+
+					position = nameEnd + 1;
+
+					// skip leading whitespace
+					while ((*position == ' ') || (*position == '\t'))
+					{
+						position++;
+					}
+
+					auto valueEnd = SkipValue(position, end, level);
+
+					if ((valueEnd[0] != '\r') || (valueEnd[1] != '\n'))
+					{
+						return HttpParseError;
+					}
+
+					header->value.data = position;
+
+					// trim trailing whitespace
+					auto valueLast = valueEnd;
+
+					while ((valueLast > position) && ((valueLast[-1] == ' ') || (valueLast[-1] == '\t')))
+					{
+						valueLast--;
+					}
+
+					header->value.length = (ULONG) (valueLast - position);
+
+					request.headersCount++;
+
+					position = valueEnd + 2;
+				}
+
+				request.headersLength = headersLength;
+
+				return HttpParseComplete;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the best instruction set supported by the processor and the system, is detected once.
+			/// </summary>
+			static HttpScanLevel GetScanLevel()
+			{
+				static const HttpScanLevel level = DetectScanLevel();
+
+				return level;
+			}
+
+			/// <summary>
+			/// Detects the best instruction set supported by the processor and the system.
+			/// </summary>
+			static HttpScanLevel DetectScanLevel()
+			{
+				int registers[4];
+
+				__cpuid(registers, 0);
+
+				auto maxLeaf = registers[0];
+
+				__cpuid(registers, 1);
+
+				auto sse42 = (registers[2] & (1 << 20)) != 0;
+
+				// the system should save the state of the AVX registers
+				auto osxsave = (registers[2] & (1 << 27)) != 0;
+
+				if (!sse42)
+				{
+					return HttpScanScalar;
+				}
+
+				if (osxsave && (maxLeaf >= 7) && ((_xgetbv(0) & 6) == 6))
+				{
+					__cpuidex(registers, 7, 0);
+
+					if ((registers[1] & (1 << 5)) != 0)
+					{
+						return HttpScanAvx2;
+					}
+				}
+
+				return HttpScanSse42;
+			}
+
+			/// <summary>
+			/// Prepares the parser for the next request.
+			/// </summary>
+			inline void Reset()
+			{
+				scannedLength = 0;
+			}
+
+			/// <summary>
+			/// Parses the request with the best instruction set.
+			/// </summary>
+			inline HttpParseResult Parse(const char* data, ULONG length, HttpRequest& request)
+			{
+				return Parse(data, length, request, GetScanLevel());
+			}
+
+			/// <summary>
+			/// Parses the request.
+			/// </summary>
+			/// <param name="data">A pointer to the received data, which starts with the request.</param>
+			/// <param name="length">The length of all data received for the request so far.</param>
+			/// <param name="request">The request to fill.</param>
+			/// <param name="level">The instruction set to use.</param>
+			/// <returns>The result of the parse, the parser is reset unless the result is <see cref="HttpParseIncomplete" />.</returns>
+			/// <remarks>
+			/// The data received by the next operation should be appended to the previous one, the views refer to the data.
+			/// </remarks>
+			HttpParseResult Parse(const char* data, ULONG length, HttpRequest& request, HttpScanLevel level)
+			{
+				// the empty line can start within the scanned data
+				auto start = scannedLength >= 3 ? scannedLength - 3 : 0;
+
+				auto headersLength = FindHeadersEnd(data, start, length, level);
+
+				if (headersLength == 0)
+				{
+					scannedLength = length;
+
+					return HttpParseIncomplete;
+				}
+
+				scannedLength = 0;
+
+				return ParseHeaders(data, headersLength, request, level);
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies the result of the read of the request from the connection.
+		/// </summary>
+		public enum class HttpRequestStatus
+		{
+			/// <summary>
+			/// The request is read and can be served.
+			/// </summary>
+			Complete = HttpParseComplete,
+
+			/// <summary>
+			/// The request is not received completely, the connection should receive more data.
+			/// </summary>
+			Incomplete = HttpParseIncomplete,
+
+			/// <summary>
+			/// The request is malformed or too large, the connection should be closed.
+			/// </summary>
+			Malformed = HttpParseError
+		};
+	}
+}
@@ -0,0 +1,717 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "HttpParser.h"
+#include <intrin.h>
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The maximum count of the segments of the path of the route.
+		/// </summary>
+		#define HTTP_ROUTE_MAX_SEGMENTS 16
+
+		/// <summary>
+		/// The maximum count of the parameters of the route.
+		/// </summary>
+		#define HTTP_ROUTE_MAX_PARAMETERS 8
+
+		/// <summary>
+		/// The maximum count of the seeds tried to place the bucket of the routes.
+		/// </summary>
+		#define HTTP_ROUTE_MAX_SEEDS 0x100000
+
+		/// <summary>
+		/// Contains the result of the match of the request.
+		/// </summary>
+		private struct HttpRouteMatch final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The index of the route.
+			/// </summary>
+			ULONG routeIndex;
+
+			/// <summary>
+			/// The count of the parameters.
+			/// </summary>
+			ULONG parametersCount;
+
+			/// <summary>
+			/// The values of the parameters, in the order they appear in the route, which refer to the receive buffer.
+			/// </summary>
+			HttpStringView parameters[HTTP_ROUTE_MAX_PARAMETERS];
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Maps the method and the path of the request to the index of the route through the perfect hash.
+		/// </summary>
+		/// <remarks>
+		/// The route is the method followed by the path, such as <c>GET /users/{id}</c>, where the segment enclosed in braces is the parameter.
+		/// The routes are grouped by the shape: the count of the segments and the positions of the parameters, there are only a few of them.
+		/// The key of the route is the hash of the method and the literal segments of the shape, which is placed into the table by the hash and displace,
+		/// so the lookup hashes the path once per shape with the same count of the segments, reads the single slot and compares the single route.
+		/// The literal segment takes precedence over the parameter, so <c>GET /users/me</c> is matched before <c>GET /users/{id}</c>.
+		/// The table is built once and read by all workers without locks.
+		/// </remarks>
+		private class HttpRouter final
+		{
+			private:
+
+			#pragma region Nested Types
+
+			/// <summary>
+			/// Contains the parsed route.
+			/// </summary>
+			struct Route
+			{
+				/// <summary>
+				/// The copy of the text of the route, the views refer to it.
+				/// </summary>
+				char* text;
+
+				/// <summary>
+				/// The method.
+				/// </summary>
+				HttpStringView method;
+
+				/// <summary>
+				/// The count of the segments of the path.
+				/// </summary>
+				ULONG segmentsCount;
+
+				/// <summary>
+				/// The bit per segment which is the parameter.
+				/// </summary>
+				ULONG parametersMask;
+
+				/// <summary>
+				/// The segments of the path, the ones of the parameters are not compared.
+				/// </summary>
+				HttpStringView segments[HTTP_ROUTE_MAX_SEGMENTS];
+
+				/// <summary>
+				/// The hash of the key.
+				/// </summary>
+				ULONG64 hash;
+			};
+
+			/// <summary>
+			/// Describes the distinct count of the segments and the positions of the parameters.
+			/// </summary>
+			struct Shape
+			{
+				ULONG segmentsCount;
+
+				ULONG parametersMask;
+			};
+
+			#pragma endregion
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The collection of the routes.
+			/// </summary>
+			Route* routes;
+
+			/// <summary>
+			/// The count of the routes.
+			/// </summary>
+			ULONG routesCount;
+
+			/// <summary>
+			/// The distinct shapes of the routes.
+			/// </summary>
+			Shape* shapes;
+
+			/// <summary>
+			/// The count of the distinct shapes.
+			/// </summary>
+			ULONG shapesCount;
+
+			/// <summary>
+			/// The seeds of the buckets, which place the keys of the bucket to the free slots.
+			/// </summary>
+			ULONG* seeds;
+
+			/// <summary>
+			/// The count of the buckets minus one, the count is the power of two.
+			/// </summary>
+			ULONG bucketsMask;
+
+			/// <summary>
+			/// The index of the route per slot, <c>ULONG_MAX</c> if the slot is free.
+			/// </summary>
+			ULONG* slots;
+
+			/// <summary>
+			/// The count of the slots minus one, the count is the power of two.
+			/// </summary>
+			ULONG slotsMask;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="HttpRouter" /> class.
+			/// </summary>
+			inline HttpRouter(ULONG routesCount)
+			{
+				this->routesCount = routesCount;
+
+				routes = new Route[routesCount];
+
+				memset(routes, 0, sizeof(Route) * routesCount);
+
+				shapes = new Shape[routesCount];
+
+				shapesCount = 0;
+
+				seeds = nullptr;
+
+				slots = nullptr;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the smallest power of two which is not less than the value.
+			/// </summary>
+			inline static ULONG GetPowerOfTwo(ULONG value)
+			{
+				ULONG result = 1;
+
+				while (result < value)
+				{
+					result <<= 1;
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Adds the bytes to the FNV-1a hash.
+			/// </summary>
+			inline static ULONG64 Hash(ULONG64 hash, const char* data, ULONG length)
+			{
+				for (ULONG index = 0; index < length; index++)
+				{
+					hash = (hash ^ (unsigned char) data[index]) * 0x100000001B3ULL;
+				}
+
+				return hash;
+			}
+
+			/// <summary>
+			/// Gets the hash of the key of the route of the shape.
+			/// </summary>
+			/// <param name="methodHash">The hash of the method.</param>
+			/// <param name="segments">The segments of the path, the ones of the parameters are skipped.</param>
+			inline static ULONG64 HashKey(ULONG64 methodHash, const Shape& shape, const HttpStringView* segments)
+			{
+				auto hash = (methodHash ^ shape.parametersMask) * 0x100000001B3ULL;
+
+				for (ULONG segmentIndex = 0; segmentIndex < shape.segmentsCount; segmentIndex++)
+				{
+					// the separator keeps the segments apart, the parameter is the separator only
+					if ((shape.parametersMask & (1UL << segmentIndex)) == 0)
+					{
+						hash = Hash(hash, segments[segmentIndex].data, segments[segmentIndex].length);
+					}
+
+					hash = (hash ^ '/') * 0x100000001B3ULL;
+				}
+
+				return hash;
+			}
+
+			/// <summary>
+			/// Gets the slot of the key displaced by the seed of its bucket.
+			/// </summary>
+			inline ULONG GetSlot(ULONG64 hash, ULONG seed) const
+			{
+				auto mixed = (hash ^ ((ULONG64) seed * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+
+				return (ULONG) (mixed >> 32) & slotsMask;
+			}
+
+			/// <summary>
+			/// Gets the bucket of the key.
+			/// </summary>
+			inline ULONG GetBucket(ULONG64 hash) const
+			{
+				return (ULONG) hash & bucketsMask;
+			}
+
+			/// <summary>
+			/// Determines whether the shape is tried before the other one.
+			/// </summary>
+			inline static BOOL Precedes(const Shape& shape, const Shape& other)
+			{
+				auto parametersCount = __popcnt(shape.parametersMask);
+
+				auto otherParametersCount = __popcnt(other.parametersMask);
+
+				if (parametersCount != otherParametersCount)
+				{
+					return parametersCount < otherParametersCount;
+				}
+
+				// the parameters of the higher mask come later, after the literals
+				return shape.parametersMask > other.parametersMask;
+			}
+
+			/// <summary>
+			/// Splits the path into the segments, the query is ignored.
+			/// </summary>
+			/// <returns>The count of the segments, or <c>ULONG_MAX</c> if the path is not absolute or has too many segments.</returns>
+			inline static ULONG Split(const char* path, ULONG length, HttpStringView* segments)
+			{
+				if ((length == 0) || (path[0] != '/'))
+				{
+					return ULONG_MAX;
+				}
+
+				auto end = path + length;
+
+				auto query = (const char*) memchr(path, '?', length);
+
+				if (query != nullptr)
+				{
+					end = query;
+				}
+
+				// the root has no segments
+				if (end - path == 1)
+				{
+					return 0;
+				}
+
+				ULONG segmentsCount = 0;
+
+				auto position = path + 1;
+
+				for (;;)
+				{
+					if (segmentsCount == HTTP_ROUTE_MAX_SEGMENTS)
+					{
+						return ULONG_MAX;
+					}
+
+					auto segmentEnd = (const char*) memchr(position, '/', end - position);
+
+					if (segmentEnd == nullptr)
+					{
+						segmentEnd = end;
+					}
+
+					segments[segmentsCount].data = position;
+
+					segments[segmentsCount].length = (ULONG) (segmentEnd - position);
+
+					segmentsCount++;
+
+					if (segmentEnd == end)
+					{
+						return segmentsCount;
+					}
+
+					position = segmentEnd + 1;
+				}
+			}
+
+			/// <summary>
+			/// Places the keys into the slots, the buckets with more keys are placed first.
+			/// </summary>
+			/// <returns><c>TRUE</c> if all keys are placed; otherwise, <c>FALSE</c> if the keys collide, which means the routes are duplicated.</returns>
+			inline BOOL Place()
+			{
+				auto bucketsCount = GetPowerOfTwo((routesCount + 3) / 4);
+
+				auto slotsCount = GetPowerOfTwo(routesCount * 2);
+
+				bucketsMask = bucketsCount - 1;
+
+				slotsMask = slotsCount - 1;
+
+				seeds = new ULONG[bucketsCount];
+
+				memset(seeds, 0, sizeof(ULONG) * bucketsCount);
+
+				slots = new ULONG[slotsCount];
+
+				memset(slots, 0xFF, sizeof(ULONG) * slotsCount);
+
+				// the routes of each bucket follow each other
+				auto bucketStarts = new ULONG[bucketsCount + 1];
+
+				auto bucketFills = new ULONG[bucketsCount];
+
+				auto bucketRoutes = new ULONG[routesCount];
+
+				auto bucketOrder = new ULONG[bucketsCount];
+
+				auto candidateSlots = new ULONG[routesCount];
+
+				memset(bucketStarts, 0, sizeof(ULONG) * (bucketsCount + 1));
+
+				for (ULONG routeIndex = 0; routeIndex < routesCount; routeIndex++)
+				{
+					bucketStarts[GetBucket(routes[routeIndex].hash) + 1]++;
+				}
+
+				for (ULONG bucketIndex = 0; bucketIndex < bucketsCount; bucketIndex++)
+				{
+					bucketStarts[bucketIndex + 1] += bucketStarts[bucketIndex];
+
+					bucketFills[bucketIndex] = bucketStarts[bucketIndex];
+
+					bucketOrder[bucketIndex] = bucketIndex;
+				}
+
+				for (ULONG routeIndex = 0; routeIndex < routesCount; routeIndex++)
+				{
+					bucketRoutes[bucketFills[GetBucket(routes[routeIndex].hash)]++] = routeIndex;
+				}
+
+				// insertion sort of the buckets by size, descending, the count of the buckets is small
+				for (ULONG orderIndex = 1; orderIndex < bucketsCount; orderIndex++)
+				{
+					auto bucketIndex = bucketOrder[orderIndex];
+
+					auto bucketSize = bucketStarts[bucketIndex + 1] - bucketStarts[bucketIndex];
+
+					auto position = orderIndex;
+
+					while ((position > 0) && (bucketStarts[bucketOrder[position - 1] + 1] - bucketStarts[bucketOrder[position - 1]] < bucketSize))
+					{
+						bucketOrder[position] = bucketOrder[position - 1];
+
+						position--;
+					}
+
+					bucketOrder[position] = bucketIndex;
+				}
+
+				auto result = TRUE;
+
+				for (ULONG orderIndex = 0; (orderIndex < bucketsCount) && result; orderIndex++)
+				{
+					auto bucketIndex = bucketOrder[orderIndex];
+
+					auto start = bucketStarts[bucketIndex];
+
+					auto bucketSize = bucketStarts[bucketIndex + 1] - start;
+
+					if (bucketSize == 0)
+					{
+						break;
+					}
+
+					result = FALSE;
+
+					// try the seeds until all keys of the bucket fall into the distinct free slots
+					for (ULONG seed = 0; (seed < HTTP_ROUTE_MAX_SEEDS) && !result; seed++)
+					{
+						result = TRUE;
+
+						for (ULONG keyIndex = 0; (keyIndex < bucketSize) && result; keyIndex++)
+						{
+							auto slot = GetSlot(routes[bucketRoutes[start + keyIndex]].hash, seed);
+
+							if (slots[slot] != ULONG_MAX)
+							{
+								result = FALSE;
+							}
+
+							for (ULONG previousIndex = 0; (previousIndex < keyIndex) && result; previousIndex++)
+							{
+								if (candidateSlots[previousIndex] == slot)
+								{
+									result = FALSE;
+								}
+							}
+
+							candidateSlots[keyIndex] = slot;
+						}
+
+						if (result)
+						{
+							seeds[bucketIndex] = seed;
+
+							for (ULONG keyIndex = 0; keyIndex < bucketSize; keyIndex++)
+							{
+								slots[candidateSlots[keyIndex]] = bucketRoutes[start + keyIndex];
+							}
+						}
+					}
+				}
+
+				delete[] bucketStarts;
+
+				delete[] bucketFills;
+
+				delete[] bucketRoutes;
+
+				delete[] bucketOrder;
+
+				delete[] candidateSlots;
+
+				return result;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Creates the router of the specified count of the routes, which should be set and built.
+			/// </summary>
+			/// <param name="routesCount">The count of the routes.</param>
+			/// <returns>A pointer to the router.</returns>
+			inline static HttpRouter* Create(ULONG routesCount)
+			{
+				return new HttpRouter(routesCount);
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~HttpRouter()
+			{
+				for (ULONG routeIndex = 0; routeIndex < routesCount; routeIndex++)
+				{
+					delete[] routes[routeIndex].text;
+				}
+
+				delete[] routes;
+
+				delete[] shapes;
+
+				delete[] seeds;
+
+				delete[] slots;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Parses the route.
+			/// </summary>
+			/// <param name="routeIndex">The index of the route.</param>
+			/// <param name="text">The method and the path separated by the single space.</param>
+			/// <param name="length">The length of the text.</param>
+			/// <returns><c>TRUE</c> if the route is valid; otherwise, <c>FALSE</c>.</returns>
+			inline BOOL SetRoute(ULONG routeIndex, const char* text, ULONG length)
+			{
+				auto& route = routes[routeIndex];
+
+				route.text = new char[length];
+
+				memcpy(route.text, text, length);
+
+				auto space = (const char*) memchr(route.text, ' ', length);
+
+				if ((space == nullptr) || (space == route.text))
+				{
+					return FALSE;
+				}
+
+				route.method.data = route.text;
+
+				route.method.length = (ULONG) (space - route.text);
+
+				auto path = space + 1;
+
+				auto pathLength = length - route.method.length - 1;
+
+				if ((memchr(path, '?', pathLength) != nullptr) || (memchr(path, ' ', pathLength) != nullptr))
+				{
+					return FALSE;
+				}
+
+				route.segmentsCount = Split(path, pathLength, route.segments);
+
+				if (route.segmentsCount == ULONG_MAX)
+				{
+					return FALSE;
+				}
+
+				route.parametersMask = 0;
+
+				ULONG parametersCount = 0;
+
+				for (ULONG segmentIndex = 0; segmentIndex < route.segmentsCount; segmentIndex++)
+				{
+					auto& segment = route.segments[segmentIndex];
+
+					if ((segment.length < 2) || (segment.data[0] != '{') || (segment.data[segment.length - 1] != '}'))
+					{
+						continue;
+					}
+
+					if (++parametersCount > HTTP_ROUTE_MAX_PARAMETERS)
+					{
+						return FALSE;
+					}
+
+					route.parametersMask |= 1UL << segmentIndex;
+				}
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Builds the perfect hash of the routes set.
+			/// </summary>
+			/// <returns><c>TRUE</c> if the hash is built; otherwise, <c>FALSE</c> if the routes are duplicated.</returns>
+			inline BOOL Build()
+			{
+				for (ULONG routeIndex = 0; routeIndex < routesCount; routeIndex++)
+				{
+					auto& route = routes[routeIndex];
+
+					Shape shape = { route.segmentsCount, route.parametersMask };
+
+					route.hash = HashKey(Hash(0xCBF29CE484222325ULL, route.method.data, route.method.length), shape, route.segments);
+
+					// collect the distinct shapes
+					ULONG shapeIndex = 0;
+
+					while ((shapeIndex < shapesCount) && ((shapes[shapeIndex].segmentsCount != shape.segmentsCount) || (shapes[shapeIndex].parametersMask != shape.parametersMask)))
+					{
+						shapeIndex++;
+					}
+
+					if (shapeIndex == shapesCount)
+					{
+						shapes[shapesCount++] = shape;
+					}
+				}
+
+				// the literal segment takes precedence over the parameter: the shapes with fewer parameters are tried first, then the ones with the leading literals
+				for (ULONG shapeIndex = 1; shapeIndex < shapesCount; shapeIndex++)
+				{
+					auto shape = shapes[shapeIndex];
+
+					auto position = shapeIndex;
+
+					while ((position > 0) && Precedes(shape, shapes[position - 1]))
+					{
+						shapes[position] = shapes[position - 1];
+
+						position--;
+					}
+
+					shapes[position] = shape;
+				}
+
+				return Place();
+			}
+
+			/// <summary>
+			/// Finds the route of the request.
+			/// </summary>
+			/// <param name="request">The request.</param>
+			/// <param name="match">The index of the route and the values of its parameters, which refer to the path of the request.</param>
+			/// <returns><c>TRUE</c> if the route is found; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// The literal segments are compared as is and the parameters are not decoded.
+			/// </remarks>
+			inline BOOL Match(const HttpRequest& request, HttpRouteMatch& match) const
+			{
+				HttpStringView segments[HTTP_ROUTE_MAX_SEGMENTS];
+
+				auto segmentsCount = Split(request.path.data, request.path.length, segments);
+
+				if (segmentsCount == ULONG_MAX)
+				{
+					return FALSE;
+				}
+
+				auto methodHash = Hash(0xCBF29CE484222325ULL, request.method.data, request.method.length);
+
+				for (ULONG shapeIndex = 0; shapeIndex < shapesCount; shapeIndex++)
+				{
+					auto& shape = shapes[shapeIndex];
+
+					if (shape.segmentsCount != segmentsCount)
+					{
+						continue;
+					}
+
+					auto hash = HashKey(methodHash, shape, segments);
+
+					auto routeIndex = slots[GetSlot(hash, seeds[GetBucket(hash)])];
+
+					if (routeIndex == ULONG_MAX)
+					{
+						continue;
+					}
+
+					auto& route = routes[routeIndex];
+
+					// verify the single candidate
+					if ((route.hash != hash) || (route.parametersMask != shape.parametersMask) || (route.method.length != request.method.length) || (memcmp(route.method.data, request.method.data, route.method.length) != 0))
+					{
+						continue;
+					}
+
+					auto equals = TRUE;
+
+					match.parametersCount = 0;
+
+					for (ULONG segmentIndex = 0; (segmentIndex < segmentsCount) && equals; segmentIndex++)
+					{
+						if ((shape.parametersMask & (1UL << segmentIndex)) != 0)
+						{
+							match.parameters[match.parametersCount++] = segments[segmentIndex];
+						}
+						else
+						{
+							equals = (route.segments[segmentIndex].length == segments[segmentIndex].length) && (memcmp(route.segments[segmentIndex].data, segments[segmentIndex].data, segments[segmentIndex].length) == 0);
+						}
+					}
+
+					if (equals)
+					{
+						match.routeIndex = routeIndex;
+
+						return TRUE;
+					}
+				}
+
+				return FALSE;
+			}
+
+			/// <summary>
+			/// Gets the count of the routes.
+			/// </summary>
+			inline ULONG GetCount() const
+			{
+				return routesCount;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -3,29 +3,87 @@
 #include "Stdafx.h"
 #include "Winsock.h"
 #include "TcpServerException.h"
-#include "RioBufferPool.h"
+#include "RioSizeClassPool.h"
 #include "TcpConnection.h"
+#include "ConnectionTable.h"
+#include "CompletionDispatch.h"
+#include "ConnectionLifecycle.h"
+#include "AdmissionControl.h"
+#include "StatisticsRegion.h"
+#include "TraceRing.h"
+#include "TcpListener.h"
+#include "TcpUpstream.h"
+#include "UpstreamPool.h"
+#include "ResponseTemplates.h"
+#include "PayloadRegistry.h"
+#include "HttpRouter.h"
+#include "HttpChunked.h"
+#include "FrameCodec.h"
+#include "BroadcastBatch.h"
+#include "BroadcastSends.h"
 #include "Ovelapped.h"
 #include "ReceiveTask.h"
 
 using namespace System;
 using namespace System::Threading;
 using namespace System::Collections::Generic;
+using namespace System::Runtime::InteropServices;
+using namespace System::Threading::Tasks;
 
 namespace SXN
 {
 	namespace Net
 	{
+		ref class IocpWorker;
+
 		public ref class Connection sealed
 		{
 			private:
 
 			internal:
 
-			const char* testMessage = "HTTP/1.1 200 OK\r\nServer:SXN.Ion\r\nContent-Length:0\r\nDate:Sat, 26 Sep 2015 17:45:57 GMT\r\n\r\n";
-
 			TcpConnection* connection;
 
+			/// <summary>
+			/// The worker that owns the connection.
+			/// </summary>
+			IocpWorker^ worker;
+
+			/// <summary>
+			/// The source of the task of the connect in progress, if the connection is made to the upstream.
+			/// </summary>
+			TaskCompletionSource<Connection^>^ connectSource;
+
+			/// <summary>
+			/// The transitions of the slots of the worker that owns the connection.
+			/// </summary>
+			ConnectionLifecycle* lifecycle;
+
+			/// <summary>
+			/// The timestamps of the stages of the request processed by the connection.
+			/// </summary>
+			ConnectionTimestamps* timestamps;
+
+			/// <summary>
+			/// The trace ring of the worker that owns the connection.
+			/// </summary>
+			TraceRing* trace;
+
+			/// <summary>
+			/// The pre-rendered responses shared by all workers.
+			/// </summary>
+			ResponseTemplates* responseTemplates;
+
+			/// <summary>
+			/// The views of the last request read, or <c>null</c> if no request is read yet.
+			/// </summary>
+			HttpRequest* request;
+
+			/// <summary>
+			/// The route of the last request routed, or <c>null</c> if no request is routed yet.
+			/// </summary>
+			HttpRouteMatch* routeMatch;
+
 			initonly ReceiveTask^ receiveTask;
 
 			initonly ReceiveTask^ sendTask;
@@ -33,38 +91,139 @@ namespace SXN
 			/// <summary>
 			/// Initializes a new instance of the <see cref="Connection" /> class.
 			/// </summary>
-			/// <param name="listenSocket">The descriptor of the listening socket.</param>
-			/// <param name="pWinsock">A pointer to the object that provides work with Winsock extensions.</param>
-			/// <param name="id">The unique identifier of the worker.</param>
-			/// <param name="segmentLength">The length of the segment.</param>
-			/// <param name="connectionsCount">The count of the segments.</param>
-			inline Connection(TcpConnection* connection)
+			/// <param name="connection">A pointer to the native connection.</param>
+			/// <param name="worker">The worker that owns the connection.</param>
+			/// <param name="lifecycle">A pointer to the transitions of the slots of the worker that owns the connection.</param>
+			/// <param name="timestamps">A pointer to the timestamps of the stages of the request processed by the connection.</param>
+			/// <param name="trace">A pointer to the trace ring of the worker that owns the connection.</param>
+			/// <param name="responseTemplates">A pointer to the pre-rendered responses shared by all workers.</param>
+			inline Connection(TcpConnection* connection, IocpWorker^ worker, ConnectionLifecycle* lifecycle, ConnectionTimestamps* timestamps, TraceRing* trace, ResponseTemplates* responseTemplates)
 			{
 				this->connection = connection;
 
-				receiveTask = gcnew ReceiveTask(this);
+				this->worker = worker;
+
+				this->lifecycle = lifecycle;
+
+				this->timestamps = timestamps;
+
+				this->trace = trace;
+
+				this->responseTemplates = responseTemplates;
 
-				sendTask = gcnew ReceiveTask(this);
+				// the handler starts when it obtains the result of the receive
+				receiveTask = gcnew ReceiveTask(this, &timestamps->handlerStarted);
+
+				sendTask = gcnew ReceiveTask(this, nullptr);
 			}
 
 			inline Boolean BeginReceive()
 			{
+				auto fromState = connection->state;
+
 				auto res = connection->StartRecieve();
 
-				//Console::WriteLine("Connection[{0}]::BeginReceive {1}", connection->connectionSocket, res);
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
 
 				return res;
 			}
 
+			/// <summary>
+			/// Completes the task of the connect to the upstream, is called by the worker thread.
+			/// </summary>
+			/// <param name="winsockErrorCode">The error code of the connect, or zero if the connection is made.</param>
+			/// <remarks>
+			/// The continuations of the task run asynchronously, so the handler does not hold the worker thread.
+			/// </remarks>
+			inline void EndConnect(int winsockErrorCode)
+			{
+				auto source = connectSource;
+
+				connectSource = nullptr;
+
+				if (winsockErrorCode == 0)
+				{
+					source->SetResult(this);
+				}
+				else
+				{
+					source->SetException(gcnew TcpServerException((WinsockErrorCode) winsockErrorCode));
+				}
+			}
+
+			/// <summary>
+			/// Releases the views of the request.
+			/// </summary>
+			!Connection()
+			{
+				delete request;
+
+				delete routeMatch;
+			}
+
+			/// <summary>
+			/// Resumes the handler with the result of the receive, the receive is ended by the <see cref="ConnectionLifecycle" /> first.
+			/// </summary>
 			inline void EndReceive(unsigned int bytesTransferred)
 			{
-				connection->state = ConnectionState::Received;
+				auto context = connection->context;
+
+				// the receive of the body completes with the piece of the body, the one which brings the framing only is repeated
+				if (context->bodyReceiving && (bytesTransferred != 0))
+				{
+					bytesTransferred = TakeBody();
+
+					if ((bytesTransferred == 0) && context->bodyReceiving)
+					{
+						ReceiveBody();
 
-				//Console::WriteLine("Connection[{0}]::EndReceive {1} bytes", connection->connectionSocket, bytesTransferred);
+						return;
+					}
+				}
 
 				receiveTask->Complete(bytesTransferred);
 			}
 
+			/// <summary>
+			/// Gets a pointer to the data of the receive buffer, which is the window of the ring if the connection receives into the mirrored ring.
+			/// </summary>
+			PCHAR GetReceiveData();
+
+			/// <summary>
+			/// Parses the request line and the headers of the next request, nothing is consumed.
+			/// </summary>
+			HttpRequestStatus ParseRequest();
+
+			/// <summary>
+			/// Takes the next piece of the body of the data received, the previous piece is released.
+			/// </summary>
+			/// <returns>The length of the piece, zero if the data received holds no data of the body.</returns>
+			UInt32 TakeBody();
+
+			/// <summary>
+			/// Receives the next portion of the body into the whole receive buffer, all data received is consumed.
+			/// </summary>
+			void ReceiveBody();
+
+			/// <summary>
+			/// Ends the send of the stream, resumes the handler which waits for the free slice or the end of the stream.
+			/// </summary>
+			void EndStreamSend(unsigned int bytesTransferred);
+
+			/// <summary>
+			/// Posts the send of the slice of the stream, the handler continues at once while the stream has the free slice.
+			/// </summary>
+			/// <param name="offset">The offset of the data within the send buffer.</param>
+			/// <param name="length">The length of the data.</param>
+			/// <param name="sendsIncrement">The increment of the count of the sends of the stream in progress, carries the ending flag with the last send.</param>
+			ReceiveTask^ SendStreamSlice(ULONG offset, ULONG length, LONG sendsIncrement);
+
+			/// <summary>
+			/// Ensures the next slice of the stream is free, so the slice still sent is never overwritten.
+			/// </summary>
+			/// <exception cref="InvalidOperationException">The task of the previous write is not awaited, or the stream is ended.</exception>
+			void CheckStreamSlice();
+
 			public:
 
 			inline ReceiveTask^ ReceiveAsync()
@@ -84,6 +243,21 @@ namespace SXN
 				}
 			}
 
+			/// <summary>
+			/// Gets the number of the client accepted by the slot of the connection.
+			/// </summary>
+			/// <remarks>
+			/// The <see cref="Connection" /> is reused by the next client of the slot, so the generation read along with the connection tells the clients apart,
+			/// see <see cref="TcpWorker::Broadcast" />.
+			/// </remarks>
+			property UInt16 Generation
+			{
+				UInt16 get()
+				{
+					return connection->generation;
+				}
+			}
+
 			property ConnectionState State
 			{
 				ConnectionState get()
@@ -92,159 +266,732 @@ namespace SXN
 				}
 			}
 
-			inline ReceiveTask^ SendAsync()
+			/// <summary>
+			/// Gets the index of the listener on which the connection is accepted.
+			/// </summary>
+			property UInt32 ListenerIndex
 			{
-				//Console::WriteLine("Connection[{0}]::SendAsync", connection->connectionSocket);
+				UInt32 get()
+				{
+					return connection->context->listenerIndex;
+				}
+			}
 
-				connection->StartSend(strlen(testMessage));
+			/// <summary>
+			/// Gets the index of the upstream to which the connection is made, or <see cref="UInt32::MaxValue" /> if the connection is accepted.
+			/// </summary>
+			property UInt32 UpstreamIndex
+			{
+				UInt32 get()
+				{
+					return connection->context->upstreamIndex;
+				}
+			}
 
-				return receiveTask;
+			/// <summary>
+			/// Gets a pointer to the registered memory into which the data is received.
+			/// </summary>
+			property IntPtr ReceiveData
+			{
+				IntPtr get();
 			}
 
-			inline void EndSend(unsigned int bytesTransferred)
+			/// <summary>
+			/// Gets a pointer to the registered memory from which the data is sent.
+			/// </summary>
+			property IntPtr SendData
 			{
-				connection->state = ConnectionState::Sent;
+				IntPtr get();
+			}
 
-				//Console::WriteLine("Connection[{0}]::EndSend {1} bytes", connection->connectionSocket, bytesTransferred);
+			/// <summary>
+			/// Takes the connection to the upstream from the pool of the worker that owns this connection.
+			/// </summary>
+			/// <param name="upstreamIndex">The index of the upstream within the <see cref="TcpWorkerSettings::Upstreams" />.</param>
+			/// <returns>The task that completes with the connected upstream connection.</returns>
+			/// <remarks>
+			/// The idle connection is returned at once, otherwise the connection is made by the worker thread.
+			/// The idle connection may have been closed by the upstream, which is reported by the receive of zero bytes.
+			/// The connection should be returned by the <see cref="Release" />.
+			/// </remarks>
+			/// <exception cref="InvalidOperationException">All connections of the worker to the upstream are in use.</exception>
+			Task<Connection^>^ ConnectAsync(UInt32 upstreamIndex);
 
-				sendTask->Complete(bytesTransferred);
-			}
+			/// <summary>
+			/// Returns the upstream connection to the pool of the worker.
+			/// </summary>
+			/// <param name="keepAlive"><c>true</c> to keep the connection for reuse; <c>false</c> to disconnect it.</param>
+			/// <remarks>
+			/// The connection can be kept only if there is no operation in progress and the upstream expects the next request.
+			/// </remarks>
+			void Release(Boolean keepAlive);
 
-			inline void Disconnect()
+			/// <summary>
+			/// Sends the specified amount of bytes from the <see cref="SendData" />.
+			/// </summary>
+			/// <param name="length">The amount of bytes to send.</param>
+			inline ReceiveTask^ SendAsync(UInt32 length)
 			{
-				connection->state = ConnectionState::Disconnected;
+				timestamps->sendPosted = LatencyHistogram::GetTimestamp();
 
-				connection->StartDisconnect();
+				auto fromState = connection->state;
 
-				connection->StartAccept();
+				auto res = connection->StartSend(length);
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+				return sendTask;
 			}
-		};
-	}
-}
 
-namespace SXN
-{
-	namespace Net
-	{
-		private ref class IocpWorker
-		{
-			private:
+			/// <summary>
+			/// Sends the template followed by the specified amount of bytes from the <see cref="SendData" />.
+			/// </summary>
+			/// <param name="templateIndex">The index of the template within the <see cref="TcpWorkerSettings::ResponseTemplates" />.</param>
+			/// <param name="length">The amount of bytes to send after the template, may be zero.</param>
+			/// <remarks>
+			/// The template is sent from the registered memory shared by all workers, its Date header is refreshed once per second.
+			/// </remarks>
+			inline ReceiveTask^ SendAsync(UInt32 templateIndex, UInt32 length)
+			{
+				if (templateIndex >= responseTemplates->GetCount())
+				{
+					throw gcnew ArgumentOutOfRangeException("templateIndex");
+				}
 
-			const char* testMessage = "HTTP/1.1 200 OK\r\nServer:SXN.Ion\r\nContent-Length:0\r\nDate:Sat, 26 Sep 2015 17:45:57 GMT\r\n\r\n";
+				timestamps->sendPosted = LatencyHistogram::GetTimestamp();
 
-			#pragma region Fields
+				auto fromState = connection->state;
+
+				auto res = connection->StartSendTemplate(responseTemplates->GetTemplate(templateIndex), length);
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+				return sendTask;
+			}
 
 			/// <summary>
-			/// The descriptor of the listening socket.
+			/// Receives the data after the requests already read, see <see cref="ReadRequest" />.
 			/// </summary>
-			SOCKET listenSocket;
+			/// <returns>The task that completes with the amount of bytes received, zero if the connection is closed by the client or has waited for the next request longer than the <see cref="TcpWorkerSettings::KeepAliveTimeout" />.</returns>
+			/// <remarks>
+			/// The beginning of the next request, received with the previous ones, is kept.
+			/// </remarks>
+			ReceiveTask^ ReceiveRequestsAsync();
 
 			/// <summary>
-			/// A reference to the object that provides work with the Winsock extensions.
+			/// Reads the next request of the data received, so all requests pipelined by the client are served in order.
 			/// </summary>
-			Winsock& winsock;
+			/// <returns>The status of the request; when the request is <see cref="HttpRequestStatus::Complete" />, its parts can be read by the <see cref="RequestMethod" />, the <see cref="RequestPath" /> and the <see cref="GetRequestHeader" />.</returns>
+			/// <remarks>
+			/// The body, if any, should be received completely within the receive buffer and is read by the <see cref="BodyData" />,
+			/// the larger or the chunked body is read by the <see cref="ReadRequestHeaders" />.
+			/// </remarks>
+			HttpRequestStatus ReadRequest();
 
 			/// <summary>
-			/// The completion port of the Registered I/O operations.
+			/// Reads the request line and the headers of the next request, the body is received by the <see cref="ReceiveBodyAsync" />.
 			/// </summary>
-			initonly HANDLE rioCompletionPort;
+			/// <returns>The status of the request, see <see cref="ReadRequest" />.</returns>
+			/// <remarks>
+			/// The body may be of any length and chunked, only its piece is kept in the receive buffer at once.
+			/// The body should be received to the end before the next request is read.
+			/// </remarks>
+			HttpRequestStatus ReadRequestHeaders();
 
 			/// <summary>
-			/// The completion queue of the Registered I/O receive operations.
+			/// Receives the next piece of the body of the last request read by the <see cref="ReadRequestHeaders" />.
 			/// </summary>
-			initonly RIO_CQ rioCompletionQueue;
+			/// <returns>
+			/// The task that completes with the length of the piece, which is at the <see cref="BodyData" />;
+			/// zero if the body is received completely, see <see cref="BodyCompleted" />, or the connection is closed by the client.
+			/// </returns>
+			/// <remarks>
+			/// The piece refers to the receive buffer and is valid until the next call, which releases it, so the receive is posted only when the handler
+			/// asks for more data and the slow consumer, such as the file or the downstream connection, pauses the client.
+			/// The task should be awaited before the next call, the call while the receive is in progress is refused.
+			/// </remarks>
+			ReceiveTask^ ReceiveBodyAsync();
 
 			/// <summary>
-			/// The Registered I/O buffer pool.
+			/// Gets a pointer to the piece of the body, or to the whole body of the request read by the <see cref="ReadRequest" />.
 			/// </summary>
-			RioBufferPool* rioReceiveBufferPool;
+			property IntPtr BodyData
+			{
+				IntPtr get();
+			}
 
 			/// <summary>
-			/// The Registered I/O buffer pool.
+			/// Gets the length of the piece of the body, or of the whole body of the request read by the <see cref="ReadRequest" />.
 			/// </summary>
-			RioBufferPool* rioSendBufferPool;
+			property UInt32 BodyLength
+			{
+				UInt32 get()
+				{
+					return connection->context->bodyLength;
+				}
+			}
 
 			/// <summary>
-			/// The completion port of the disconnect operations.
+			/// Gets a value indicating whether the body of the last request read is received completely.
 			/// </summary>
-			initonly HANDLE disconnectCompletionPort;
+			/// <remarks>
+			/// Is <c>false</c> if the connection is closed by the client before the end of the body or the chunked body is malformed,
+			/// in which case the connection should be closed.
+			/// </remarks>
+			property Boolean BodyCompleted
+			{
+				Boolean get()
+				{
+					return !connection->context->bodyReceiving && !connection->context->bodyMalformed;
+				}
+			}
 
 			/// <summary>
-			/// The unique identifier of the worker.
+			/// Gets the method of the last request read.
 			/// </summary>
-			initonly Int32 Id;
+			property String^ RequestMethod
+			{
+				String^ get()
+				{
+					return gcnew String((signed char*) request->method.data, 0, request->method.length);
+				}
+			}
 
 			/// <summary>
-			/// The collection of the connections.
+			/// Gets the target of the last request read.
 			/// </summary>
-			TcpConnection** connections;
-
-			int connectionsCount;
+			property String^ RequestPath
+			{
+				String^ get()
+				{
+					return gcnew String((signed char*) request->path.data, 0, request->path.length);
+				}
+			}
 
-			initonly Thread^ processRioOperationsThread;
+			/// <summary>
+			/// Gets the value of the header of the last request read.
+			/// </summary>
+			/// <param name="name">The name of the header, the case is ignored.</param>
+			/// <returns>The value of the first header with the name, or <c>null</c> if there is no such header.</returns>
+			String^ GetRequestHeader(String^ name);
 
-			#pragma endregion
+			/// <summary>
+			/// Finds the route of the last request read within the <see cref="TcpWorkerSettings::Routes" />.
+			/// </summary>
+			/// <returns>The index of the route, or <c>-1</c> if no route matches the method and the path of the request.</returns>
+			/// <remarks>
+			/// The lookup takes the constant time whatever the count of the routes is and does not allocate,
+			/// the values of the parameters are read by the <see cref="GetRouteParameter" />.
+			/// </remarks>
+			Int32 RouteRequest();
 
-			internal:
+			/// <summary>
+			/// Gets the count of the parameters of the route of the last request routed.
+			/// </summary>
+			property Int32 RouteParametersCount
+			{
+				Int32 get()
+				{
+					return routeMatch == nullptr ? 0 : (Int32) routeMatch->parametersCount;
+				}
+			}
 
 			/// <summary>
-			/// The collection of the connections.
+			/// Gets the value of the parameter of the route of the last request routed, as it is received.
 			/// </summary>
-			array<Connection^>^ managedConnections;
+			/// <param name="parameterIndex">The index of the parameter, in the order the parameters appear in the route.</param>
+			String^ GetRouteParameter(Int32 parameterIndex);
 
-			#pragma region Constructor & Destructor
+			/// <summary>
+			/// Reads the next frame of the data received, see <see cref="TcpWorkerSettings::Framing" />.
+			/// </summary>
+			/// <returns>The status of the frame; when the frame is <see cref="FrameStatus::Complete" />, it is read by the <see cref="FrameHeader" /> and the <see cref="FramePayload" />.</returns>
+			/// <remarks>
+			/// The frames are received by the <see cref="ReceiveRequestsAsync" />, which keeps the beginning of the next frame, so all frames pipelined by the client are served in order.
+			/// </remarks>
+			FrameStatus ReadFrame();
 
 			/// <summary>
-			/// Initializes a new instance of the <see cref="IocpWorker" /> class.
+			/// Gets a pointer to the header of the last frame read, which refers to the receive buffer and is valid until the next receive.
 			/// </summary>
-			/// <param name="listenSocket">The descriptor of the listening socket.</param>
-			/// <param name="pWinsock">A pointer to the object that provides work with Winsock extensions.</param>
-			/// <param name="id">The unique identifier of the worker.</param>
-			/// <param name="segmentLength">The length of the segment.</param>
-			/// <param name="connectionsCount">The count of the segments.</param>
-			IocpWorker(SOCKET listenSocket, Winsock& winsock, Int32 id, UInt32 segmentLength, UInt32 connectionsCount)
-				: winsock(winsock)
+			property IntPtr FrameHeader
 			{
-				this->Id = id;
-
-				// set listen socket
-				this->listenSocket = listenSocket;
+				IntPtr get();
+			}
 
-				// set connections count
-				this->connectionsCount = connectionsCount;
+			/// <summary>
+			/// Gets a pointer to the payload of the last frame read, which follows the header.
+			/// </summary>
+			property IntPtr FramePayload
+			{
+				IntPtr get();
+			}
 
+			/// <summary>
+			/// Gets the length of the payload of the last frame read.
+			/// </summary>
+			property UInt32 FramePayloadLength
+			{
+				UInt32 get()
 				{
-					// create I/O completion port
-					this->rioCompletionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+					return connection->context->framePayloadLength;
+				}
+			}
 
-					// check if operation has failed
-					if (rioCompletionPort == nullptr)
-					{
-						// get error code
-						DWORD kernelErrorCode = ::GetLastError();
+			/// <summary>
+			/// Appends the frame to the data to send, so the frames appended since the last flush are sent by the single send, see <see cref="FlushAsync" />.
+			/// </summary>
+			/// <param name="header">The header of the frame, whose length is written by the codec; or <c>null</c> if the header holds only the length.</param>
+			/// <param name="payload">The payload of the frame.</param>
+			/// <returns><c>true</c> if the frame is appended; <c>false</c> if the send buffer has no room for it, so the frames should be flushed first.</returns>
+			Boolean AppendFrame(array<Byte>^ header, array<Byte>^ payload);
 
-						// throw exception
-						throw gcnew TcpServerException(kernelErrorCode);
-					}
+			/// <summary>
+			/// Gets a value indicating whether the connection should be kept open after the response to the last request read.
+			/// </summary>
+			/// <remarks>
+			/// Is <c>false</c> if the client asks to close the connection, or the connection has served the <see cref="TcpWorkerSettings::MaxKeepAliveRequests" />,
+			/// in which case the response should have the <c>Connection: close</c> header.
+			/// </remarks>
+			property Boolean KeepAlive
+			{
+				Boolean get();
+			}
 
-					// compose completion method structure
-					RIO_NOTIFICATION_COMPLETION completionSettings;
+			/// <summary>
+			/// Appends the template to the responses to send, see <see cref="FlushAsync" />.
+			/// </summary>
+			/// <param name="templateIndex">The index of the template within the <see cref="TcpWorkerSettings::ResponseTemplates" />.</param>
+			/// <returns><c>true</c> if the template is appended; <c>false</c> if the send buffer has no room for it, so the responses should be flushed first.</returns>
+			Boolean AppendTemplate(UInt32 templateIndex);
 
-					// set type to IOCP
-					completionSettings.Type = RIO_IOCP_COMPLETION;
+			/// <summary>
+			/// Appends the data to the responses to send, see <see cref="FlushAsync" />.
+			/// </summary>
+			/// <param name="data">The data to append.</param>
+			/// <returns><c>true</c> if the data is appended; <c>false</c> if the send buffer has no room for it, so the responses should be flushed first.</returns>
+			Boolean Append(array<Byte>^ data);
 
-					// set IOCP handle to completion port
-					completionSettings.Iocp.IocpHandle = rioCompletionPort;
+			/// <summary>
+			/// Sends the responses appended since the last flush by the single send.
+			/// </summary>
+			ReceiveTask^ FlushAsync();
 
-					// set IOCP completion key to id of current worker
-					// TODO: can be null
-					completionSettings.Iocp.CompletionKey = (PVOID) id;
+			/// <summary>
+			/// Gets the maximum length of the data of the single chunk written by the <see cref="WriteChunkAsync" />.
+			/// </summary>
+			property UInt32 StreamChunkCapacity
+			{
+				UInt32 get();
+			}
 
-					// set IOCP overlapped to invalid
-					completionSettings.Iocp.Overlapped = (LPOVERLAPPED)-1;
+			/// <summary>
+			/// Starts the response streamed with the chunked transfer coding: ends the headers appended by the <see cref="AppendTemplate" /> and the <see cref="Append" />
+			/// with the <c>Transfer-Encoding</c> header and sends them.
+			/// </summary>
+			/// <returns>The task that completes when the next chunk may be written.</returns>
+			/// <remarks>
+			/// The headers should fit the slice of the send buffer, see <see cref="TcpWorkerSettings::MaxStreamSends" />.
+			/// </remarks>
+			ReceiveTask^ BeginStreamAsync();
 
-					// create the completion queue for the Registered I/O receive operations
-					rioCompletionQueue = winsock.RIOCreateCompletionQueue(connectionsCount * 64, &completionSettings);
+			/// <summary>
+			/// Sends the data as the chunk of the streamed response.
+			/// </summary>
+			/// <param name="data">The data, not longer than the <see cref="StreamChunkCapacity" />; the empty data is not sent.</param>
+			/// <returns>The task that completes when the next chunk may be written.</returns>
+			/// <remarks>
+			/// The data is copied into the free slice of the send buffer and sent at once. While the sends of the other slices are in progress,
+			/// the task is completed before the send; when all slices are sent, the task completes when the first send completes, so the slow client pauses the handler.
+			/// The task should be awaited before the next write, the write while all slices are sent is refused.
+			/// </remarks>
+			ReceiveTask^ WriteChunkAsync(array<Byte>^ data);
+
+			/// <summary>
+			/// Sends the last chunk of the streamed response.
+			/// </summary>
+			/// <returns>The task that completes when all sends of the stream complete, after which the connection is <see cref="ConnectionState::Sent" />.</returns>
+			ReceiveTask^ EndStreamAsync();
+
+			/// <summary>
+			/// Sends the shared payload.
+			/// </summary>
+			/// <param name="payloadIndex">The index of the payload returned by the <see cref="TcpWorker::RegisterPayload" />.</param>
+			/// <remarks>
+			/// The payload is sent from the registered memory shared by all connections, nothing is copied.
+			/// </remarks>
+			ReceiveTask^ SendPayloadAsync(UInt32 payloadIndex);
+
+			/// <summary>
+			/// Sends the first template.
+			/// </summary>
+			inline ReceiveTask^ SendAsync()
+			{
+				//Console::WriteLine("Connection[{0}]::SendAsync", connection->connectionSocket);
+
+				return SendAsync(0, 0);
+			}
+
+			/// <summary>
+			/// Resumes the handler with the result of the send, the send is ended by the <see cref="ConnectionLifecycle" /> first.
+			/// </summary>
+			inline void EndSend(unsigned int bytesTransferred)
+			{
+				sendTask->Complete(bytesTransferred);
+			}
+
+			inline void Disconnect()
+			{
+				// the upstream connection returns to its pool instead of accept
+				if (connection->context->upstreamIndex != ULONG_MAX)
+				{
+					Release(false);
+
+					return;
+				}
+
+				lifecycle->Disconnect(connection);
+			}
+		};
+	}
+}
+
+namespace SXN
+{
+	namespace Net
+	{
+		private ref class IocpWorker
+		{
+			private:
+
+			#pragma region Constant and Static Fields
+
+			/// <summary>
+			/// The interval, in milliseconds, between the samples of the occupancy of the slots.
+			/// </summary>
+			literal ULONG64 OccupancySampleInterval = 1000;
+
+			/// <summary>
+			/// The count of the broadcast sends in progress per connection, the sends above the limit are dropped.
+			/// </summary>
+			literal ULONG BroadcastSendsPerConnection = 16;
+
+			#pragma endregion
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The collection of the listeners, shared by all workers.
+			/// </summary>
+			TcpListener* listeners;
+
+			/// <summary>
+			/// The collection of the upstreams, shared by all workers.
+			/// </summary>
+			TcpUpstream* upstreams;
+
+			/// <summary>
+			/// The count of the upstreams.
+			/// </summary>
+			initonly UInt32 upstreamsCount;
+
+			/// <summary>
+			/// The pool of the connections to the upstreams which are not in use, or <c>null</c> if there are no upstreams.
+			/// </summary>
+			UpstreamPool* upstreamPool;
+
+			/// <summary>
+			/// A reference to the object that provides work with the Winsock extensions.
+			/// </summary>
+			Winsock& winsock;
+
+			/// <summary>
+			/// The completion port of the Registered I/O operations.
+			/// </summary>
+			initonly HANDLE rioCompletionPort;
+
+			/// <summary>
+			/// The completion queue of the Registered I/O receive operations.
+			/// </summary>
+			initonly RIO_CQ rioCompletionQueue;
+
+			/// <summary>
+			/// The Registered I/O buffer pool.
+			/// </summary>
+			RioSizeClassPool* rioBufferPool;
+
+			/// <summary>
+			/// The admission control of the worker.
+			/// </summary>
+			AdmissionControl* admissionControl;
+
+			/// <summary>
+			/// The pre-rendered responses shared by all workers.
+			/// </summary>
+			ResponseTemplates* responseTemplates;
+
+			/// <summary>
+			/// The payloads shared by all workers.
+			/// </summary>
+			PayloadRegistry* payloadRegistry;
+
+			/// <summary>
+			/// The router of the requests shared by all workers, or <c>null</c> if there are no routes.
+			/// </summary>
+			HttpRouter* router;
+
+			/// <summary>
+			/// The codec of the frames shared by all workers, or <c>null</c> if the connections serve HTTP only.
+			/// </summary>
+			FrameCodec* frameCodec;
+
+			/// <summary>
+			/// The payloads of the broadcast sends in progress.
+			/// </summary>
+			BroadcastSends* broadcastSends;
+
+			/// <summary>
+			/// The counters of the worker within the statistics region.
+			/// </summary>
+			WorkerCounters* counters;
+
+			/// <summary>
+			/// The trace ring of the worker.
+			/// </summary>
+			TraceRing* trace;
+
+			/// <summary>
+			/// The completion port of the disconnect operations.
+			/// </summary>
+			initonly HANDLE disconnectCompletionPort;
+
+			/// <summary>
+			/// The unique identifier of the worker.
+			/// </summary>
+			initonly Int32 Id;
+
+			/// <summary>
+			/// The storage of the connections.
+			/// </summary>
+			ConnectionTable* connectionTable;
+
+			/// <summary>
+			/// The transitions of the slots shared with the simulation.
+			/// </summary>
+			ConnectionLifecycle* lifecycle;
+
+			int connectionsCount;
+
+			/// <summary>
+			/// The length of the segment used for receiving data.
+			/// </summary>
+			initonly UInt32 receiveSegmentLength;
+
+			/// <summary>
+			/// The length of the segment used for sending data.
+			/// </summary>
+			initonly UInt32 sendSegmentLength;
+
+			/// <summary>
+			/// The time, in milliseconds, the connection waits for the next request, or zero if it waits without limit.
+			/// </summary>
+			initonly UInt32 keepAliveTimeout;
+
+			/// <summary>
+			/// The maximum count of the sends of the stream in progress per connection, the send buffer is split into as many slices.
+			/// </summary>
+			initonly UInt32 maxStreamSends;
+
+			/// <summary>
+			/// The length of the slice of the send buffer used by the single send of the stream.
+			/// </summary>
+			initonly UInt32 streamSliceLength;
+
+			/// <summary>
+			/// Indicates whether the connections receive into the mirrored rings instead of the segments of the pool.
+			/// </summary>
+			initonly Boolean useReceiveRings;
+
+			/// <summary>
+			/// The callback which runs the handler of the admitted connection on the thread pool.
+			/// </summary>
+			initonly WaitCallback^ serveCallback;
+
+			initonly Thread^ processRioOperationsThread;
+
+			/// <summary>
+			/// The mask of the processor the thread of the worker is bound to, or zero if it is not bound.
+			/// </summary>
+			initonly UInt64 processorMask;
+
+			#pragma endregion
+
+			internal:
+
+			/// <summary>
+			/// The collection of the connections.
+			/// </summary>
+			array<Connection^>^ managedConnections;
+
+			#pragma region Constructor & Destructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="IocpWorker" /> class.
+			/// </summary>
+			/// <param name="listeners">A pointer to the collection of the listeners, which defines the share of the connections of each listener.</param>
+			/// <param name="listenersCount">The count of the listeners.</param>
+			/// <param name="upstreams">A pointer to the collection of the upstreams, which defines the count of the connections to each upstream.</param>
+			/// <param name="upstreamsCount">The count of the upstreams.</param>
+			/// <param name="pWinsock">A pointer to the object that provides work with Winsock extensions.</param>
+			/// <param name="id">The unique identifier of the worker.</param>
+			/// <param name="receiveSegmentLength">The average length of the receive memory per connection, by which the larger size classes of the pool are sized; the length of the ring, if the rings are used.</param>
+			/// <param name="sendSegmentLength">The length of the segment used for sending data.</param>
+			/// <param name="keepAliveTimeout">The time, in milliseconds, the connection waits for the next request, or zero if it waits without limit.</param>
+			/// <param name="maxKeepAliveRequests">The maximum count of the requests served by the single connection, or zero if the count is not limited.</param>
+			/// <param name="maxStreamSends">The maximum count of the sends of the stream in progress per connection.</param>
+			/// <param name="useReceiveRings">Indicates whether the connections receive into the mirrored rings instead of the segments of the pool.</param>
+			/// <param name="admissionControl">A pointer to the admission control of the worker, ownership is transferred to the worker.</param>
+			/// <param name="busyResponse">The descriptor of the portion of the shared registered buffer that contains the busy response.</param>
+			/// <param name="responseTemplates">A pointer to the pre-rendered responses shared by all workers.</param>
+			/// <param name="payloadRegistry">A pointer to the payloads shared by all workers.</param>
+			/// <param name="router">A pointer to the router of the requests shared by all workers, or <c>null</c> if there are no routes.</param>
+			/// <param name="frameCodec">A pointer to the codec of the frames shared by all workers, or <c>null</c> if the connections serve HTTP only.</param>
+			/// <param name="counters">A pointer to the counters of the worker within the statistics region.</param>
+			/// <param name="trace">A pointer to the trace ring of the worker.</param>
+			/// <param name="processorMask">The mask of the processor to bind the thread of the worker to, or zero to let the system schedule it.</param>
+			/// <param name="serveCallback">The callback which runs the handler of the admitted connection, is queued to the thread pool by the worker thread.</param>
+			IocpWorker(TcpListener* listeners, UInt32 listenersCount, TcpUpstream* upstreams, UInt32 upstreamsCount, Winsock& winsock, Int32 id, UInt32 receiveSegmentLength, UInt32 sendSegmentLength, UInt32 keepAliveTimeout, UInt32 maxKeepAliveRequests, UInt32 maxStreamSends, Boolean useReceiveRings, AdmissionControl* admissionControl, PRIO_BUF busyResponse, ResponseTemplates* responseTemplates, PayloadRegistry* payloadRegistry, HttpRouter* router, FrameCodec* frameCodec, WorkerCounters* counters, TraceRing* trace, UInt64 processorMask, WaitCallback^ serveCallback)
+				: winsock(winsock)
+			{
+				// check arguments
+				if ((receiveSegmentLength == 0) || (receiveSegmentLength > ConnectionLifecycle::LargeSegmentLength))
+				{
+					throw gcnew ArgumentOutOfRangeException("receiveSegmentLength");
+				}
+
+				if ((sendSegmentLength == 0) || (sendSegmentLength > ConnectionLifecycle::LargeSegmentLength))
+				{
+					throw gcnew ArgumentOutOfRangeException("sendSegmentLength");
+				}
+
+				// the slice should hold the framing and some data
+				if ((maxStreamSends == 0) || (sendSegmentLength / maxStreamSends <= HTTP_CHUNK_FRAMING_MAX_LENGTH + HTTP_CHUNKED_HEADER_LENGTH))
+				{
+					throw gcnew ArgumentOutOfRangeException("maxStreamSends");
+				}
+
+				this->receiveSegmentLength = receiveSegmentLength;
+
+				this->sendSegmentLength = sendSegmentLength;
+
+				this->keepAliveTimeout = keepAliveTimeout;
+
+				this->maxStreamSends = maxStreamSends;
+
+				this->streamSliceLength = sendSegmentLength / maxStreamSends;
+
+				this->useReceiveRings = useReceiveRings;
+
+				this->serveCallback = serveCallback;
+
+				// the connections of the listeners follow each other
+				UInt32 connectionsCount = 0;
+
+				// the forwarded connections receive into the segment of the full length
+				UInt32 forwardedConnectionsCount = 0;
+
+				for (UInt32 listenerIndex = 0; listenerIndex < listenersCount; listenerIndex++)
+				{
+					connectionsCount += listeners[listenerIndex].connectionsCount;
+
+					if (listeners[listenerIndex].upstreamIndex != ULONG_MAX)
+					{
+						forwardedConnectionsCount += listeners[listenerIndex].connectionsCount;
+					}
+				}
+
+				auto servedConnectionsCount = connectionsCount - forwardedConnectionsCount;
+
+				// the connections to the upstreams follow the accepted ones and share the buffers and the completion queue with them
+				auto firstUpstreamConnectionId = connectionsCount;
+
+				for (UInt32 upstreamIndex = 0; upstreamIndex < upstreamsCount; upstreamIndex++)
+				{
+					connectionsCount += upstreams[upstreamIndex].connectionsCount;
+				}
+
+				this->admissionControl = admissionControl;
+
+				this->responseTemplates = responseTemplates;
+
+				this->payloadRegistry = payloadRegistry;
+
+				this->router = router;
+
+				this->frameCodec = frameCodec;
+
+				this->counters = counters;
+
+				counters->slotsCount = connectionsCount;
+
+				this->trace = trace;
+
+				this->processorMask = processorMask;
+
+				this->Id = id;
+
+				// set listeners
+				this->listeners = listeners;
+
+				// set upstreams
+				this->upstreams = upstreams;
+
+				this->upstreamsCount = upstreamsCount;
+
+				// set connections count
+				this->connectionsCount = connectionsCount;
+
+				// the slots of the broadcast sends are identified by the request context as well as the connections
+				if ((ULONG64) connectionsCount * BroadcastSendsPerConnection > (ULONG64) TCP_CONNECTION_ID_MASK + 1)
+				{
+					throw gcnew ArgumentOutOfRangeException("connectionsCount");
+				}
+
+				// the broadcast sends run beside the own operations of the connections
+				broadcastSends = new BroadcastSends(connectionsCount * BroadcastSendsPerConnection);
+
+				{
+					// create I/O completion port
+					this->rioCompletionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+
+					// check if operation has failed
+					if (rioCompletionPort == nullptr)
+					{
+						// get error code
+						DWORD kernelErrorCode = ::GetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(kernelErrorCode);
+					}
+
+					// compose completion method structure
+					RIO_NOTIFICATION_COMPLETION completionSettings;
+
+					// set type to IOCP
+					completionSettings.Type = RIO_IOCP_COMPLETION;
+
+					// set IOCP handle to completion port
+					completionSettings.Iocp.IocpHandle = rioCompletionPort;
+
+					// set IOCP completion key to id of current worker
+					// TODO: can be null
+					completionSettings.Iocp.CompletionKey = (PVOID) id;
+
+					// set IOCP overlapped to invalid
+					completionSettings.Iocp.Overlapped = (LPOVERLAPPED)-1;
+
+					// create the completion queue for the Registered I/O receive operations
+					rioCompletionQueue = winsock.RIOCreateCompletionQueue(connectionsCount * 64, &completionSettings);
 
 					// check if operation has failed
 					if (rioCompletionQueue == RIO_INVALID_CQ)
@@ -252,282 +999,1795 @@ namespace SXN
 						// get error code
 						WinsockErrorCode winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
 
-						// throw exception
-						throw gcnew TcpServerException(winsockErrorCode);
-					}
-				}
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				/**
+				{
+					// create I/O completion port
+					this->disconnectCompletionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+
+					// check if operation has failed
+					if (disconnectCompletionPort == nullptr)
+					{
+						// get error code
+						DWORD kernelErrorCode = ::GetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(kernelErrorCode);
+					}
+				}
+				/**/
+
+				// the length of the largest segment the receive of the served connection can grow into
+				ULONG maxReceiveLength;
+
+				// create buffer pool
+				{
+					ULONG segmentsCounts[ConnectionLifecycle::SizeClassesCount];
+
+					maxReceiveLength = ConnectionLifecycle::GetSegmentsCounts(servedConnectionsCount, connectionsCount - servedConnectionsCount, receiveSegmentLength, sendSegmentLength, useReceiveRings, segmentsCounts);
+
+					DWORD kernelErrorCode;
+
+					int winsockErrorCode;
+
+					rioBufferPool = RioSizeClassPool::Create(winsock, ConnectionLifecycle::GetSegmentLengths(), segmentsCounts, ConnectionLifecycle::SizeClassesCount, kernelErrorCode, winsockErrorCode);
+
+					// check if operation has failed
+					if (rioBufferPool == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
+					}
+				}
+
+				// create connection table
+				{
+					DWORD kernelErrorCode;
+
+					connectionTable = ConnectionTable::Create(connectionsCount, kernelErrorCode);
+
+					// check if operation has failed
+					if (connectionTable == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((int)kernelErrorCode);
+					}
+				}
+
+				// create pool of the upstream connections
+				if (upstreamsCount != 0)
+				{
+					DWORD kernelErrorCode;
+
+					upstreamPool = UpstreamPool::Create(upstreams, upstreamsCount, firstUpstreamConnectionId, kernelErrorCode);
+
+					// check if operation has failed
+					if (upstreamPool == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((int)kernelErrorCode);
+					}
+				}
+
+				lifecycle = new ConnectionLifecycle(connectionTable, rioBufferPool, admissionControl, upstreamPool, listeners, upstreams, counters, trace, busyResponse, receiveSegmentLength, sendSegmentLength, maxReceiveLength, keepAliveTimeout, maxKeepAliveRequests, useReceiveRings);
+
+				managedConnections = gcnew array<Connection ^>(connectionsCount);
+
+				// initialize connections
+				unsigned int index = 0;
+
+				for (UInt32 listenerIndex = 0; listenerIndex < listenersCount; listenerIndex++)
+				{
+					for (ULONG listenerConnectionIndex = 0; listenerConnectionIndex < listeners[listenerIndex].connectionsCount; listenerConnectionIndex++, index++)
+					{
+						// create connection
+						TcpConnection* connection = CreateConnection(index, listenerIndex, 24, 40);
+
+						managedConnections[index] = gcnew Connection(connection, this, lifecycle, connectionTable->GetTimestamps(index), trace, responseTemplates);
+
+						auto acceptResult = connection->StartAccept();
+
+						trace->Record(connection, ConnectionState::Disconnected, 0, TraceRing::GetError(acceptResult));
+					}
+				}
+
+				// initialize upstream connections, they are connected on first use
+				for (UInt32 upstreamIndex = 0; upstreamIndex < upstreamsCount; upstreamIndex++)
+				{
+					for (ULONG upstreamConnectionIndex = 0; upstreamConnectionIndex < upstreams[upstreamIndex].connectionsCount; upstreamConnectionIndex++, index++)
+					{
+						TcpConnection* connection = CreateUpstreamConnection(index, upstreamIndex, 24, 40);
+
+						managedConnections[index] = gcnew Connection(connection, this, lifecycle, connectionTable->GetTimestamps(index), trace, responseTemplates);
+					}
+				}
+
+				{
+					ThreadStart^ threadDelegate = gcnew ThreadStart(this, &IocpWorker::ProcessRioOperations);
+
+					processRioOperationsThread = gcnew Thread(threadDelegate);
+
+					processRioOperationsThread->Name = String::Format("RIO processing thread # {0}", id);
+
+					processRioOperationsThread->IsBackground = true;
+
+					processRioOperationsThread->Start();
+				}
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			~IocpWorker()
+			{
+				// release receive rings
+				if (useReceiveRings && (connectionTable != nullptr))
+				{
+					for (ULONG connectionId = 0; connectionId < (ULONG) connectionsCount; connectionId++)
+					{
+						delete connectionTable->GetContext(connectionId)->receiveRing;
+					}
+				}
+
+				// release transitions of the slots
+				delete lifecycle;
+
+				// release connection table
+				delete connectionTable;
+
+				// release upstream pool
+				delete upstreamPool;
+
+				// release admission control
+				delete admissionControl;
+
+				// release buffer pool
+				delete rioBufferPool;
+
+				// close completion queue
+				winsock.RIOCloseCompletionQueue(rioCompletionQueue);
+
+				// close completion port
+				// ignore result
+				::CloseHandle(rioCompletionPort);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Decides whether the accepted connection should be served, refuses it otherwise.
+			/// </summary>
+			/// <param name="connectionId">The unique identifier of the connection within the worker.</param>
+			/// <returns><c>true</c> if the connection is handed over to the worker thread; otherwise, <c>false</c>.</returns>
+			/// <remarks>
+			/// Is called by the accept thread. The admitted connection is handed over to the worker thread, which owns the buffer pool,
+			/// rents the segments of the connection and starts serving or forwarding it, see <see cref="EndAdmit" />.
+			/// The refused connection is sent the busy response from the shared buffer, then disconnected and returned to accept by the worker thread,
+			/// neither thread waits for the disconnect.
+			/// </remarks>
+			Boolean TryAdmit(ULONG connectionId)
+			{
+				auto connection = connectionTable->GetConnection(connectionId);
+
+				connection->EndAccepet();
+
+				if (!lifecycle->Admit(connection))
+				{
+					return false;
+				}
+
+				connectionTable->GetTimestamps(connectionId)->accepted = LatencyHistogram::GetTimestamp();
+
+				// the accept structure is not used until the connection returns to accept
+				auto postResult = ::PostQueuedCompletionStatus(rioCompletionPort, 0, 0, &connection->context->acceptOverlapped);
+
+				// check if operation has failed
+				if (postResult == FALSE)
+				{
+					admissionControl->Release();
+
+					lifecycle->ReturnToAccept(connection);
+
+					return false;
+				}
+
+				return true;
+			}
+
+			/// <summary>
+			/// Rents the segments of the admitted connection and starts serving it, or forwarding it if its listener forwards the connections to the upstream.
+			/// </summary>
+			/// <param name="connectionId">The unique identifier of the admitted connection within the worker.</param>
+			/// <remarks>
+			/// Is called by the worker thread, so the segments are rented from the local lists of the pool without synchronization.
+			/// The connection the pool has no free segments for is refused.
+			/// </remarks>
+			void EndAdmit(ULONG connectionId)
+			{
+				auto connection = connectionTable->GetConnection(connectionId);
+
+				// the forwarded and the refused connections are not passed to the handler
+				if (!lifecycle->EndAdmit(connection))
+				{
+					return;
+				}
+
+				// the handler runs on the thread pool
+				ThreadPool::UnsafeQueueUserWorkItem(serveCallback, managedConnections[connectionId]);
+			}
+
+			TcpConnection* CreateConnection(int connectionId, UInt32 listenerIndex, ULONG maxOutstandingReceive, ULONG maxOutstandingSend)
+			{
+				auto listener = listeners + listenerIndex;
+
+				// create connection socket of the same address family as the listening one, the refused and the forwarded connections are disconnected by the overlapped operation
+				auto connectionSocket = ::WSASocket(listener->addressFamily, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+
+				// check if operation has failed
+				if (connectionSocket == INVALID_SOCKET)
+				{
+					// get error code
+					auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+					// throw exception
+					throw gcnew TcpServerException(winsockErrorCode);
+				}
+
+				// associate the connection socket with the completion port of the worker, so the disconnect completes on the worker thread
+				{
+					HANDLE associateResult = ::CreateIoCompletionPort((HANDLE)connectionSocket, rioCompletionPort, 0, 0);
+
+					if ((associateResult == nullptr) || (associateResult != rioCompletionPort))
+					{
+						// get error code
+						auto kernelErrorCode = ::GetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(kernelErrorCode);
+					}
+				}
+
+				// initialize connection with the resources of the worker
+				auto connection = InitializeConnection(connectionId, connectionSocket, listener->socket, maxOutstandingReceive, maxOutstandingSend);
+
+				connection->context->listenerIndex = listenerIndex;
+
+				return connection;
+			}
+
+			/// <summary>
+			/// Creates the connection to the upstream, the socket is bound and associated with the completion port of the worker, but not connected.
+			/// </summary>
+			TcpConnection* CreateUpstreamConnection(int connectionId, UInt32 upstreamIndex, ULONG maxOutstandingReceive, ULONG maxOutstandingSend)
+			{
+				auto upstream = upstreams + upstreamIndex;
+
+				auto addressFamily = upstream->address.si_family;
+
+				// create connection socket of the address family of the upstream
+				auto connectionSocket = ::WSASocket(addressFamily, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+
+				// check if operation has failed
+				if (connectionSocket == INVALID_SOCKET)
+				{
+					// get error code
+					auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+					// throw exception
+					throw gcnew TcpServerException(winsockErrorCode);
+				}
+
+				// enable fast loopback if requested, should be done before connect
+				if (upstream->useFastLoopback)
+				{
+					UInt32 optionValue = 1;
+
+					DWORD dwBytes = 0;
+
+					int enableFastLoopbackResult = ::WSAIoctl(connectionSocket, SIO_LOOPBACK_FAST_PATH, &optionValue, sizeof(UInt32), nullptr, 0, &dwBytes, nullptr, nullptr);
+
+					// check if operation has failed
+					if (enableFastLoopbackResult == SOCKET_ERROR)
+					{
+						// get error code
+						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				// bind to the wildcard address, as required by the connect
+				{
+					SOCKADDR_INET localAddress;
+
+					memset(&localAddress, 0, sizeof(SOCKADDR_INET));
+
+					localAddress.si_family = addressFamily;
+
+					auto bindResult = ::bind(connectionSocket, (sockaddr *)&localAddress, upstream->addressLength);
+
+					// check if operation has failed
+					if (bindResult == SOCKET_ERROR)
+					{
+						// get error code
+						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				// associate the connection socket with the completion port of the worker, so the connect completes on the worker thread
+				{
+					HANDLE associateResult = ::CreateIoCompletionPort((HANDLE)connectionSocket, rioCompletionPort, 0, 0);
+
+					if ((associateResult == nullptr) || (associateResult != rioCompletionPort))
+					{
+						// get error code
+						auto kernelErrorCode = ::GetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(kernelErrorCode);
+					}
+				}
+
+				// initialize connection with the resources of the worker
+				auto connection = InitializeConnection(connectionId, connectionSocket, INVALID_SOCKET, maxOutstandingReceive, maxOutstandingSend);
+
+				connection->context->upstreamIndex = upstreamIndex;
+
+				// the upstream connection keeps its segments, the pool is sized to hold them
+				if (!lifecycle->RentSegments(connection, receiveSegmentLength))
+				{
+					throw gcnew TcpServerException((int) ERROR_NOT_ENOUGH_MEMORY);
+				}
+
+				return connection;
+			}
+
+			/// <summary>
+			/// Creates the request queue of the connection socket, initializes the slot of the connection and maps its ring, if the rings are used.
+			/// </summary>
+			TcpConnection* InitializeConnection(int connectionId, SOCKET connectionSocket, SOCKET listenSocket, ULONG maxOutstandingReceive, ULONG maxOutstandingSend)
+			{
+				// create request queue, the send takes the template and the dynamic part
+				auto requestQueue = winsock.RIOCreateRequestQueue(connectionSocket, maxOutstandingReceive, 1, maxOutstandingSend, 2, rioCompletionQueue, rioCompletionQueue, (PVOID)connectionId);
+				{
+					// check if operation has failed
+					if (requestQueue == RIO_INVALID_RQ)
+					{
+						// get error code
+						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				// associate the connection socket with the completion port
+				/**
+				HANDLE resultPort = ::CreateIoCompletionPort((HANDLE)connectionSocket, disconnectCompletionPort, 0, 0);
+
+				// check if operation has succeed
+				if ((resultPort == nullptr) || (resultPort != disconnectCompletionPort))
+				{
+					// get error code
+					WinsockErrorCode winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+					// throw exception
+					throw gcnew TcpServerException(winsockErrorCode);
+				}
+				/**
+
+				// set output buffer to 0
+				{
+					int intValue = 0;
+
+					auto setBufferResult = ::setsockopt(connectionSocket, SOL_SOCKET, SO_SNDBUF, (const char *)&intValue, sizeof(int));
+
+					// check if operation has failed
+					if (setBufferResult == SOCKET_ERROR)
+					{
+						// get error code
+						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				// disable nagle
+				{
+					BOOL boolValue = TRUE;
+
+					int disableNagleResult = ::setsockopt(connectionSocket, IPPROTO_TCP, TCP_NODELAY, (const char *)&boolValue, sizeof(BOOL));
+
+					// check if operation has failed
+					if (disableNagleResult == SOCKET_ERROR)
+					{
+						// get error code
+						WinsockErrorCode winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				/**/
+
+				// get connection slot
+				TcpConnection* connection = connectionTable->GetConnection(connectionId);
+
+				// initialize connection, state is set to disconnected
+				connection->Initialize(winsock, connectionTable->GetContext(connectionId), listenSocket, connectionSocket, requestQueue, rioCompletionPort, connectionId, this->Id);
+
+				// the segments are rented later, the ring is mapped once per slot
+				connection->context->receiveSegment = RIO_SEGMENT_NIL;
+
+				connection->context->sendSegment = RIO_SEGMENT_NIL;
+
+				if (useReceiveRings)
+				{
+					DWORD kernelErrorCode;
+
+					int winsockErrorCode;
+
+					auto receiveRing = MirroredRing::Create(winsock, receiveSegmentLength, kernelErrorCode, winsockErrorCode);
+
+					// check if operation has failed
+					if (receiveRing == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
+					}
+
+					connection->rioReceiveBuffer = receiveRing->GetBuffer();
+
+					connection->context->receiveRing = receiveRing;
+				}
+
+				return connection;
+			}
+
+			/// <summary>
+			/// Registers the method to use for notification behavior with the completion queue.
+			/// </summary>
+			inline void Notify()
+			{
+				counters->notifyCount++;
+
+				winsock.RIONotify(rioCompletionQueue);
+			}
+
+			/// <summary>
+			/// Removes entries from the completion queue.
+			/// </summary>
+			/// <param name="rioResults">The array to receive the description of the completions dequeued.</param>
+			/// <param name="rioResultsCount">The maximum number of entries to write.</param>
+			/// <returns>The number of completion entries removed.</returns>
+			inline ULONG DequeueCompletions(PRIORESULT rioResults, ULONG rioResultsCount)
+			{
+				auto result = winsock.RIODequeueCompletion(rioCompletionQueue, rioResults, rioResultsCount);
+
+				counters->RecordDequeue(result);
+
+				return result;
+			}
+
+			/// <summary>
+			/// Records the latencies of the stages that end with the completion of the receive.
+			/// </summary>
+			/// <param name="timestamps">The timestamps of the connection.</param>
+			/// <param name="now">The time of the completion.</param>
+			inline void RecordReceiveLatencies(ConnectionTimestamps* timestamps, LONG64 now)
+			{
+				// check if this is the first receive after accept
+				if (timestamps->accepted != 0)
+				{
+					counters->latencies[LATENCY_STAGE_ACCEPT].Record(now - timestamps->accepted);
+
+					timestamps->accepted = 0;
+				}
+
+				timestamps->received = now;
+			}
+
+			/// <summary>
+			/// Records the latencies of the stages that end with the completion of the send.
+			/// </summary>
+			/// <param name="timestamps">The timestamps of the connection.</param>
+			/// <param name="now">The time of the completion.</param>
+			/// <remarks>
+			/// The start of the handler and the post of the send are set by the handler thread, so latencies are calculated here to keep histograms single writer.
+			/// </remarks>
+			inline void RecordSendLatencies(ConnectionTimestamps* timestamps, LONG64 now)
+			{
+				auto received = timestamps->received;
+
+				auto handlerStarted = timestamps->handlerStarted;
+
+				auto sendPosted = timestamps->sendPosted;
+
+				// check if the send is the response to the received request
+				if ((received != 0) && (handlerStarted >= received) && (sendPosted >= handlerStarted))
+				{
+					counters->latencies[LATENCY_STAGE_DISPATCH].Record(handlerStarted - received);
+
+					counters->latencies[LATENCY_STAGE_HANDLER].Record(sendPosted - handlerStarted);
+				}
+
+				counters->latencies[LATENCY_STAGE_SEND].Record(now - sendPosted);
+
+				timestamps->received = 0;
+			}
+
+			/// <summary>
+			/// Counts the slots in each state and publishes result into the statistics.
+			/// </summary>
+			/// <param name="sampleTime">The time, in milliseconds since system start, of the sample.</param>
+			/// <remarks>
+			/// Is called by the worker thread once per <see cref="OccupancySampleInterval" />, so the completion path is not charged with the per state counters.
+			/// </remarks>
+			void SampleOccupancy(ULONG64 sampleTime)
+			{
+				ULONG slotsByState[STATISTICS_STATES_COUNT] = { 0 };
+
+				for (ULONG connectionId = 0; connectionId < (ULONG) connectionsCount; connectionId++)
+				{
+					auto state = connectionTable->GetConnection(connectionId)->state;
+
+					if (state < STATISTICS_STATES_COUNT)
+					{
+						slotsByState[state]++;
+					}
+				}
+
+				for (auto stateIndex = 0; stateIndex < STATISTICS_STATES_COUNT; stateIndex++)
+				{
+					counters->slotsByState[stateIndex] = slotsByState[stateIndex];
+				}
+
+				counters->occupancySampleTime = sampleTime;
+			}
+
+			/// <summary>
+			/// Gets a pointer to the memory of the portion of the registered buffer.
+			/// </summary>
+			inline PCHAR GetData(const RIO_BUF& rioBuffer)
+			{
+				return rioBufferPool->GetData(rioBuffer);
+			}
+
+			/// <summary>
+			/// Gets the length of the segment used for sending data.
+			/// </summary>
+			inline UInt32 GetSendSegmentLength()
+			{
+				return sendSegmentLength;
+			}
+
+			/// <summary>
+			/// Gets the maximum count of the sends of the stream in progress per connection.
+			/// </summary>
+			inline UInt32 GetMaxStreamSends()
+			{
+				return maxStreamSends;
+			}
+
+			/// <summary>
+			/// Gets the length of the slice of the send buffer used by the single send of the stream.
+			/// </summary>
+			inline UInt32 GetStreamSliceLength()
+			{
+				return streamSliceLength;
+			}
+
+			/// <summary>
+			/// Gets the router of the requests, or <c>null</c> if there are no routes.
+			/// </summary>
+			inline HttpRouter* GetRouter()
+			{
+				return router;
+			}
+
+			/// <summary>
+			/// Gets the codec of the frames, or <c>null</c> if the connections serve HTTP only.
+			/// </summary>
+			inline FrameCodec* GetFrameCodec()
+			{
+				return frameCodec;
+			}
+
+			/// <summary>
+			/// Hands the receive of the connection whose receive segment is full over to the worker thread, which replaces the segment with the larger one first.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <returns><c>TRUE</c> if the receive is handed over; otherwise, <c>FALSE</c>.</returns>
+			inline BOOL BeginGrowReceive(TcpConnection* connection)
+			{
+				ConnectionLifecycle::BeginGrowReceive(connection);
+
+				return ::PostQueuedCompletionStatus(rioCompletionPort, 0, 0, &connection->context->growOverlapped);
+			}
+
+			/// <summary>
+			/// Replaces the full receive segment of the connection with the larger one and receives the rest of the request into it.
+			/// </summary>
+			/// <param name="connectionId">The unique identifier of the connection within the worker.</param>
+			/// <remarks>
+			/// Is called by the worker thread, which owns the buffer pool.
+			/// If the pool has no larger free segment, the receive is completed with zero bytes, so the handler closes the connection.
+			/// </remarks>
+			void EndGrowReceive(ULONG connectionId)
+			{
+				if (!lifecycle->EndGrowReceive(connectionTable->GetConnection(connectionId), ::GetTickCount64()))
+				{
+					managedConnections[connectionId]->EndReceive(0);
+				}
+			}
+
+			/// <summary>
+			/// Completes the receives of the connections which have waited for the next request longer than the timeout.
+			/// </summary>
+			/// <param name="tickCount">The current tick count.</param>
+			/// <remarks>
+			/// The receive is completed with zero bytes, so the handler disconnects the connection as closed by the client.
+			/// </remarks>
+			void CloseIdleConnections(ULONG64 tickCount)
+			{
+				for (ULONG connectionId = 0; connectionId < (ULONG) connectionsCount; connectionId++)
+				{
+					if (lifecycle->ExpireIdle(connectionTable->GetConnection(connectionId), tickCount))
+					{
+						managedConnections[connectionId]->EndReceive(0);
+					}
+				}
+			}
+
+			/// <summary>
+			/// Runs the periodic tasks of the worker if it is time to.
+			/// </summary>
+			inline void ProcessTimers()
+			{
+				auto tickCount = ::GetTickCount64();
+
+				if (tickCount - counters->occupancySampleTime >= OccupancySampleInterval)
+				{
+					SampleOccupancy(tickCount);
+
+					// close the connections which wait for the next request too long
+					if (keepAliveTimeout != 0)
+					{
+						CloseIdleConnections(tickCount);
+					}
+				}
+			}
+
+			/// <summary>
+			/// Takes the reference to the shared payload.
+			/// </summary>
+			/// <param name="payloadIndex">The index of the payload.</param>
+			/// <returns>A pointer to the payload.</returns>
+			inline SharedPayload* AcquirePayload(UInt32 payloadIndex)
+			{
+				auto payload = payloadRegistry->Acquire(payloadIndex);
+
+				if (payload == nullptr)
+				{
+					throw gcnew ArgumentOutOfRangeException("payloadIndex");
+				}
+
+				return payload;
+			}
+
+			/// <summary>
+			/// Takes the connection to the upstream from the pool, connects it if it is not idle.
+			/// </summary>
+			/// <param name="upstreamIndex">The index of the upstream.</param>
+			/// <returns>The task that completes with the connected upstream connection.</returns>
+			Task<Connection^>^ AcquireUpstream(UInt32 upstreamIndex)
+			{
+				if (upstreamIndex >= upstreamsCount)
+				{
+					throw gcnew ArgumentOutOfRangeException("upstreamIndex");
+				}
+
+				ULONG connectionId;
+
+				BOOL connected;
+
+				if (!upstreamPool->TryAcquire(upstreamIndex, connectionId, connected))
+				{
+					throw gcnew InvalidOperationException("All connections of the worker to the upstream are in use.");
+				}
+
+				auto connection = connectionTable->GetConnection(connectionId);
+
+				auto managedConnection = managedConnections[connectionId];
+
+				// reuse the idle connection at once
+				if (connected)
+				{
+					connection->state = ConnectionState::Connected;
+
+					trace->Record(connection, ConnectionState::Idle, 0, 0);
+
+					return Task::FromResult(managedConnection);
+				}
+
+				// the slot holds the new connection
+				connection->generation++;
+
+				// the task is completed by the worker thread, continuations should not run on it
+				auto connectSource = gcnew TaskCompletionSource<Connection^>(TaskCreationOptions::RunContinuationsAsynchronously);
+
+				managedConnection->connectSource = connectSource;
+
+				auto upstream = upstreams + upstreamIndex;
+
+				auto connectResult = connection->StartConnect((const sockaddr *)&upstream->address, upstream->addressLength);
+
+				auto error = TraceRing::GetError(connectResult);
+
+				trace->Record(connection, ConnectionState::Disconnected, 0, error);
+
+				// check if operation has failed
+				if (error != 0)
+				{
+					managedConnection->connectSource = nullptr;
+
+					connection->state = ConnectionState::Disconnected;
+
+					upstreamPool->Release(upstreamIndex, connectionId, FALSE);
+
+					// throw exception
+					throw gcnew TcpServerException((WinsockErrorCode) error);
+				}
+
+				return connectSource->Task;
+			}
+
+			/// <summary>
+			/// Returns the upstream connection to the pool, disconnects it if it is not kept alive.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection.</param>
+			/// <param name="keepAlive"><c>true</c> to keep the connection for reuse; <c>false</c> to disconnect it.</param>
+			void ReleaseUpstream(TcpConnection* connection, Boolean keepAlive)
+			{
+				auto upstreamIndex = connection->context->upstreamIndex;
+
+				if (upstreamIndex == ULONG_MAX)
+				{
+					throw gcnew InvalidOperationException("The connection is not made to the upstream.");
+				}
+
+				auto fromState = connection->state;
+
+				if (keepAlive)
+				{
+					connection->state = ConnectionState::Idle;
+
+					trace->Record(connection, fromState, 0, 0);
+				}
+				else
+				{
+					// the socket stays bound and is connected again on the next use
+					auto disconnectResult = connection->StartDisconnect();
+
+					trace->Record(connection, fromState, 0, TraceRing::GetError(disconnectResult));
+
+					connection->state = ConnectionState::Disconnected;
+				}
+
+				upstreamPool->Release(upstreamIndex, connection->id, keepAlive);
+			}
+
+			/// <summary>
+			/// Processes the completion of the connect of the upstream connection.
+			/// </summary>
+			/// <param name="overlapped">The structure used by the connect operation.</param>
+			/// <param name="succeeded">Indicates whether the operation has succeed.</param>
+			void EndConnect(Ovelapped* overlapped, BOOL succeeded)
+			{
+				auto connectionId = overlapped->connectionId;
+
+				auto connection = connectionTable->GetConnection(connectionId);
+
+				int winsockErrorCode = 0;
+
+				if (!succeeded)
+				{
+					DWORD bytesTransferred;
+
+					DWORD flags;
+
+					// get the error of the operation in terms of the Winsock
+					::WSAGetOverlappedResult(overlapped->connectionSocket, overlapped, &bytesTransferred, FALSE, &flags);
+
+					winsockErrorCode = ::WSAGetLastError();
+				}
+				else if (connection->EndConnect() == SOCKET_ERROR)
+				{
+					winsockErrorCode = ::WSAGetLastError();
+				}
+
+				// the connection made for forwarding has no task, the accepted connection waits for it instead
+				if (lifecycle->EndConnect(connection, winsockErrorCode))
+				{
+					return;
+				}
+
+				managedConnections[connectionId]->EndConnect(winsockErrorCode);
+			}
+
+			/// <summary>
+			/// Hands the payload over to the worker thread to send it to the connections.
+			/// </summary>
+			/// <param name="payload">The payload to send.</param>
+			/// <param name="targets">The identifiers of the connections within the worker, each with the generation of its slot when it was chosen.</param>
+			/// <remarks>
+			/// The sends are posted by the worker thread while the handlers post the operations of the same connections from their own threads,
+			/// the request queue is not thread safe, so the posts to it are serialized by the lock of the connection.
+			/// </remarks>
+			void Broadcast(SharedPayload* payload, List<KeyValuePair<UInt32, UInt16>>^ targets)
+			{
+				auto batch = BroadcastBatch::Create(payload, targets->Count);
+
+				if (batch == nullptr)
+				{
+					throw gcnew OutOfMemoryException();
+				}
+
+				// the batch holds its own reference until the sends are posted
+				payload->AddReference();
+
+				for (auto index = 0; index < targets->Count; index++)
+				{
+					batch->targets[index].connectionId = targets[index].Key;
+
+					batch->targets[index].generation = targets[index].Value;
+				}
+
+				auto postResult = ::PostQueuedCompletionStatus(rioCompletionPort, 0, 0, &batch->overlapped);
+
+				// check if operation has failed
+				if (postResult == FALSE)
+				{
+					auto kernelErrorCode = ::GetLastError();
+
+					BroadcastBatch::Destroy(batch);
+
+					throw gcnew TcpServerException((int) kernelErrorCode);
+				}
+			}
+
+			/// <summary>
+			/// Posts the sends of the payload to the connections of the batch, is called by the worker thread.
+			/// </summary>
+			/// <remarks>
+			/// The connection which is not connected, or whose slot holds the next client, is skipped.
+			/// The sends to the connection which has too many sends in progress, and to the rest of the batch once the slots of the broadcast sends run out, are dropped and counted.
+			/// </remarks>
+			void ProcessBroadcast(BroadcastBatch* batch)
+			{
+				auto payload = batch->payload;
+
+				for (ULONG index = 0; index < batch->connectionsCount; index++)
+				{
+					auto target = batch->targets + index;
+
+					if (target->connectionId >= (ULONG) connectionsCount)
+					{
+						continue;
+					}
+
+					auto connection = connectionTable->GetConnection(target->connectionId);
+
+					// the client the payload is meant for has disconnected
+					if (connection->generation != target->generation)
+					{
+						continue;
+					}
+
+					auto state = connection->state;
+
+					if ((state < ConnectionState::Accepted) || (state > ConnectionState::Sent))
+					{
+						continue;
+					}
+
+					auto slotIndex = broadcastSends->Take(payload);
+
+					if (slotIndex == ULONG_MAX)
+					{
+						counters->broadcastDropsCount += batch->connectionsCount - index;
+
+						break;
+					}
+
+					// the queue of the sends of the connection is full
+					if (!connection->StartBroadcastSend(payload->GetBuffer(), slotIndex))
+					{
+						broadcastSends->Return(slotIndex);
+
+						counters->broadcastDropsCount++;
+					}
+				}
+
+				BroadcastBatch::Destroy(batch);
+			}
+
+			/// <summary>
+			/// Processes the completion of the overlapped disconnect of the connection.
+			/// </summary>
+			/// <param name="overlapped">The structure of the disconnect.</param>
+			/// <param name="succeeded">Indicates whether the disconnect has succeeded.</param>
+			void EndDisconnect(Ovelapped* overlapped, BOOL succeeded)
+			{
+				lifecycle->EndDisconnect(connectionTable->GetConnection(overlapped->connectionId), succeeded ? 0 : ::GetLastError());
+			}
+
+			#pragma endregion
+
+			[System::Security::SuppressUnmanagedCodeSecurity]
+			inline void ProcessRioOperations()
+			{
+				// bind the thread to its processor, the managed thread should stay on the same system thread
+				if (processorMask != 0)
+				{
+					Thread::BeginThreadAffinity();
+
+					::SetThreadAffinityMask(::GetCurrentThread(), (DWORD_PTR) processorMask);
+				}
+
+				// the segments are rented and replaced by this thread, the other threads return them through the remote lists
+				rioBufferPool->SetOwnerThread();
+
+				// the number of bytes transferred during an I/O operation that has completed
+				DWORD numberOfBytes = 0;
+
+				// the completion key value associated with the file handle whose I/O operation has completed
+				ULONG_PTR completionKey = 0;
+
+				// the OVERLAPPED structure that was specified when the completed I/O operation was started.
+				LPOVERLAPPED overlapped = nullptr;
+
+				// array of the Registered IO results
+				RIORESULT rioResults[1024];
+
+				while (true)
+				{
+					// register the method to use for notification behavior with an I/O completion queue for use with the Winsock registered I/O extensions
+					Notify();
+
+					// dequeue completion status, the worker wakes up periodically to close the idle connections
+					BOOL dequeueResult = ::GetQueuedCompletionStatus(rioCompletionPort, &numberOfBytes, &completionKey, &overlapped, keepAliveTimeout != 0 ? (DWORD) OccupancySampleInterval : WSA_INFINITE);
+
+					// check if the socket operation has completed, the notification of the completion queue carries no overlapped structure
+					if ((overlapped != nullptr) && (overlapped != (LPOVERLAPPED)-1))
+					{
+						auto socketOverlapped = (Ovelapped*) overlapped;
+
+						// the admitted connection is handed over by the accept thread to rent its segments
+						if (socketOverlapped->action == SOCK_ACTION_ACCEPT)
+						{
+							EndAdmit(socketOverlapped->connectionId);
+						}
+						else if (socketOverlapped->action == SOCK_ACTION_GROW)
+						{
+							EndGrowReceive(socketOverlapped->connectionId);
+						}
+						else if (socketOverlapped->action == SOCK_ACTION_BROADCAST)
+						{
+							// the batch starts with the structure
+							ProcessBroadcast((BroadcastBatch*) socketOverlapped);
+						}
+						else if (socketOverlapped->action == SOCK_ACTION_DISCONNECT)
+						{
+							EndDisconnect(socketOverlapped, dequeueResult);
+						}
+						else
+						{
+							EndConnect(socketOverlapped, dequeueResult);
+						}
+
+						continue;
+					}
+
+					// check if operation has failed
+					if (dequeueResult == FALSE)
+					{
+						// the wait has timed out
+						if (overlapped == nullptr)
+						{
+							ProcessTimers();
+						}
+
+						continue;
+					}
+
+					counters->wakeupsCount++;
+
+					// dequeue Registered IO completion results
+					ULONG receiveCompletionsCount;
+
+					BOOL activatedCompletionPort = FALSE;
+
+					while ((receiveCompletionsCount = DequeueCompletions(rioResults, 1024)) > 0)
+					{
+						// take the time once per batch
+						auto now = LatencyHistogram::GetTimestamp();
+
+						// publish depth of the queue for the admission control
+						admissionControl->SetCompletionQueueDepth(receiveCompletionsCount);
+
+						for (int resultIndex = 0; resultIndex < receiveCompletionsCount; resultIndex++)
+						{
+							// get Registered IO result
+							auto rioResult = rioResults[resultIndex];
+
+							// get request context, which holds the connection id
+							auto requestContext = (ULONG) rioResult.RequestContext;
+
+							TcpConnection* connection;
+
+							auto kind = CompletionDispatch::Classify(connectionTable, requestContext, connection);
+
+							auto connectionId = requestContext & TCP_CONNECTION_ID_MASK;
+
+							if (kind == CompletionBroadcastSend)
+							{
+								counters->sendsCount++;
+
+								counters->bytesSent += rioResult.BytesTransferred;
+
+								// the context holds the slot of the payload
+								broadcastSends->Return(connectionId);
+							}
+							else if (kind == CompletionForward)
+							{
+								lifecycle->ProcessForward(requestContext, rioResult);
+							}
+							else if (kind == CompletionReceive)
+							{
+								RecordReceiveLatencies(connectionTable->GetTimestamps(connectionId), now);
+
+								// end receive and resume the handler
+								lifecycle->CompleteReceive(connection, rioResult);
+
+								managedConnections[connectionId]->EndReceive(rioResult.BytesTransferred);
+							}
+							else if (kind == CompletionSend)
+							{
+								RecordSendLatencies(connectionTable->GetTimestamps(connectionId), now);
+
+								// end send and resume the handler
+								lifecycle->CompleteSend(connection, rioResult);
+
+								managedConnections[connectionId]->EndSend(rioResult.BytesTransferred);
+							}
+							else if (kind == CompletionStreamSend)
+							{
+								counters->sendsCount++;
+
+								counters->bytesSent += rioResult.BytesTransferred;
+
+								trace->Record(connection, ConnectionState::Streaming, rioResult.BytesTransferred, rioResult.Status);
+
+								// the last send of the stream completes the response
+								managedConnections[connectionId]->EndStreamSend(rioResult.BytesTransferred);
+							}
+							else if (kind == CompletionRefuse)
+							{
+								// busy response is sent, return connection to accept without waiting for the disconnect
+								lifecycle->ReturnToAccept(connection);
+							}
+
+							// the late completion of the operation posted by the previous connection of the slot is dropped, as well as the unexpected one
+						}
+
+						if (!activatedCompletionPort)
+						{
+							// register the method to use for notification behavior with an I/O completion queue for use with the Winsock registered I/O extensions
+							Notify();
+
+							activatedCompletionPort = TRUE;
+						}
+					}
+
+					// sample occupancy of the slots and close the idle connections if it is time to
+					ProcessTimers();
+				}
+			}
+		};
+	}
+}
+
+namespace SXN
+{
+	namespace Net
+	{
+		inline PCHAR Connection::GetReceiveData()
+		{
+			return lifecycle->GetReceiveData(connection);
+		}
+
+		inline IntPtr Connection::ReceiveData::get()
+		{
+			return IntPtr(GetReceiveData());
+		}
+
+		inline IntPtr Connection::SendData::get()
+		{
+			return IntPtr(worker->GetData(connection->rioSendBuffer));
+		}
+
+		inline ReceiveTask^ Connection::ReceiveRequestsAsync()
+		{
+			auto fromState = connection->state;
+
+			// the request fills the whole segment, the worker thread replaces it with the larger one before the receive
+			if (lifecycle->CompactReceive(connection))
+			{
+				auto growResult = worker->BeginGrowReceive(connection);
+
+				trace->Record(connection, fromState, 0, growResult ? 0 : ::GetLastError());
+
+				// check if operation has failed
+				if (!growResult)
+				{
+					ConnectionLifecycle::EndReceive(connection, 0);
+
+					EndReceive(0);
+				}
+
+				return receiveTask;
+			}
+
+			lifecycle->ReceiveNext(connection, ::GetTickCount64());
+
+			return receiveTask;
+		}
+
+		inline HttpRequestStatus Connection::ParseRequest()
+		{
+			if (request == nullptr)
+			{
+				request = new HttpRequest();
+			}
+
+			// the request which fills the whole buffer that can not grow is malformed
+			auto result = lifecycle->ParseRequest(connection, *request);
+
+			if (result == HttpParseIncomplete)
+			{
+				return HttpRequestStatus::Incomplete;
+			}
+
+			if (result == HttpParseError)
+			{
+				return HttpRequestStatus::Malformed;
+			}
+
+			return HttpRequestStatus::Complete;
+		}
+
+		inline HttpRequestStatus Connection::ReadRequest()
+		{
+			auto status = ParseRequest();
+
+			if (status != HttpRequestStatus::Complete)
+			{
+				return status;
+			}
+
+			auto context = connection->context;
+
+			auto length = context->receivedLength - context->consumedLength;
+
+			ULONG64 contentLength;
+
+			const HttpStringView* transferEncoding;
+
+			if (!request->GetContentLength(contentLength) || !request->GetTransferEncoding(transferEncoding) || (transferEncoding != nullptr))
+			{
+				return HttpRequestStatus::Malformed;
+			}
+
+			// the body is not received yet, the headers are parsed again with it
+			if (request->headersLength + contentLength > length)
+			{
+				return (request->headersLength + contentLength > lifecycle->GetReceiveLimit(connection)) ? HttpRequestStatus::Malformed : HttpRequestStatus::Incomplete;
+			}
+
+			// the whole body is the single piece
+			context->bodyOffset = context->consumedLength + request->headersLength;
+
+			context->bodyLength = (ULONG) contentLength;
+
+			context->bodyReceiving = FALSE;
+
+			context->bodyMalformed = FALSE;
+
+			ConnectionLifecycle::ConsumeRequest(connection, request->headersLength + (ULONG) contentLength);
+
+			return HttpRequestStatus::Complete;
+		}
+
+		inline HttpRequestStatus Connection::ReadRequestHeaders()
+		{
+			auto status = ParseRequest();
+
+			if (status != HttpRequestStatus::Complete)
+			{
+				return status;
+			}
+
+			auto context = connection->context;
+
+			ULONG64 contentLength;
+
+			const HttpStringView* transferEncoding;
+
+			if (!request->GetContentLength(contentLength) || !request->GetTransferEncoding(transferEncoding))
+			{
+				return HttpRequestStatus::Malformed;
+			}
+
+			// the chunked coding should be the final one and excludes the length
+			if ((transferEncoding != nullptr) && (!HttpRequest::IsLastOption(*transferEncoding, "chunked", 7) || (request->FindHeader("Content-Length", 14) != nullptr)))
+			{
+				return HttpRequestStatus::Malformed;
+			}
+
+			context->bodyChunked = transferEncoding != nullptr;
+
+			context->bodyRemaining = contentLength;
+
+			context->bodyReceiving = context->bodyChunked || (contentLength != 0);
+
+			context->bodyMalformed = FALSE;
+
+			context->bodyLength = 0;
+
+			context->chunkedDecoder.Reset();
+
+			ConnectionLifecycle::ConsumeRequest(connection, request->headersLength);
+
+			return HttpRequestStatus::Complete;
+		}
+
+		inline UInt32 Connection::TakeBody()
+		{
+			auto context = connection->context;
+
+			context->bodyLength = 0;
+
+			auto length = context->receivedLength - context->consumedLength;
+
+			if (!context->bodyChunked)
+			{
+				// the data after the body belongs to the next request
+				if (length > context->bodyRemaining)
+				{
+					length = (ULONG) context->bodyRemaining;
+				}
+
+				context->bodyOffset = context->consumedLength;
+
+				context->bodyLength = length;
+
+				context->consumedLength += length;
+
+				context->bodyRemaining -= length;
+
+				context->bodyReceiving = context->bodyRemaining != 0;
+
+				return length;
+			}
+
+			ULONG consumed;
+
+			ULONG dataOffset;
+
+			ULONG dataLength;
+
+			auto result = context->chunkedDecoder.Decode(GetReceiveData() + context->consumedLength, length, consumed, dataOffset, dataLength);
+
+			if (result == HttpParseError)
+			{
+				context->bodyReceiving = FALSE;
+
+				context->bodyMalformed = TRUE;
+
+				return 0;
+			}
+
+			context->bodyOffset = context->consumedLength + dataOffset;
+
+			context->bodyLength = dataLength;
+
+			context->consumedLength += consumed;
+
+			context->bodyReceiving = !context->chunkedDecoder.IsDone();
+
+			return dataLength;
+		}
+
+		inline void Connection::ReceiveBody()
+		{
+			auto context = connection->context;
+
+			context->receivedLength = 0;
+
+			context->consumedLength = 0;
+
+			// the client which sends the body is not idle
+			context->idleSince = 0;
+
+			auto fromState = connection->state;
+
+			auto res = connection->StartReceiveNext();
+
+			trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+		}
+
+		inline ReceiveTask^ Connection::ReceiveBodyAsync()
+		{
+			// the piece being received would be taken twice
+			if (connection->state == ConnectionState::Receiving)
+			{
+				throw gcnew InvalidOperationException("The previous receive of the body is not awaited.");
+			}
+
+			auto context = connection->context;
+
+			context->bodyLength = 0;
+
+			if (context->bodyReceiving)
+			{
+				auto length = TakeBody();
+
+				// all data received is consumed, the buffer is reused for the next piece
+				if ((length == 0) && context->bodyReceiving)
+				{
+					ReceiveBody();
+
+					return receiveTask;
+				}
+
+				receiveTask->Complete(length);
+
+				return receiveTask;
+			}
+
+			receiveTask->Complete(0);
+
+			return receiveTask;
+		}
+
+		inline IntPtr Connection::BodyData::get()
+		{
+			return IntPtr(GetReceiveData() + connection->context->bodyOffset);
+		}
+
+		inline String^ Connection::GetRequestHeader(String^ name)
+		{
+			if (name == nullptr)
+			{
+				throw gcnew ArgumentNullException("name");
+			}
+
+			for (ULONG headerIndex = 0; headerIndex < request->headersCount; headerIndex++)
+			{
+				auto& header = request->headers[headerIndex];
+
+				if (header.name.length != (ULONG) name->Length)
+				{
+					continue;
+				}
+
+				auto equals = true;
+
+				for (auto charIndex = 0; charIndex < name->Length; charIndex++)
+				{
+					if (Char::ToLowerInvariant(name[charIndex]) != Char::ToLowerInvariant((wchar_t) (unsigned char) header.name.data[charIndex]))
+					{
+						equals = false;
+
+						break;
+					}
+				}
+
+				if (equals)
+				{
+					return gcnew String((signed char*) header.value.data, 0, header.value.length);
+				}
+			}
+
+			return nullptr;
+		}
+
+		inline Int32 Connection::RouteRequest()
+		{
+			auto router = worker->GetRouter();
+
+			if ((router == nullptr) || (request == nullptr))
+			{
+				return -1;
+			}
+
+			if (routeMatch == nullptr)
+			{
+				routeMatch = new HttpRouteMatch();
+			}
+
+			if (!router->Match(*request, *routeMatch))
+			{
+				routeMatch->parametersCount = 0;
+
+				return -1;
+			}
+
+			return (Int32) routeMatch->routeIndex;
+		}
+
+		inline String^ Connection::GetRouteParameter(Int32 parameterIndex)
+		{
+			if ((parameterIndex < 0) || (parameterIndex >= RouteParametersCount))
+			{
+				throw gcnew ArgumentOutOfRangeException("parameterIndex");
+			}
 
-				/**
-				{
-					// create I/O completion port
-					this->disconnectCompletionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+			auto& parameter = routeMatch->parameters[parameterIndex];
 
-					// check if operation has failed
-					if (disconnectCompletionPort == nullptr)
-					{
-						// get error code
-						DWORD kernelErrorCode = ::GetLastError();
+			return gcnew String((signed char*) parameter.data, 0, parameter.length);
+		}
 
-						// throw exception
-						throw gcnew TcpServerException(kernelErrorCode);
-					}
-				}
-				/**/
+		inline FrameStatus Connection::ReadFrame()
+		{
+			auto frameCodec = worker->GetFrameCodec();
 
-				// create receive buffer pool
-				{
-					DWORD kernelErrorCode;
+			if (frameCodec == nullptr)
+			{
+				throw gcnew InvalidOperationException();
+			}
 
-					int winsockErrorCode;
+			auto context = connection->context;
 
-					rioReceiveBufferPool = RioBufferPool::Create(winsock, segmentLength, connectionsCount, kernelErrorCode, winsockErrorCode);
+			auto data = GetReceiveData() + context->consumedLength;
 
-					// check if operation has failed
-					if (rioReceiveBufferPool == nullptr)
-					{
-						// throw exception
-						throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
-					}
-				}
+			auto length = context->receivedLength - context->consumedLength;
 
-				// create send buffer pool
-				{
-					DWORD kernelErrorCode;
+			ULONG payloadLength;
 
-					int winsockErrorCode;
+			// the frame above the limit is refused by its header, the largest frame fits within the buffer
+			auto result = frameCodec->Decode(data, length, payloadLength);
 
-					rioSendBufferPool = RioBufferPool::Create(winsock, segmentLength, connectionsCount, kernelErrorCode, winsockErrorCode);
+			if (result != FrameDecodeComplete)
+			{
+				return (FrameStatus) result;
+			}
 
-					// check if operation has failed
-					if (rioSendBufferPool == nullptr)
-					{
-						// throw exception
-						throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
-					}
-				}
+			context->frameOffset = context->consumedLength;
 
-				// initialize connections array
-				connections = new TcpConnection*[connectionsCount];
+			context->framePayloadLength = payloadLength;
 
-				managedConnections = gcnew array<Connection ^>(connectionsCount);
+			ConnectionLifecycle::ConsumeRequest(connection, frameCodec->GetHeaderLength() + payloadLength);
 
-				// initialize connections
-				for (unsigned int index = 0; index < connectionsCount; index++)
-				{
-					// create connection
-					TcpConnection* connection = CreateConnection(index, 24, 40);
+			return FrameStatus::Complete;
+		}
 
-					// add to collection
-					connections[index] = connection;
+		inline IntPtr Connection::FrameHeader::get()
+		{
+			return IntPtr(GetReceiveData() + connection->context->frameOffset);
+		}
 
-					managedConnections[index] = gcnew Connection(connection);
+		inline IntPtr Connection::FramePayload::get()
+		{
+			auto frameCodec = worker->GetFrameCodec();
 
-					connection->StartAccept();
+			if (frameCodec == nullptr)
+			{
+				throw gcnew InvalidOperationException();
+			}
 
-					//managedConnections[index]->BeginReceive();
-				}
+			return IntPtr(GetReceiveData() + connection->context->frameOffset + frameCodec->GetHeaderLength());
+		}
 
-				{
-					ThreadStart^ threadDelegate = gcnew ThreadStart(this, &IocpWorker::ProcessRioOperations);
+		inline Boolean Connection::AppendFrame(array<Byte>^ header, array<Byte>^ payload)
+		{
+			auto frameCodec = worker->GetFrameCodec();
 
-					processRioOperationsThread = gcnew Thread(threadDelegate);
+			if (frameCodec == nullptr)
+			{
+				throw gcnew InvalidOperationException();
+			}
 
-					processRioOperationsThread->Name = String::Format("RIO processing thread # {0}", id);
+			if (payload == nullptr)
+			{
+				throw gcnew ArgumentNullException("payload");
+			}
 
-					processRioOperationsThread->IsBackground = true;
+			auto headerLength = frameCodec->GetHeaderLength();
 
-					processRioOperationsThread->Start();
-				}
+			if ((header != nullptr) && ((ULONG) header->Length != headerLength))
+			{
+				throw gcnew ArgumentOutOfRangeException("header");
 			}
 
-			/// <summary>
-			/// Releases all associated resources.
-			/// </summary>
-			~IocpWorker()
+			if ((ULONG) payload->Length > frameCodec->GetMaxPayloadLength())
 			{
-				// release buffer pool
-				delete rioReceiveBufferPool;
+				throw gcnew ArgumentOutOfRangeException("payload");
+			}
 
-				// close completion queue
-				winsock.RIOCloseCompletionQueue(rioCompletionQueue);
+			auto context = connection->context;
 
-				// close completion port
-				// ignore result
-				::CloseHandle(rioCompletionPort);
+			if (context->sendLength + headerLength + payload->Length > worker->GetSendSegmentLength())
+			{
+				return false;
 			}
 
-			#pragma endregion
+			auto frame = worker->GetData(connection->rioSendBuffer) + context->sendLength;
 
-			#pragma region Methods
+			if (header != nullptr)
+			{
+				Marshal::Copy(header, 0, IntPtr(frame), header->Length);
+			}
+			else
+			{
+				memset(frame, 0, headerLength);
+			}
+
+			frameCodec->Encode(frame, payload->Length);
 
+			Marshal::Copy(payload, 0, IntPtr(frame + headerLength), payload->Length);
+
+			context->sendLength += headerLength + payload->Length;
+
+			return true;
+		}
+
+		inline Boolean Connection::KeepAlive::get()
+		{
+			return lifecycle->KeepsAlive(connection, *request) != FALSE;
+		}
 
-			TcpConnection* CreateConnection(int connectionId, ULONG maxOutstandingReceive, ULONG maxOutstandingSend)
+		inline Boolean Connection::AppendTemplate(UInt32 templateIndex)
+		{
+			if (templateIndex >= responseTemplates->GetCount())
 			{
-				// create connection socket
-				auto connectionSocket = ::WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+				throw gcnew ArgumentOutOfRangeException("templateIndex");
+			}
 
-				// check if operation has failed
-				if (connectionSocket == INVALID_SOCKET)
-				{
-					// get error code
-					auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+			auto context = connection->context;
 
-					// throw exception
-					throw gcnew TcpServerException(winsockErrorCode);
-				}
+			ULONG templateLength;
 
-				// create request queue
-				auto requestQueue = winsock.RIOCreateRequestQueue(connectionSocket, maxOutstandingReceive, 1, maxOutstandingSend, 1, rioCompletionQueue, rioCompletionQueue, (PVOID)connectionId);
-				{
-					// check if operation has failed
-					if (requestQueue == RIO_INVALID_RQ)
-					{
-						// get error code
-						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+			auto templateData = responseTemplates->GetTemplateData(templateIndex, templateLength);
 
-						// throw exception
-						throw gcnew TcpServerException(winsockErrorCode);
-					}
-				}
+			if (context->sendLength + templateLength > worker->GetSendSegmentLength())
+			{
+				return false;
+			}
 
-				// associate the connection socket with the completion port
-				/**
-				HANDLE resultPort = ::CreateIoCompletionPort((HANDLE)connectionSocket, disconnectCompletionPort, 0, 0);
+			memcpy(worker->GetData(connection->rioSendBuffer) + context->sendLength, templateData, templateLength);
 
-				// check if operation has succeed
-				if ((resultPort == nullptr) || (resultPort != disconnectCompletionPort))
-				{
-					// get error code
-					WinsockErrorCode winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+			context->sendLength += templateLength;
 
-					// throw exception
-					throw gcnew TcpServerException(winsockErrorCode);
-				}
-				/**
+			return true;
+		}
 
-				// set output buffer to 0
-				{
-					int intValue = 0;
+		inline Boolean Connection::Append(array<Byte>^ data)
+		{
+			if (data == nullptr)
+			{
+				throw gcnew ArgumentNullException("data");
+			}
 
-					auto setBufferResult = ::setsockopt(connectionSocket, SOL_SOCKET, SO_SNDBUF, (const char *)&intValue, sizeof(int));
+			auto context = connection->context;
 
-					// check if operation has failed
-					if (setBufferResult == SOCKET_ERROR)
-					{
-						// get error code
-						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+			if (context->sendLength + data->Length > worker->GetSendSegmentLength())
+			{
+				return false;
+			}
 
-						// throw exception
-						throw gcnew TcpServerException(winsockErrorCode);
-					}
-				}
+			Marshal::Copy(data, 0, IntPtr(worker->GetData(connection->rioSendBuffer) + context->sendLength), data->Length);
 
-				// disable nagle
-				{
-					BOOL boolValue = TRUE;
+			context->sendLength += data->Length;
 
-					int disableNagleResult = ::setsockopt(connectionSocket, IPPROTO_TCP, TCP_NODELAY, (const char *)&boolValue, sizeof(BOOL));
+			return true;
+		}
 
-					// check if operation has failed
-					if (disableNagleResult == SOCKET_ERROR)
-					{
-						// get error code
-						WinsockErrorCode winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+		inline ReceiveTask^ Connection::FlushAsync()
+		{
+			auto context = connection->context;
 
-						// throw exception
-						throw gcnew TcpServerException(winsockErrorCode);
-					}
-				}
+			auto length = context->sendLength;
 
-				/**/
+			context->sendLength = 0;
 
-				// create connection handle
-				TcpConnection* connection = new TcpConnection(winsock, listenSocket, connectionSocket, requestQueue, rioCompletionPort, connectionId, this->Id);
+			timestamps->sendPosted = LatencyHistogram::GetTimestamp();
 
-				// set initial state
-				connection->state = ConnectionState::Disconnected;
+			auto fromState = connection->state;
 
-				connection->rioReceiveBuffer = rioReceiveBufferPool->GetBuffer(connectionId);
+			auto res = connection->StartSend(length);
 
-				connection->rioSendBuffer = rioSendBufferPool->GetBuffer(connectionId);
+			trace->Record(connection, fromState, 0, TraceRing::GetError(res));
 
-				memcpy(rioSendBufferPool->GetBufferData(connectionId), testMessage, strlen(testMessage));
+			return sendTask;
+		}
 
-				return connection;
+		inline void Connection::EndStreamSend(unsigned int bytesTransferred)
+		{
+			auto context = connection->context;
+
+			auto sendsCount = ::InterlockedDecrement(&context->streamSendsCount);
+
+			// all sends of the ended stream are completed
+			if (sendsCount == TCP_CONNECTION_STREAM_ENDING)
+			{
+				context->streamSendsCount = 0;
+
+				connection->state = ConnectionState::Sent;
+
+				EndSend(bytesTransferred);
+
+				return;
 			}
 
-			#pragma endregion
+			// the handler has filled all slices and waits for this one
+			if (sendsCount == (LONG) worker->GetMaxStreamSends() - 1)
+			{
+				sendTask->Complete(bytesTransferred);
+			}
+		}
 
-			[System::Security::SuppressUnmanagedCodeSecurity]
-			inline void ProcessRioOperations()
+		inline ReceiveTask^ Connection::SendStreamSlice(ULONG offset, ULONG length, LONG sendsIncrement)
+		{
+			auto context = connection->context;
+
+			context->streamSliceIndex = (context->streamSliceIndex + 1) % worker->GetMaxStreamSends();
+
+			// the send is counted before it is posted, so its completion never sees the count below it
+			auto sendsCount = ::InterlockedExchangeAdd(&context->streamSendsCount, sendsIncrement) + sendsIncrement;
+
+			timestamps->sendPosted = LatencyHistogram::GetTimestamp();
+
+			auto fromState = connection->state;
+
+			auto res = connection->StartStreamSend(offset, length);
+
+			trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+			// the failed send is never completed by the worker, it is ended here, so the handler which waits for it is resumed once
+			if (!res)
 			{
-				// the number of bytes transferred during an I/O operation that has completed
-				DWORD numberOfBytes = 0;
+				EndStreamSend(0);
+			}
 
-				// the completion key value associated with the file handle whose I/O operation has completed
-				ULONG_PTR completionKey = 0;
+			// the ending flag makes the count large, the handler waits for the end of the stream
+			if (sendsCount < (LONG) worker->GetMaxStreamSends())
+			{
+				sendTask->Complete(0);
+			}
 
-				// the OVERLAPPED structure that was specified when the completed I/O operation was started.
-				LPOVERLAPPED overlapped = nullptr;
+			return sendTask;
+		}
 
-				// array of the Registered IO results
-				RIORESULT rioResults[1024];
+		inline UInt32 Connection::StreamChunkCapacity::get()
+		{
+			return worker->GetStreamSliceLength() - HTTP_CHUNK_FRAMING_MAX_LENGTH;
+		}
 
-				while (true)
-				{
-					// register the method to use for notification behavior with an I/O completion queue for use with the Winsock registered I/O extensions
-					winsock.RIONotify(rioCompletionQueue);
+		inline ReceiveTask^ Connection::BeginStreamAsync()
+		{
+			auto context = connection->context;
 
-					// dequeue completion status
-					BOOL dequeueResult = ::GetQueuedCompletionStatus(rioCompletionPort, &numberOfBytes, &completionKey, &overlapped, WSA_INFINITE);
+			if (context->sendLength + HTTP_CHUNKED_HEADER_LENGTH > worker->GetStreamSliceLength())
+			{
+				throw gcnew InvalidOperationException("The headers do not fit the slice of the send buffer.");
+			}
 
-					// check if operation has failed
-					if (dequeueResult == FALSE)
-					{
-						continue;
-					}
+			// the headers start the first slice
+			memcpy(worker->GetData(connection->rioSendBuffer) + context->sendLength, HTTP_CHUNKED_HEADER, HTTP_CHUNKED_HEADER_LENGTH);
 
-					// dequeue Registered IO completion results
-					ULONG receiveCompletionsCount;
+			auto length = context->sendLength + HTTP_CHUNKED_HEADER_LENGTH;
 
-					BOOL activatedCompletionPort = FALSE;
+			context->sendLength = 0;
 
-					while ((receiveCompletionsCount = winsock.RIODequeueCompletion(rioCompletionQueue, rioResults, 1024)) > 0)
-					{
-						for (int resultIndex = 0; resultIndex < receiveCompletionsCount; resultIndex++)
-						{
-							// get Registered IO result
-							auto rioResult = rioResults[resultIndex];
+			context->streamSendsCount = 0;
 
-							// get connection id
-							auto connectionId = (ULONG) rioResult.RequestContext;
+			context->streamSliceIndex = 0;
 
-							// get connection
-							auto connection = managedConnections[connectionId];
+			return SendStreamSlice(0, length, 1);
+		}
 
-							if (connection->State == Receiving)
-							{
-								// end receive
-								connection->EndReceive(rioResult.BytesTransferred);
-							}
-							else if (connection->State == Sending)
-							{
-								// set connection state to sent
-								//connection->state = SXN::Net::ConnectionState::Sent;
-								connection->EndSend(rioResult.BytesTransferred);
-							}
-						}
+		inline void Connection::CheckStreamSlice()
+		{
+			// all slices are in progress, or the stream is ended: the previous task is not awaited
+			if (connection->context->streamSendsCount >= (LONG) worker->GetMaxStreamSends())
+			{
+				throw gcnew InvalidOperationException("The previous write of the stream is not awaited.");
+			}
+		}
 
-						if (!activatedCompletionPort)
-						{
-							// register the method to use for notification behavior with an I/O completion queue for use with the Winsock registered I/O extensions
-							winsock.RIONotify(rioCompletionQueue);
+		inline ReceiveTask^ Connection::WriteChunkAsync(array<Byte>^ data)
+		{
+			if (data == nullptr)
+			{
+				throw gcnew ArgumentNullException("data");
+			}
 
-							activatedCompletionPort = TRUE;
-						}
-					}
-				}
+			if ((UInt32) data->Length > StreamChunkCapacity)
+			{
+				throw gcnew ArgumentOutOfRangeException("data");
 			}
-		};
+
+			CheckStreamSlice();
+
+			// the empty chunk would end the body
+			if (data->Length == 0)
+			{
+				sendTask->Complete(0);
+
+				return sendTask;
+			}
+
+			auto sliceOffset = connection->context->streamSliceIndex * worker->GetStreamSliceLength();
+
+			auto slice = worker->GetData(connection->rioSendBuffer) + sliceOffset;
+
+			Marshal::Copy(data, 0, IntPtr(slice + HTTP_CHUNK_HEADER_MAX_LENGTH), data->Length);
+
+			ULONG chunkOffset;
+
+			auto chunkLength = HttpChunked::Frame(slice, data->Length, chunkOffset);
+
+			return SendStreamSlice(sliceOffset + chunkOffset, chunkLength, 1);
+		}
+
+		inline ReceiveTask^ Connection::EndStreamAsync()
+		{
+			CheckStreamSlice();
+
+			auto sliceOffset = connection->context->streamSliceIndex * worker->GetStreamSliceLength();
+
+			memcpy(worker->GetData(connection->rioSendBuffer) + sliceOffset, HTTP_LAST_CHUNK, HTTP_LAST_CHUNK_LENGTH);
+
+			return SendStreamSlice(sliceOffset, HTTP_LAST_CHUNK_LENGTH, TCP_CONNECTION_STREAM_ENDING + 1);
+		}
+
+		inline ReceiveTask^ Connection::SendPayloadAsync(UInt32 payloadIndex)
+		{
+			auto payload = worker->AcquirePayload(payloadIndex);
+
+			timestamps->sendPosted = LatencyHistogram::GetTimestamp();
+
+			auto fromState = connection->state;
+
+			auto res = connection->StartSendPayload(payload);
+
+			trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+			return sendTask;
+		}
+
+		inline Task<Connection^>^ Connection::ConnectAsync(UInt32 upstreamIndex)
+		{
+			return worker->AcquireUpstream(upstreamIndex);
+		}
+
+		inline void Connection::Release(Boolean keepAlive)
+		{
+			worker->ReleaseUpstream(connection, keepAlive);
+		}
 	}
 }
\ No newline at end of file
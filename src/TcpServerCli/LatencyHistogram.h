@@ -0,0 +1,229 @@
+#pragma once
+
+#include "Stdafx.h"
+
+/// <summary>
+/// The number of bits of the value kept by the bucket of the <see cref="LatencyHistogram" />, determines relative precision of about 3%.
+/// </summary>
+#define LATENCY_SUB_BUCKET_BITS 5
+
+/// <summary>
+/// The count of the sub buckets within the single power of two.
+/// </summary>
+#define LATENCY_SUB_BUCKETS_COUNT (1 << LATENCY_SUB_BUCKET_BITS)
+
+/// <summary>
+/// The number of bits of the largest value tracked by the <see cref="LatencyHistogram" />.
+/// </summary>
+#define LATENCY_VALUE_BITS 40
+
+/// <summary>
+/// The count of the buckets of the <see cref="LatencyHistogram" />.
+/// </summary>
+#define LATENCY_BUCKETS_COUNT ((LATENCY_VALUE_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS_COUNT)
+
+/// <summary>
+/// The stage from the completion of the accept to the completion of the first receive.
+/// </summary>
+#define LATENCY_STAGE_ACCEPT 0
+
+/// <summary>
+/// The stage from the completion of the receive to the start of the handler.
+/// </summary>
+#define LATENCY_STAGE_DISPATCH 1
+
+/// <summary>
+/// The stage from the start of the handler to the post of the send.
+/// </summary>
+#define LATENCY_STAGE_HANDLER 2
+
+/// <summary>
+/// The stage from the post of the send to the completion of the send.
+/// </summary>
+#define LATENCY_STAGE_SEND 3
+
+/// <summary>
+/// The count of the stages tracked by the latency histograms.
+/// </summary>
+#define LATENCY_STAGES_COUNT 4
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Contains the timestamps of the stages of the request processed by the connection.
+		/// </summary>
+		/// <remarks>
+		/// Zero means that the stage has not been reached.
+		/// </remarks>
+		private struct ConnectionTimestamps final
+		{
+			public:
+
+			/// <summary>
+			/// The time when the accept has completed.
+			/// </summary>
+			volatile LONG64 accepted;
+
+			/// <summary>
+			/// The time when the receive has completed.
+			/// </summary>
+			volatile LONG64 received;
+
+			/// <summary>
+			/// The time when the handler has obtained the result of the receive.
+			/// </summary>
+			volatile LONG64 handlerStarted;
+
+			/// <summary>
+			/// The time when the send was posted.
+			/// </summary>
+			volatile LONG64 sendPosted;
+		};
+
+		/// <summary>
+		/// Provides the histogram of the latencies with the logarithmic buckets of the constant relative precision.
+		/// </summary>
+		/// <remarks>
+		/// Values below <c>2 * LATENCY_SUB_BUCKETS_COUNT</c> are kept exactly, larger values are kept with <c>LATENCY_SUB_BUCKET_BITS</c> significant bits.
+		/// The histogram is written by the single thread without synchronization, histograms of several workers are merged on read.
+		/// </remarks>
+		private struct LatencyHistogram final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The collection of the counts of the values within each bucket.
+			/// </summary>
+			volatile ULONG64 buckets[LATENCY_BUCKETS_COUNT];
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the index of the bucket that holds the value.
+			/// </summary>
+			inline static ULONG GetBucketIndex(ULONG64 value)
+			{
+				// small values are kept exactly
+				if (value < 2 * LATENCY_SUB_BUCKETS_COUNT)
+				{
+					return (ULONG) value;
+				}
+
+				// get index of the most significant bit, 32 bit targets have no 64 bit scan
+				unsigned long topBit;
+
+				if ((value >> 32) != 0)
+				{
+					_BitScanReverse(&topBit, (unsigned long) (value >> 32));
+
+					topBit += 32;
+				}
+				else
+				{
+					_BitScanReverse(&topBit, (unsigned long) value);
+				}
+
+				// check if value is out of range
+				if (topBit >= LATENCY_VALUE_BITS)
+				{
+					return LATENCY_BUCKETS_COUNT - 1;
+				}
+
+				// keep significant bits only
+				auto shift = topBit - LATENCY_SUB_BUCKET_BITS;
+
+				return (ULONG) (shift * LATENCY_SUB_BUCKETS_COUNT + (value >> shift));
+			}
+
+			/// <summary>
+			/// Gets the lowest value that is held by the bucket.
+			/// </summary>
+			inline static ULONG64 GetBucketValue(ULONG bucketIndex)
+			{
+				if (bucketIndex < 2 * LATENCY_SUB_BUCKETS_COUNT)
+				{
+					return bucketIndex;
+				}
+
+				auto shift = bucketIndex / LATENCY_SUB_BUCKETS_COUNT - 1;
+
+				auto subBucket = (ULONG64) (bucketIndex % LATENCY_SUB_BUCKETS_COUNT + LATENCY_SUB_BUCKETS_COUNT);
+
+				return subBucket << shift;
+			}
+
+			/// <summary>
+			/// Gets the current time in the units of the high resolution performance counter.
+			/// </summary>
+			inline static LONG64 GetTimestamp()
+			{
+				LARGE_INTEGER value;
+
+				::QueryPerformanceCounter(&value);
+
+				return value.QuadPart;
+			}
+
+			/// <summary>
+			/// Records the value.
+			/// </summary>
+			/// <remarks>
+			/// Must be called by the single thread.
+			/// </remarks>
+			inline void Record(LONG64 value)
+			{
+				// clock is monotonic, negative values mean the stage was reached by the other thread after the time has been taken
+				if (value < 0)
+				{
+					value = 0;
+				}
+
+				buckets[GetBucketIndex((ULONG64) value)]++;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies the stage of the processing of the request which latency is tracked.
+		/// </summary>
+		public enum class LatencyStage
+		{
+			/// <summary>
+			/// From the completion of the accept to the completion of the first receive.
+			/// </summary>
+			Accept = LATENCY_STAGE_ACCEPT,
+
+			/// <summary>
+			/// From the completion of the receive to the start of the handler.
+			/// </summary>
+			Dispatch = LATENCY_STAGE_DISPATCH,
+
+			/// <summary>
+			/// From the start of the handler to the post of the send.
+			/// </summary>
+			Handler = LATENCY_STAGE_HANDLER,
+
+			/// <summary>
+			/// From the post of the send to the completion of the send.
+			/// </summary>
+			Send = LATENCY_STAGE_SEND
+		};
+	}
+}
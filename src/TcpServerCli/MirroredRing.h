@@ -0,0 +1,329 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Winsock.h"
+
+#ifndef MEM_RESERVE_PLACEHOLDER
+#define MEM_RESERVE_PLACEHOLDER 0x00040000
+#endif
+
+#ifndef MEM_REPLACE_PLACEHOLDER
+#define MEM_REPLACE_PLACEHOLDER 0x00004000
+#endif
+
+#ifndef MEM_PRESERVE_PLACEHOLDER
+#define MEM_PRESERVE_PLACEHOLDER 0x00000002
+#endif
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The maximum count of the attempts to map the views back to back, when the address space taken meanwhile by the other thread is the cause of the failure.
+		/// </summary>
+		#define MIRRORED_RING_MAP_ATTEMPTS 16
+
+		/// <summary>
+		/// Keeps the receive buffer of the connection as the ring, whose pages are mapped twice back to back.
+		/// </summary>
+		/// <remarks>
+		/// The byte at the offset <c>i + length</c> is the byte at the offset <c>i</c>, so the window of the ring which wraps around its end is contiguous:
+		/// the data not consumed stays in place and the window moves over it, the parser never sees the split data and nothing is moved.
+		/// Both views are registered as the single buffer, so the receive is posted right after the data not consumed.
+		/// The length is the multiple of the allocation granularity, 64 KB.
+		/// </remarks>
+		private class MirroredRing final
+		{
+			private:
+
+			#pragma region Nested Types
+
+			typedef PVOID (WINAPI *VirtualAlloc2Function)(HANDLE process, PVOID baseAddress, SIZE_T size, ULONG allocationType, ULONG pageProtection, PVOID extendedParameters, ULONG parametersCount);
+
+			typedef PVOID (WINAPI *MapViewOfFile3Function)(HANDLE fileMapping, HANDLE process, PVOID baseAddress, ULONG64 offset, SIZE_T viewSize, ULONG allocationType, ULONG pageProtection, PVOID extendedParameters, ULONG parametersCount);
+
+			#pragma endregion
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A reference to the object that provides work with the Winsock extensions.
+			/// </summary>
+			Winsock& winsock;
+
+			/// <summary>
+			/// The section which holds the pages of the ring.
+			/// </summary>
+			HANDLE section;
+
+			/// <summary>
+			/// A pointer to the first view, the second one follows it.
+			/// </summary>
+			PCHAR memoryBlock;
+
+			/// <summary>
+			/// The length of the ring.
+			/// </summary>
+			ULONG length;
+
+			/// <summary>
+			/// The identifier of both views within the Winsock registered I/O extensions.
+			/// </summary>
+			RIO_BUFFERID rioBufferId;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="MirroredRing" /> class.
+			/// </summary>
+			inline MirroredRing(Winsock& winsock, HANDLE section, PCHAR memoryBlock, ULONG length, RIO_BUFFERID rioBufferId)
+				: winsock(winsock)
+			{
+				this->section = section;
+
+				this->memoryBlock = memoryBlock;
+
+				this->length = length;
+
+				this->rioBufferId = rioBufferId;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Maps the section twice back to back into the placeholder, which can not be taken by the other thread meanwhile.
+			/// </summary>
+			/// <returns>A pointer to the first view, or <c>null</c> if the system does not support the placeholders or the operation has failed.</returns>
+			inline static PCHAR MapIntoPlaceholder(HANDLE section, ULONG length)
+			{
+				static auto kernelBase = ::GetModuleHandleW(L"kernelbase.dll");
+
+				static auto virtualAlloc2 = kernelBase == nullptr ? nullptr : (VirtualAlloc2Function) ::GetProcAddress(kernelBase, "VirtualAlloc2");
+
+				static auto mapViewOfFile3 = kernelBase == nullptr ? nullptr : (MapViewOfFile3Function) ::GetProcAddress(kernelBase, "MapViewOfFile3");
+
+				if ((virtualAlloc2 == nullptr) || (mapViewOfFile3 == nullptr))
+				{
+					return nullptr;
+				}
+
+				auto placeholder = (PCHAR) virtualAlloc2(nullptr, nullptr, (SIZE_T) length * 2, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0);
+
+				if (placeholder == nullptr)
+				{
+					return nullptr;
+				}
+
+				// split the placeholder in two, one per view
+				::VirtualFree(placeholder, length, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+
+				auto firstView = mapViewOfFile3(section, nullptr, placeholder, 0, length, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, nullptr, 0);
+
+				auto secondView = mapViewOfFile3(section, nullptr, placeholder + length, 0, length, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, nullptr, 0);
+
+				if ((firstView != nullptr) && (secondView != nullptr))
+				{
+					return placeholder;
+				}
+
+				// release the views, or the placeholders they have not replaced
+				if (firstView == nullptr)
+				{
+					::VirtualFree(placeholder, 0, MEM_RELEASE);
+				}
+				else
+				{
+					::UnmapViewOfFile(firstView);
+				}
+
+				if (secondView == nullptr)
+				{
+					::VirtualFree(placeholder + length, 0, MEM_RELEASE);
+				}
+				else
+				{
+					::UnmapViewOfFile(secondView);
+				}
+
+				return nullptr;
+			}
+
+			/// <summary>
+			/// Maps the section twice back to back at the free address, which may be taken by the other thread between the attempts.
+			/// </summary>
+			/// <returns>A pointer to the first view, or <c>null</c> if all attempts have failed.</returns>
+			inline static PCHAR MapIntoFreeAddress(HANDLE section, ULONG length)
+			{
+				for (auto attempt = 0; attempt < MIRRORED_RING_MAP_ATTEMPTS; attempt++)
+				{
+					// find the free address of both views
+					auto address = (PCHAR) ::VirtualAlloc(nullptr, (SIZE_T) length * 2, MEM_RESERVE, PAGE_NOACCESS);
+
+					if (address == nullptr)
+					{
+						return nullptr;
+					}
+
+					::VirtualFree(address, 0, MEM_RELEASE);
+
+					auto firstView = ::MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, length, address);
+
+					if (firstView == nullptr)
+					{
+						continue;
+					}
+
+					auto secondView = ::MapViewOfFileEx(section, FILE_MAP_ALL_ACCESS, 0, 0, length, address + length);
+
+					if (secondView != nullptr)
+					{
+						return address;
+					}
+
+					::UnmapViewOfFile(firstView);
+				}
+
+				return nullptr;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Creates the ring within the registered memory.
+			/// </summary>
+			/// <param name="winsock">A reference to the object that provides work with the Winsock extensions.</param>
+			/// <param name="minLength">The minimum length of the ring, is rounded up to the allocation granularity.</param>
+			/// <returns>A pointer to the ring, or <c>null</c> if the memory can not be mapped or registered.</returns>
+			inline static MirroredRing* Create(Winsock& winsock, ULONG minLength, DWORD& kernelErrorCode, int& winsockErrorCode)
+			{
+				SYSTEM_INFO systemInfo;
+
+				::GetSystemInfo(&systemInfo);
+
+				auto granularity = systemInfo.dwAllocationGranularity;
+
+				auto length = (minLength + granularity - 1) / granularity * granularity;
+
+				auto section = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, length, nullptr);
+
+				// check if operation has failed
+				if (section == nullptr)
+				{
+					kernelErrorCode = ::GetLastError();
+
+					winsockErrorCode = 0;
+
+					return nullptr;
+				}
+
+				// the placeholders exist since Windows 10 version 1803
+				auto memoryBlock = MapIntoPlaceholder(section, length);
+
+				if (memoryBlock == nullptr)
+				{
+					memoryBlock = MapIntoFreeAddress(section, length);
+				}
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					kernelErrorCode = ::GetLastError();
+
+					winsockErrorCode = 0;
+
+					::CloseHandle(section);
+
+					return nullptr;
+				}
+
+				auto rioBufferId = winsock.RIORegisterBuffer(memoryBlock, length * 2);
+
+				// check if operation has failed
+				if (rioBufferId == RIO_INVALID_BUFFERID)
+				{
+					winsockErrorCode = ::WSAGetLastError();
+
+					kernelErrorCode = 0;
+
+					::UnmapViewOfFile(memoryBlock + length);
+
+					::UnmapViewOfFile(memoryBlock);
+
+					::CloseHandle(section);
+
+					return nullptr;
+				}
+
+				return new MirroredRing(winsock, section, memoryBlock, length, rioBufferId);
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~MirroredRing()
+			{
+				// ignore result
+				winsock.RIODeregisterBuffer(rioBufferId);
+
+				::UnmapViewOfFile(memoryBlock + length);
+
+				::UnmapViewOfFile(memoryBlock);
+
+				::CloseHandle(section);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the descriptor of the window of the ring which starts at its beginning.
+			/// </summary>
+			inline RIO_BUF GetBuffer() const
+			{
+				RIO_BUF rioBuffer;
+
+				rioBuffer.BufferId = rioBufferId;
+
+				rioBuffer.Offset = 0;
+
+				rioBuffer.Length = length;
+
+				return rioBuffer;
+			}
+
+			/// <summary>
+			/// Gets a pointer to the data of the window.
+			/// </summary>
+			inline PCHAR GetData(const RIO_BUF& window) const
+			{
+				return memoryBlock + window.Offset;
+			}
+
+			/// <summary>
+			/// Moves the window over the consumed data, the rest of the data stays in place at the start of the window.
+			/// </summary>
+			/// <param name="window">The descriptor of the window, which keeps the length of the ring.</param>
+			/// <param name="consumedLength">The length of the consumed data.</param>
+			inline void Advance(RIO_BUF& window, ULONG consumedLength) const
+			{
+				window.Offset = (window.Offset + consumedLength) % length;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
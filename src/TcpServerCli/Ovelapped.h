@@ -10,6 +10,12 @@
 
 #define SOCK_ACTION_DISCONNECT 16
 
+#define SOCK_ACTION_CONNECT 32
+
+#define SOCK_ACTION_BROADCAST 64
+
+#define SOCK_ACTION_GROW 128
+
 #pragma unmanaged
 
 
@@ -36,6 +42,18 @@ namespace SXN
 			Sent,
 
 			Disconnecting,
+
+			Refusing,
+
+			Connecting,
+
+			Connected,
+
+			Idle,
+
+			Forwarding,
+
+			Streaming,
 		};
 
 		class TcpConnection;
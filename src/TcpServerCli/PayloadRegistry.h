@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "SharedPayload.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Keeps the shared payloads by index, shared by all workers.
+		/// </summary>
+		/// <remarks>
+		/// The payloads are taken by the workers on each send and replaced by the application at any time,
+		/// so the reference is added under the shared lock, which the replace takes exclusively.
+		/// </remarks>
+		private class PayloadRegistry final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The lock which guards the collection.
+			/// </summary>
+			SRWLOCK lock;
+
+			/// <summary>
+			/// The collection of the payloads.
+			/// </summary>
+			SharedPayload** payloads;
+
+			/// <summary>
+			/// The maximum count of the payloads.
+			/// </summary>
+			ULONG capacity;
+
+			/// <summary>
+			/// The count of the payloads.
+			/// </summary>
+			ULONG payloadsCount;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor and Destructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="PayloadRegistry" /> class.
+			/// </summary>
+			/// <param name="capacity">The maximum count of the payloads.</param>
+			inline PayloadRegistry(ULONG capacity)
+			{
+				::InitializeSRWLock(&lock);
+
+				this->capacity = capacity;
+
+				this->payloadsCount = 0;
+
+				this->payloads = new SharedPayload*[capacity];
+			}
+
+			/// <summary>
+			/// Releases the references held by the registry.
+			/// </summary>
+			inline ~PayloadRegistry()
+			{
+				for (ULONG payloadIndex = 0; payloadIndex < payloadsCount; payloadIndex++)
+				{
+					payloads[payloadIndex]->Release();
+				}
+
+				delete[] payloads;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Adds the payload, the registry takes over its reference.
+			/// </summary>
+			/// <returns>The index of the payload, or <c>ULONG_MAX</c> if the registry is full.</returns>
+			inline ULONG Add(SharedPayload* payload)
+			{
+				::AcquireSRWLockExclusive(&lock);
+
+				auto payloadIndex = ULONG_MAX;
+
+				if (payloadsCount < capacity)
+				{
+					payloadIndex = payloadsCount;
+
+					payloads[payloadIndex] = payload;
+
+					payloadsCount++;
+				}
+
+				::ReleaseSRWLockExclusive(&lock);
+
+				return payloadIndex;
+			}
+
+			/// <summary>
+			/// Replaces the payload, the registry takes over the reference of the new one and releases the reference of the old one.
+			/// </summary>
+			/// <returns><c>TRUE</c> if the payload is replaced; otherwise, <c>FALSE</c> if there is no payload with the index.</returns>
+			/// <remarks>
+			/// The old payload stays valid until the sends that refer to it are completed.
+			/// </remarks>
+			inline BOOL Replace(ULONG payloadIndex, SharedPayload* payload)
+			{
+				SharedPayload* oldPayload = nullptr;
+
+				::AcquireSRWLockExclusive(&lock);
+
+				if (payloadIndex < payloadsCount)
+				{
+					oldPayload = payloads[payloadIndex];
+
+					payloads[payloadIndex] = payload;
+				}
+
+				::ReleaseSRWLockExclusive(&lock);
+
+				if (oldPayload == nullptr)
+				{
+					return FALSE;
+				}
+
+				oldPayload->Release();
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Takes the reference to the payload, which should be released when the send that refers to it is completed.
+			/// </summary>
+			/// <returns>A pointer to the payload, or <c>null</c> if there is no payload with the index.</returns>
+			inline SharedPayload* Acquire(ULONG payloadIndex)
+			{
+				SharedPayload* payload = nullptr;
+
+				::AcquireSRWLockShared(&lock);
+
+				if (payloadIndex < payloadsCount)
+				{
+					payload = payloads[payloadIndex];
+
+					payload->AddReference();
+				}
+
+				::ReleaseSRWLockShared(&lock);
+
+				return payload;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
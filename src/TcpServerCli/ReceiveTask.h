@@ -2,6 +2,7 @@
 
 #include "Stdafx.h"
 #include "TcpConnection.h"
+#include "LatencyHistogram.h"
 
 using namespace System;
 using namespace System::Runtime::CompilerServices;
@@ -17,11 +18,13 @@ namespace SXN
 		{
 			private:
 
-			static initonly Action^ EmptyContinuation = gcnew Action(&ReceiveTask::DoNothing);
+			/// <summary>
+			/// Marks the task completed before the continuation is stored, the continuation stored after it is run at once.
+			/// </summary>
+			static initonly Action^ CallbackRan = gcnew Action(&ReceiveTask::DoNothing);
 
 			static void DoNothing()
 			{
-				Console::WriteLine("ReceiveTask::DoNothing WTF??");
 			}
 
 			static initonly WaitCallback^ continueWaitCallback = gcnew WaitCallback(&ReceiveTask::UnsafeCallback);
@@ -29,8 +32,11 @@ namespace SXN
 			/// <summary>
 			/// Indicates whether task is completed.
 			/// </summary>
-			Boolean isCompleted;
+			volatile Boolean isCompleted;
 
+			/// <summary>
+			/// The continuation of the awaiter, the <see cref="CallbackRan" /> if the task is completed first, or <c>null</c>.
+			/// </summary>
 			Action^ continuation;
 
 			/// <summary>
@@ -42,6 +48,11 @@ namespace SXN
 
 			Connection^ connection;
 
+			/// <summary>
+			/// A pointer to the timestamp to set when the result is obtained, or <c>null</c>.
+			/// </summary>
+			volatile LONG64* resultTimestamp;
+
 			internal:
 
 			#pragma region Constructors
@@ -49,10 +60,14 @@ namespace SXN
 			/// <summary>
 			/// Initialize a new instance of the <see cref="ReceiveTask" /> class.
 			/// </summary>
-			ReceiveTask(Connection^ connection)
+			/// <param name="connection">The connection that owns the task.</param>
+			/// <param name="resultTimestamp">A pointer to the timestamp to set when the result is obtained, or <c>null</c>.</param>
+			ReceiveTask(Connection^ connection, volatile LONG64* resultTimestamp)
 			{
 				this->connection = connection;
 
+				this->resultTimestamp = resultTimestamp;
+
 				isCompleted = false;
 
 				continuation = nullptr;
@@ -99,8 +114,7 @@ namespace SXN
 					throw gcnew ArgumentNullException("continuation");
 				}
 
-				// TODO: must fix this
-				// throw gcnew NotImplementedException();
+				UnsafeOnCompleted(continuation);
 			}
 
 			/// <summary>
@@ -110,10 +124,11 @@ namespace SXN
 			[System::Security::SecurityCritical]
 			virtual void UnsafeOnCompleted(Action^ newContinuation)
 			{
-				// replace reference
-				//Interlocked::Exchange(continuation, newContinuation);
-
-				ThreadPool::UnsafeQueueUserWorkItem(continueWaitCallback, newContinuation);
+				// the continuation is run by the completion, unless the completion has come first
+				if (Interlocked::CompareExchange(continuation, newContinuation, (Action^) nullptr) == CallbackRan)
+				{
+					ThreadPool::UnsafeQueueUserWorkItem(continueWaitCallback, newContinuation);
+				}
 			}
 
 			/// <summary>
@@ -125,6 +140,12 @@ namespace SXN
 
 				auto result = this->bytesTransferred;
 
+				// mark the start of the handler
+				if (resultTimestamp != nullptr)
+				{
+					*resultTimestamp = LatencyHistogram::GetTimestamp();
+				}
+
 				//Buffer.BlockCopy(_segment.Buffer, _segment.Offset, _buffer.Array, _buffer.Offset, (int)bytesTransferred)
 				Reset();
 
@@ -147,16 +168,26 @@ namespace SXN
 				continuation = nullptr;
 			}
 
+			/// <summary>
+			/// Completes the task, runs the continuation if the awaiter has stored it.
+			/// </summary>
+			/// <param name="bytesTransferred">The result of the task.</param>
+			/// <remarks>
+			/// The task is completed once per await: the result is published by the full barrier of the exchange,
+			/// and the awaiter which stores the continuation after it finds the <see cref="CallbackRan" /> and runs the continuation itself.
+			/// </remarks>
 			void Complete(UInt32 bytesTransferred)
 			{
+				this->bytesTransferred = bytesTransferred;
+
 				// set completed
 				isCompleted = true;
 
-				this->bytesTransferred = bytesTransferred;
+				auto storedContinuation = Interlocked::CompareExchange(continuation, CallbackRan, (Action^) nullptr);
 
-				if (continuation != nullptr)
+				if (storedContinuation != nullptr)
 				{
-					//ThreadPool::UnsafeQueueUserWorkItem(continueWaitCallback, continuation);
+					ThreadPool::UnsafeQueueUserWorkItem(continueWaitCallback, storedContinuation);
 				}
 			}
 
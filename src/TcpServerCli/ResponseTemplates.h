@@ -0,0 +1,349 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "RioBufferPool.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// The length of the value of the Date header, such as <c>Sun, 06 Nov 1994 08:49:37 GMT</c>.
+		/// </summary>
+		#define RESPONSE_DATE_LENGTH 29
+
+		/// <summary>
+		/// Keeps the pre-rendered responses within the registered memory shared by all workers.
+		/// </summary>
+		/// <remarks>
+		/// Each template is kept in two generations, the Date header of the inactive one is rewritten once per second by the single timer,
+		/// after which the generations are swapped, so the workers read the current generation without locks.
+		/// The send that stays queued for more than a second may carry the date of the next second.
+		/// </remarks>
+		private class ResponseTemplates final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The registered buffers of the templates, the first generation is followed by the second one.
+			/// </summary>
+			RioBufferPool* buffers;
+
+			/// <summary>
+			/// The count of the templates.
+			/// </summary>
+			ULONG templatesCount;
+
+			/// <summary>
+			/// The offsets of the values of the Date header within the templates.
+			/// </summary>
+			ULONG* dateOffsets;
+
+			/// <summary>
+			/// The index of the generation read by the workers.
+			/// </summary>
+			volatile LONG generation;
+
+			/// <summary>
+			/// The timer that refreshes the Date header, or <c>null</c> if it is not started.
+			/// </summary>
+			PTP_TIMER timer;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="ResponseTemplates" /> class.
+			/// </summary>
+			inline ResponseTemplates(RioBufferPool* buffers, ULONG templatesCount, ULONG* dateOffsets)
+			{
+				this->buffers = buffers;
+
+				this->templatesCount = templatesCount;
+
+				this->dateOffsets = dateOffsets;
+
+				this->generation = 0;
+
+				this->timer = nullptr;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Formats the specified time as the value of the Date header.
+			/// </summary>
+			/// <param name="time">The time in UTC.</param>
+			/// <param name="date">The buffer of <see cref="RESPONSE_DATE_LENGTH" /> characters, is not terminated.</param>
+			inline static void FormatDate(const SYSTEMTIME& time, char* date)
+			{
+				static const char* dayNames = "SunMonTueWedThuFriSat";
+
+				static const char* monthNames = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+				memcpy(date, dayNames + time.wDayOfWeek * 3, 3);
+
+				date[3] = ',';
+
+				date[4] = ' ';
+
+				date[5] = (char) ('0' + time.wDay / 10);
+
+				date[6] = (char) ('0' + time.wDay % 10);
+
+				date[7] = ' ';
+
+				memcpy(date + 8, monthNames + (time.wMonth - 1) * 3, 3);
+
+				date[11] = ' ';
+
+				date[12] = (char) ('0' + time.wYear / 1000);
+
+				date[13] = (char) ('0' + time.wYear / 100 % 10);
+
+				date[14] = (char) ('0' + time.wYear / 10 % 10);
+
+				date[15] = (char) ('0' + time.wYear % 10);
+
+				date[16] = ' ';
+
+				date[17] = (char) ('0' + time.wHour / 10);
+
+				date[18] = (char) ('0' + time.wHour % 10);
+
+				date[19] = ':';
+
+				date[20] = (char) ('0' + time.wMinute / 10);
+
+				date[21] = (char) ('0' + time.wMinute % 10);
+
+				date[22] = ':';
+
+				date[23] = (char) ('0' + time.wSecond / 10);
+
+				date[24] = (char) ('0' + time.wSecond % 10);
+
+				memcpy(date + 25, " GMT", 4);
+			}
+
+			/// <summary>
+			/// Writes the date into the templates of the specified generation.
+			/// </summary>
+			inline void WriteDate(ULONG generationIndex, const char* date)
+			{
+				for (ULONG templateIndex = 0; templateIndex < templatesCount; templateIndex++)
+				{
+					memcpy(buffers->GetBufferData(generationIndex * templatesCount + templateIndex) + dateOffsets[templateIndex], date, RESPONSE_DATE_LENGTH);
+				}
+			}
+
+			/// <summary>
+			/// Schedules the next refresh to the start of the next second.
+			/// </summary>
+			inline void ScheduleRefresh(const SYSTEMTIME& time)
+			{
+				// relative due time in 100-nanosecond intervals, the next refresh happens right after the second changes
+				LARGE_INTEGER dueTime;
+
+				dueTime.QuadPart = -(LONGLONG) (1000 - time.wMilliseconds) * 10000;
+
+				FILETIME fileDueTime;
+
+				fileDueTime.dwLowDateTime = dueTime.LowPart;
+
+				fileDueTime.dwHighDateTime = (DWORD) dueTime.HighPart;
+
+				::SetThreadpoolTimer(timer, &fileDueTime, 0, 50);
+			}
+
+			/// <summary>
+			/// Rewrites the Date header of the inactive generation and makes it current.
+			/// </summary>
+			static VOID CALLBACK OnTimer(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
+			{
+				auto responseTemplates = (ResponseTemplates*) context;
+
+				responseTemplates->Refresh();
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Creates the templates within the registered memory.
+			/// </summary>
+			/// <param name="winsock">A reference to the object that provides work with the Winsock extensions.</param>
+			/// <param name="templatesCount">The count of the templates.</param>
+			/// <param name="maxTemplateLength">The length of the longest template.</param>
+			/// <returns>A pointer to the templates, or <c>null</c> if the memory can not be registered.</returns>
+			inline static ResponseTemplates* Create(Winsock& winsock, ULONG templatesCount, ULONG maxTemplateLength, DWORD& kernelErrorCode, int& winsockErrorCode)
+			{
+				// align templates to the cache lines
+				auto bufferLength = (maxTemplateLength + 63) & ~63UL;
+
+				auto buffers = RioBufferPool::Create(winsock, bufferLength, templatesCount * 2, kernelErrorCode, winsockErrorCode);
+
+				if (buffers == nullptr)
+				{
+					return nullptr;
+				}
+
+				auto dateOffsets = new ULONG[templatesCount];
+
+				memset(dateOffsets, 0, sizeof(ULONG) * templatesCount);
+
+				return new ResponseTemplates(buffers, templatesCount, dateOffsets);
+			}
+
+			/// <summary>
+			/// Stops the timer and releases all associated resources.
+			/// </summary>
+			inline ~ResponseTemplates()
+			{
+				if (timer != nullptr)
+				{
+					// cancel pending refresh and wait for the running one
+					::SetThreadpoolTimer(timer, nullptr, 0, 0);
+
+					::WaitForThreadpoolTimerCallbacks(timer, TRUE);
+
+					::CloseThreadpoolTimer(timer);
+				}
+
+				delete[] dateOffsets;
+
+				delete buffers;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Copies the template into both generations.
+			/// </summary>
+			/// <param name="templateIndex">The index of the template.</param>
+			/// <param name="data">The response, which contains the place of <see cref="RESPONSE_DATE_LENGTH" /> characters for the value of the Date header.</param>
+			/// <param name="length">The length of the response, should not exceed the length given on create.</param>
+			/// <param name="dateOffset">The offset of the value of the Date header.</param>
+			inline void SetTemplate(ULONG templateIndex, const char* data, ULONG length, ULONG dateOffset)
+			{
+				dateOffsets[templateIndex] = dateOffset;
+
+				for (ULONG generationIndex = 0; generationIndex < 2; generationIndex++)
+				{
+					auto bufferIndex = generationIndex * templatesCount + templateIndex;
+
+					memcpy(buffers->GetBufferData(bufferIndex), data, length);
+
+					buffers->GetBuffer(bufferIndex)->Length = length;
+				}
+			}
+
+			/// <summary>
+			/// Writes the current date into both generations and starts the timer that refreshes it.
+			/// </summary>
+			/// <returns><c>TRUE</c> if the timer is started; otherwise, <c>FALSE</c>.</returns>
+			inline BOOL Start(DWORD& kernelErrorCode)
+			{
+				SYSTEMTIME time;
+
+				::GetSystemTime(&time);
+
+				char date[RESPONSE_DATE_LENGTH];
+
+				FormatDate(time, date);
+
+				WriteDate(0, date);
+
+				WriteDate(1, date);
+
+				timer = ::CreateThreadpoolTimer(&ResponseTemplates::OnTimer, this, nullptr);
+
+				if (timer == nullptr)
+				{
+					kernelErrorCode = ::GetLastError();
+
+					return FALSE;
+				}
+
+				ScheduleRefresh(time);
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Rewrites the Date header of the inactive generation and makes it current.
+			/// </summary>
+			/// <remarks>
+			/// Is called by the timer only.
+			/// </remarks>
+			inline void Refresh()
+			{
+				SYSTEMTIME time;
+
+				::GetSystemTime(&time);
+
+				char date[RESPONSE_DATE_LENGTH];
+
+				FormatDate(time, date);
+
+				auto nextGeneration = (ULONG) (generation ^ 1);
+
+				WriteDate(nextGeneration, date);
+
+				// the full barrier publishes the date before the generation
+				::InterlockedExchange(&generation, (LONG) nextGeneration);
+
+				ScheduleRefresh(time);
+			}
+
+			/// <summary>
+			/// Gets the count of the templates.
+			/// </summary>
+			inline ULONG GetCount()
+			{
+				return templatesCount;
+			}
+
+			/// <summary>
+			/// Gets the descriptor of the current generation of the template.
+			/// </summary>
+			/// <param name="templateIndex">The index of the template.</param>
+			/// <returns>The descriptor to send.</returns>
+			inline PRIO_BUF GetTemplate(ULONG templateIndex)
+			{
+				return buffers->GetBuffer(generation * templatesCount + templateIndex);
+			}
+
+			/// <summary>
+			/// Gets the data of the current generation of the template.
+			/// </summary>
+			/// <param name="templateIndex">The index of the template.</param>
+			/// <param name="length">The length of the template.</param>
+			/// <returns>A pointer to the data to copy.</returns>
+			inline const char* GetTemplateData(ULONG templateIndex, ULONG& length)
+			{
+				auto bufferIndex = generation * templatesCount + templateIndex;
+
+				length = buffers->GetBuffer(bufferIndex)->Length;
+
+				return buffers->GetBufferData(bufferIndex);
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
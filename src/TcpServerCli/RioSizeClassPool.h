@@ -0,0 +1,543 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Winsock.h"
+
+#pragma unmanaged
+
+/// <summary>
+/// The maximum number of the size classes within the <see cref="RioSizeClassPool" />.
+/// </summary>
+#define RIO_SIZE_CLASS_MAX_COUNT 8
+
+/// <summary>
+/// The value that marks the end of the list of the free segments.
+/// </summary>
+#define RIO_SEGMENT_NIL 0xFFFFFFFF
+
+/// <summary>
+/// The number of bits of the segment handle that hold the index of the segment within the size class.
+/// </summary>
+#define RIO_SEGMENT_INDEX_BITS 24
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Describes a segment of the registered buffer rented from the <see cref="RioSizeClassPool" />.
+		/// </summary>
+		private struct RioSegment final
+		{
+			public:
+
+			/// <summary>
+			/// The descriptor of the segment within the Winsock registered I/O extensions.
+			/// </summary>
+			RIO_BUF rioBuffer;
+
+			/// <summary>
+			/// A pointer to the memory of the segment.
+			/// </summary>
+			PCHAR data;
+
+			/// <summary>
+			/// The handle of the segment, that should be used to return the segment into the pool.
+			/// </summary>
+			ULONG handle;
+		};
+
+		/// <summary>
+		/// Provides management of the memory segments of several fixed lengths within the Winsock registered I/O extensions.
+		/// </summary>
+		/// <remarks>
+		/// The pool is owned by the single thread, which rents and returns segments without synchronization.
+		/// Other threads may return segments through the lock-free list of the remote frees, which is moved to the local list by the owner when the latter is empty.
+		/// All size classes are carved from one memory block registered once within the Winsock registered I/O extensions.
+		/// </remarks>
+		private class RioSizeClassPool final
+		{
+			private:
+
+			/// <summary>
+			/// Contains state of the single size class.
+			/// </summary>
+			struct __declspec(align(64)) SizeClass
+			{
+				/// <summary>
+				/// The length of the single segment.
+				/// </summary>
+				ULONG segmentLength;
+
+				/// <summary>
+				/// The count of the segments.
+				/// </summary>
+				ULONG segmentsCount;
+
+				/// <summary>
+				/// The offset of the first segment within the memory block.
+				/// </summary>
+				ULONG offset;
+
+				/// <summary>
+				/// The index of the first segment within the list of the free segments of the owner.
+				/// </summary>
+				ULONG localHead;
+
+				/// <summary>
+				/// The count of the segments within the list of the free segments of the owner.
+				/// </summary>
+				ULONG localCount;
+
+				/// <summary>
+				/// The collection of the links between the free segments.
+				/// </summary>
+				ULONG* next;
+
+				/// <summary>
+				/// The index of the first segment within the list of the segments returned by other threads.
+				/// </summary>
+				/// <remarks>
+				/// Is placed on a separate cache line to avoid false sharing with the fields of the owner.
+				/// </remarks>
+				__declspec(align(64)) volatile LONG remoteHead;
+
+				/// <summary>
+				/// The approximate count of the segments within the list of the segments returned by other threads.
+				/// </summary>
+				volatile LONG remoteCount;
+			};
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A reference to the object that provides work with the Winsock extensions.
+			/// </summary>
+			Winsock& winsock;
+
+			/// <summary>
+			/// The count of the size classes.
+			/// </summary>
+			ULONG sizeClassesCount;
+
+			/// <summary>
+			/// The collection of the size classes ordered by the length of the segment.
+			/// </summary>
+			SizeClass* sizeClasses;
+
+			/// <summary>
+			/// A pointer to the memory block of the segments.
+			/// </summary>
+			LPVOID memoryBlock;
+
+			/// <summary>
+			/// A pointer to the memory block of the size classes and links between the segments.
+			/// </summary>
+			LPVOID metadataBlock;
+
+			/// <summary>
+			/// The identifier of the <see cref="memoryBlock" /> within the Winsock registered I/O extensions.
+			/// </summary>
+			RIO_BUFFERID rioBufferId;
+
+			/// <summary>
+			/// The identifier of the thread that owns the pool.
+			/// </summary>
+			DWORD ownerThreadId;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="RioSizeClassPool" /> class.
+			/// </summary>
+			inline RioSizeClassPool(Winsock& winsock, ULONG sizeClassesCount, SizeClass* sizeClasses, LPVOID memoryBlock, LPVOID metadataBlock, RIO_BUFFERID rioBufferId)
+				: winsock(winsock)
+			{
+				this->sizeClassesCount = sizeClassesCount;
+
+				this->sizeClasses = sizeClasses;
+
+				this->memoryBlock = memoryBlock;
+
+				this->metadataBlock = metadataBlock;
+
+				this->rioBufferId = rioBufferId;
+
+				this->ownerThreadId = ::GetCurrentThreadId();
+			}
+
+			#pragma endregion
+
+			#pragma region Private Methods
+
+			/// <summary>
+			/// Rounds the value up to the allocation page.
+			/// </summary>
+			inline static SIZE_T RoundToPage(SIZE_T value)
+			{
+				return (value + 4095) & ~((SIZE_T) 4095);
+			}
+
+			/// <summary>
+			/// Moves the segments returned by other threads into the list of the owner.
+			/// </summary>
+			/// <returns><c>TRUE</c> if at least one segment was moved; otherwise, <c>FALSE</c>.</returns>
+			inline BOOL DrainRemote(SizeClass* sizeClass)
+			{
+				// take the whole list at once, this is not subject to the ABA problem
+				auto head = (ULONG) ::InterlockedExchange(&sizeClass->remoteHead, (LONG) RIO_SEGMENT_NIL);
+
+				if (head == RIO_SEGMENT_NIL)
+				{
+					return FALSE;
+				}
+
+				// count items, the cost is amortized over the subsequent allocations
+				ULONG count = 0;
+
+				for (auto index = head; index != RIO_SEGMENT_NIL; index = sizeClass->next[index])
+				{
+					count++;
+				}
+
+				::InterlockedExchangeAdd(&sizeClass->remoteCount, -(LONG) count);
+
+				// the local list is empty at this point
+				sizeClass->localHead = head;
+
+				sizeClass->localCount = count;
+
+				return TRUE;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="RioSizeClassPool" /> class.
+			/// </summary>
+			/// <param name="winsock">A reference to the object that provides work with the Winsock extensions.</param>
+			/// <param name="segmentLengths">The collection of the lengths of the segment of each size class, in ascending order.</param>
+			/// <param name="segmentsCounts">The collection of the counts of the segments of each size class, may be zero.</param>
+			/// <param name="sizeClassesCount">The count of the size classes.</param>
+			inline static RioSizeClassPool* Create(Winsock& winsock, const ULONG* segmentLengths, const ULONG* segmentsCounts, ULONG sizeClassesCount, DWORD& kernelErrorCode, int& winsockErrorCode)
+			{
+				winsockErrorCode = 0;
+
+				// validate size classes
+				if ((sizeClassesCount == 0) || (sizeClassesCount > RIO_SIZE_CLASS_MAX_COUNT))
+				{
+					kernelErrorCode = ERROR_INVALID_PARAMETER;
+
+					return nullptr;
+				}
+
+				for (ULONG classIndex = 0; classIndex < sizeClassesCount; classIndex++)
+				{
+					if ((segmentLengths[classIndex] == 0) || (segmentsCounts[classIndex] >= (1 << RIO_SEGMENT_INDEX_BITS)) || ((classIndex > 0) && (segmentLengths[classIndex] <= segmentLengths[classIndex - 1])))
+					{
+						kernelErrorCode = ERROR_INVALID_PARAMETER;
+
+						return nullptr;
+					}
+				}
+
+				// calculate the length of the memory blocks, each size class starts at the page boundary
+				SIZE_T memoryBlockLength = 0;
+
+				SIZE_T metadataBlockLength = sizeof(SizeClass) * sizeClassesCount;
+
+				for (ULONG classIndex = 0; classIndex < sizeClassesCount; classIndex++)
+				{
+					memoryBlockLength += RoundToPage((SIZE_T) segmentLengths[classIndex] * segmentsCounts[classIndex]);
+
+					metadataBlockLength += sizeof(ULONG) * segmentsCounts[classIndex];
+				}
+
+				// the registered buffer length is limited to DWORD
+				if (memoryBlockLength > MAXDWORD)
+				{
+					kernelErrorCode = ERROR_INVALID_PARAMETER;
+
+					return nullptr;
+				}
+
+				// reserve and commit memory block of the segments
+				auto memoryBlock = ::VirtualAlloc(nullptr, memoryBlockLength, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					return nullptr;
+				}
+
+				// reserve and commit memory block of the metadata
+				auto metadataBlock = ::VirtualAlloc(nullptr, metadataBlockLength, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+				// check if operation has failed
+				if (metadataBlock == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					// free allocated memory and ignore result
+					::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+
+					return nullptr;
+				}
+
+				// register and set the identifier of the buffer
+				auto rioBufferId = winsock.RIORegisterBuffer((PCHAR) memoryBlock, (DWORD) memoryBlockLength);
+
+				// check if operation has failed
+				if (rioBufferId == RIO_INVALID_BUFFERID)
+				{
+					// get winsock error code
+					winsockErrorCode = ::WSAGetLastError();
+
+					kernelErrorCode = 0;
+
+					// free allocated memory and ignore result
+					::VirtualFree(metadataBlock, 0, MEM_RELEASE);
+
+					::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+
+					return nullptr;
+				}
+
+				// initialize size classes, the metadata block is page aligned
+				auto sizeClasses = (SizeClass*) metadataBlock;
+
+				auto nextLinks = (ULONG*) (sizeClasses + sizeClassesCount);
+
+				ULONG offset = 0;
+
+				for (ULONG classIndex = 0; classIndex < sizeClassesCount; classIndex++)
+				{
+					auto sizeClass = sizeClasses + classIndex;
+
+					auto segmentsCount = segmentsCounts[classIndex];
+
+					sizeClass->segmentLength = segmentLengths[classIndex];
+
+					sizeClass->segmentsCount = segmentsCount;
+
+					sizeClass->offset = offset;
+
+					sizeClass->next = nextLinks;
+
+					// link all segments into the list of the owner
+					for (ULONG segmentIndex = 0; segmentIndex < segmentsCount; segmentIndex++)
+					{
+						nextLinks[segmentIndex] = segmentIndex + 1 < segmentsCount ? segmentIndex + 1 : RIO_SEGMENT_NIL;
+					}
+
+					// the empty size class is skipped by the allocation
+					sizeClass->localHead = segmentsCount != 0 ? 0 : RIO_SEGMENT_NIL;
+
+					sizeClass->localCount = segmentsCount;
+
+					sizeClass->remoteHead = (LONG) RIO_SEGMENT_NIL;
+
+					sizeClass->remoteCount = 0;
+
+					nextLinks += segmentsCount;
+
+					offset += (ULONG) RoundToPage((SIZE_T) sizeClass->segmentLength * segmentsCount);
+				}
+
+				kernelErrorCode = 0;
+
+				// initialize and return result
+				return new RioSizeClassPool(winsock, sizeClassesCount, sizeClasses, memoryBlock, metadataBlock, rioBufferId);
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~RioSizeClassPool()
+			{
+				// deregister buffer within the Registered I/O extensions
+				// ignore result
+				winsock.RIODeregisterBuffer(rioBufferId);
+
+				// free allocated memory
+				// ignore result
+				::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+
+				::VirtualFree(metadataBlock, 0, MEM_RELEASE);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Sets the calling thread as the owner of the pool.
+			/// </summary>
+			/// <remarks>
+			/// Should be called by the thread which rents the segments before it rents any.
+			/// </remarks>
+			inline void SetOwnerThread()
+			{
+				ownerThreadId = ::GetCurrentThreadId();
+			}
+
+			/// <summary>
+			/// Gets the index of the smallest size class which segments can hold the specified amount of bytes.
+			/// </summary>
+			/// <returns>The index of the size class if exists; otherwise, the count of the size classes.</returns>
+			inline ULONG GetSizeClass(ULONG length)
+			{
+				ULONG classIndex = 0;
+
+				while ((classIndex < sizeClassesCount) && (sizeClasses[classIndex].segmentLength < length))
+				{
+					classIndex++;
+				}
+
+				return classIndex;
+			}
+
+			/// <summary>
+			/// Gets the approximate count of the free segments within the size class.
+			/// </summary>
+			inline ULONG GetAvailableCount(ULONG classIndex)
+			{
+				auto sizeClass = sizeClasses + classIndex;
+
+				auto remoteCount = sizeClass->remoteCount;
+
+				return sizeClass->localCount + (remoteCount > 0 ? remoteCount : 0);
+			}
+
+			/// <summary>
+			/// Rents a segment which can hold the specified amount of bytes.
+			/// </summary>
+			/// <param name="length">The required length of the segment.</param>
+			/// <param name="segment">The descriptor of the rented segment.</param>
+			/// <returns><c>TRUE</c> if operation has succeed; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// Must be called by the owner thread.
+			/// If the suitable size class is exhausted, the segment is taken from the larger one.
+			/// </remarks>
+			inline BOOL Allocate(ULONG length, RioSegment& segment)
+			{
+				for (auto classIndex = GetSizeClass(length); classIndex < sizeClassesCount; classIndex++)
+				{
+					auto sizeClass = sizeClasses + classIndex;
+
+					// check if local list is empty and there is nothing to take from the remote list
+					if ((sizeClass->localHead == RIO_SEGMENT_NIL) && !DrainRemote(sizeClass))
+					{
+						continue;
+					}
+
+					// pop segment from the local list
+					auto segmentIndex = sizeClass->localHead;
+
+					sizeClass->localHead = sizeClass->next[segmentIndex];
+
+					sizeClass->localCount--;
+
+					// compose result
+					auto offset = sizeClass->offset + sizeClass->segmentLength * segmentIndex;
+
+					segment.rioBuffer.BufferId = rioBufferId;
+
+					segment.rioBuffer.Offset = offset;
+
+					segment.rioBuffer.Length = sizeClass->segmentLength;
+
+					segment.data = ((PCHAR) memoryBlock) + offset;
+
+					segment.handle = (classIndex << RIO_SEGMENT_INDEX_BITS) | segmentIndex;
+
+					return TRUE;
+				}
+
+				return FALSE;
+			}
+
+			/// <summary>
+			/// Returns the segment into the pool.
+			/// </summary>
+			/// <param name="handle">The handle of the segment.</param>
+			/// <remarks>Must be called by the owner thread.</remarks>
+			inline void Free(ULONG handle)
+			{
+				auto sizeClass = sizeClasses + (handle >> RIO_SEGMENT_INDEX_BITS);
+
+				auto segmentIndex = handle & ((1 << RIO_SEGMENT_INDEX_BITS) - 1);
+
+				// push segment into the local list
+				sizeClass->next[segmentIndex] = sizeClass->localHead;
+
+				sizeClass->localHead = segmentIndex;
+
+				sizeClass->localCount++;
+			}
+
+			/// <summary>
+			/// Returns the segment into the pool from the thread other than the owner.
+			/// </summary>
+			/// <param name="handle">The handle of the segment.</param>
+			inline void FreeRemote(ULONG handle)
+			{
+				auto sizeClass = sizeClasses + (handle >> RIO_SEGMENT_INDEX_BITS);
+
+				auto segmentIndex = handle & ((1 << RIO_SEGMENT_INDEX_BITS) - 1);
+
+				// push segment into the remote list, only pushes are concurrent so there is no ABA problem
+				LONG head;
+
+				do
+				{
+					head = sizeClass->remoteHead;
+
+					sizeClass->next[segmentIndex] = (ULONG) head;
+				}
+				while (::InterlockedCompareExchange(&sizeClass->remoteHead, (LONG) segmentIndex, head) != head);
+
+				::InterlockedIncrement(&sizeClass->remoteCount);
+			}
+
+			/// <summary>
+			/// Returns the segment into the pool from any thread.
+			/// </summary>
+			/// <param name="handle">The handle of the segment.</param>
+			inline void Release(ULONG handle)
+			{
+				if (::GetCurrentThreadId() == ownerThreadId)
+				{
+					Free(handle);
+				}
+				else
+				{
+					FreeRemote(handle);
+				}
+			}
+
+			/// <summary>
+			/// Gets a pointer to the memory of the segment.
+			/// </summary>
+			/// <param name="rioBuffer">The descriptor of the segment.</param>
+			inline PCHAR GetData(const RIO_BUF& rioBuffer)
+			{
+				return ((PCHAR) memoryBlock) + rioBuffer.Offset;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Winsock.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Keeps the read-only data registered once and sent by any connection of any worker.
+		/// </summary>
+		/// <remarks>
+		/// The payload is released when the last reference is released: the one of the registry and one per send in progress,
+		/// so the payload replaced within the registry stays valid until the sends that refer to it are completed.
+		/// </remarks>
+		private class SharedPayload final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A reference to the object that provides work with the Winsock extensions.
+			/// </summary>
+			Winsock& winsock;
+
+			/// <summary>
+			/// A pointer to the memory block that contains the data.
+			/// </summary>
+			LPVOID memoryBlock;
+
+			/// <summary>
+			/// The identifier of the <see cref="memoryBlock" /> within the Winsock registered I/O extensions.
+			/// </summary>
+			RIO_BUFFERID rioBufferId;
+
+			/// <summary>
+			/// The descriptor of the data.
+			/// </summary>
+			RIO_BUF rioBuffer;
+
+			/// <summary>
+			/// The count of the references.
+			/// </summary>
+			volatile LONG referencesCount;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="SharedPayload" /> class, which holds the single reference.
+			/// </summary>
+			inline SharedPayload(Winsock& winsock, LPVOID memoryBlock, RIO_BUFFERID rioBufferId, ULONG length)
+				: winsock(winsock)
+			{
+				this->memoryBlock = memoryBlock;
+
+				this->rioBufferId = rioBufferId;
+
+				rioBuffer.BufferId = rioBufferId;
+
+				rioBuffer.Offset = 0;
+
+				rioBuffer.Length = length;
+
+				referencesCount = 1;
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~SharedPayload()
+			{
+				// ignore result
+				winsock.RIODeregisterBuffer(rioBufferId);
+
+				// ignore result
+				::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create
+
+			/// <summary>
+			/// Copies the data into the new registered memory block.
+			/// </summary>
+			/// <param name="winsock">A reference to the object that provides work with the Winsock extensions.</param>
+			/// <param name="data">A pointer to the data.</param>
+			/// <param name="length">The length of the data.</param>
+			/// <returns>A pointer to the payload which holds the single reference, or <c>null</c> if the memory can not be registered.</returns>
+			inline static SharedPayload* Create(Winsock& winsock, const void* data, ULONG length, DWORD& kernelErrorCode, int& winsockErrorCode)
+			{
+				auto memoryBlock = ::VirtualAlloc(nullptr, length, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					kernelErrorCode = ::GetLastError();
+
+					winsockErrorCode = 0;
+
+					return nullptr;
+				}
+
+				// the data is never written again
+				memcpy(memoryBlock, data, length);
+
+				auto rioBufferId = winsock.RIORegisterBuffer((PCHAR) memoryBlock, length);
+
+				// check if operation has failed
+				if (rioBufferId == RIO_INVALID_BUFFERID)
+				{
+					winsockErrorCode = ::WSAGetLastError();
+
+					kernelErrorCode = 0;
+
+					// ignore result
+					::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+
+					return nullptr;
+				}
+
+				return new SharedPayload(winsock, memoryBlock, rioBufferId, length);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Adds the reference.
+			/// </summary>
+			inline void AddReference()
+			{
+				::InterlockedIncrement(&referencesCount);
+			}
+
+			/// <summary>
+			/// Releases the reference, the payload is deleted when the last one is released.
+			/// </summary>
+			inline void Release()
+			{
+				if (::InterlockedDecrement(&referencesCount) == 0)
+				{
+					delete this;
+				}
+			}
+
+			/// <summary>
+			/// Gets the descriptor of the data.
+			/// </summary>
+			inline PRIO_BUF GetBuffer()
+			{
+				return &rioBuffer;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
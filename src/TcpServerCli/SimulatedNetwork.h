@@ -0,0 +1,1193 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Winsock.h"
+
+/// <summary>
+/// The maximum count of the buffers registered within the simulated network.
+/// </summary>
+#define SIMULATED_NETWORK_MAX_BUFFERS 64
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Contains the behavior of the simulated network.
+		/// </summary>
+		/// <remarks>
+		/// Probabilities are set in percents and are rolled independently for each operation.
+		/// </remarks>
+		private struct SimulationSettings final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The seed of the pseudo random generator, equal seeds produce equal runs.
+			/// </summary>
+			ULONG64 seed;
+
+			/// <summary>
+			/// The minimal delay, in simulated nanoseconds, between the start and the completion of the operation.
+			/// </summary>
+			ULONG minDelay;
+
+			/// <summary>
+			/// The maximal delay, in simulated nanoseconds, between the start and the completion of the operation.
+			/// </summary>
+			ULONG maxDelay;
+
+			/// <summary>
+			/// The probability of the receive or send to transfer only the part of the data.
+			/// </summary>
+			ULONG partialPercent;
+
+			/// <summary>
+			/// The probability of the receive or send to fail because the connection has been reset by the client.
+			/// </summary>
+			ULONG resetPercent;
+
+			/// <summary>
+			/// The probability of the receive to complete with no data because the client has closed the connection.
+			/// </summary>
+			ULONG closePercent;
+
+			/// <summary>
+			/// The probability of the operation to be delayed past the operations started after it.
+			/// </summary>
+			ULONG reorderPercent;
+
+			/// <summary>
+			/// A pointer to the request sent by each client.
+			/// </summary>
+			const char* request;
+
+			/// <summary>
+			/// The length of the request.
+			/// </summary>
+			ULONG requestLength;
+
+			/// <summary>
+			/// A pointer to the data sent by the upstream over each connection the server makes to it.
+			/// </summary>
+			const char* response;
+
+			/// <summary>
+			/// The length of the data sent by the upstream.
+			/// </summary>
+			ULONG responseLength;
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// The kind of the simulated operation.
+		/// </summary>
+		enum SimulatedOperation
+		{
+			/// <summary>
+			/// The Registered I/O receive or send.
+			/// </summary>
+			SimulatedTransfer,
+
+			/// <summary>
+			/// The overlapped accept.
+			/// </summary>
+			SimulatedAccept,
+
+			/// <summary>
+			/// The overlapped connect to the upstream.
+			/// </summary>
+			SimulatedConnect,
+
+			/// <summary>
+			/// The overlapped disconnect.
+			/// </summary>
+			SimulatedDisconnect,
+		};
+
+		/// <summary>
+		/// Describes the operation which completes at the specified simulated time.
+		/// </summary>
+		private struct SimulatedEvent final
+		{
+			public:
+
+			/// <summary>
+			/// The simulated time of the completion.
+			/// </summary>
+			ULONG64 time;
+
+			/// <summary>
+			/// The ordinal number of the event, orders the events that complete at the same time.
+			/// </summary>
+			ULONG64 sequence;
+
+			/// <summary>
+			/// The kind of the operation.
+			/// </summary>
+			SimulatedOperation operation;
+
+			/// <summary>
+			/// The index of the socket.
+			/// </summary>
+			ULONG socketIndex;
+
+			/// <summary>
+			/// The epoch of the socket at the start of the operation.
+			/// </summary>
+			ULONG epoch;
+
+			/// <summary>
+			/// The overlapped structure of the accept, the connect or the disconnect, or <c>null</c> for the Registered I/O operations.
+			/// </summary>
+			LPOVERLAPPED overlapped;
+
+			/// <summary>
+			/// The request context of the Registered I/O operation.
+			/// </summary>
+			PVOID requestContext;
+
+			/// <summary>
+			/// The count of the bytes transferred.
+			/// </summary>
+			ULONG bytesTransferred;
+
+			/// <summary>
+			/// The status of the completion.
+			/// </summary>
+			LONG status;
+		};
+
+		/// <summary>
+		/// Provides the completion queue of the simulated network.
+		/// </summary>
+		/// <remarks>
+		/// Alongside each result keeps the flag which indicates that the operation has been started for the previous connection of the socket.
+		/// </remarks>
+		private struct SimulatedCompletionQueue final
+		{
+			public:
+
+			/// <summary>
+			/// The capacity of the queue.
+			/// </summary>
+			ULONG capacity;
+
+			/// <summary>
+			/// The index of the next result to dequeue.
+			/// </summary>
+			ULONG head;
+
+			/// <summary>
+			/// The count of the results within the queue.
+			/// </summary>
+			ULONG count;
+
+			/// <summary>
+			/// The collection of the results.
+			/// </summary>
+			RIORESULT* results;
+
+			/// <summary>
+			/// The collection of the flags of the late results.
+			/// </summary>
+			BOOL* late;
+
+			/// <summary>
+			/// The flags of the late results returned by the last dequeue.
+			/// </summary>
+			BOOL* lastDequeueLate;
+		};
+
+		/// <summary>
+		/// Contains the state of the simulated socket.
+		/// </summary>
+		private struct SimulatedSocket final
+		{
+			public:
+
+			/// <summary>
+			/// The number of the connection held by the socket, is incremented on disconnect, so the operations started before are recognized as late.
+			/// </summary>
+			ULONG epoch;
+
+			/// <summary>
+			/// Indicates whether the socket is connected to the client.
+			/// </summary>
+			BOOL connected;
+
+			/// <summary>
+			/// Indicates whether the client has closed or reset the connection.
+			/// </summary>
+			BOOL closed;
+
+			/// <summary>
+			/// Indicates whether the socket is connected by the server to the upstream, which sends the response instead of the request.
+			/// </summary>
+			BOOL outbound;
+
+			/// <summary>
+			/// The count of the bytes of the current request, or the response of the upstream, which are not yet received.
+			/// </summary>
+			ULONG requestRemaining;
+
+			/// <summary>
+			/// The completion queue of the socket.
+			/// </summary>
+			SimulatedCompletionQueue* completionQueue;
+
+			/// <summary>
+			/// The socket context passed to the request queue.
+			/// </summary>
+			PVOID socketContext;
+		};
+
+		/// <summary>
+		/// Provides the deterministic in-process emulation of the accept, disconnect and Registered I/O operations.
+		/// </summary>
+		/// <remarks>
+		/// The network is driven by the single thread: operations are scheduled into the queue of events ordered by the simulated time,
+		/// and each call of <see cref="Advance" /> completes the earliest one, so the run depends only on the settings and the order of the calls.
+		/// The network is plugged into the connections through the <see cref="Winsock" /> created by <see cref="CreateWinsock" />,
+		/// which functions dispatch to the current instance, so only one instance may be active at a time.
+		/// Operations started before <see cref="Winsock::DisconnectEx" /> complete with <c>WSAECONNABORTED</c> and are reported as late by <see cref="IsLate" />.
+		/// The overlapped accepts, connects and disconnects complete into the queue read by <see cref="DequeueOverlapped" />, as they do into the completion port;
+		/// the sockets connected to the upstream send the response of the settings continuously, as the clients send the request.
+		/// </remarks>
+		private class SimulatedNetwork final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The behavior of the network.
+			/// </summary>
+			SimulationSettings settings;
+
+			/// <summary>
+			/// The state of the pseudo random generator.
+			/// </summary>
+			ULONG64 randomState;
+
+			/// <summary>
+			/// The current simulated time.
+			/// </summary>
+			ULONG64 time;
+
+			/// <summary>
+			/// The ordinal number of the next event.
+			/// </summary>
+			ULONG64 nextSequence;
+
+			/// <summary>
+			/// The maximal count of the sockets.
+			/// </summary>
+			ULONG socketsCapacity;
+
+			/// <summary>
+			/// The count of the created sockets.
+			/// </summary>
+			ULONG socketsCount;
+
+			/// <summary>
+			/// The collection of the sockets.
+			/// </summary>
+			SimulatedSocket* sockets;
+
+			/// <summary>
+			/// The capacity of the queue of the events.
+			/// </summary>
+			ULONG eventsCapacity;
+
+			/// <summary>
+			/// The count of the scheduled events.
+			/// </summary>
+			ULONG eventsCount;
+
+			/// <summary>
+			/// The queue of the events, organized as the binary heap.
+			/// </summary>
+			SimulatedEvent* events;
+
+			/// <summary>
+			/// The index of the next completed overlapped operation to dequeue.
+			/// </summary>
+			ULONG overlappedHead;
+
+			/// <summary>
+			/// The count of the completed overlapped operations.
+			/// </summary>
+			ULONG overlappedCount;
+
+			/// <summary>
+			/// The queue of the overlapped structures of the completed accepts, connects and disconnects, each socket has at most one of them in progress.
+			/// </summary>
+			LPOVERLAPPED* overlappedQueue;
+
+			/// <summary>
+			/// The collection of the registered buffers, the identifier of the buffer is its index plus one.
+			/// </summary>
+			PCHAR buffers[SIMULATED_NETWORK_MAX_BUFFERS];
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="SimulatedNetwork" /> class.
+			/// </summary>
+			inline SimulatedNetwork(const SimulationSettings& settings, ULONG socketsCapacity, SimulatedSocket* sockets, ULONG eventsCapacity, SimulatedEvent* events, LPOVERLAPPED* overlappedQueue)
+			{
+				this->settings = settings;
+
+				// zero state would lock the generator
+				this->randomState = settings.seed != 0 ? settings.seed : 0x9E3779B97F4A7C15ULL;
+
+				this->time = 0;
+
+				this->nextSequence = 0;
+
+				this->socketsCapacity = socketsCapacity;
+
+				this->socketsCount = 0;
+
+				this->sockets = sockets;
+
+				this->eventsCapacity = eventsCapacity;
+
+				this->eventsCount = 0;
+
+				this->events = events;
+
+				this->overlappedHead = 0;
+
+				this->overlappedCount = 0;
+
+				this->overlappedQueue = overlappedQueue;
+
+				memset(buffers, 0, sizeof(buffers));
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the reference to the pointer to the instance that serves the functions of the <see cref="Winsock" />.
+			/// </summary>
+			inline static SimulatedNetwork*& Current()
+			{
+				static SimulatedNetwork* current = nullptr;
+
+				return current;
+			}
+
+			/// <summary>
+			/// Gets the next pseudo random number, the xorshift64* generator.
+			/// </summary>
+			inline ULONG64 NextRandom()
+			{
+				randomState ^= randomState >> 12;
+
+				randomState ^= randomState << 25;
+
+				randomState ^= randomState >> 27;
+
+				return randomState * 0x2545F4914F6CDD1DULL;
+			}
+
+			/// <summary>
+			/// Rolls the event with the specified probability.
+			/// </summary>
+			inline BOOL Roll(ULONG percent)
+			{
+				return (percent != 0) && ((NextRandom() % 100) < percent);
+			}
+
+			/// <summary>
+			/// Gets the random delay of the operation.
+			/// </summary>
+			inline ULONG64 NextDelay()
+			{
+				ULONG64 delay = settings.minDelay + (settings.maxDelay > settings.minDelay ? NextRandom() % (settings.maxDelay - settings.minDelay + 1) : 0);
+
+				// the reordered operation is held long enough to complete after the operations started later
+				if (Roll(settings.reorderPercent))
+				{
+					delay += (ULONG64) settings.maxDelay * 4 + 1;
+				}
+
+				return delay;
+			}
+
+			/// <summary>
+			/// Gets the socket by the descriptor.
+			/// </summary>
+			/// <returns>A pointer to the socket if the descriptor is valid; otherwise, <c>null</c>.</returns>
+			inline SimulatedSocket* GetSocket(SOCKET socket)
+			{
+				return (socket == 0) || (socket > socketsCount) ? nullptr : sockets + (socket - 1);
+			}
+
+			/// <summary>
+			/// Compares the events by the time of the completion.
+			/// </summary>
+			inline static BOOL IsEarlier(const SimulatedEvent& left, const SimulatedEvent& right)
+			{
+				return (left.time < right.time) || ((left.time == right.time) && (left.sequence < right.sequence));
+			}
+
+			/// <summary>
+			/// Schedules the event at the random delay from the current time.
+			/// </summary>
+			/// <returns><c>TRUE</c> if operation has succeed; otherwise, <c>FALSE</c> and the Winsock error is set.</returns>
+			BOOL Schedule(SimulatedOperation operation, ULONG socketIndex, LPOVERLAPPED overlapped, PVOID requestContext, ULONG bytesTransferred, LONG status)
+			{
+				if (eventsCount == eventsCapacity)
+				{
+					::WSASetLastError(WSAENOBUFS);
+
+					return FALSE;
+				}
+
+				SimulatedEvent event;
+
+				event.time = time + NextDelay();
+
+				event.sequence = nextSequence++;
+
+				event.operation = operation;
+
+				event.socketIndex = socketIndex;
+
+				event.epoch = sockets[socketIndex].epoch;
+
+				event.overlapped = overlapped;
+
+				event.requestContext = requestContext;
+
+				event.bytesTransferred = bytesTransferred;
+
+				event.status = status;
+
+				// sift up
+				auto index = eventsCount++;
+
+				while (index > 0)
+				{
+					auto parentIndex = (index - 1) / 2;
+
+					if (!IsEarlier(event, events[parentIndex]))
+					{
+						break;
+					}
+
+					events[index] = events[parentIndex];
+
+					index = parentIndex;
+				}
+
+				events[index] = event;
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Removes the earliest event from the queue.
+			/// </summary>
+			SimulatedEvent PopEvent()
+			{
+				auto result = events[0];
+
+				auto last = events[--eventsCount];
+
+				// sift down
+				ULONG index = 0;
+
+				while (true)
+				{
+					auto childIndex = index * 2 + 1;
+
+					if (childIndex >= eventsCount)
+					{
+						break;
+					}
+
+					if ((childIndex + 1 < eventsCount) && IsEarlier(events[childIndex + 1], events[childIndex]))
+					{
+						childIndex++;
+					}
+
+					if (!IsEarlier(events[childIndex], last))
+					{
+						break;
+					}
+
+					events[index] = events[childIndex];
+
+					index = childIndex;
+				}
+
+				events[index] = last;
+
+				return result;
+			}
+
+			/// <summary>
+			/// Gets the length of the data described by the buffers.
+			/// </summary>
+			inline static ULONG GetLength(PRIO_BUF pData, ULONG dataBufferCount)
+			{
+				ULONG result = 0;
+
+				for (ULONG bufferIndex = 0; bufferIndex < dataBufferCount; bufferIndex++)
+				{
+					result += pData[bufferIndex].Length;
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Starts the receive, the data of the request is copied into the registered buffer immediately and reported on completion.
+			/// </summary>
+			BOOL Receive(RIO_RQ socketQueue, PRIO_BUF pData, ULONG dataBufferCount, PVOID requestContext)
+			{
+				auto socket = GetSocket((SOCKET) socketQueue);
+
+				if ((socket == nullptr) || (dataBufferCount != 1))
+				{
+					::WSASetLastError(WSAEINVAL);
+
+					return FALSE;
+				}
+
+				auto socketIndex = (ULONG) (socket - sockets);
+
+				if (!socket->connected)
+				{
+					return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, 0, WSAENOTCONN);
+				}
+
+				if (socket->closed)
+				{
+					return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, 0, 0);
+				}
+
+				if (Roll(settings.resetPercent))
+				{
+					socket->closed = TRUE;
+
+					return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, 0, WSAECONNRESET);
+				}
+
+				if (Roll(settings.closePercent))
+				{
+					socket->closed = TRUE;
+
+					return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, 0, 0);
+				}
+
+				// the upstream sends the response instead of the request
+				auto message = socket->outbound ? settings.response : settings.request;
+
+				auto messageLength = socket->outbound ? settings.responseLength : settings.requestLength;
+
+				// the client sends the next request once the previous one is received
+				if (socket->requestRemaining == 0)
+				{
+					socket->requestRemaining = messageLength;
+				}
+
+				auto length = socket->requestRemaining < pData->Length ? socket->requestRemaining : pData->Length;
+
+				if ((length > 1) && Roll(settings.partialPercent))
+				{
+					length = 1 + (ULONG) (NextRandom() % (length - 1));
+				}
+
+				// copy the data if the buffer is known
+				auto bufferIndex = (ULONG_PTR) pData->BufferId - 1;
+
+				if ((bufferIndex < SIMULATED_NETWORK_MAX_BUFFERS) && (buffers[bufferIndex] != nullptr) && (message != nullptr))
+				{
+					memcpy(buffers[bufferIndex] + pData->Offset, message + (messageLength - socket->requestRemaining), length);
+				}
+
+				socket->requestRemaining -= length;
+
+				return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, length, 0);
+			}
+
+			/// <summary>
+			/// Starts the send.
+			/// </summary>
+			BOOL Send(RIO_RQ socketQueue, PRIO_BUF pData, ULONG dataBufferCount, PVOID requestContext)
+			{
+				auto socket = GetSocket((SOCKET) socketQueue);
+
+				if ((socket == nullptr) || (dataBufferCount == 0))
+				{
+					::WSASetLastError(WSAEINVAL);
+
+					return FALSE;
+				}
+
+				auto socketIndex = (ULONG) (socket - sockets);
+
+				if (!socket->connected)
+				{
+					return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, 0, WSAENOTCONN);
+				}
+
+				if (socket->closed || Roll(settings.resetPercent))
+				{
+					socket->closed = TRUE;
+
+					return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, 0, WSAECONNRESET);
+				}
+
+				auto length = GetLength(pData, dataBufferCount);
+
+				if ((length > 1) && Roll(settings.partialPercent))
+				{
+					length = 1 + (ULONG) (NextRandom() % (length - 1));
+				}
+
+				return Schedule(SimulatedTransfer, socketIndex, nullptr, requestContext, length, 0);
+			}
+
+			/// <summary>
+			/// Puts the result of the completed event into the completion queue of the socket.
+			/// </summary>
+			void Complete(const SimulatedEvent& event)
+			{
+				auto socket = sockets + event.socketIndex;
+
+				// the operation has been started for the previous connection of the socket
+				auto late = event.epoch != socket->epoch;
+
+				if (event.operation != SimulatedTransfer)
+				{
+					if (event.operation != SimulatedDisconnect)
+					{
+						if (late)
+						{
+							// the accept or the connect has been canceled by the disconnect
+							return;
+						}
+
+						socket->connected = TRUE;
+
+						socket->closed = FALSE;
+
+						socket->outbound = event.operation == SimulatedConnect;
+
+						// the client sends the request, the upstream sends the response at once
+						socket->requestRemaining = socket->outbound ? settings.responseLength : settings.requestLength;
+					}
+
+					overlappedQueue[(overlappedHead + overlappedCount) % socketsCapacity] = event.overlapped;
+
+					overlappedCount++;
+
+					return;
+				}
+
+				auto completionQueue = socket->completionQueue;
+
+				if ((completionQueue == nullptr) || (completionQueue->count == completionQueue->capacity))
+				{
+					// the overflowed queue loses the result as the real one does
+					return;
+				}
+
+				auto position = (completionQueue->head + completionQueue->count) % completionQueue->capacity;
+
+				auto& result = completionQueue->results[position];
+
+				result.Status = late ? WSAECONNABORTED : event.status;
+
+				result.BytesTransferred = late ? 0 : event.bytesTransferred;
+
+				result.SocketContext = (ULONGLONG) socket->socketContext;
+
+				result.RequestContext = (ULONGLONG) event.requestContext;
+
+				completionQueue->late[position] = late;
+
+				completionQueue->count++;
+			}
+
+			#pragma region Winsock Functions
+
+			static BOOL PASCAL AcceptExThunk(SOCKET sListenSocket, SOCKET sAcceptSocket, PVOID lpOutputBuffer, DWORD dwReceiveDataLength, DWORD dwLocalAddressLength, DWORD dwRemoteAddressLength, LPDWORD lpdwBytesReceived, LPOVERLAPPED lpOverlapped)
+			{
+				auto network = Current();
+
+				auto socket = network->GetSocket(sAcceptSocket);
+
+				if ((socket == nullptr) || socket->connected || (lpOverlapped == nullptr))
+				{
+					::WSASetLastError(WSAEINVAL);
+
+					return FALSE;
+				}
+
+				if (!network->Schedule(SimulatedAccept, (ULONG) (socket - network->sockets), lpOverlapped, nullptr, 0, 0))
+				{
+					return FALSE;
+				}
+
+				::WSASetLastError(WSA_IO_PENDING);
+
+				return FALSE;
+			}
+
+			static BOOL PASCAL ConnectExThunk(SOCKET s, const sockaddr* name, int namelen, PVOID lpSendBuffer, DWORD dwSendDataLength, LPDWORD lpdwBytesSent, LPOVERLAPPED lpOverlapped)
+			{
+				auto network = Current();
+
+				auto socket = network->GetSocket(s);
+
+				if ((socket == nullptr) || (lpOverlapped == nullptr))
+				{
+					::WSASetLastError(WSAEINVAL);
+
+					return FALSE;
+				}
+
+				if (socket->connected)
+				{
+					::WSASetLastError(WSAEISCONN);
+
+					return FALSE;
+				}
+
+				// the upstream always accepts the connection
+				if (!network->Schedule(SimulatedConnect, (ULONG) (socket - network->sockets), lpOverlapped, nullptr, 0, 0))
+				{
+					return FALSE;
+				}
+
+				::WSASetLastError(WSA_IO_PENDING);
+
+				return FALSE;
+			}
+
+			static BOOL PASCAL DisconnectExThunk(SOCKET s, LPOVERLAPPED lpOverlapped, DWORD dwFlags, DWORD dwReserved)
+			{
+				auto network = Current();
+
+				auto socket = network->GetSocket(s);
+
+				if (socket == nullptr)
+				{
+					::WSASetLastError(WSAENOTSOCK);
+
+					return FALSE;
+				}
+
+				// the socket is disconnected at once, the operations in flight become late
+				socket->epoch++;
+
+				socket->connected = FALSE;
+
+				socket->closed = FALSE;
+
+				socket->outbound = FALSE;
+
+				socket->requestRemaining = 0;
+
+				// the overlapped disconnect reports its completion as the one posted to the completion port
+				if (lpOverlapped == nullptr)
+				{
+					return TRUE;
+				}
+
+				if (!network->Schedule(SimulatedDisconnect, (ULONG) (socket - network->sockets), lpOverlapped, nullptr, 0, 0))
+				{
+					return FALSE;
+				}
+
+				::WSASetLastError(WSA_IO_PENDING);
+
+				return FALSE;
+			}
+
+			static VOID PASCAL GetAcceptExSockaddrsThunk(PVOID lpOutputBuffer, DWORD dwReceiveDataLength, DWORD dwLocalAddressLength, DWORD dwRemoteAddressLength, sockaddr** LocalSockaddr, LPINT LocalSockaddrLength, sockaddr** RemoteSockaddr, LPINT RemoteSockaddrLength)
+			{
+				// there are no addresses within the simulated network
+				*LocalSockaddr = nullptr;
+
+				*LocalSockaddrLength = 0;
+
+				*RemoteSockaddr = nullptr;
+
+				*RemoteSockaddrLength = 0;
+			}
+
+			static BOOL PASCAL RIOReceiveThunk(RIO_RQ SocketQueue, PRIO_BUF pData, ULONG DataBufferCount, DWORD Flags, PVOID RequestContext)
+			{
+				return Current()->Receive(SocketQueue, pData, DataBufferCount, RequestContext);
+			}
+
+			static int PASCAL RIOReceiveExThunk(RIO_RQ SocketQueue, PRIO_BUF pData, ULONG DataBufferCount, PRIO_BUF pLocalAddress, PRIO_BUF pRemoteAddress, PRIO_BUF pControlContext, PRIO_BUF pFlags, DWORD Flags, PVOID RequestContext)
+			{
+				::WSASetLastError(WSAEOPNOTSUPP);
+
+				return FALSE;
+			}
+
+			static BOOL PASCAL RIOSendThunk(RIO_RQ SocketQueue, PRIO_BUF pData, ULONG DataBufferCount, DWORD Flags, PVOID RequestContext)
+			{
+				return Current()->Send(SocketQueue, pData, DataBufferCount, RequestContext);
+			}
+
+			static BOOL PASCAL RIOSendExThunk(RIO_RQ SocketQueue, PRIO_BUF pData, ULONG DataBufferCount, PRIO_BUF pLocalAddress, PRIO_BUF pRemoteAddress, PRIO_BUF pControlContext, PRIO_BUF pFlags, DWORD Flags, PVOID RequestContext)
+			{
+				::WSASetLastError(WSAEOPNOTSUPP);
+
+				return FALSE;
+			}
+
+			static VOID PASCAL RIOCloseCompletionQueueThunk(RIO_CQ CQ)
+			{
+				auto completionQueue = (SimulatedCompletionQueue*) CQ;
+
+				delete[] completionQueue->results;
+
+				delete[] completionQueue->late;
+
+				delete[] completionQueue->lastDequeueLate;
+
+				delete completionQueue;
+			}
+
+			static RIO_CQ PASCAL RIOCreateCompletionQueueThunk(DWORD QueueSize, PRIO_NOTIFICATION_COMPLETION NotificationCompletion)
+			{
+				// completions are delivered by the calls of Advance, so the notification is ignored
+				auto completionQueue = new SimulatedCompletionQueue();
+
+				completionQueue->capacity = QueueSize;
+
+				completionQueue->head = 0;
+
+				completionQueue->count = 0;
+
+				completionQueue->results = new RIORESULT[QueueSize];
+
+				completionQueue->late = new BOOL[QueueSize];
+
+				completionQueue->lastDequeueLate = new BOOL[QueueSize];
+
+				return (RIO_CQ) completionQueue;
+			}
+
+			static RIO_RQ PASCAL RIOCreateRequestQueueThunk(SOCKET Socket, ULONG MaxOutstandingReceive, ULONG MaxReceiveDataBuffers, ULONG MaxOutstandingSend, ULONG MaxSendDataBuffers, RIO_CQ ReceiveCQ, RIO_CQ SendCQ, PVOID SocketContext)
+			{
+				auto socket = Current()->GetSocket(Socket);
+
+				// the simulated socket has the single completion queue
+				if ((socket == nullptr) || (ReceiveCQ != SendCQ))
+				{
+					::WSASetLastError(WSAEINVAL);
+
+					return RIO_INVALID_RQ;
+				}
+
+				socket->completionQueue = (SimulatedCompletionQueue*) ReceiveCQ;
+
+				socket->socketContext = SocketContext;
+
+				// the descriptor of the request queue is the descriptor of the socket
+				return (RIO_RQ) Socket;
+			}
+
+			static ULONG PASCAL RIODequeueCompletionThunk(RIO_CQ CQ, PRIORESULT Array, ULONG ArraySize)
+			{
+				auto completionQueue = (SimulatedCompletionQueue*) CQ;
+
+				auto result = completionQueue->count < ArraySize ? completionQueue->count : ArraySize;
+
+				for (ULONG resultIndex = 0; resultIndex < result; resultIndex++)
+				{
+					Array[resultIndex] = completionQueue->results[completionQueue->head];
+
+					completionQueue->lastDequeueLate[resultIndex] = completionQueue->late[completionQueue->head];
+
+					completionQueue->head = (completionQueue->head + 1) % completionQueue->capacity;
+				}
+
+				completionQueue->count -= result;
+
+				return result;
+			}
+
+			static VOID PASCAL RIODeregisterBufferThunk(RIO_BUFFERID BufferId)
+			{
+				auto bufferIndex = (ULONG_PTR) BufferId - 1;
+
+				if (bufferIndex < SIMULATED_NETWORK_MAX_BUFFERS)
+				{
+					Current()->buffers[bufferIndex] = nullptr;
+				}
+			}
+
+			static INT PASCAL RIONotifyThunk(RIO_CQ CQ)
+			{
+				return ERROR_SUCCESS;
+			}
+
+			static RIO_BUFFERID PASCAL RIORegisterBufferThunk(PCHAR DataBuffer, DWORD DataLength)
+			{
+				auto network = Current();
+
+				for (ULONG bufferIndex = 0; bufferIndex < SIMULATED_NETWORK_MAX_BUFFERS; bufferIndex++)
+				{
+					if (network->buffers[bufferIndex] == nullptr)
+					{
+						network->buffers[bufferIndex] = DataBuffer;
+
+						return (RIO_BUFFERID) (ULONG_PTR) (bufferIndex + 1);
+					}
+				}
+
+				::WSASetLastError(WSAENOBUFS);
+
+				return RIO_INVALID_BUFFERID;
+			}
+
+			static BOOL PASCAL RIOResizeCompletionQueueThunk(RIO_CQ CQ, DWORD QueueSize)
+			{
+				::WSASetLastError(WSAEOPNOTSUPP);
+
+				return FALSE;
+			}
+
+			static BOOL PASCAL RIOResizeRequestQueueThunk(RIO_RQ RQ, DWORD MaxOutstandingReceive, DWORD MaxOutstandingSend)
+			{
+				return TRUE;
+			}
+
+			#pragma endregion
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="SimulatedNetwork" /> class and makes it current.
+			/// </summary>
+			/// <param name="settings">The behavior of the network.</param>
+			/// <param name="socketsCapacity">The maximal count of the sockets.</param>
+			/// <param name="eventsCapacity">The maximal count of the operations in flight.</param>
+			/// <returns>A pointer to the instance of the class if operation has succeed; otherwise, <c>null</c>.</returns>
+			static SimulatedNetwork* Create(const SimulationSettings& settings, ULONG socketsCapacity, ULONG eventsCapacity)
+			{
+				if ((socketsCapacity == 0) || (eventsCapacity == 0) || (settings.minDelay > settings.maxDelay) || (Current() != nullptr))
+				{
+					return nullptr;
+				}
+
+				auto sockets = new SimulatedSocket[socketsCapacity];
+
+				memset(sockets, 0, sizeof(SimulatedSocket) * socketsCapacity);
+
+				auto events = new SimulatedEvent[eventsCapacity];
+
+				auto overlappedQueue = new LPOVERLAPPED[socketsCapacity];
+
+				auto result = new SimulatedNetwork(settings, socketsCapacity, sockets, eventsCapacity, events, overlappedQueue);
+
+				Current() = result;
+
+				return result;
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			~SimulatedNetwork()
+			{
+				delete[] sockets;
+
+				delete[] events;
+
+				delete[] overlappedQueue;
+
+				Current() = nullptr;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Creates the object that provides work with the Winsock extensions over the simulated network.
+			/// </summary>
+			inline static Winsock* CreateWinsock()
+			{
+				RIO_EXTENSION_FUNCTION_TABLE rioFunctionsTable;
+
+				rioFunctionsTable.cbSize = sizeof(RIO_EXTENSION_FUNCTION_TABLE);
+
+				rioFunctionsTable.RIOReceive = &RIOReceiveThunk;
+
+				rioFunctionsTable.RIOReceiveEx = &RIOReceiveExThunk;
+
+				rioFunctionsTable.RIOSend = &RIOSendThunk;
+
+				rioFunctionsTable.RIOSendEx = &RIOSendExThunk;
+
+				rioFunctionsTable.RIOCloseCompletionQueue = &RIOCloseCompletionQueueThunk;
+
+				rioFunctionsTable.RIOCreateCompletionQueue = &RIOCreateCompletionQueueThunk;
+
+				rioFunctionsTable.RIOCreateRequestQueue = &RIOCreateRequestQueueThunk;
+
+				rioFunctionsTable.RIODequeueCompletion = &RIODequeueCompletionThunk;
+
+				rioFunctionsTable.RIODeregisterBuffer = &RIODeregisterBufferThunk;
+
+				rioFunctionsTable.RIONotify = &RIONotifyThunk;
+
+				rioFunctionsTable.RIORegisterBuffer = &RIORegisterBufferThunk;
+
+				rioFunctionsTable.RIOResizeCompletionQueue = &RIOResizeCompletionQueueThunk;
+
+				rioFunctionsTable.RIOResizeRequestQueue = &RIOResizeRequestQueueThunk;
+
+				return Winsock::Create(&AcceptExThunk, &ConnectExThunk, &DisconnectExThunk, &GetAcceptExSockaddrsThunk, rioFunctionsTable);
+			}
+
+			/// <summary>
+			/// Creates the simulated socket.
+			/// </summary>
+			/// <returns>The descriptor of the socket if operation has succeed; otherwise, <c>INVALID_SOCKET</c>.</returns>
+			inline SOCKET CreateSocket()
+			{
+				if (socketsCount == socketsCapacity)
+				{
+					::WSASetLastError(WSAEMFILE);
+
+					return INVALID_SOCKET;
+				}
+
+				// zero is not a valid descriptor
+				return ++socketsCount;
+			}
+
+			/// <summary>
+			/// Completes the earliest operation and moves the simulated time to its completion.
+			/// </summary>
+			/// <returns><c>TRUE</c> if the operation has been completed; otherwise, <c>FALSE</c> when there are no operations in flight.</returns>
+			inline BOOL Advance()
+			{
+				if (eventsCount == 0)
+				{
+					return FALSE;
+				}
+
+				auto event = PopEvent();
+
+				time = event.time;
+
+				Complete(event);
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Completes all the operations which complete at the time of the earliest one.
+			/// </summary>
+			/// <returns>The count of the completed operations.</returns>
+			inline ULONG AdvanceBatch()
+			{
+				if (eventsCount == 0)
+				{
+					return 0;
+				}
+
+				auto batchTime = events[0].time;
+
+				ULONG result = 0;
+
+				while ((eventsCount != 0) && (events[0].time == batchTime))
+				{
+					Advance();
+
+					result++;
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Removes the overlapped structure of the completed accept, connect or disconnect from the queue.
+			/// </summary>
+			/// <returns>A pointer to the overlapped structure if there is the completed operation; otherwise, <c>null</c>.</returns>
+			inline LPOVERLAPPED DequeueOverlapped()
+			{
+				if (overlappedCount == 0)
+				{
+					return nullptr;
+				}
+
+				auto result = overlappedQueue[overlappedHead];
+
+				overlappedHead = (overlappedHead + 1) % socketsCapacity;
+
+				overlappedCount--;
+
+				return result;
+			}
+
+			/// <summary>
+			/// Checks whether the result returned by the last dequeue from the completion queue has been started for the previous connection of the socket.
+			/// </summary>
+			/// <param name="rioCompletionQueue">The completion queue.</param>
+			/// <param name="resultIndex">The index of the result within the array filled by the last dequeue.</param>
+			inline static BOOL IsLate(RIO_CQ rioCompletionQueue, ULONG resultIndex)
+			{
+				return ((SimulatedCompletionQueue*) rioCompletionQueue)->lastDequeueLate[resultIndex];
+			}
+
+			/// <summary>
+			/// Gets the current simulated time, in nanoseconds.
+			/// </summary>
+			inline ULONG64 GetTime()
+			{
+				return time;
+			}
+
+			/// <summary>
+			/// Gets the count of the operations in flight.
+			/// </summary>
+			inline ULONG GetPendingCount()
+			{
+				return eventsCount;
+			}
+
+			/// <summary>
+			/// Gets the next pseudo random number of the run, so the driver of the simulation stays deterministic.
+			/// </summary>
+			inline ULONG64 GetRandom()
+			{
+				return NextRandom();
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
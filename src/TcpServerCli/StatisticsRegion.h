@@ -0,0 +1,460 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Ovelapped.h"
+#include "LatencyHistogram.h"
+
+#pragma unmanaged
+
+/// <summary>
+/// The signature of the statistics region, the ASCII string "SXNS".
+/// </summary>
+#define STATISTICS_SIGNATURE 0x534E5853
+
+/// <summary>
+/// The version of the layout of the statistics region.
+/// </summary>
+#define STATISTICS_VERSION 1
+
+/// <summary>
+/// The count of the buckets of the histogram of the completions dequeued at once.
+/// </summary>
+/// <remarks>
+/// Bucket <c>n</c> counts the batches of <c>[2^n, 2^(n+1))</c> completions, the last bucket counts the batches of 1024 completions.
+/// </remarks>
+#define STATISTICS_BATCH_BUCKETS_COUNT 11
+
+/// <summary>
+/// The count of the values of the <see cref="ConnectionState" /> tracked by the statistics.
+/// </summary>
+#define STATISTICS_STATES_COUNT 16
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Contains the header of the statistics region.
+		/// </summary>
+		/// <remarks>
+		/// The region consists of the header followed by the <see cref="WorkerCounters" /> of each worker.
+		/// </remarks>
+		private struct __declspec(align(64)) StatisticsHeader final
+		{
+			public:
+
+			/// <summary>
+			/// The signature of the region, equals <c>STATISTICS_SIGNATURE</c>.
+			/// </summary>
+			ULONG signature;
+
+			/// <summary>
+			/// The version of the layout of the region, equals <c>STATISTICS_VERSION</c>.
+			/// </summary>
+			ULONG version;
+
+			/// <summary>
+			/// The length of the <see cref="StatisticsHeader" /> structure.
+			/// </summary>
+			ULONG headerLength;
+
+			/// <summary>
+			/// The length of the <see cref="WorkerCounters" /> structure.
+			/// </summary>
+			ULONG workerCountersLength;
+
+			/// <summary>
+			/// The count of the workers.
+			/// </summary>
+			ULONG workersCount;
+
+			/// <summary>
+			/// The identifier of the process that writes the region.
+			/// </summary>
+			ULONG processId;
+
+			/// <summary>
+			/// The time, in the FILETIME format, when the region was created.
+			/// </summary>
+			ULONG64 startTime;
+
+			/// <summary>
+			/// The frequency, in counts per second, of the timestamps used by the latency histograms.
+			/// </summary>
+			ULONG64 timestampFrequency;
+		};
+
+		/// <summary>
+		/// Contains the counters of the single worker.
+		/// </summary>
+		/// <remarks>
+		/// Each group of the counters is written by the single thread and occupies separate cache lines.
+		/// Counters are monotonic, readers should calculate rates as differences between two snapshots.
+		/// </remarks>
+		private struct __declspec(align(64)) WorkerCounters final
+		{
+			public:
+
+			#pragma region Written by the worker thread
+
+			/// <summary>
+			/// The number of times the worker thread was woken up by the completion port.
+			/// </summary>
+			volatile ULONG64 wakeupsCount;
+
+			/// <summary>
+			/// The number of calls of the <see cref="Winsock::RIONotify" />.
+			/// </summary>
+			volatile ULONG64 notifyCount;
+
+			/// <summary>
+			/// The number of calls of the <see cref="Winsock::RIODequeueCompletion" />, including the calls that returned no completions.
+			/// </summary>
+			volatile ULONG64 dequeueCallsCount;
+
+			/// <summary>
+			/// The number of completions dequeued.
+			/// </summary>
+			volatile ULONG64 completionsCount;
+
+			/// <summary>
+			/// The number of completed receive operations.
+			/// </summary>
+			volatile ULONG64 receivesCount;
+
+			/// <summary>
+			/// The number of bytes received.
+			/// </summary>
+			volatile ULONG64 bytesReceived;
+
+			/// <summary>
+			/// The number of completed send operations.
+			/// </summary>
+			volatile ULONG64 sendsCount;
+
+			/// <summary>
+			/// The number of bytes sent.
+			/// </summary>
+			volatile ULONG64 bytesSent;
+
+			/// <summary>
+			/// The histogram of the number of completions dequeued by the single call.
+			/// </summary>
+			volatile ULONG64 batchSizes[STATISTICS_BATCH_BUCKETS_COUNT];
+
+			/// <summary>
+			/// The number of accepted connections refused because all connections to their upstream are in use.
+			/// </summary>
+			/// <remarks>
+			/// Is kept apart from the <see cref="refusalsCount" />, which is written by the accept thread.
+			/// </remarks>
+			volatile ULONG64 forwardRefusalsCount;
+
+			/// <summary>
+			/// The number of broadcast sends dropped because the slots of the broadcast sends have run out or the request queue of the connection is full.
+			/// </summary>
+			volatile ULONG64 broadcastDropsCount;
+
+			/// <summary>
+			/// The number of admitted connections refused because the buffer pool has no free segments for them.
+			/// </summary>
+			volatile ULONG64 bufferRefusalsCount;
+
+			#pragma endregion
+
+			#pragma region Written by the accept thread
+
+			/// <summary>
+			/// The number of accepted connections, including refused.
+			/// </summary>
+			__declspec(align(64)) volatile ULONG64 acceptsCount;
+
+			/// <summary>
+			/// The number of connections refused by the admission control.
+			/// </summary>
+			volatile ULONG64 refusalsCount;
+
+			#pragma endregion
+
+			#pragma region Sampled by the worker thread
+
+			/// <summary>
+			/// The time, in milliseconds since system start, when the occupancy of the slots was sampled.
+			/// </summary>
+			__declspec(align(64)) volatile ULONG64 occupancySampleTime;
+
+			/// <summary>
+			/// The count of the slots of the worker.
+			/// </summary>
+			volatile ULONG slotsCount;
+
+			/// <summary>
+			/// The count of the slots in each <see cref="ConnectionState" />.
+			/// </summary>
+			volatile ULONG slotsByState[STATISTICS_STATES_COUNT];
+
+			#pragma endregion
+
+			#pragma region Written by the worker thread
+
+			/// <summary>
+			/// The histograms of the latencies of each stage, indexed by the <c>LATENCY_STAGE_*</c> constants.
+			/// </summary>
+			/// <remarks>
+			/// Values are in the units of the <see cref="StatisticsHeader::timestampFrequency" />.
+			/// </remarks>
+			__declspec(align(64)) LatencyHistogram latencies[LATENCY_STAGES_COUNT];
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Records the result of the single call of the <see cref="Winsock::RIODequeueCompletion" />.
+			/// </summary>
+			/// <param name="count">The number of completions dequeued.</param>
+			inline void RecordDequeue(ULONG count)
+			{
+				dequeueCallsCount++;
+
+				if (count == 0)
+				{
+					return;
+				}
+
+				completionsCount += count;
+
+				// get index of the most significant bit
+				unsigned long bucketIndex;
+
+				_BitScanReverse(&bucketIndex, count);
+
+				if (bucketIndex >= STATISTICS_BATCH_BUCKETS_COUNT)
+				{
+					bucketIndex = STATISTICS_BATCH_BUCKETS_COUNT - 1;
+				}
+
+				batchSizes[bucketIndex]++;
+			}
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Provides the memory region which contains the statistics of the workers.
+		/// </summary>
+		/// <remarks>
+		/// If the path of the file is specified, the region is mapped onto the file and can be read by external processes while server is running.
+		/// Otherwise the region is allocated in the private memory of the process.
+		/// </remarks>
+		private class StatisticsRegion final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The handle of the file, or <c>INVALID_HANDLE_VALUE</c> if the region is not mapped onto the file.
+			/// </summary>
+			HANDLE fileHandle;
+
+			/// <summary>
+			/// The handle of the file mapping, or <c>null</c> if the region is not mapped onto the file.
+			/// </summary>
+			HANDLE mappingHandle;
+
+			/// <summary>
+			/// A pointer to the header of the region.
+			/// </summary>
+			StatisticsHeader* header;
+
+			/// <summary>
+			/// The collection of the counters of the workers.
+			/// </summary>
+			WorkerCounters* workerCounters;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="StatisticsRegion" /> class.
+			/// </summary>
+			inline StatisticsRegion(HANDLE fileHandle, HANDLE mappingHandle, LPVOID memoryBlock, ULONG workersCount)
+			{
+				this->fileHandle = fileHandle;
+
+				this->mappingHandle = mappingHandle;
+
+				this->header = (StatisticsHeader*) memoryBlock;
+
+				this->workerCounters = (WorkerCounters*) (header + 1);
+
+				// memory is zeroed by the kernel, so only header is filled
+				header->version = STATISTICS_VERSION;
+
+				header->headerLength = sizeof(StatisticsHeader);
+
+				header->workerCountersLength = sizeof(WorkerCounters);
+
+				header->workersCount = workersCount;
+
+				header->processId = ::GetCurrentProcessId();
+
+				::GetSystemTimeAsFileTime((LPFILETIME) &header->startTime);
+
+				::QueryPerformanceFrequency((LARGE_INTEGER*) &header->timestampFrequency);
+
+				// signature is written last, so readers never see the partially filled header
+				::MemoryBarrier();
+
+				header->signature = STATISTICS_SIGNATURE;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="StatisticsRegion" /> class.
+			/// </summary>
+			/// <param name="filePath">The path of the file onto which to map the region, or <c>null</c> to keep region in the private memory.</param>
+			/// <param name="workersCount">The count of the workers.</param>
+			/// <param name="kernelErrorCode">The error code of the kernel if operation has failed.</param>
+			/// <returns>A pointer to the instance of the class if operation has succeed; otherwise, <c>null</c>.</returns>
+			inline static StatisticsRegion* Create(LPCWSTR filePath, ULONG workersCount, DWORD& kernelErrorCode)
+			{
+				// calculate the length of the region
+				auto regionLength = (DWORD) (sizeof(StatisticsHeader) + sizeof(WorkerCounters) * workersCount);
+
+				// check if region should be kept in the private memory
+				if (filePath == nullptr)
+				{
+					// reserve and commit memory block, memory is zeroed by the kernel
+					auto memoryBlock = ::VirtualAlloc(nullptr, regionLength, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+					// check if operation has failed
+					if (memoryBlock == nullptr)
+					{
+						// get kernel error code
+						kernelErrorCode = ::GetLastError();
+
+						return nullptr;
+					}
+
+					kernelErrorCode = 0;
+
+					return new StatisticsRegion(INVALID_HANDLE_VALUE, nullptr, memoryBlock, workersCount);
+				}
+
+				// create file, readers are allowed to open it while it is written
+				auto fileHandle = ::CreateFileW(filePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+
+				// check if operation has failed
+				if (fileHandle == INVALID_HANDLE_VALUE)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					return nullptr;
+				}
+
+				// create file mapping of the required length, file is extended and zeroed by the kernel
+				auto mappingHandle = ::CreateFileMappingW(fileHandle, nullptr, PAGE_READWRITE, 0, regionLength, nullptr);
+
+				// check if operation has failed
+				if (mappingHandle == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					// close file and ignore result
+					::CloseHandle(fileHandle);
+
+					return nullptr;
+				}
+
+				// map view of the file
+				auto memoryBlock = ::MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, regionLength);
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					// close handles and ignore result
+					::CloseHandle(mappingHandle);
+
+					::CloseHandle(fileHandle);
+
+					return nullptr;
+				}
+
+				kernelErrorCode = 0;
+
+				// initialize and return result
+				return new StatisticsRegion(fileHandle, mappingHandle, memoryBlock, workersCount);
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~StatisticsRegion()
+			{
+				// check if region is kept in the private memory
+				if (mappingHandle == nullptr)
+				{
+					// free allocated memory
+					// ignore result
+					::VirtualFree(header, 0, MEM_RELEASE);
+
+					return;
+				}
+
+				// unmap view and close handles
+				// ignore result
+				::UnmapViewOfFile(header);
+
+				::CloseHandle(mappingHandle);
+
+				::CloseHandle(fileHandle);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets a pointer to the counters of the worker.
+			/// </summary>
+			/// <param name="workerId">The unique identifier of the worker.</param>
+			inline WorkerCounters* GetWorkerCounters(ULONG workerId)
+			{
+				return workerCounters + workerId;
+			}
+
+			/// <summary>
+			/// Gets the count of the workers.
+			/// </summary>
+			inline ULONG GetWorkersCount()
+			{
+				return header->workersCount;
+			}
+
+			/// <summary>
+			/// Gets the frequency, in counts per second, of the timestamps used by the latency histograms.
+			/// </summary>
+			inline ULONG64 GetTimestampFrequency()
+			{
+				return header->timestampFrequency;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -3,6 +3,10 @@
 #include "Stdafx.h"
 #include "Winsock.h"
 #include "Ovelapped.h"
+#include "SharedPayload.h"
+#include "HttpParser.h"
+#include "HttpChunked.h"
+#include "MirroredRing.h"
 
 #pragma unmanaged
 
@@ -11,19 +15,73 @@ namespace SXN
 	namespace Net
 	{
 		/// <summary>
-		/// Provides work with a TCP connection.
+		/// The length of the address storage required by the <see cref="Winsock::AcceptEx" /> for the single address.
+		/// </summary>
+		/// <remarks>
+		/// Fits the address of any family the listener can be bound to.
+		/// </remarks>
+		#define TCP_CONNECTION_ADDRESS_LENGTH (sizeof(SOCKADDR_IN6) + 16)
+
+		/// <summary>
+		/// The flag of the request context of the receive of the forwarded data.
 		/// </summary>
-		public class TcpConnection final
+		/// <remarks>
+		/// The receive and the send of the forwarding connection are in progress at once, so the operation is encoded into the context instead of the state.
+		/// </remarks>
+		#define TCP_CONNECTION_FORWARD_RECEIVE 0x40000000UL
+
+		/// <summary>
+		/// The flag of the request context of the send of the forwarded data.
+		/// </summary>
+		#define TCP_CONNECTION_FORWARD_SEND 0x80000000UL
+
+		/// <summary>
+		/// The flag of the request context of the broadcast send, the context holds the index of the slot of the send instead of the connection.
+		/// </summary>
+		#define TCP_CONNECTION_BROADCAST_SEND 0x20000000UL
+
+		/// <summary>
+		/// The shift of the low bits of the generation of the connection within the request context of its own operation.
+		/// </summary>
+		/// <remarks>
+		/// The operation posted by the previous connection of the slot, such as the receive of the connection closed by the idle timeout, may complete
+		/// after the slot is reused, so its completion is told apart by the generation and dropped.
+		/// </remarks>
+		#define TCP_CONNECTION_GENERATION_SHIFT 24
+
+		/// <summary>
+		/// The mask of the low bits of the generation within the request context, after the shift.
+		/// </summary>
+		#define TCP_CONNECTION_GENERATION_MASK 0x1FUL
+
+		/// <summary>
+		/// The mask of the identifier of the connection within the request context.
+		/// </summary>
+		#define TCP_CONNECTION_ID_MASK 0x00FFFFFFUL
+
+		/// <summary>
+		/// The flag of the count of the sends of the stream in progress, which is set with the last send.
+		/// </summary>
+		/// <remarks>
+		/// The flag and the last send are counted by the single atomic add, so the send completed meanwhile sees either both or none.
+		/// </remarks>
+		#define TCP_CONNECTION_STREAM_ENDING 0x10000L
+
+		/// <summary>
+		/// Contains the state of the TCP connection which is not needed to dispatch the completions.
+		/// </summary>
+		/// <remarks>
+		/// Holds the sockets and the structures used on accept and disconnect, and the state of the request being read and answered,
+		/// such as the parser, the lengths of the buffers and the body, the frame and the stream, which is touched by the handler once its completion is dispatched.
+		/// Is kept apart from the <see cref="TcpConnection" />, so the dispatch loop walks only the cache lines of the connections,
+		/// and a handler reading the request of one connection does not share the cache line with the dispatch of the others.
+		/// </remarks>
+		private struct TcpConnectionContext final
 		{
-			public :
+			public:
 
 			#pragma region Fields
 
-			/// <summary>
-			/// A reference to the object that provides work with the Winsock extensions.
-			/// </summary>
-			Winsock& winsock;
-
 			/// <summary>
 			/// The descriptor of the listening socket.
 			/// </summary>
@@ -35,61 +93,268 @@ namespace SXN
 			SOCKET connectionSocket;
 
 			/// <summary>
-			/// The descriptor of the socket within the Registered I/O extension.
+			/// The structure used by the accept operation.
 			/// </summary>
-			RIO_RQ rioRequestQueue;
+			Ovelapped acceptOverlapped;
 
 			/// <summary>
-			/// The descriptor of the portion of the registered buffer used for receiving data.
+			/// The structure used by the disconnect operation.
 			/// </summary>
-			PRIO_BUF rioReceiveBuffer;
+			Ovelapped disconnectOverlapped;
 
 			/// <summary>
-			/// The descriptor of the portion of the registered buffer used for sending data.
+			/// The structure used by the connect operation of the upstream connection.
+			/// </summary>
+			Ovelapped connectOverlapped;
+
+			/// <summary>
+			/// The structure which hands the receive over to the worker thread, which replaces the full receive segment with the larger one first.
 			/// </summary>
-			PRIO_BUF rioSendBuffer;
+			Ovelapped growOverlapped;
 
 			/// <summary>
-			/// The pointer to the IP address of the client which has requested the connection.
+			/// The storage of the local and remote addresses of the connection.
 			/// </summary>
-			PVOID clientAddress;
+			char clientAddress[TCP_CONNECTION_ADDRESS_LENGTH * 2];
 
-			Ovelapped* acceptOverlapped;
+			/// <summary>
+			/// The index of the listener on which the connection is accepted.
+			/// </summary>
+			ULONG listenerIndex;
 
-			Ovelapped* disconnectOverlaped;
+			/// <summary>
+			/// The index of the upstream to which the connection is made, or <c>ULONG_MAX</c> if the connection is accepted.
+			/// </summary>
+			ULONG upstreamIndex;
 
-			ULONG id;
+			/// <summary>
+			/// The identifier of the connection to which the data is forwarded, or <c>ULONG_MAX</c> if the connection does not forward.
+			/// </summary>
+			ULONG peerId;
+
+			/// <summary>
+			/// The count of the operations of the forwarding pair in progress, is kept by the accepted connection of the pair.
+			/// </summary>
+			ULONG forwardPendingCount;
+
+			/// <summary>
+			/// Indicates whether the forwarding pair is closing, is kept by the accepted connection of the pair.
+			/// </summary>
+			BOOL forwardClosing;
+
+			/// <summary>
+			/// The shared payload referred to by the send in progress, or <c>null</c> if the send is made from the send buffer.
+			/// </summary>
+			SharedPayload* sendPayload;
+
+			/// <summary>
+			/// The parser of the request which is not received completely.
+			/// </summary>
+			HttpParser httpParser;
+
+			/// <summary>
+			/// The length of the data within the receive buffer.
+			/// </summary>
+			ULONG receivedLength;
+
+			/// <summary>
+			/// The length of the data within the receive buffer consumed by the requests already read.
+			/// </summary>
+			ULONG consumedLength;
+
+			/// <summary>
+			/// The length of the responses appended to the send buffer and not sent yet.
+			/// </summary>
+			ULONG sendLength;
+
+			/// <summary>
+			/// The count of the requests read from the connection.
+			/// </summary>
+			ULONG requestsCount;
+
+			/// <summary>
+			/// The tick count when the connection started to wait for the next request, or zero if it does not wait.
+			/// </summary>
+			ULONG64 idleSince;
+
+			/// <summary>
+			/// The decoder of the chunked body of the request.
+			/// </summary>
+			HttpChunkedDecoder chunkedDecoder;
+
+			/// <summary>
+			/// The length of the body of the request which is not received yet, if the body is not chunked.
+			/// </summary>
+			ULONG64 bodyRemaining;
+
+			/// <summary>
+			/// Indicates whether the body of the request is chunked.
+			/// </summary>
+			BOOL bodyChunked;
+
+			/// <summary>
+			/// Indicates whether the rest of the body of the request is expected.
+			/// </summary>
+			BOOL bodyReceiving;
+
+			/// <summary>
+			/// Indicates whether the framing of the chunked body is malformed.
+			/// </summary>
+			BOOL bodyMalformed;
+
+			/// <summary>
+			/// The offset of the piece of the body within the receive buffer.
+			/// </summary>
+			ULONG bodyOffset;
+
+			/// <summary>
+			/// The length of the piece of the body.
+			/// </summary>
+			ULONG bodyLength;
+
+			/// <summary>
+			/// The offset of the last frame read within the receive buffer.
+			/// </summary>
+			ULONG frameOffset;
+
+			/// <summary>
+			/// The length of the payload of the last frame read.
+			/// </summary>
+			ULONG framePayloadLength;
+
+			/// <summary>
+			/// The count of the sends of the stream in progress, is decremented by the worker as the sends complete.
+			/// </summary>
+			volatile LONG streamSendsCount;
+
+			/// <summary>
+			/// The index of the slice of the send buffer the next chunk of the stream is written to.
+			/// </summary>
+			ULONG streamSliceIndex;
+
+			/// <summary>
+			/// The handle of the segment of the registered buffer used for receiving data, or <c>RIO_SEGMENT_NIL</c> if none is rented.
+			/// </summary>
+			/// <remarks>
+			/// The served connection rents the smallest segment on admit, which is replaced by the larger one when the request fills it.
+			/// </remarks>
+			ULONG receiveSegment;
+
+			/// <summary>
+			/// The ring used for receiving data instead of the segment, or <c>null</c> if the connection receives into the segment.
+			/// </summary>
+			MirroredRing* receiveRing;
+
+			/// <summary>
+			/// The handle of the segment of the registered buffer used for sending data, rented on admit, or <c>RIO_SEGMENT_NIL</c> if none is rented.
+			/// </summary>
+			ULONG sendSegment;
+
+			/// <summary>
+			/// The lock which serializes the posts to the request queue of the connection.
+			/// </summary>
+			/// <remarks>
+			/// The request queue is not thread safe, and the broadcast sends are posted by the worker thread while the handler posts the own operations.
+			/// </remarks>
+			SRWLOCK requestQueueLock;
 
 			#pragma endregion
+		};
 
+		/// <summary>
+		/// Provides work with a TCP connection.
+		/// </summary>
+		/// <remarks>
+		/// Contains only the fields read by the dispatch of every completion and occupies exactly one cache line.
+		/// </remarks>
+		public class __declspec(align(64)) TcpConnection final
+		{
 			public:
 
+			#pragma region Fields
+
+			/// <summary>
+			/// The state of the connection.
+			/// </summary>
 			ConnectionState state;
 
-			#pragma region Constructor & Destructor
+			/// <summary>
+			/// The number of the connection accepted by the slot, distinguishes connections which reuse the slot within the trace.
+			/// </summary>
+			/// <remarks>
+			/// Its low bits tag the own operations of the connection, it is also moved on when the receive is abandoned by the idle timeout.
+			/// </remarks>
+			USHORT generation;
+
+			/// <summary>
+			/// The unique identifier of the connection within the worker.
+			/// </summary>
+			ULONG id;
+
+			/// <summary>
+			/// The descriptor of the socket within the Registered I/O extension.
+			/// </summary>
+			RIO_RQ rioRequestQueue;
+
+			/// <summary>
+			/// A pointer to the object that provides work with the Winsock extensions.
+			/// </summary>
+			Winsock* winsock;
+
+			/// <summary>
+			/// The descriptor of the portion of the registered buffer used for receiving data.
+			/// </summary>
+			RIO_BUF rioReceiveBuffer;
+
+			/// <summary>
+			/// The descriptor of the portion of the registered buffer used for sending data.
+			/// </summary>
+			RIO_BUF rioSendBuffer;
+
+			/// <summary>
+			/// A pointer to the state of the connection not needed to dispatch the completions.
+			/// </summary>
+			TcpConnectionContext* context;
+
+			#pragma endregion
+
+			#pragma region Methods
 
 			/// <summary>
-			/// Initializes a new instance of the <see cref="TcpConnection" /> class.
+			/// Initializes the connection.
 			/// </summary>
 			/// <param name="winsock">A reference to the object that provides work with the Winsock extensions.</param>
+			/// <param name="context">A pointer to the state of the connection not needed to dispatch the completions.</param>
 			/// <param name="listenSocket">The descriptor of the listening socket.</param>
 			/// <param name="connectionSocket">The descriptor of the connection socket.</param>
 			/// <param name="rioRequestQueue">The descriptor of the socket within the Registered I/O extension.</param>
-			inline TcpConnection(Winsock& winsock, SOCKET listenSocket, SOCKET connectionSocket, RIO_RQ rioRequestQueue, HANDLE complitionPort, ULONG id, ULONG workerId)
-				: winsock(winsock)
+			/// <param name="completionPort">The completion port of the connection.</param>
+			/// <param name="id">The unique identifier of the connection within the worker.</param>
+			/// <param name="workerId">The unique identifier of the worker.</param>
+			inline void Initialize(Winsock& winsock, TcpConnectionContext* context, SOCKET listenSocket, SOCKET connectionSocket, RIO_RQ rioRequestQueue, HANDLE completionPort, ULONG id, ULONG workerId)
 			{
-				this->id = id;
+				this->winsock = &winsock;
 
-				this->listenSocket = listenSocket;
+				this->context = context;
 
-				this->connectionSocket = connectionSocket;
+				this->id = id;
 
 				this->rioRequestQueue = rioRequestQueue;
 
-				this->clientAddress = new char[(sizeof(sockaddr_in) + 16) * 2];
+				context->listenSocket = listenSocket;
+
+				context->connectionSocket = connectionSocket;
+
+				context->upstreamIndex = ULONG_MAX;
+
+				context->peerId = ULONG_MAX;
+
+				context->sendPayload = nullptr;
+
+				::InitializeSRWLock(&context->requestQueueLock);
 
 				{
-					this->acceptOverlapped = new Ovelapped();
+					auto acceptOverlapped = &context->acceptOverlapped;
 
 					memset(acceptOverlapped, 0, sizeof(Ovelapped));
 
@@ -103,82 +368,373 @@ namespace SXN
 
 					acceptOverlapped->connectionSocket = connectionSocket;
 
-					acceptOverlapped->completionPort = complitionPort;
+					acceptOverlapped->completionPort = completionPort;
 				}
 
 				{
-					this->disconnectOverlaped = new Ovelapped();
+					auto disconnectOverlapped = &context->disconnectOverlapped;
+
+					memset(disconnectOverlapped, 0, sizeof(Ovelapped));
 
-					memset(disconnectOverlaped, 0, sizeof(Ovelapped));
+					disconnectOverlapped->connectionId = id;
 
-					disconnectOverlaped->action = SOCK_ACTION_DISCONNECT;
+					disconnectOverlapped->workerId = workerId;
 
-					disconnectOverlaped->connection = this;
+					disconnectOverlapped->action = SOCK_ACTION_DISCONNECT;
 
-					disconnectOverlaped->connectionSocket = connectionSocket;
+					disconnectOverlapped->connection = this;
 
-					disconnectOverlaped->completionPort = complitionPort;
+					disconnectOverlapped->connectionSocket = connectionSocket;
+
+					disconnectOverlapped->completionPort = completionPort;
 				}
 
-				state = ConnectionState::Disconnected;
-			}
+				{
+					auto connectOverlapped = &context->connectOverlapped;
 
-			inline ~TcpConnection()
-			{
-				delete clientAddress;
-			}
+					memset(connectOverlapped, 0, sizeof(Ovelapped));
 
-			#pragma endregion
+					connectOverlapped->connectionId = id;
 
-			#pragma region Methods
+					connectOverlapped->workerId = workerId;
+
+					connectOverlapped->action = SOCK_ACTION_CONNECT;
+
+					connectOverlapped->connection = this;
+
+					connectOverlapped->connectionSocket = connectionSocket;
+
+					connectOverlapped->completionPort = completionPort;
+				}
+
+				{
+					auto growOverlapped = &context->growOverlapped;
+
+					memset(growOverlapped, 0, sizeof(Ovelapped));
+
+					growOverlapped->connectionId = id;
+
+					growOverlapped->workerId = workerId;
+
+					growOverlapped->action = SOCK_ACTION_GROW;
+
+					growOverlapped->connection = this;
+
+					growOverlapped->connectionSocket = connectionSocket;
+
+					growOverlapped->completionPort = completionPort;
+				}
+
+				state = ConnectionState::Disconnected;
+			}
 
 			inline BOOL StartAccept()
 			{
+				ResetRequests();
+
 				state = ConnectionState::Accepting;
 
 				DWORD dwBytes;
 
-				return winsock.AcceptEx(listenSocket, connectionSocket, clientAddress, 0, sizeof(sockaddr_in) + 16, sizeof(sockaddr_in) + 16, &dwBytes, acceptOverlapped);
+				return winsock->AcceptEx(context->listenSocket, context->connectionSocket, context->clientAddress, 0, TCP_CONNECTION_ADDRESS_LENGTH, TCP_CONNECTION_ADDRESS_LENGTH, &dwBytes, &context->acceptOverlapped);
 			}
 
 			inline int EndAccepet()
 			{
-				return ::setsockopt(connectionSocket, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, (char *)&listenSocket, sizeof(SOCKET));
+				return ::setsockopt(context->connectionSocket, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, (char *)&context->listenSocket, sizeof(SOCKET));
+			}
+
+			/// <summary>
+			/// Starts connecting of the upstream connection to the specified address.
+			/// </summary>
+			/// <param name="address">A pointer to the address of the upstream.</param>
+			/// <param name="addressLength">The length, in bytes, of the address.</param>
+			/// <remarks>
+			/// The socket should be bound, the completion is delivered to the port the socket is associated with.
+			/// </remarks>
+			inline BOOL StartConnect(const sockaddr* address, int addressLength)
+			{
+				ResetRequests();
+
+				state = ConnectionState::Connecting;
+
+				return winsock->ConnectEx(context->connectionSocket, address, addressLength, nullptr, 0, nullptr, &context->connectOverlapped);
+			}
+
+			inline int EndConnect()
+			{
+				state = ConnectionState::Connected;
+
+				return ::setsockopt(context->connectionSocket, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0);
 			}
 
 			inline void GetSourceAddress()
 			{
-				//winsock.GetAcceptExSockaddrs();
+				//winsock->GetAcceptExSockaddrs();
+			}
+
+			/// <summary>
+			/// Gets the request context of the own operation of the connection, which holds its identifier and the low bits of its generation.
+			/// </summary>
+			inline PVOID GetRequestContext() const
+			{
+				return (PVOID) (ULONG_PTR) (id | ((generation & TCP_CONNECTION_GENERATION_MASK) << TCP_CONNECTION_GENERATION_SHIFT));
+			}
+
+			/// <summary>
+			/// Checks whether the completed own operation was posted by the connection which holds the slot now.
+			/// </summary>
+			/// <param name="requestContext">The request context of the completed operation.</param>
+			inline BOOL IsCurrent(ULONG requestContext) const
+			{
+				return ((requestContext >> TCP_CONNECTION_GENERATION_SHIFT) & TCP_CONNECTION_GENERATION_MASK) == (generation & TCP_CONNECTION_GENERATION_MASK);
+			}
+
+			/// <summary>
+			/// Posts the receive to the request queue, while no other thread posts to it.
+			/// </summary>
+			inline BOOL PostReceive(PRIO_BUF buffer, PVOID requestContext)
+			{
+				::AcquireSRWLockExclusive(&context->requestQueueLock);
+
+				auto result = winsock->RIOReceive(rioRequestQueue, buffer, 1, 0, requestContext);
+
+				::ReleaseSRWLockExclusive(&context->requestQueueLock);
+
+				return result;
+			}
+
+			/// <summary>
+			/// Posts the send to the request queue, while no other thread posts to it.
+			/// </summary>
+			inline BOOL PostSend(PRIO_BUF buffers, ULONG buffersCount, PVOID requestContext)
+			{
+				::AcquireSRWLockExclusive(&context->requestQueueLock);
+
+				auto result = winsock->RIOSend(rioRequestQueue, buffers, buffersCount, 0, requestContext);
+
+				::ReleaseSRWLockExclusive(&context->requestQueueLock);
+
+				return result;
 			}
 
 			inline BOOL StartRecieve()
+			{
+				// the data is received from the start of the buffer
+				context->receivedLength = 0;
+
+				context->consumedLength = 0;
+
+				context->idleSince = 0;
+
+				state = ConnectionState::Receiving;
+
+				return PostReceive(&rioReceiveBuffer, GetRequestContext());
+			}
+
+			/// <summary>
+			/// Starts receiving of the data after the data already within the receive buffer.
+			/// </summary>
+			/// <remarks>
+			/// The data not consumed should be moved to the start of the buffer first.
+			/// </remarks>
+			inline BOOL StartReceiveNext()
 			{
 				state = ConnectionState::Receiving;
 
-				return winsock.RIOReceive(rioRequestQueue, rioReceiveBuffer, 1, 0, (PVOID) id);
+				auto rioBuffer = rioReceiveBuffer;
+
+				rioBuffer.Offset += context->receivedLength;
+
+				rioBuffer.Length -= context->receivedLength;
+
+				return PostReceive(&rioBuffer, GetRequestContext());
+			}
+
+			/// <summary>
+			/// Forgets the requests of the previous connection of the slot.
+			/// </summary>
+			inline void ResetRequests()
+			{
+				context->httpParser.Reset();
+
+				context->receivedLength = 0;
+
+				context->consumedLength = 0;
+
+				context->sendLength = 0;
+
+				context->requestsCount = 0;
+
+				context->idleSince = 0;
+
+				context->streamSendsCount = 0;
+
+				context->streamSliceIndex = 0;
+
+				context->bodyRemaining = 0;
+
+				context->bodyReceiving = FALSE;
+
+				context->bodyMalformed = FALSE;
+
+				context->bodyLength = 0;
 			}
 
 			inline BOOL StartSend(DWORD dataLength)
 			{
 				state = ConnectionState::Sending;
 
-				rioSendBuffer->Length = dataLength;
+				rioSendBuffer.Length = dataLength;
+
+				return PostSend(&rioSendBuffer, 1, GetRequestContext());
+			}
+
+			/// <summary>
+			/// Starts sending of the template followed by the data of the send buffer.
+			/// </summary>
+			/// <param name="responseTemplate">The descriptor of the template within the shared registered buffer.</param>
+			/// <param name="dataLength">The length of the data of the send buffer, may be zero.</param>
+			inline BOOL StartSendTemplate(PRIO_BUF responseTemplate, DWORD dataLength)
+			{
+				state = ConnectionState::Sending;
+
+				if (dataLength == 0)
+				{
+					return PostSend(responseTemplate, 1, GetRequestContext());
+				}
+
+				rioSendBuffer.Length = dataLength;
+
+				RIO_BUF buffers[2] = { *responseTemplate, rioSendBuffer };
 
-				return winsock.RIOSend(rioRequestQueue, rioSendBuffer, 1, 0, (PVOID) id);
+				return PostSend(buffers, 2, GetRequestContext());
+			}
+
+			/// <summary>
+			/// Starts sending of the shared payload.
+			/// </summary>
+			/// <param name="payload">The payload, the reference to which is taken over by the connection until the send is completed.</param>
+			inline BOOL StartSendPayload(SharedPayload* payload)
+			{
+				// the send aborted by the disconnect is not completed by the worker, so its reference is released by the next one
+				ReleaseSendPayload();
+
+				state = ConnectionState::Sending;
+
+				context->sendPayload = payload;
+
+				auto result = PostSend(payload->GetBuffer(), 1, GetRequestContext());
+
+				// the failed send is never completed
+				if (!result)
+				{
+					ReleaseSendPayload();
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Starts sending of the portion of the send buffer while the previous sends of the stream are in progress.
+			/// </summary>
+			/// <param name="offset">The offset of the data within the send buffer.</param>
+			/// <param name="length">The length of the data.</param>
+			inline BOOL StartStreamSend(ULONG offset, ULONG length)
+			{
+				state = ConnectionState::Streaming;
+
+				auto rioBuffer = rioSendBuffer;
+
+				rioBuffer.Offset += offset;
+
+				rioBuffer.Length = length;
+
+				return PostSend(&rioBuffer, 1, GetRequestContext());
+			}
+
+			/// <summary>
+			/// Starts sending of the broadcast payload beside the operation in progress.
+			/// </summary>
+			/// <param name="payload">The descriptor of the payload.</param>
+			/// <param name="slotIndex">The index of the slot which keeps the payload until the send is completed.</param>
+			inline BOOL StartBroadcastSend(PRIO_BUF payload, ULONG slotIndex)
+			{
+				return PostSend(payload, 1, (PVOID) (slotIndex | TCP_CONNECTION_BROADCAST_SEND));
+			}
+
+			/// <summary>
+			/// Releases the reference to the payload of the completed send, if any.
+			/// </summary>
+			inline void ReleaseSendPayload()
+			{
+				auto payload = context->sendPayload;
+
+				if (payload != nullptr)
+				{
+					context->sendPayload = nullptr;
+
+					payload->Release();
+				}
+			}
+
+			/// <summary>
+			/// Starts receiving of the data to forward into the receive buffer.
+			/// </summary>
+			inline BOOL StartForwardReceive()
+			{
+				return PostReceive(&rioReceiveBuffer, (PVOID) (id | TCP_CONNECTION_FORWARD_RECEIVE));
+			}
+
+			/// <summary>
+			/// Starts sending of the data received by the peer, directly from its receive buffer.
+			/// </summary>
+			/// <param name="data">The descriptor of the portion of the receive buffer of the peer which holds the data.</param>
+			inline BOOL StartForwardSend(RIO_BUF data)
+			{
+				return PostSend(&data, 1, (PVOID) (id | TCP_CONNECTION_FORWARD_SEND));
+			}
+
+			/// <summary>
+			/// Starts sending of the busy response, after which the connection should be disconnected.
+			/// </summary>
+			/// <param name="busyResponse">The descriptor of the portion of the shared registered buffer that contains the busy response.</param>
+			inline BOOL StartRefuse(PRIO_BUF busyResponse)
+			{
+				state = ConnectionState::Refusing;
+
+				return PostSend(busyResponse, 1, GetRequestContext());
 			}
 
 			inline BOOL StartDisconnect()
 			{
 				state = ConnectionState::Disconnecting;
 
-				//return winsock.DisconnectEx(connectionSocket, disconnectOverlaped, TF_REUSE_SOCKET, 0);
+				//return winsock->DisconnectEx(context->connectionSocket, &context->disconnectOverlapped, TF_REUSE_SOCKET, 0);
+
+				return winsock->DisconnectEx(context->connectionSocket, NULL, TF_REUSE_SOCKET, 0);
+			}
+
+			/// <summary>
+			/// Starts the disconnect which completes on the completion port of the socket, so the caller does not wait for it.
+			/// </summary>
+			/// <remarks>
+			/// The socket should be associated with the completion port, the socket can be reused once the disconnect completes.
+			/// </remarks>
+			inline BOOL StartOverlappedDisconnect()
+			{
+				state = ConnectionState::Disconnecting;
 
-				return winsock.DisconnectEx(connectionSocket, NULL, TF_REUSE_SOCKET, 0);
+				return winsock->DisconnectEx(context->connectionSocket, &context->disconnectOverlapped, TF_REUSE_SOCKET, 0);
 			}
 
 			#pragma endregion
 		};
+
+		#ifdef _WIN64
+		static_assert(sizeof(TcpConnection) == 64, "TcpConnection must occupy exactly one cache line.");
+		#endif
 	}
 }
 
-#pragma managed
\ No newline at end of file
+#pragma managed
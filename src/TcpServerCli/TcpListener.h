@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Stdafx.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Describes the listening socket and its share of the connections of the single worker.
+		/// </summary>
+		private struct TcpListener final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The descriptor of the listening socket.
+			/// </summary>
+			SOCKET socket;
+
+			/// <summary>
+			/// The address family of the listening socket, the connection sockets are created with the same one.
+			/// </summary>
+			int addressFamily;
+
+			/// <summary>
+			/// The count of the connections of the worker which accept on the socket.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// The index of the upstream to which the accepted connections are forwarded, or <c>ULONG_MAX</c> if they are served by the handler.
+			/// </summary>
+			ULONG upstreamIndex;
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
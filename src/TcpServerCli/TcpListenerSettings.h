@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Stdafx.h"
+
+using namespace System;
+using namespace System::Net;
+using namespace System::Net::Sockets;
+
+namespace SXN
+{
+	namespace Net
+	{
+		ref class Connection;
+
+		/// <summary>
+		/// Specifies the configuration settings of the single listening endpoint of the TCP worker.
+		/// </summary>
+		public ref class TcpListenerSettings
+		{
+			private:
+
+			#pragma region Fields
+
+			IPEndPoint^ acceptPoint;
+
+			Int32 upstreamIndex;
+
+			#pragma endregion
+
+			public:
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="TcpListenerSettings" /> class.
+			/// </summary>
+			TcpListenerSettings()
+			{
+				upstreamIndex = -1;
+			}
+
+			#pragma region Properties
+
+			/// <summary>
+			/// The Internet Protocol address and port on which to listen the incoming connections.
+			/// </summary>
+			property IPEndPoint^ AcceptPoint
+			{
+				IPEndPoint^ get()
+				{
+					return acceptPoint;
+				}
+
+				void set(IPEndPoint^ value)
+				{
+					if (value == nullptr)
+					{
+						throw gcnew ArgumentNullException("value");
+					}
+
+					if ((value->AddressFamily != AddressFamily::InterNetwork) && (value->AddressFamily != AddressFamily::InterNetworkV6))
+					{
+						throw gcnew ArgumentOutOfRangeException("value.AddressFamily");
+					}
+
+					acceptPoint = value;
+				}
+			}
+
+			/// <summary>
+			/// Determines whether the IPv6 listener accepts the IPv4 connections as well.
+			/// </summary>
+			/// <remarks>
+			/// Is ignored for the IPv4 <see cref="AcceptPoint" />.
+			/// </remarks>
+			property Boolean DualMode;
+
+			/// <summary>
+			/// The count of the connections which accept on the endpoint.
+			/// </summary>
+			/// <remarks>
+			/// Value is split evenly between the workers, so each endpoint has its own share of the slots of each worker.
+			/// </remarks>
+			property UInt32 ConnectionsBacklogLength;
+
+			/// <summary>
+			/// Determines whether the TCP Loopback optimization is used by the endpoint.
+			/// </summary>
+			/// <remarks>
+			/// The local traffic of the endpoint bypasses the most of the TCP stack, both ends of the connection should enable the optimization.
+			/// </remarks>
+			property Boolean UseFastLoopback;
+
+			/// <summary>
+			/// The handler of the connections accepted on the endpoint.
+			/// </summary>
+			/// <remarks>
+			/// If value is <c>null</c>, the handler passed to the <see cref="TcpWorker" /> is used.
+			/// </remarks>
+			property Func<Connection^, System::Threading::Tasks::Task^>^ Handler;
+
+			/// <summary>
+			/// The index of the upstream within the <see cref="TcpWorkerSettings::Upstreams" /> to which the connections accepted on the endpoint are forwarded.
+			/// </summary>
+			/// <remarks>
+			/// Each accepted connection is paired with the connection to the upstream made by the same worker, and the data is forwarded by the worker thread,
+			/// the received data is sent to the peer directly from the registered buffer it is received into, without the handler.
+			/// The next portion is not received until the previous one is sent, so each direction runs at the pace of its slower side.
+			/// The pair is closed when either side closes.
+			/// If value is <c>-1</c>, the connections are served by the <see cref="Handler" />.
+			/// </remarks>
+			property Int32 UpstreamIndex
+			{
+				Int32 get()
+				{
+					return upstreamIndex;
+				}
+
+				void set(Int32 value)
+				{
+					if (value < -1)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					upstreamIndex = value;
+				}
+			}
+
+			#pragma endregion
+		};
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Stdafx.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Describes the endpoint to which the workers connect and the count of the connections each worker keeps to it.
+		/// </summary>
+		private struct TcpUpstream final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The address of the endpoint, the connection sockets are created with its family.
+			/// </summary>
+			SOCKADDR_INET address;
+
+			/// <summary>
+			/// The length, in bytes, of the address.
+			/// </summary>
+			int addressLength;
+
+			/// <summary>
+			/// The count of the connections of the worker to the endpoint.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// Determines whether the TCP Loopback optimization is used by the connections.
+			/// </summary>
+			BOOL useFastLoopback;
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Stdafx.h"
+
+using namespace System;
+using namespace System::Net;
+using namespace System::Net::Sockets;
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies the configuration settings of the endpoint to which the TCP worker connects.
+		/// </summary>
+		public ref class TcpUpstreamSettings
+		{
+			private:
+
+			#pragma region Fields
+
+			IPEndPoint^ connectPoint;
+
+			UInt32 connectionsCount;
+
+			#pragma endregion
+
+			public:
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="TcpUpstreamSettings" /> class.
+			/// </summary>
+			TcpUpstreamSettings()
+			{
+				connectionsCount = 16;
+			}
+
+			#pragma region Properties
+
+			/// <summary>
+			/// The Internet Protocol address and port to which to connect.
+			/// </summary>
+			property IPEndPoint^ ConnectPoint
+			{
+				IPEndPoint^ get()
+				{
+					return connectPoint;
+				}
+
+				void set(IPEndPoint^ value)
+				{
+					if (value == nullptr)
+					{
+						throw gcnew ArgumentNullException("value");
+					}
+
+					if ((value->AddressFamily != AddressFamily::InterNetwork) && (value->AddressFamily != AddressFamily::InterNetworkV6))
+					{
+						throw gcnew ArgumentOutOfRangeException("value.AddressFamily");
+					}
+
+					connectPoint = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum count of the connections each worker keeps to the endpoint.
+			/// </summary>
+			/// <remarks>
+			/// Connections are made on first use and kept alive between uses, so the count bounds the concurrent requests of the worker to the endpoint.
+			/// The connection forwarded by the listener holds one of them while it is open, see <see cref="TcpListenerSettings::UpstreamIndex" />.
+			/// </remarks>
+			property UInt32 ConnectionsCount
+			{
+				UInt32 get()
+				{
+					return connectionsCount;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					connectionsCount = value;
+				}
+			}
+
+			/// <summary>
+			/// Determines whether the TCP Loopback optimization is used by the connections to the endpoint.
+			/// </summary>
+			property Boolean UseFastLoopback;
+
+			#pragma endregion
+		};
+	}
+}
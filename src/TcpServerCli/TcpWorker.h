@@ -1,7 +1,18 @@
 #pragma once
 
 #include "Stdafx.h"
-
+#include "RioBufferPool.h"
+#include "ResponseTemplates.h"
+#include "HttpRouter.h"
+#include "FrameCodec.h"
+#include "PayloadRegistry.h"
+#include "StatisticsRegion.h"
+#include "TraceRing.h"
+#include "TcpListener.h"
+#include "TcpUpstream.h"
+#include <vcclr.h>
+
+using namespace System::Runtime::InteropServices;
 
 namespace SXN
 {
@@ -14,12 +25,32 @@ namespace SXN
 			#pragma region Fields
 
 			/// <summary>
-			/// The descriptor of the listening socket.
+			/// The collection of the listeners.
+			/// </summary>
+			initonly TcpListener* listeners;
+
+			/// <summary>
+			/// The count of the listeners.
+			/// </summary>
+			initonly UInt32 listenersCount;
+
+			/// <summary>
+			/// The collection of the handlers of the connections, one per listener.
+			/// </summary>
+			initonly array<Func<Connection^, System::Threading::Tasks::Task^>^>^ handlers;
+
+			/// <summary>
+			/// The collection of the upstreams.
 			/// </summary>
-			initonly SOCKET listenSocket;
+			initonly TcpUpstream* upstreams;
 
 			/// <summary>
-			/// The completion port of the listening socket.
+			/// The count of the upstreams.
+			/// </summary>
+			initonly UInt32 upstreamsCount;
+
+			/// <summary>
+			/// The completion port of the listening sockets.
 			/// </summary>
 			initonly HANDLE completionPort;
 
@@ -42,6 +73,41 @@ namespace SXN
 			/// </summary>
 			initonly UInt32 acceptQueueMaxEntriesCount;
 
+			/// <summary>
+			/// The registered buffer that contains the busy response shared by all workers.
+			/// </summary>
+			initonly RioBufferPool* busyResponseBuffer;
+
+			/// <summary>
+			/// The pre-rendered responses shared by all workers.
+			/// </summary>
+			initonly ResponseTemplates* responseTemplates;
+
+			/// <summary>
+			/// The payloads shared by all workers.
+			/// </summary>
+			initonly PayloadRegistry* payloadRegistry;
+
+			/// <summary>
+			/// The router of the requests shared by all workers, or <c>null</c> if there are no routes.
+			/// </summary>
+			initonly HttpRouter* router;
+
+			/// <summary>
+			/// The codec of the frames shared by all workers, or <c>null</c> if the connections serve HTTP only.
+			/// </summary>
+			initonly FrameCodec* frameCodec;
+
+			/// <summary>
+			/// The region that contains the statistics of the workers.
+			/// </summary>
+			initonly StatisticsRegion* statisticsRegion;
+
+			/// <summary>
+			/// The region that contains the trace rings of the workers.
+			/// </summary>
+			initonly TraceRegion* traceRegion;
+
 			#pragma endregion
 
 			public:
@@ -55,6 +121,8 @@ namespace SXN
 			{
 				this->serveSocket = serveSocket;
 
+				this->acceptQueueMaxEntriesCount = settings->AcceptQueueMaxEntriesCount;
+
 				// initialize Winsock
 				{
 					WSADATA data;
@@ -72,16 +140,59 @@ namespace SXN
 					}
 				}
 
-				// initialize listen socket
+				// compose settings of the listeners, the single one is made of the accept point if none are given
+				auto listenersSettings = settings->Listeners;
+
+				if (listenersSettings->Count == 0)
 				{
+					auto listenerSettings = gcnew TcpListenerSettings();
+
+					listenerSettings->AcceptPoint = settings->AcceptPoint;
+
+					listenerSettings->ConnectionsBacklogLength = settings->ConnectionsBacklogLength;
+
+					listenerSettings->UseFastLoopback = settings->UseFastLoopback;
+
+					listenersSettings = gcnew List<TcpListenerSettings^>();
+
+					listenersSettings->Add(listenerSettings);
+				}
+
+				listenersCount = listenersSettings->Count;
+
+				listeners = new TcpListener[listenersCount];
+
+				handlers = gcnew array<Func<Connection^, System::Threading::Tasks::Task^>^>(listenersCount);
+
+				// initialize listen sockets
+				for (UInt32 listenerIndex = 0; listenerIndex < listenersCount; listenerIndex++)
+				{
+					auto listenerSettings = listenersSettings[listenerIndex];
+
+					if (listenerSettings->AcceptPoint == nullptr)
+					{
+						throw gcnew ArgumentNullException("settings.Listeners.AcceptPoint");
+					}
+
+					handlers[listenerIndex] = listenerSettings->Handler == nullptr ? serveSocket : listenerSettings->Handler;
+
+					if (listenerSettings->UpstreamIndex >= settings->Upstreams->Count)
+					{
+						throw gcnew ArgumentOutOfRangeException("settings.Listeners.UpstreamIndex");
+					}
+
+					auto listener = listeners + listenerIndex;
+
+					listener->upstreamIndex = listenerSettings->UpstreamIndex < 0 ? ULONG_MAX : (ULONG) listenerSettings->UpstreamIndex;
+
 					// get address family from the accept point
-					auto addressFamily = (int) settings->AcceptPoint->AddressFamily;
+					listener->addressFamily = (int) listenerSettings->AcceptPoint->AddressFamily;
 
 					// create socket
-					listenSocket = ::WSASocket(addressFamily, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+					listener->socket = ::WSASocket(listener->addressFamily, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
 
 					// check if operation has failed
-					if (listenSocket == INVALID_SOCKET)
+					if (listener->socket == INVALID_SOCKET)
 					{
 						// get error code
 						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
@@ -89,11 +200,9 @@ namespace SXN
 						// throw exception
 						throw gcnew TcpServerException(winsockErrorCode);
 					}
-				}
 
-				// configure listen socket
-				{
-					auto configResult = Configure(listenSocket, settings);
+					// configure listen socket
+					auto configResult = Configure(listener->socket, settings->UseNagleAlgorithm, listenerSettings);
 
 					if (!configResult)
 					{
@@ -105,9 +214,32 @@ namespace SXN
 					}
 				}
 
+				// compose upstreams, each worker connects to them on its own
+				upstreamsCount = settings->Upstreams->Count;
+
+				upstreams = new TcpUpstream[upstreamsCount];
+
+				for (UInt32 upstreamIndex = 0; upstreamIndex < upstreamsCount; upstreamIndex++)
+				{
+					auto upstreamSettings = settings->Upstreams[upstreamIndex];
+
+					if (upstreamSettings->ConnectPoint == nullptr)
+					{
+						throw gcnew ArgumentNullException("settings.Upstreams.ConnectPoint");
+					}
+
+					auto upstream = upstreams + upstreamIndex;
+
+					upstream->addressLength = ComposeAddress(upstreamSettings->ConnectPoint, upstream->address);
+
+					upstream->connectionsCount = upstreamSettings->ConnectionsCount;
+
+					upstream->useFastLoopback = upstreamSettings->UseFastLoopback;
+				}
+
 				// initialize winsock extensions
 				{
-					pWinsock = Winsock::Initialize(listenSocket);
+					pWinsock = Winsock::Initialize(listeners[0].socket);
 
 					if (pWinsock == nullptr)
 					{
@@ -134,22 +266,26 @@ namespace SXN
 						throw gcnew TcpServerException(kernelErrorCode);
 					}
 
-					// associate the listening socket with the completion port
-					HANDLE associateResult = ::CreateIoCompletionPort((HANDLE)listenSocket, completionPort, 0, 0);
-
-					if ((associateResult == nullptr) || (associateResult != completionPort))
+					// associate the listening sockets with the completion port, the accepts of all listeners are processed by the single thread
+					for (UInt32 listenerIndex = 0; listenerIndex < listenersCount; listenerIndex++)
 					{
-						// get error code
-						auto kernelErrorCode = ::GetLastError();
+						HANDLE associateResult = ::CreateIoCompletionPort((HANDLE)listeners[listenerIndex].socket, completionPort, 0, 0);
 
-						// throw exception
-						throw gcnew TcpServerException(kernelErrorCode);
+						if ((associateResult == nullptr) || (associateResult != completionPort))
+						{
+							// get error code
+							auto kernelErrorCode = ::GetLastError();
+
+							// throw exception
+							throw gcnew TcpServerException(kernelErrorCode);
+						}
 					}
 				}
 
 				// start listen
+				for (UInt32 listenerIndex = 0; listenerIndex < listenersCount; listenerIndex++)
 				{
-					auto configResult = StartListen(listenSocket, settings);
+					auto configResult = StartListen(listeners[listenerIndex].socket, listenersSettings[listenerIndex]);
 
 					if (!configResult)
 					{
@@ -161,13 +297,220 @@ namespace SXN
 					}
 				}
 
+				// register busy response
+				{
+					auto busyResponseBytes = settings->BusyResponse;
+
+					DWORD kernelErrorCode;
+
+					int winsockErrorCode;
+
+					busyResponseBuffer = RioBufferPool::Create(*pWinsock, busyResponseBytes->Length, 1, kernelErrorCode, winsockErrorCode);
+
+					// check if operation has failed
+					if (busyResponseBuffer == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
+					}
+
+					// copy response into the registered buffer
+					Marshal::Copy(busyResponseBytes, 0, IntPtr(busyResponseBuffer->GetBufferData(0)), busyResponseBytes->Length);
+				}
+
+				// render response templates
+				{
+					auto templatesSettings = settings->ResponseTemplates;
+
+					auto templatesCount = templatesSettings->Count;
+
+					if (templatesCount == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("settings.ResponseTemplates");
+					}
+
+					auto templatesBytes = gcnew array<array<Byte>^>(templatesCount);
+
+					auto dateOffsets = gcnew array<Int32>(templatesCount);
+
+					UInt32 maxTemplateLength = 0;
+
+					for (auto templateIndex = 0; templateIndex < templatesCount; templateIndex++)
+					{
+						auto templateText = templatesSettings[templateIndex];
+
+						if (templateText == nullptr)
+						{
+							throw gcnew ArgumentNullException("settings.ResponseTemplates");
+						}
+
+						// the Date header goes before the empty line if the template is the complete response, or after the last header
+						auto headersEnd = templateText->IndexOf("\r\n\r\n", StringComparison::Ordinal);
+
+						auto dateIndex = headersEnd < 0 ? templateText->Length : headersEnd + 2;
+
+						templateText = templateText->Insert(dateIndex, "Date:" + gcnew String(' ', RESPONSE_DATE_LENGTH) + "\r\n");
+
+						dateOffsets[templateIndex] = dateIndex + 5;
+
+						templatesBytes[templateIndex] = System::Text::Encoding::ASCII->GetBytes(templateText);
+
+						maxTemplateLength = Math::Max(maxTemplateLength, (UInt32) templatesBytes[templateIndex]->Length);
+					}
+
+					DWORD kernelErrorCode;
+
+					int winsockErrorCode = 0;
+
+					responseTemplates = ResponseTemplates::Create(*pWinsock, templatesCount, maxTemplateLength, kernelErrorCode, winsockErrorCode);
+
+					// check if operation has failed
+					if (responseTemplates == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
+					}
+
+					for (auto templateIndex = 0; templateIndex < templatesCount; templateIndex++)
+					{
+						pin_ptr<Byte> templateData = &templatesBytes[templateIndex][0];
+
+						responseTemplates->SetTemplate(templateIndex, (const char*) templateData, templatesBytes[templateIndex]->Length, dateOffsets[templateIndex]);
+					}
+
+					// start refresh of the Date header
+					if (!responseTemplates->Start(kernelErrorCode))
+					{
+						// throw exception
+						throw gcnew TcpServerException((int)kernelErrorCode);
+					}
+				}
+
+				payloadRegistry = new PayloadRegistry(settings->MaxSharedPayloads);
+
+				// compile routes
+				if (settings->Routes->Count != 0)
+				{
+					auto routesSettings = settings->Routes;
+
+					router = HttpRouter::Create(routesSettings->Count);
+
+					for (auto routeIndex = 0; routeIndex < routesSettings->Count; routeIndex++)
+					{
+						if (routesSettings[routeIndex] == nullptr)
+						{
+							throw gcnew ArgumentNullException("settings.Routes");
+						}
+
+						auto routeBytes = System::Text::Encoding::ASCII->GetBytes(routesSettings[routeIndex]);
+
+						if (routeBytes->Length == 0)
+						{
+							throw gcnew ArgumentOutOfRangeException("settings.Routes");
+						}
+
+						pin_ptr<Byte> routeData = &routeBytes[0];
+
+						if (!router->SetRoute(routeIndex, (const char*) routeData, routeBytes->Length))
+						{
+							throw gcnew ArgumentOutOfRangeException("settings.Routes");
+						}
+					}
+
+					// the routes collide only if they are duplicated
+					if (!router->Build())
+					{
+						throw gcnew ArgumentOutOfRangeException("settings.Routes");
+					}
+				}
+
+				// create frame codec
+				if (settings->Framing != nullptr)
+				{
+					auto framing = settings->Framing;
+
+					// the length should fit within the header
+					if (framing->LengthOffset + framing->LengthSize > framing->HeaderLength)
+					{
+						throw gcnew ArgumentOutOfRangeException("settings.Framing");
+					}
+
+					// the length of the largest frame should fit within the length, the longer one would be truncated on encode
+					UInt64 maxLength = (UInt64) framing->MaxPayloadLength + (framing->LengthIncludesHeader ? framing->HeaderLength : 0);
+
+					if ((framing->LengthSize < 8) && (maxLength >> (framing->LengthSize * 8) != 0))
+					{
+						throw gcnew ArgumentOutOfRangeException("settings.Framing");
+					}
+
+					// the largest frame should fit within the receive buffer
+					if ((UInt64) framing->HeaderLength + framing->MaxPayloadLength > (UInt64) settings->ReceiveBufferLength)
+					{
+						throw gcnew ArgumentOutOfRangeException("settings.Framing");
+					}
+
+					frameCodec = new FrameCodec(framing->HeaderLength, framing->LengthOffset, framing->LengthSize, framing->BigEndian, framing->LengthIncludesHeader, framing->MaxPayloadLength);
+				}
+
 				// create and configure sub workers
 				{
-					// get count of processors
-					auto processorsCount = TcpWorkerSettings::ProcessorsCount;
+					// get count of the workers, which is the count of the processors the process can use unless overridden
+					auto processorsCount = settings->WorkersCount;
+
+					// get the share of the connections of each listener per processor, reserve connections are added to accept and refuse connections above the limits
+					for (UInt32 listenerIndex = 0; listenerIndex < listenersCount; listenerIndex++)
+					{
+						listeners[listenerIndex].connectionsCount = listenersSettings[listenerIndex]->ConnectionsBacklogLength / processorsCount + settings->RefuseConnectionsCount;
+					}
+
+					// get the maximum number of the active connections per processor, ceiled
+					auto perWorkerMaxActiveConnections = (settings->MaxActiveConnections + processorsCount - 1) / processorsCount;
+
+					// create statistics region
+					{
+						DWORD kernelErrorCode;
 
-					// get the length of the connections backlog per processor
-					auto perWorkerConnectionBacklogLength = settings->ConnectionsBacklogLength / processorsCount;
+						if (settings->StatisticsFilePath == nullptr)
+						{
+							statisticsRegion = StatisticsRegion::Create(nullptr, processorsCount, kernelErrorCode);
+						}
+						else
+						{
+							pin_ptr<const wchar_t> filePath = PtrToStringChars(settings->StatisticsFilePath);
+
+							statisticsRegion = StatisticsRegion::Create(filePath, processorsCount, kernelErrorCode);
+						}
+
+						// check if operation has failed
+						if (statisticsRegion == nullptr)
+						{
+							// throw exception
+							throw gcnew TcpServerException((int)kernelErrorCode);
+						}
+					}
+
+					// create trace region
+					{
+						DWORD kernelErrorCode;
+
+						if (settings->TraceFilePath == nullptr)
+						{
+							traceRegion = TraceRegion::Create(nullptr, processorsCount, settings->TraceEventsCount, kernelErrorCode);
+						}
+						else
+						{
+							pin_ptr<const wchar_t> filePath = PtrToStringChars(settings->TraceFilePath);
+
+							traceRegion = TraceRegion::Create(filePath, processorsCount, settings->TraceEventsCount, kernelErrorCode);
+						}
+
+						// check if operation has failed
+						if (traceRegion == nullptr)
+						{
+							// throw exception
+							throw gcnew TcpServerException((int)kernelErrorCode);
+						}
+					}
 
 					// 4 create collection of the IOCP workers
 					workers = gcnew array<IocpWorker^>(processorsCount);
@@ -175,8 +518,13 @@ namespace SXN
 					// initialize workers
 					for (int processorIndex = 0; processorIndex < processorsCount; processorIndex++)
 					{
+						// create admission control of the worker
+						auto admissionControl = new AdmissionControl(perWorkerMaxActiveConnections, settings->MinAvailableBuffers, settings->MaxCompletionQueueDepth);
+
 						// create process worker
-						auto worker = gcnew IocpWorker(listenSocket, *pWinsock, processorIndex, settings->ReceiveBufferLength, perWorkerConnectionBacklogLength);
+						auto processorMask = settings->UseThreadAffinity ? TcpWorkerSettings::GetWorkerProcessorMask(processorIndex) : 0;
+
+						auto worker = gcnew IocpWorker(listeners, listenersCount, upstreams, upstreamsCount, *pWinsock, processorIndex, settings->ReceiveBufferLength, settings->SendBufferLength, settings->KeepAliveTimeout, settings->MaxKeepAliveRequests, settings->MaxStreamSends, settings->UseReceiveRings, admissionControl, busyResponseBuffer->GetBuffer(0), responseTemplates, payloadRegistry, router, frameCodec, statisticsRegion->GetWorkerCounters(processorIndex), traceRegion->GetRing(processorIndex), processorMask, gcnew WaitCallback(this, &TcpWorker::Serve));
 
 						// add to collection
 						workers[processorIndex] = worker;
@@ -193,12 +541,294 @@ namespace SXN
 				}
 			}
 
+			/// <summary>
+			/// Gets the latency of the stage of the request processing at the specified percentile, merged over all workers.
+			/// </summary>
+			/// <param name="stage">The stage of the request processing.</param>
+			/// <param name="percentile">The percentile, from 0 to 100.</param>
+			/// <returns>The lowest latency of the bucket that holds the percentile, or <see cref="TimeSpan::Zero" /> if nothing was recorded.</returns>
+			/// <remarks>
+			/// Reads histograms while they are written, so the result is approximate.
+			/// </remarks>
+			TimeSpan GetLatency(LatencyStage stage, Double percentile)
+			{
+				if ((percentile < 0) || (percentile > 100))
+				{
+					throw gcnew ArgumentOutOfRangeException("percentile");
+				}
+
+				auto stageIndex = (int) stage;
+
+				auto workersCount = statisticsRegion->GetWorkersCount();
+
+				// merge histograms of the workers
+				auto merged = gcnew array<UInt64>(LATENCY_BUCKETS_COUNT);
+
+				UInt64 totalCount = 0;
+
+				for (ULONG workerId = 0; workerId < workersCount; workerId++)
+				{
+					auto histogram = &statisticsRegion->GetWorkerCounters(workerId)->latencies[stageIndex];
+
+					for (auto bucketIndex = 0; bucketIndex < LATENCY_BUCKETS_COUNT; bucketIndex++)
+					{
+						auto count = histogram->buckets[bucketIndex];
+
+						merged[bucketIndex] += count;
+
+						totalCount += count;
+					}
+				}
+
+				if (totalCount == 0)
+				{
+					return TimeSpan::Zero;
+				}
+
+				// get rank of the value at the percentile
+				auto rank = (UInt64) Math::Ceiling(totalCount * percentile / 100);
+
+				if (rank == 0)
+				{
+					rank = 1;
+				}
+
+				// find the bucket that holds the value
+				UInt64 cumulativeCount = 0;
+
+				auto bucketIndex = 0;
+
+				for (; bucketIndex < LATENCY_BUCKETS_COUNT - 1; bucketIndex++)
+				{
+					cumulativeCount += merged[bucketIndex];
+
+					if (cumulativeCount >= rank)
+					{
+						break;
+					}
+				}
+
+				// convert timestamp units into the ticks of the time span
+				auto value = (Double) LatencyHistogram::GetBucketValue(bucketIndex);
+
+				return TimeSpan((Int64) (value * TimeSpan::TicksPerSecond / statisticsRegion->GetTimestampFrequency()));
+			}
+
+			/// <summary>
+			/// Saves the trace rings of the workers into the file.
+			/// </summary>
+			/// <param name="filePath">The path of the file.</param>
+			/// <remarks>
+			/// The file can be decoded by the <c>TcpServerTrace</c> tool.
+			/// </remarks>
+			void DumpTrace(String^ filePath)
+			{
+				if (filePath == nullptr)
+				{
+					throw gcnew ArgumentNullException("filePath");
+				}
+
+				pin_ptr<const wchar_t> filePathChars = PtrToStringChars(filePath);
+
+				DWORD kernelErrorCode;
+
+				// check if operation has failed
+				if (!traceRegion->Save(filePathChars, kernelErrorCode))
+				{
+					// throw exception
+					throw gcnew TcpServerException((int)kernelErrorCode);
+				}
+			}
+
+			/// <summary>
+			/// Registers the read-only payload which can be sent by any connection, see <see cref="Connection::SendPayloadAsync" />.
+			/// </summary>
+			/// <param name="data">The data of the payload, is copied once into the registered memory.</param>
+			/// <returns>The index of the payload.</returns>
+			/// <exception cref="InvalidOperationException">The count of the payloads has reached the <see cref="TcpWorkerSettings::MaxSharedPayloads" />.</exception>
+			UInt32 RegisterPayload(array<Byte>^ data)
+			{
+				auto payload = CreatePayload(data);
+
+				auto payloadIndex = payloadRegistry->Add(payload);
+
+				if (payloadIndex == ULONG_MAX)
+				{
+					payload->Release();
+
+					throw gcnew InvalidOperationException();
+				}
+
+				return payloadIndex;
+			}
+
+			/// <summary>
+			/// Replaces the data of the registered payload.
+			/// </summary>
+			/// <param name="payloadIndex">The index of the payload.</param>
+			/// <param name="data">The new data of the payload.</param>
+			/// <remarks>
+			/// The sends in progress complete with the old data, which is released after the last of them.
+			/// </remarks>
+			void ReplacePayload(UInt32 payloadIndex, array<Byte>^ data)
+			{
+				auto payload = CreatePayload(data);
+
+				if (!payloadRegistry->Replace(payloadIndex, payload))
+				{
+					payload->Release();
+
+					throw gcnew ArgumentOutOfRangeException("payloadIndex");
+				}
+			}
+
+			/// <summary>
+			/// Sends the data to each of the connections.
+			/// </summary>
+			/// <param name="data">The data, is copied once into the registered memory shared by all sends.</param>
+			/// <param name="connections">The connections to send the data to, each to the client it serves at the time of the call.</param>
+			/// <remarks>
+			/// The connections are grouped by the worker that owns them, and each worker posts the sends on its own thread beside the operations of the connections,
+			/// the posts to the request queue of each connection are serialized by its lock.
+			/// The send to the connection which is not connected, or whose slot has accepted the next client by the time the send is posted, is skipped.
+			/// The send to the connection which has too many broadcast sends in progress, or beyond the broadcast sends of the worker, is dropped and counted by the statistics.
+			/// The memory is released after the last send is completed.
+			/// </remarks>
+			void Broadcast(array<Byte>^ data, IEnumerable<Connection^>^ connections)
+			{
+				if (connections == nullptr)
+				{
+					throw gcnew ArgumentNullException("connections");
+				}
+
+				// group the connections by the worker
+				auto batches = gcnew Dictionary<IocpWorker^, List<KeyValuePair<UInt32, UInt16>>^>();
+
+				for each (Connection^ connection in connections)
+				{
+					if (connection == nullptr)
+					{
+						throw gcnew ArgumentNullException("connections");
+					}
+
+					AddBroadcastTarget(batches, connection, connection->Generation);
+				}
+
+				PostBroadcast(data, batches);
+			}
+
+			/// <summary>
+			/// Sends the data to each of the subscribed clients.
+			/// </summary>
+			/// <param name="data">The data, is copied once into the registered memory shared by all sends.</param>
+			/// <param name="subscribers">The connections to send the data to, each with its <see cref="Connection::Generation" /> read when the client subscribed.</param>
+			/// <remarks>
+			/// The client which has disconnected since it subscribed is skipped, even if the slot of its connection serves the next client,
+			/// otherwise the sends are posted as by the <see cref="Broadcast(array{Byte}, IEnumerable{Connection})" />.
+			/// </remarks>
+			void Broadcast(array<Byte>^ data, IEnumerable<KeyValuePair<Connection^, UInt16>>^ subscribers)
+			{
+				if (subscribers == nullptr)
+				{
+					throw gcnew ArgumentNullException("subscribers");
+				}
+
+				// group the connections by the worker
+				auto batches = gcnew Dictionary<IocpWorker^, List<KeyValuePair<UInt32, UInt16>>^>();
+
+				for each (KeyValuePair<Connection^, UInt16> subscriber in subscribers)
+				{
+					if (subscriber.Key == nullptr)
+					{
+						throw gcnew ArgumentNullException("subscribers");
+					}
+
+					AddBroadcastTarget(batches, subscriber.Key, subscriber.Value);
+				}
+
+				PostBroadcast(data, batches);
+			}
+
 			private:
 
-			static Boolean Configure(SOCKET listenSocket, TcpWorkerSettings^ settings)
+			/// <summary>
+			/// Adds the connection to the batch of the worker that owns it.
+			/// </summary>
+			/// <param name="batches">The identifiers of the connections with the generations of their slots, grouped by the worker.</param>
+			/// <param name="connection">The connection.</param>
+			/// <param name="generation">The generation of the slot of the client the data is meant for.</param>
+			static void AddBroadcastTarget(Dictionary<IocpWorker^, List<KeyValuePair<UInt32, UInt16>>^>^ batches, Connection^ connection, UInt16 generation)
+			{
+				List<KeyValuePair<UInt32, UInt16>>^ targets;
+
+				if (!batches->TryGetValue(connection->worker, targets))
+				{
+					targets = gcnew List<KeyValuePair<UInt32, UInt16>>();
+
+					batches->Add(connection->worker, targets);
+				}
+
+				targets->Add(KeyValuePair<UInt32, UInt16>(connection->Id, generation));
+			}
+
+			/// <summary>
+			/// Copies the data into the shared payload and hands it over to each worker with its batch.
+			/// </summary>
+			void PostBroadcast(array<Byte>^ data, Dictionary<IocpWorker^, List<KeyValuePair<UInt32, UInt16>>^>^ batches)
+			{
+				auto payload = CreatePayload(data);
+
+				try
+				{
+					for each (KeyValuePair<IocpWorker^, List<KeyValuePair<UInt32, UInt16>>^> batch in batches)
+					{
+						batch.Key->Broadcast(payload, batch.Value);
+					}
+				}
+				finally
+				{
+					// each batch holds its own reference
+					payload->Release();
+				}
+			}
+
+			/// <summary>
+			/// Copies the data into the new shared payload.
+			/// </summary>
+			SharedPayload* CreatePayload(array<Byte>^ data)
+			{
+				if (data == nullptr)
+				{
+					throw gcnew ArgumentNullException("data");
+				}
+
+				if (data->Length == 0)
+				{
+					throw gcnew ArgumentOutOfRangeException("data");
+				}
+
+				pin_ptr<Byte> pinnedData = &data[0];
+
+				DWORD kernelErrorCode;
+
+				int winsockErrorCode;
+
+				auto payload = SharedPayload::Create(*pWinsock, pinnedData, data->Length, kernelErrorCode, winsockErrorCode);
+
+				// check if operation has failed
+				if (payload == nullptr)
+				{
+					// throw exception
+					throw gcnew TcpServerException((WinsockErrorCode)winsockErrorCode, (int)kernelErrorCode);
+				}
+
+				return payload;
+			}
+
+			static Boolean Configure(SOCKET listenSocket, Boolean useNagleAlgorithm, TcpListenerSettings^ settings)
 			{
 				// disable use of the Nagle algorithm if requested
-				if (settings->UseNagleAlgorithm == false)
+				if (useNagleAlgorithm == false)
 				{
 					auto boolValue = (BOOL) TRUE;
 
@@ -239,10 +869,64 @@ namespace SXN
 					}
 				}
 
+				// accept the IPv4 connections on the IPv6 socket if requested
+				if (settings->AcceptPoint->AddressFamily == System::Net::Sockets::AddressFamily::InterNetworkV6)
+				{
+					DWORD v6Only = settings->DualMode ? 0 : 1;
+
+					auto setV6OnlyResult = ::setsockopt(listenSocket, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&v6Only, sizeof(DWORD));
+
+					// check if operation has failed
+					if (setV6OnlyResult == SOCKET_ERROR)
+					{
+						return false;
+					}
+				}
+
 				return true;
 			}
 
-			static Boolean StartListen(SOCKET listenSocket, TcpWorkerSettings^ settings)
+			/// <summary>
+			/// Composes the socket address of the endpoint.
+			/// </summary>
+			/// <param name="endPoint">The endpoint.</param>
+			/// <param name="address">The address to compose.</param>
+			/// <returns>The length, in bytes, of the address.</returns>
+			static int ComposeAddress(IPEndPoint^ endPoint, SOCKADDR_INET& address)
+			{
+				// reset memory
+				memset(&address, 0, sizeof(SOCKADDR_INET));
+
+				// get address as bytes
+				auto addressBytes = endPoint->Address->GetAddressBytes();
+
+				if (endPoint->AddressFamily == System::Net::Sockets::AddressFamily::InterNetwork)
+				{
+					address.Ipv4.sin_family = AF_INET;
+
+					address.Ipv4.sin_port = ::htons(endPoint->Port);
+
+					address.Ipv4.sin_addr.S_un.S_un_b.s_b1 = addressBytes[0];
+					address.Ipv4.sin_addr.S_un.S_un_b.s_b2 = addressBytes[1];
+					address.Ipv4.sin_addr.S_un.S_un_b.s_b3 = addressBytes[2];
+					address.Ipv4.sin_addr.S_un.S_un_b.s_b4 = addressBytes[3];
+
+					return sizeof(SOCKADDR_IN);
+				}
+
+				address.Ipv6.sin6_family = AF_INET6;
+
+				address.Ipv6.sin6_port = ::htons(endPoint->Port);
+
+				for (auto index = 0; index < 16; index++)
+				{
+					address.Ipv6.sin6_addr.u.Byte[index] = addressBytes[index];
+				}
+
+				return sizeof(SOCKADDR_IN6);
+			}
+
+			static Boolean StartListen(SOCKET listenSocket, TcpListenerSettings^ settings)
 			{
 				// bind
 				{
@@ -371,15 +1055,11 @@ namespace SXN
 						// get identifier of the connection
 						auto connectionId = overlapped->connectionId;
 
-						// get connection
-						auto connection = worker->managedConnections[connectionId];
-
 						//Console::WriteLine("Accepted {0}", overlapped->connectionSocket);
 
-						// queue connection to processing chain
-						auto waitCallback = gcnew WaitCallback(this, &TcpWorker::Serve);
-
-						ThreadPool::UnsafeQueueUserWorkItem(waitCallback, (Object ^)connection);
+						// the connection refused due to the exceeded limits is returned to accept,
+						// the admitted one is handed over to the worker thread, which rents its segments and queues it to processing chain or forwards it
+						worker->TryAdmit(connectionId);
 					}
 				}
 
@@ -391,11 +1071,9 @@ namespace SXN
 			{
 				auto connection = (Connection ^) state;
 
-				connection->connection->EndAccepet();
-
 				// #pragma warning disable CS4014 // Because this call is not awaited, execution of the current method continues before the call is completed
 
-				serveSocket(connection);
+				handlers[connection->ListenerIndex](connection);
 
 				//#pragma warning restore CS4014
 			}
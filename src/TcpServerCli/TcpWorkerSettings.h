@@ -1,10 +1,15 @@
 ﻿#pragma once
 
 #include "Stdafx.h"
+#include "TraceFormat.h"
+#include "FrameCodecSettings.h"
+#include "TcpListenerSettings.h"
+#include "TcpUpstreamSettings.h"
 
 using namespace System;
 using namespace System::Net;
 using namespace System::Net::Sockets;
+using namespace System::Collections::Generic;
 
 namespace SXN
 {
@@ -21,12 +26,38 @@ namespace SXN
 
 			static initonly Int32 processorsCount;
 
+			static initonly Int32 availableProcessorsCount;
+
+			static initonly UInt64 processAffinityMask;
+
 			static initonly UInt32 allocationGranularity;
 
 			Int32 useProcessorsCount;
 
+			UInt32 acceptQueueMaxEntriesCount;
+
 			IPEndPoint^ acceptPoint;
 
+			array<Byte>^ busyResponse;
+
+			UInt32 traceEventsCount;
+
+			List<TcpListenerSettings^>^ listeners;
+
+			List<TcpUpstreamSettings^>^ upstreams;
+
+			List<String^>^ responseTemplates;
+
+			List<String^>^ routes;
+
+			UInt32 maxSharedPayloads;
+
+			UInt32 keepAliveTimeout;
+
+			UInt32 maxKeepAliveRequests;
+
+			UInt32 maxStreamSends;
+
 			#pragma endregion
 
 			public:
@@ -35,6 +66,11 @@ namespace SXN
 
 			const Int32 MaxConnections = SOMAXCONN;
 
+			/// <summary>
+			/// The upper limit of the <see cref="MaxStreamSends" />, the request queue of the connection keeps 40 sends: the one of the response, the broadcast ones and the ones of the stream.
+			/// </summary>
+			const UInt32 StreamSendsLimit = 16;
+
 			#pragma endregion
 
 			static TcpWorkerSettings()
@@ -47,6 +83,158 @@ namespace SXN
 				processorsCount = sysinfo.dwNumberOfProcessors;
 
 				allocationGranularity = sysinfo.dwAllocationGranularity;
+
+				// get processors the process is allowed to run on
+				DWORD_PTR processMask;
+
+				DWORD_PTR systemMask;
+
+				if (::GetProcessAffinityMask(::GetCurrentProcess(), &processMask, &systemMask) && (processMask != 0))
+				{
+					processAffinityMask = processMask;
+
+					availableProcessorsCount = CountProcessors(processMask);
+				}
+				else
+				{
+					availableProcessorsCount = processorsCount;
+				}
+
+				// limit by the CPU rate of the job, which is how the container limits the processor time
+				auto rateProcessorsCount = GetJobRateProcessorsCount(processorsCount);
+
+				if ((rateProcessorsCount != 0) && (rateProcessorsCount < availableProcessorsCount))
+				{
+					availableProcessorsCount = rateProcessorsCount;
+				}
+			}
+
+			private:
+
+			/// <summary>
+			/// Counts the processors within the mask.
+			/// </summary>
+			static Int32 CountProcessors(UInt64 mask)
+			{
+				Int32 result = 0;
+
+				for (; mask != 0; mask &= mask - 1)
+				{
+					result++;
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Gets the number of processors which time is granted to the job of the process by the hard cap of its CPU rate.
+			/// </summary>
+			/// <param name="processorsCount">The number of processors on the current machine.</param>
+			/// <returns>The number of processors, ceiled, or zero if the rate is not limited.</returns>
+			static Int32 GetJobRateProcessorsCount(Int32 processorsCount)
+			{
+				JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rateInformation;
+
+				memset(&rateInformation, 0, sizeof(JOBOBJECT_CPU_RATE_CONTROL_INFORMATION));
+
+				// the process which is not within the job has no limits
+				if (!::QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &rateInformation, sizeof(JOBOBJECT_CPU_RATE_CONTROL_INFORMATION), nullptr))
+				{
+					return 0;
+				}
+
+				auto flags = rateInformation.ControlFlags;
+
+				// the weight based rate does not limit the processor time when machine is idle
+				if (((flags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) == 0) || ((flags & JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED) != 0))
+				{
+					return 0;
+				}
+
+				// the rate is specified in hundredths of percent of the time of all processors
+				UInt64 rate;
+
+				if ((flags & JOB_OBJECT_CPU_RATE_CONTROL_MIN_MAX_RATE) != 0)
+				{
+					rate = rateInformation.MaxRate;
+				}
+				else if ((flags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP) != 0)
+				{
+					rate = rateInformation.CpuRate;
+				}
+				else
+				{
+					return 0;
+				}
+
+				if (rate == 0)
+				{
+					return 0;
+				}
+
+				auto result = (Int32) ((rate * processorsCount + 9999) / 10000);
+
+				return result < 1 ? 1 : result;
+			}
+
+			internal:
+
+			/// <summary>
+			/// Gets the mask of the processor to bind the worker to.
+			/// </summary>
+			/// <param name="workerIndex">The index of the worker.</param>
+			/// <returns>The mask of the single processor from the affinity mask of the process, or zero if the mask is unknown.</returns>
+			static UInt64 GetWorkerProcessorMask(Int32 workerIndex)
+			{
+				auto count = CountProcessors(processAffinityMask);
+
+				if (count == 0)
+				{
+					return 0;
+				}
+
+				auto index = workerIndex % count;
+
+				for (auto mask = processAffinityMask; mask != 0; mask &= mask - 1)
+				{
+					if (index-- == 0)
+					{
+						// isolate the lowest bit
+						return mask & (~mask + 1);
+					}
+				}
+
+				return 0;
+			}
+
+			public:
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="TcpWorkerSettings" /> class.
+			/// </summary>
+			TcpWorkerSettings()
+			{
+				busyResponse = System::Text::Encoding::ASCII->GetBytes("HTTP/1.1 503 Service Unavailable\r\nServer:SXN.Ion\r\nContent-Length:0\r\nConnection:close\r\n\r\n");
+
+				traceEventsCount = TRACE_DEFAULT_EVENTS_COUNT;
+
+				acceptQueueMaxEntriesCount = 256;
+
+				maxSharedPayloads = 256;
+
+				keepAliveTimeout = 15000;
+
+				maxStreamSends = 4;
+
+				listeners = gcnew List<TcpListenerSettings^>();
+
+				upstreams = gcnew List<TcpUpstreamSettings^>();
+
+				responseTemplates = gcnew List<String^>();
+
+				responseTemplates->Add("HTTP/1.1 200 OK\r\nServer:SXN.Ion\r\nContent-Length:0\r\n\r\n");
+
+				routes = gcnew List<String^>();
 			}
 
 
@@ -63,6 +251,35 @@ namespace SXN
 				}
 			}
 
+			/// <summary>
+			/// The number of processors the process can actually use.
+			/// </summary>
+			/// <remarks>
+			/// Is the number of processors within the affinity mask of the process,
+			/// limited by the hard cap of the CPU rate of the job the process runs within, as the container limits it.
+			/// </remarks>
+			static property Int32 AvailableProcessorsCount
+			{
+				Int32 get()
+				{
+					return availableProcessorsCount;
+				}
+			}
+
+			/// <summary>
+			/// The number of the workers to run.
+			/// </summary>
+			/// <remarks>
+			/// Is the <see cref="UseProcessorsCount" /> if it is specified; otherwise, the <see cref="AvailableProcessorsCount" />.
+			/// </remarks>
+			property Int32 WorkersCount
+			{
+				Int32 get()
+				{
+					return useProcessorsCount != 0 ? useProcessorsCount : availableProcessorsCount;
+				}
+			}
+
 			/// <summary>
 			/// The length in bytes of the memory buffer for receive operations.
 			/// </summary>
@@ -77,6 +294,9 @@ namespace SXN
 			/// </summary>
 			/// <remarks>
 			/// Value will be ceiled.
+			/// The served connection starts receiving into the 512 bytes segment, which is replaced by the larger one when the request fills it,
+			/// the larger segments of the worker share the memory the connections would take with the buffers of this length.
+			/// The forwarded and the upstream connections, and the rings, take the buffer of this length.
 			/// </remarks>
 			property Int32 ReceiveBufferLength;
 
@@ -106,10 +326,11 @@ namespace SXN
 			property Boolean UseFastLoopback;
 
 			/// <summary>
-			/// The number of processors to use.
+			/// The number of processors to use, one worker runs per processor.
 			/// </summary>
 			/// <remarks>
-			/// If value is not specified or is zero or is greater than actual number of processors, then all available processors will be used.
+			/// If value is zero, the <see cref="AvailableProcessorsCount" /> is used.
+			/// Value can not be greater than the number of processors on the current machine.
 			/// </remarks>
 			property Int32 UseProcessorsCount
 			{
@@ -120,10 +341,93 @@ namespace SXN
 
 				void set(Int32 value)
 				{
-					if ((value < 1) || (value > processorsCount))
+					if ((value < 0) || (value > processorsCount))
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					useProcessorsCount = value;
+				}
+			}
+
+			/// <summary>
+			/// Determines whether each worker thread is bound to its own processor.
+			/// </summary>
+			/// <remarks>
+			/// The processors are taken in order from the affinity mask of the process, the workers above their count share them round robin.
+			/// </remarks>
+			property Boolean UseThreadAffinity;
+
+			/// <summary>
+			/// Determines whether each connection receives into its own ring, whose pages are mapped twice back to back, instead of the segment of the pool.
+			/// </summary>
+			/// <remarks>
+			/// The request split by the end of the ring is still contiguous, so the pipelined requests are parsed in place without being moved to the start of the buffer.
+			/// The length of the ring is the <see cref="ReceiveBufferLength" /> rounded up to 64 KB, each ring takes its own section and the address space of twice its length.
+			/// </remarks>
+			property Boolean UseReceiveRings;
+
+			/// <summary>
+			/// The time, in milliseconds, the connection which has served a request waits for the next one, see <see cref="Connection::ReceiveRequestsAsync" />.
+			/// </summary>
+			/// <remarks>
+			/// The receive of the connection which waits longer is completed with zero bytes, so the handler disconnects it as closed by the client.
+			/// The timeout is checked once per second.
+			/// If value is zero, the connections wait without limit.
+			/// </remarks>
+			property UInt32 KeepAliveTimeout
+			{
+				UInt32 get()
+				{
+					return keepAliveTimeout;
+				}
+
+				void set(UInt32 value)
+				{
+					keepAliveTimeout = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum count of the requests served by the single connection, see <see cref="Connection::KeepAlive" />.
+			/// </summary>
+			/// <remarks>
+			/// If value is zero, the count is not limited.
+			/// </remarks>
+			property UInt32 MaxKeepAliveRequests
+			{
+				UInt32 get()
+				{
+					return maxKeepAliveRequests;
+				}
+
+				void set(UInt32 value)
+				{
+					maxKeepAliveRequests = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum count of the sends of the streamed response in progress per connection, see <see cref="Connection::WriteChunkAsync" />.
+			/// </summary>
+			/// <remarks>
+			/// The send buffer is split into as many slices, the handler which has filled all of them waits until the first send completes.
+			/// </remarks>
+			property UInt32 MaxStreamSends
+			{
+				UInt32 get()
+				{
+					return maxStreamSends;
+				}
+
+				void set(UInt32 value)
+				{
+					if ((value == 0) || (value > StreamSendsLimit))
 					{
 						throw gcnew ArgumentOutOfRangeException("value");
 					}
+
+					maxStreamSends = value;
 				}
 			}
 
@@ -138,7 +442,7 @@ namespace SXN
 			{
 				UInt32 get()
 				{
-					return useProcessorsCount;
+					return acceptQueueMaxEntriesCount;
 				}
 
 				void set(UInt32 value)
@@ -147,6 +451,8 @@ namespace SXN
 					{
 						throw gcnew ArgumentOutOfRangeException("value");
 					}
+
+					acceptQueueMaxEntriesCount = value;
 				}
 			}
 
@@ -183,6 +489,203 @@ namespace SXN
 				}
 			}
 
+			/// <summary>
+			/// The collection of the endpoints on which to listen the incoming connections, all of them are served by the same workers.
+			/// </summary>
+			/// <remarks>
+			/// If collection is empty, the single endpoint is composed of the <see cref="AcceptPoint" />, the <see cref="ConnectionsBacklogLength" /> and the <see cref="UseFastLoopback" />.
+			/// </remarks>
+			property List<TcpListenerSettings^>^ Listeners
+			{
+				List<TcpListenerSettings^>^ get()
+				{
+					return listeners;
+				}
+			}
+
+			/// <summary>
+			/// The collection of the endpoints to which the handlers can connect, see <see cref="Connection::ConnectAsync" />.
+			/// </summary>
+			/// <remarks>
+			/// Each worker keeps its own pool of the connections to each endpoint, which use the registered buffers and the completion queue of the worker.
+			/// </remarks>
+			property List<TcpUpstreamSettings^>^ Upstreams
+			{
+				List<TcpUpstreamSettings^>^ get()
+				{
+					return upstreams;
+				}
+			}
+
+			/// <summary>
+			/// The collection of the responses pre-rendered into the registered memory shared by all workers, see <see cref="Connection::SendAsync" />.
+			/// </summary>
+			/// <remarks>
+			/// The template is the status line and the headers, the server adds the Date header which is refreshed once per second.
+			/// If the template ends with the empty line, the Date header is inserted before it and the template is the complete response; otherwise, it is appended
+			/// and the rest of the headers and the body are sent from the send buffer of the connection.
+			/// By default contains the single empty HTTP 200 response, which is sent by <see cref="Connection::SendAsync()" />.
+			/// </remarks>
+			property List<String^>^ ResponseTemplates
+			{
+				List<String^>^ get()
+				{
+					return responseTemplates;
+				}
+			}
+
+			/// <summary>
+			/// The collection of the routes matched by the <see cref="Connection::RouteRequest" />, the index of the route is the result of the match.
+			/// </summary>
+			/// <remarks>
+			/// The route is the method and the path separated by the single space, such as <c>GET /users/{id}</c>,
+			/// where the segment enclosed in braces is the parameter read by the <see cref="Connection::GetRouteParameter" />.
+			/// The routes are compiled into the perfect hash once, when the worker starts. Is empty by default.
+			/// </remarks>
+			property List<String^>^ Routes
+			{
+				List<String^>^ get()
+				{
+					return routes;
+				}
+			}
+
+			/// <summary>
+			/// The layout of the frames of the length-prefixed binary protocol read by the <see cref="Connection::ReadFrame" /> and written by the <see cref="Connection::AppendFrame" />.
+			/// </summary>
+			/// <remarks>
+			/// If value is <c>null</c>, the connections serve HTTP only. Is <c>null</c> by default.
+			/// </remarks>
+			property FrameCodecSettings^ Framing;
+
+			/// <summary>
+			/// The maximum count of the payloads registered by the <see cref="TcpWorker::RegisterPayload" />.
+			/// </summary>
+			property UInt32 MaxSharedPayloads
+			{
+				UInt32 get()
+				{
+					return maxSharedPayloads;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					maxSharedPayloads = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum number of the connections served at once.
+			/// </summary>
+			/// <remarks>
+			/// Connections accepted above the limit are sent the <see cref="BusyResponse" /> and closed.
+			/// Value is split evenly between the workers.
+			/// If value is zero, the limit is not checked.
+			/// </remarks>
+			property UInt32 MaxActiveConnections;
+
+			/// <summary>
+			/// The number of the connections of each worker reserved to accept and refuse the connections above the limits.
+			/// </summary>
+			/// <remarks>
+			/// Without the reserve, when all connections are served, new clients wait in the backlog of the listening socket until timeout.
+			/// </remarks>
+			property UInt32 RefuseConnectionsCount;
+
+			/// <summary>
+			/// The minimum number of the connections the free buffer segments of the worker are enough for, required to admit a connection.
+			/// </summary>
+			/// <remarks>
+			/// The admitted connection rents its send segment and the smallest receive segment and returns them on disconnect, the segments are counted as they are rented.
+			/// If value is zero, the limit is not checked.
+			/// </remarks>
+			property UInt32 MinAvailableBuffers;
+
+			/// <summary>
+			/// The maximum number of the completions dequeued by the worker at once, above which the worker refuses new connections.
+			/// </summary>
+			/// <remarks>
+			/// If value is zero, the limit is not checked.
+			/// </remarks>
+			property UInt32 MaxCompletionQueueDepth;
+
+			/// <summary>
+			/// The path of the file onto which the statistics of the workers are mapped.
+			/// </summary>
+			/// <remarks>
+			/// The file can be read by external processes while server is running, the layout is described by the <c>StatisticsRegion.h</c>.
+			/// If value is <c>null</c>, the statistics are kept in the private memory of the process.
+			/// </remarks>
+			property String^ StatisticsFilePath;
+
+			/// <summary>
+			/// The path of the file onto which the trace rings of the workers are mapped.
+			/// </summary>
+			/// <remarks>
+			/// The file keeps the latest events after the crash of the process, the layout is described by the <c>TraceFormat.h</c>.
+			/// If value is <c>null</c>, the rings are kept in the private memory of the process and can be saved by the <see cref="TcpWorker::DumpTrace" />.
+			/// </remarks>
+			property String^ TraceFilePath;
+
+			/// <summary>
+			/// The count of the events within the trace ring of the single worker.
+			/// </summary>
+			/// <remarks>
+			/// Must be a power of two.
+			/// </remarks>
+			property UInt32 TraceEventsCount
+			{
+				UInt32 get()
+				{
+					return traceEventsCount;
+				}
+
+				void set(UInt32 value)
+				{
+					if ((value == 0) || ((value & (value - 1)) != 0))
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					traceEventsCount = value;
+				}
+			}
+
+			/// <summary>
+			/// The response sent to the connections refused due to the exceeded limits.
+			/// </summary>
+			/// <remarks>
+			/// Is registered once and shared by all workers.
+			/// By default is the HTTP 503 response.
+			/// </remarks>
+			property array<Byte>^ BusyResponse
+			{
+				array<Byte>^ get()
+				{
+					return busyResponse;
+				}
+
+				void set(array<Byte>^ value)
+				{
+					if (value == nullptr)
+					{
+						throw gcnew ArgumentNullException("value");
+					}
+
+					if (value->Length == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					busyResponse = value;
+				}
+			}
+
 			#pragma endregion
 
 
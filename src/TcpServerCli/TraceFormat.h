@@ -0,0 +1,172 @@
+#pragma once
+
+// The layout of the trace file is shared with the offline decoder, which is built without the server,
+// so this header depends on the standard headers only.
+
+#include <stdint.h>
+
+/// <summary>
+/// The signature of the trace file, the ASCII string "SXNT".
+/// </summary>
+#define TRACE_SIGNATURE 0x544E5853
+
+/// <summary>
+/// The version of the layout of the trace file.
+/// </summary>
+#define TRACE_VERSION 1
+
+/// <summary>
+/// The default count of the events within the ring of the single worker.
+/// </summary>
+#define TRACE_DEFAULT_EVENTS_COUNT 65536
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Contains the header of the trace file.
+		/// </summary>
+		/// <remarks>
+		/// The file consists of the header followed by the <see cref="TraceRingHeader" /> and <c>eventsCount</c> items of the <see cref="TraceEvent" /> of each worker.
+		/// </remarks>
+		struct TraceHeader
+		{
+			/// <summary>
+			/// The signature of the file, equals <c>TRACE_SIGNATURE</c>.
+			/// </summary>
+			uint32_t signature;
+
+			/// <summary>
+			/// The version of the layout of the file, equals <c>TRACE_VERSION</c>.
+			/// </summary>
+			uint32_t version;
+
+			/// <summary>
+			/// The length of the <see cref="TraceHeader" /> structure.
+			/// </summary>
+			uint32_t headerLength;
+
+			/// <summary>
+			/// The length of the <see cref="TraceEvent" /> structure.
+			/// </summary>
+			uint32_t eventLength;
+
+			/// <summary>
+			/// The count of the workers.
+			/// </summary>
+			uint32_t workersCount;
+
+			/// <summary>
+			/// The count of the events within the ring of the single worker, a power of two.
+			/// </summary>
+			uint32_t eventsCount;
+
+			/// <summary>
+			/// The identifier of the process that writes the file.
+			/// </summary>
+			uint32_t processId;
+
+			/// <summary>
+			/// Reserved.
+			/// </summary>
+			uint32_t reserved;
+
+			/// <summary>
+			/// The time, in the FILETIME format, when the trace was started.
+			/// </summary>
+			uint64_t startTime;
+
+			/// <summary>
+			/// The value of the time stamp counter when the trace was started.
+			/// </summary>
+			uint64_t startTimestamp;
+
+			/// <summary>
+			/// The frequency, in counts per second, of the time stamp counter.
+			/// </summary>
+			uint64_t timestampFrequency;
+
+			/// <summary>
+			/// Pads the structure to the length of the cache line.
+			/// </summary>
+			uint8_t padding[8];
+		};
+
+		/// <summary>
+		/// Contains the header of the ring of the single worker.
+		/// </summary>
+		struct TraceRingHeader
+		{
+			/// <summary>
+			/// The index of the next event to write; the event <c>n</c> is stored at <c>n % eventsCount</c>.
+			/// </summary>
+			volatile int64_t nextIndex;
+
+			/// <summary>
+			/// Pads the structure to the length of the cache line.
+			/// </summary>
+			uint8_t padding[56];
+		};
+
+		/// <summary>
+		/// Contains the single event of the trace.
+		/// </summary>
+		struct TraceEvent
+		{
+			/// <summary>
+			/// The value of the time stamp counter when the event has occurred.
+			/// </summary>
+			uint64_t timestamp;
+
+			/// <summary>
+			/// The identifier of the slot of the connection within the worker.
+			/// </summary>
+			uint32_t slot;
+
+			/// <summary>
+			/// The number of the connection accepted by the slot.
+			/// </summary>
+			uint16_t generation;
+
+			/// <summary>
+			/// The state of the connection before the event.
+			/// </summary>
+			uint8_t fromState;
+
+			/// <summary>
+			/// The state of the connection after the event.
+			/// </summary>
+			uint8_t toState;
+
+			/// <summary>
+			/// The number of bytes transferred.
+			/// </summary>
+			uint32_t bytes;
+
+			/// <summary>
+			/// The error code of the operation, or zero on success.
+			/// </summary>
+			uint32_t error;
+
+			/// <summary>
+			/// Reserved.
+			/// </summary>
+			uint32_t reserved;
+
+			/// <summary>
+			/// The index of the event plus one, truncated to 32 bits.
+			/// </summary>
+			/// <remarks>
+			/// Is written last, the event which sequence does not match its position is torn or overwritten.
+			/// </remarks>
+			volatile uint32_t sequence;
+		};
+
+		static_assert(sizeof(TraceHeader) == 64, "TraceHeader must occupy exactly one cache line.");
+
+		static_assert(sizeof(TraceRingHeader) == 64, "TraceRingHeader must occupy exactly one cache line.");
+
+		static_assert(sizeof(TraceEvent) == 32, "TraceEvent must occupy exactly half of the cache line.");
+	}
+}
@@ -0,0 +1,414 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "TraceFormat.h"
+#include "TcpConnection.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Provides recording of the transitions of the states of the connections of the single worker into the fixed size ring.
+		/// </summary>
+		/// <remarks>
+		/// The ring is written by the worker, accept and handler threads, each of which takes the index of the event by the interlocked increment.
+		/// The oldest events are overwritten, so the ring always contains the latest <c>eventsCount</c> events.
+		/// </remarks>
+		private class TraceRing final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A pointer to the header of the ring.
+			/// </summary>
+			TraceRingHeader* header;
+
+			/// <summary>
+			/// The collection of the events.
+			/// </summary>
+			TraceEvent* events;
+
+			/// <summary>
+			/// The mask which is applied to the index of the event to get the position within the ring.
+			/// </summary>
+			ULONG mask;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="TraceRing" /> class.
+			/// </summary>
+			/// <param name="header">A pointer to the header of the ring, which is followed by the events.</param>
+			/// <param name="eventsCount">The count of the events within the ring, a power of two.</param>
+			inline TraceRing(TraceRingHeader* header, ULONG eventsCount)
+			{
+				this->header = header;
+
+				this->events = (TraceEvent*) (header + 1);
+
+				this->mask = eventsCount - 1;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the error code of the operation to record.
+			/// </summary>
+			/// <param name="result">The result of the operation.</param>
+			/// <returns>Zero if operation has succeed or is pending; otherwise, the error code of the Winsock.</returns>
+			inline static ULONG GetError(BOOL result)
+			{
+				if (result)
+				{
+					return 0;
+				}
+
+				auto winsockErrorCode = ::WSAGetLastError();
+
+				return winsockErrorCode == WSA_IO_PENDING ? 0 : winsockErrorCode;
+			}
+
+			/// <summary>
+			/// Records the transition of the state of the connection.
+			/// </summary>
+			/// <param name="connection">A pointer to the connection which state is already changed.</param>
+			/// <param name="fromState">The state of the connection before the transition.</param>
+			/// <param name="bytes">The number of bytes transferred.</param>
+			/// <param name="error">The error code of the operation, or zero on success.</param>
+			inline void Record(TcpConnection* connection, ConnectionState fromState, ULONG bytes, ULONG error)
+			{
+				// take the index of the event
+				auto index = ::InterlockedIncrement64(&header->nextIndex) - 1;
+
+				auto traceEvent = events + (index & mask);
+
+				LARGE_INTEGER timestamp;
+
+				::QueryPerformanceCounter(&timestamp);
+
+				traceEvent->timestamp = timestamp.QuadPart;
+
+				traceEvent->slot = connection->id;
+
+				traceEvent->generation = connection->generation;
+
+				traceEvent->fromState = (uint8_t) fromState;
+
+				traceEvent->toState = (uint8_t) connection->state;
+
+				traceEvent->bytes = bytes;
+
+				traceEvent->error = error;
+
+				// sequence is written last, so the decoder can detect the event which is torn or overwritten
+				::MemoryBarrier();
+
+				traceEvent->sequence = (uint32_t) (index + 1);
+			}
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Provides the memory region which contains the trace rings of the workers.
+		/// </summary>
+		/// <remarks>
+		/// If the path of the file is specified, the region is mapped onto the file and survives the crash of the process.
+		/// Otherwise the region is allocated in the private memory of the process and can be saved on request.
+		/// The layout of the region is described by the <c>TraceFormat.h</c>.
+		/// </remarks>
+		private class TraceRegion final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The handle of the file, or <c>INVALID_HANDLE_VALUE</c> if the region is not mapped onto the file.
+			/// </summary>
+			HANDLE fileHandle;
+
+			/// <summary>
+			/// The handle of the file mapping, or <c>null</c> if the region is not mapped onto the file.
+			/// </summary>
+			HANDLE mappingHandle;
+
+			/// <summary>
+			/// The length of the region.
+			/// </summary>
+			ULONG64 regionLength;
+
+			/// <summary>
+			/// A pointer to the header of the region.
+			/// </summary>
+			TraceHeader* header;
+
+			/// <summary>
+			/// The collection of the rings of the workers.
+			/// </summary>
+			TraceRing* rings;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="TraceRegion" /> class.
+			/// </summary>
+			inline TraceRegion(HANDLE fileHandle, HANDLE mappingHandle, LPVOID memoryBlock, ULONG64 regionLength, ULONG workersCount, ULONG eventsCount)
+			{
+				this->fileHandle = fileHandle;
+
+				this->mappingHandle = mappingHandle;
+
+				this->regionLength = regionLength;
+
+				this->header = (TraceHeader*) memoryBlock;
+
+				// compose rings, each ring header is followed by its events
+				this->rings = (TraceRing*) ::operator new(sizeof(TraceRing) * workersCount);
+
+				auto ringLength = sizeof(TraceRingHeader) + sizeof(TraceEvent) * (ULONG64) eventsCount;
+
+				for (ULONG workerId = 0; workerId < workersCount; workerId++)
+				{
+					auto ringHeader = (TraceRingHeader*) ((PCHAR) (header + 1) + ringLength * workerId);
+
+					new (rings + workerId) TraceRing(ringHeader, eventsCount);
+				}
+
+				// memory is zeroed by the kernel, so only header is filled
+				header->version = TRACE_VERSION;
+
+				header->headerLength = sizeof(TraceHeader);
+
+				header->eventLength = sizeof(TraceEvent);
+
+				header->workersCount = workersCount;
+
+				header->eventsCount = eventsCount;
+
+				header->processId = ::GetCurrentProcessId();
+
+				::GetSystemTimeAsFileTime((LPFILETIME) &header->startTime);
+
+				::QueryPerformanceCounter((LARGE_INTEGER*) &header->startTimestamp);
+
+				::QueryPerformanceFrequency((LARGE_INTEGER*) &header->timestampFrequency);
+
+				// signature is written last, so readers never see the partially filled header
+				::MemoryBarrier();
+
+				header->signature = TRACE_SIGNATURE;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="TraceRegion" /> class.
+			/// </summary>
+			/// <param name="filePath">The path of the file onto which to map the region, or <c>null</c> to keep region in the private memory.</param>
+			/// <param name="workersCount">The count of the workers.</param>
+			/// <param name="eventsCount">The count of the events within the ring of the single worker, a power of two.</param>
+			/// <param name="kernelErrorCode">The error code of the kernel if operation has failed.</param>
+			/// <returns>A pointer to the instance of the class if operation has succeed; otherwise, <c>null</c>.</returns>
+			inline static TraceRegion* Create(LPCWSTR filePath, ULONG workersCount, ULONG eventsCount, DWORD& kernelErrorCode)
+			{
+				// check if count of the events is a power of two
+				if ((eventsCount == 0) || ((eventsCount & (eventsCount - 1)) != 0))
+				{
+					kernelErrorCode = ERROR_INVALID_PARAMETER;
+
+					return nullptr;
+				}
+
+				// calculate the length of the region
+				auto regionLength = sizeof(TraceHeader) + (sizeof(TraceRingHeader) + sizeof(TraceEvent) * (ULONG64) eventsCount) * workersCount;
+
+				// check if region should be kept in the private memory
+				if (filePath == nullptr)
+				{
+					// reserve and commit memory block, memory is zeroed by the kernel
+					auto memoryBlock = ::VirtualAlloc(nullptr, (SIZE_T) regionLength, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+					// check if operation has failed
+					if (memoryBlock == nullptr)
+					{
+						// get kernel error code
+						kernelErrorCode = ::GetLastError();
+
+						return nullptr;
+					}
+
+					kernelErrorCode = 0;
+
+					return new TraceRegion(INVALID_HANDLE_VALUE, nullptr, memoryBlock, regionLength, workersCount, eventsCount);
+				}
+
+				// create file, readers are allowed to open it while it is written
+				auto fileHandle = ::CreateFileW(filePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+				// check if operation has failed
+				if (fileHandle == INVALID_HANDLE_VALUE)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					return nullptr;
+				}
+
+				// create file mapping of the required length, file is extended and zeroed by the kernel
+				auto mappingHandle = ::CreateFileMappingW(fileHandle, nullptr, PAGE_READWRITE, (DWORD) (regionLength >> 32), (DWORD) regionLength, nullptr);
+
+				// check if operation has failed
+				if (mappingHandle == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					// close file and ignore result
+					::CloseHandle(fileHandle);
+
+					return nullptr;
+				}
+
+				// map view of the file
+				auto memoryBlock = ::MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, (SIZE_T) regionLength);
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					// close handles and ignore result
+					::CloseHandle(mappingHandle);
+
+					::CloseHandle(fileHandle);
+
+					return nullptr;
+				}
+
+				kernelErrorCode = 0;
+
+				// initialize and return result
+				return new TraceRegion(fileHandle, mappingHandle, memoryBlock, regionLength, workersCount, eventsCount);
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~TraceRegion()
+			{
+				::operator delete(rings);
+
+				// check if region is kept in the private memory
+				if (mappingHandle == nullptr)
+				{
+					// free allocated memory
+					// ignore result
+					::VirtualFree(header, 0, MEM_RELEASE);
+
+					return;
+				}
+
+				// unmap view and close handles
+				// ignore result
+				::UnmapViewOfFile(header);
+
+				::CloseHandle(mappingHandle);
+
+				::CloseHandle(fileHandle);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets a pointer to the ring of the worker.
+			/// </summary>
+			/// <param name="workerId">The unique identifier of the worker.</param>
+			inline TraceRing* GetRing(ULONG workerId)
+			{
+				return rings + workerId;
+			}
+
+			/// <summary>
+			/// Writes the copy of the region into the file.
+			/// </summary>
+			/// <param name="filePath">The path of the file.</param>
+			/// <param name="kernelErrorCode">The error code of the kernel if operation has failed.</param>
+			/// <returns><c>TRUE</c> if operation has succeed; otherwise, <c>FALSE</c>.</returns>
+			/// <remarks>
+			/// Rings are copied while they are written, the events which are torn by the copy are detected by the decoder.
+			/// </remarks>
+			inline BOOL Save(LPCWSTR filePath, DWORD& kernelErrorCode)
+			{
+				auto saveFileHandle = ::CreateFileW(filePath, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+				// check if operation has failed
+				if (saveFileHandle == INVALID_HANDLE_VALUE)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					return FALSE;
+				}
+
+				auto data = (PCHAR) header;
+
+				auto remainingLength = regionLength;
+
+				// write by chunks, length of the single write is limited to 32 bits
+				while (remainingLength > 0)
+				{
+					auto chunkLength = remainingLength > 0x40000000 ? 0x40000000 : (DWORD) remainingLength;
+
+					DWORD writtenLength;
+
+					if (!::WriteFile(saveFileHandle, data, chunkLength, &writtenLength, nullptr))
+					{
+						// get kernel error code
+						kernelErrorCode = ::GetLastError();
+
+						// close file and ignore result
+						::CloseHandle(saveFileHandle);
+
+						return FALSE;
+					}
+
+					data += writtenLength;
+
+					remainingLength -= writtenLength;
+				}
+
+				kernelErrorCode = 0;
+
+				// close file and ignore result
+				::CloseHandle(saveFileHandle);
+
+				return TRUE;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
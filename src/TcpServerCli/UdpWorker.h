@@ -0,0 +1,783 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "Winsock.h"
+#include "TcpServerException.h"
+#include "RioBufferPool.h"
+#include "StatisticsRegion.h"
+#include "UdpWorkerSettings.h"
+#include <vcclr.h>
+
+using namespace System;
+using namespace System::Threading;
+
+#ifndef UDP_SEND_MSG_SIZE
+/// <summary>
+/// The option of the UDP send offload, is defined by the SDK starting from Windows 10 version 1703.
+/// </summary>
+#define UDP_SEND_MSG_SIZE 2
+#endif
+
+#ifndef UDP_RECV_MAX_COALESCED_SIZE
+/// <summary>
+/// The option of the UDP receive offload, is defined by the SDK starting from Windows 10 version 1703.
+/// </summary>
+#define UDP_RECV_MAX_COALESCED_SIZE 3
+#endif
+
+#ifndef UDP_COALESCED_INFO
+/// <summary>
+/// The type of the control message that contains the length of the coalesced datagrams.
+/// </summary>
+#define UDP_COALESCED_INFO 3
+#endif
+
+/// <summary>
+/// The length of the control segment of the receive, holds the total length and the control message of the coalescing.
+/// </summary>
+#define UDP_CONTROL_SEGMENT_LENGTH 64
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Handles the datagram received by the <see cref="UdpWorker" />.
+		/// </summary>
+		/// <param name="data">A pointer to the data of the datagram, valid only until the handler returns.</param>
+		/// <param name="length">The length of the datagram.</param>
+		/// <param name="replyData">A pointer to the registered buffer to write the reply into, or <c>IntPtr::Zero</c> if all sends are in flight.</param>
+		/// <param name="replyCapacity">The length of the buffer of the reply.</param>
+		/// <returns>The length of the reply sent to the sender of the datagram, or zero if there is no reply.</returns>
+		public delegate Int32 DatagramHandler(IntPtr data, Int32 length, IntPtr replyData, Int32 replyCapacity);
+
+		/// <summary>
+		/// Receives and replies the datagrams over the Registered I/O UDP socket.
+		/// </summary>
+		/// <remarks>
+		/// The socket has the single request queue, so the datagrams are processed by the single thread, which calls the handler synchronously.
+		/// Completions are dequeued in batches, receives and replies of the batch are posted deferred and committed once per batch.
+		/// Each receive and each send owns the data and the address segments of the registered buffers, the address of the sender is copied into the send on reply.
+		/// With the receive offload, the segment of the receive holds several datagrams of the same sender, the length of which is given by the control segment.
+		/// With the send offload, the reply may hold several datagrams, which are split by the system.
+		/// </remarks>
+		public ref class UdpWorker sealed
+		{
+			private:
+
+			#pragma region Constant and Static Fields
+
+			/// <summary>
+			/// The maximum count of the completions dequeued at once.
+			/// </summary>
+			literal ULONG BatchLength = 1024;
+
+			#pragma endregion
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The descriptor of the socket.
+			/// </summary>
+			initonly SOCKET socket;
+
+			/// <summary>
+			/// A pointer to the object that provides work with the Winsock extensions.
+			/// </summary>
+			initonly Winsock* pWinsock;
+
+			/// <summary>
+			/// The completion port of the Registered I/O operations.
+			/// </summary>
+			initonly HANDLE rioCompletionPort;
+
+			/// <summary>
+			/// The completion queue of the Registered I/O operations.
+			/// </summary>
+			initonly RIO_CQ rioCompletionQueue;
+
+			/// <summary>
+			/// The descriptor of the socket within the Registered I/O extension.
+			/// </summary>
+			initonly RIO_RQ rioRequestQueue;
+
+			/// <summary>
+			/// The segments of the data of the receives.
+			/// </summary>
+			initonly RioBufferPool* receivePool;
+
+			/// <summary>
+			/// The segments of the data of the sends.
+			/// </summary>
+			initonly RioBufferPool* sendPool;
+
+			/// <summary>
+			/// The segments of the control information of the receives, or <c>null</c> if the receive offload is not used.
+			/// </summary>
+			initonly RioBufferPool* controlPool;
+
+			/// <summary>
+			/// The segments of the addresses, receives are followed by sends.
+			/// </summary>
+			initonly RioBufferPool* addressPool;
+
+			/// <summary>
+			/// The count of the receives.
+			/// </summary>
+			initonly ULONG receivesCount;
+
+			/// <summary>
+			/// The maximum length of the reply.
+			/// </summary>
+			initonly ULONG maxReplyLength;
+
+			/// <summary>
+			/// The stack of the indices of the sends that are not in flight.
+			/// </summary>
+			initonly ULONG* freeSends;
+
+			/// <summary>
+			/// The count of the sends that are not in flight.
+			/// </summary>
+			ULONG freeSendsCount;
+
+			/// <summary>
+			/// The region that contains the statistics of the worker.
+			/// </summary>
+			initonly StatisticsRegion* statisticsRegion;
+
+			/// <summary>
+			/// The counters of the worker within the statistics region.
+			/// </summary>
+			initonly WorkerCounters* counters;
+
+			/// <summary>
+			/// The handler of the datagrams.
+			/// </summary>
+			initonly DatagramHandler^ handler;
+
+			initonly Thread^ processRioOperationsThread;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor & Destructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="UdpWorker" /> class.
+			/// </summary>
+			/// <param name="settings">The configuration settings of the worker.</param>
+			/// <param name="handler">The handler of the datagrams.</param>
+			UdpWorker(UdpWorkerSettings^ settings, DatagramHandler^ handler)
+			{
+				// check arguments
+				if (settings == nullptr)
+				{
+					throw gcnew ArgumentNullException("settings");
+				}
+
+				if (settings->ReceivePoint == nullptr)
+				{
+					throw gcnew ArgumentNullException("settings.ReceivePoint");
+				}
+
+				if (handler == nullptr)
+				{
+					throw gcnew ArgumentNullException("handler");
+				}
+
+				this->handler = handler;
+
+				this->receivesCount = settings->ReceivesCount;
+
+				this->maxReplyLength = settings->MaxReplyLength;
+
+				// the reply of several datagrams can be sent only by the send offload
+				if ((maxReplyLength > settings->MaxDatagramLength) && (settings->SendSegmentLength == 0))
+				{
+					throw gcnew ArgumentOutOfRangeException("settings.MaxReplyLength");
+				}
+
+				// initialize Winsock
+				{
+					WSADATA data;
+
+					auto startupResultCode = ::WSAStartup(MAKEWORD(2, 2), &data);
+
+					// check if startup was successful
+					if (startupResultCode != 0)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode) startupResultCode);
+					}
+				}
+
+				// initialize winsock extensions, the functions are provided for the stream socket, the table of the Registered I/O is common
+				{
+					auto extensionSocket = ::WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+
+					pWinsock = extensionSocket == INVALID_SOCKET ? nullptr : Winsock::Initialize(extensionSocket);
+
+					// get error code before the socket is closed
+					auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+					if (extensionSocket != INVALID_SOCKET)
+					{
+						::closesocket(extensionSocket);
+					}
+
+					if (pWinsock == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				// create and bind socket
+				{
+					socket = ::WSASocket((int) settings->ReceivePoint->AddressFamily, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+
+					// check if operation has failed
+					if ((socket == INVALID_SOCKET) || !Bind(socket, settings->ReceivePoint) || !Configure(socket, settings))
+					{
+						// get error code
+						auto winsockErrorCode = (WinsockErrorCode) ::WSAGetLastError();
+
+						// throw exception
+						throw gcnew TcpServerException(winsockErrorCode);
+					}
+				}
+
+				auto sendsCount = settings->SendsCount;
+
+				auto operationsCount = receivesCount + sendsCount;
+
+				// create completion queue
+				{
+					// create I/O completion port
+					rioCompletionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+
+					// check if operation has failed
+					if (rioCompletionPort == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException(::GetLastError());
+					}
+
+					RIO_NOTIFICATION_COMPLETION completionSettings;
+
+					completionSettings.Type = RIO_IOCP_COMPLETION;
+
+					completionSettings.Iocp.IocpHandle = rioCompletionPort;
+
+					completionSettings.Iocp.CompletionKey = nullptr;
+
+					completionSettings.Iocp.Overlapped = (LPOVERLAPPED) -1;
+
+					// each operation completes once
+					rioCompletionQueue = pWinsock->RIOCreateCompletionQueue(operationsCount, &completionSettings);
+
+					// check if operation has failed
+					if (rioCompletionQueue == RIO_INVALID_CQ)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode) ::WSAGetLastError());
+					}
+				}
+
+				// create request queue
+				{
+					rioRequestQueue = pWinsock->RIOCreateRequestQueue(socket, receivesCount, 1, sendsCount, 1, rioCompletionQueue, rioCompletionQueue, nullptr);
+
+					// check if operation has failed
+					if (rioRequestQueue == RIO_INVALID_RQ)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode) ::WSAGetLastError());
+					}
+				}
+
+				// create buffer pools
+				{
+					DWORD kernelErrorCode;
+
+					int winsockErrorCode;
+
+					// the receive segment holds either the single datagram or the coalesced ones
+					auto receiveLength = settings->MaxCoalescedReceiveLength > settings->MaxDatagramLength ? settings->MaxCoalescedReceiveLength : settings->MaxDatagramLength;
+
+					receivePool = RioBufferPool::Create(*pWinsock, receiveLength, receivesCount, kernelErrorCode, winsockErrorCode);
+
+					if (receivePool != nullptr)
+					{
+						sendPool = RioBufferPool::Create(*pWinsock, maxReplyLength, sendsCount, kernelErrorCode, winsockErrorCode);
+					}
+
+					if (sendPool != nullptr)
+					{
+						addressPool = RioBufferPool::Create(*pWinsock, sizeof(SOCKADDR_INET), operationsCount, kernelErrorCode, winsockErrorCode);
+					}
+
+					if ((addressPool != nullptr) && (settings->MaxCoalescedReceiveLength != 0))
+					{
+						controlPool = RioBufferPool::Create(*pWinsock, UDP_CONTROL_SEGMENT_LENGTH, receivesCount, kernelErrorCode, winsockErrorCode);
+
+						// check if operation has failed
+						if (controlPool == nullptr)
+						{
+							// throw exception
+							throw gcnew TcpServerException((WinsockErrorCode) winsockErrorCode, (int) kernelErrorCode);
+						}
+					}
+
+					// check if operation has failed
+					if (addressPool == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode) winsockErrorCode, (int) kernelErrorCode);
+					}
+				}
+
+				// create statistics region
+				{
+					DWORD kernelErrorCode;
+
+					if (settings->StatisticsFilePath == nullptr)
+					{
+						statisticsRegion = StatisticsRegion::Create(nullptr, 1, kernelErrorCode);
+					}
+					else
+					{
+						pin_ptr<const wchar_t> filePath = PtrToStringChars(settings->StatisticsFilePath);
+
+						statisticsRegion = StatisticsRegion::Create(filePath, 1, kernelErrorCode);
+					}
+
+					// check if operation has failed
+					if (statisticsRegion == nullptr)
+					{
+						// throw exception
+						throw gcnew TcpServerException((int) kernelErrorCode);
+					}
+
+					counters = statisticsRegion->GetWorkerCounters(0);
+
+					counters->slotsCount = receivesCount;
+				}
+
+				// all sends are free, the sends follow the receives within the pools
+				freeSends = new ULONG[sendsCount];
+
+				for (ULONG sendIndex = 0; sendIndex < sendsCount; sendIndex++)
+				{
+					freeSends[sendIndex] = receivesCount + sendIndex;
+				}
+
+				freeSendsCount = sendsCount;
+
+				// post all receives
+				for (ULONG receiveIndex = 0; receiveIndex < receivesCount; receiveIndex++)
+				{
+					if (!PostReceive(receiveIndex, 0))
+					{
+						// throw exception
+						throw gcnew TcpServerException((WinsockErrorCode) ::WSAGetLastError());
+					}
+				}
+
+				{
+					ThreadStart^ threadDelegate = gcnew ThreadStart(this, &UdpWorker::ProcessRioOperations);
+
+					processRioOperationsThread = gcnew Thread(threadDelegate);
+
+					processRioOperationsThread->Name = "RIO datagram processing thread";
+
+					processRioOperationsThread->IsBackground = true;
+
+					processRioOperationsThread->Start();
+				}
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			~UdpWorker()
+			{
+				// close socket, request queue is closed with it
+				::closesocket(socket);
+
+				// release buffer pools
+				delete receivePool;
+
+				delete sendPool;
+
+				delete controlPool;
+
+				delete addressPool;
+
+				delete[] freeSends;
+
+				delete statisticsRegion;
+
+				// close completion queue
+				pWinsock->RIOCloseCompletionQueue(rioCompletionQueue);
+
+				// close completion port
+				// ignore result
+				::CloseHandle(rioCompletionPort);
+			}
+
+			#pragma endregion
+
+			private:
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Associates the address with the socket.
+			/// </summary>
+			/// <returns><c>true</c> if operation has succeed; otherwise, <c>false</c>.</returns>
+			static Boolean Bind(SOCKET socket, IPEndPoint^ endPoint)
+			{
+				// compose socket address
+				SOCKADDR_INET socketAddress;
+
+				// reset memory
+				memset(&socketAddress, 0, sizeof(SOCKADDR_INET));
+
+				// get address as bytes
+				auto addressBytes = endPoint->Address->GetAddressBytes();
+
+				pin_ptr<Byte> pinnedAddressBytes = &addressBytes[0];
+
+				int socketAddressLength;
+
+				if (endPoint->AddressFamily == AddressFamily::InterNetwork)
+				{
+					socketAddress.Ipv4.sin_family = AF_INET;
+
+					socketAddress.Ipv4.sin_port = ::htons(endPoint->Port);
+
+					memcpy(&socketAddress.Ipv4.sin_addr, pinnedAddressBytes, 4);
+
+					socketAddressLength = sizeof(SOCKADDR_IN);
+				}
+				else
+				{
+					socketAddress.Ipv6.sin6_family = AF_INET6;
+
+					socketAddress.Ipv6.sin6_port = ::htons(endPoint->Port);
+
+					memcpy(&socketAddress.Ipv6.sin6_addr, pinnedAddressBytes, 16);
+
+					socketAddress.Ipv6.sin6_scope_id = (ULONG) endPoint->Address->ScopeId;
+
+					socketAddressLength = sizeof(SOCKADDR_IN6);
+				}
+
+				return ::bind(socket, (sockaddr*) &socketAddress, socketAddressLength) != SOCKET_ERROR;
+			}
+
+			/// <summary>
+			/// Enables the offloads of the socket if requested.
+			/// </summary>
+			/// <returns><c>true</c> if operation has succeed; otherwise, <c>false</c>.</returns>
+			static Boolean Configure(SOCKET socket, UdpWorkerSettings^ settings)
+			{
+				// enable coalescing of the received datagrams
+				if (settings->MaxCoalescedReceiveLength != 0)
+				{
+					DWORD optionValue = settings->MaxCoalescedReceiveLength;
+
+					if (::setsockopt(socket, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (const char *) &optionValue, sizeof(DWORD)) == SOCKET_ERROR)
+					{
+						return false;
+					}
+				}
+
+				// enable segmentation of the sent replies
+				if (settings->SendSegmentLength != 0)
+				{
+					DWORD optionValue = settings->SendSegmentLength;
+
+					if (::setsockopt(socket, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (const char *) &optionValue, sizeof(DWORD)) == SOCKET_ERROR)
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			/// <summary>
+			/// Posts the receive into the data and the address segments of the specified index.
+			/// </summary>
+			/// <param name="receiveIndex">The index of the receive, which is also its request context.</param>
+			/// <param name="flags">The flags of the Registered I/O operation.</param>
+			inline BOOL PostReceive(ULONG receiveIndex, DWORD flags)
+			{
+				auto control = controlPool == nullptr ? nullptr : controlPool->GetBuffer(receiveIndex);
+
+				return pWinsock->RIOReceiveEx(rioRequestQueue, receivePool->GetBuffer(receiveIndex), 1, nullptr, addressPool->GetBuffer(receiveIndex), control, nullptr, flags, (PVOID) receiveIndex);
+			}
+
+			/// <summary>
+			/// Gets the length of the datagrams coalesced into the receive.
+			/// </summary>
+			/// <param name="receiveIndex">The index of the receive.</param>
+			/// <returns>The length of the datagrams, the last one may be shorter, or zero if the receive holds the single datagram.</returns>
+			/// <remarks>
+			/// The control segment starts with the total length of the control information, which is followed by the control messages.
+			/// </remarks>
+			ULONG GetCoalescedLength(ULONG receiveIndex)
+			{
+				if (controlPool == nullptr)
+				{
+					return 0;
+				}
+
+				auto control = (PCHAR) controlPool->GetBufferData(receiveIndex);
+
+				auto totalLength = *(ULONG*) control;
+
+				if (totalLength > UDP_CONTROL_SEGMENT_LENGTH)
+				{
+					return 0;
+				}
+
+				// walk the control messages
+				auto position = WSA_CMSGHDR_ALIGN(sizeof(ULONG));
+
+				while (position + sizeof(WSACMSGHDR) <= totalLength)
+				{
+					auto header = (PWSACMSGHDR) (control + position);
+
+					if (header->cmsg_len < sizeof(WSACMSGHDR))
+					{
+						break;
+					}
+
+					if ((header->cmsg_level == IPPROTO_UDP) && (header->cmsg_type == UDP_COALESCED_INFO))
+					{
+						return *(DWORD*) WSA_CMSG_DATA(header);
+					}
+
+					position += WSA_CMSGHDR_ALIGN(header->cmsg_len);
+				}
+
+				return 0;
+			}
+
+			/// <summary>
+			/// Splits the completed receive into the datagrams and handles each of them.
+			/// </summary>
+			/// <param name="receiveIndex">The index of the receive.</param>
+			/// <param name="length">The count of the bytes received.</param>
+			/// <returns><c>true</c> if any reply has been posted deferred; otherwise, <c>false</c>.</returns>
+			BOOL HandleReceive(ULONG receiveIndex, ULONG length)
+			{
+				auto data = receivePool->GetBufferData(receiveIndex);
+
+				auto datagramLength = GetCoalescedLength(receiveIndex);
+
+				if ((datagramLength == 0) || (datagramLength >= length))
+				{
+					counters->receivesCount++;
+
+					return HandleDatagram(receiveIndex, data, length);
+				}
+
+				BOOL result = FALSE;
+
+				for (ULONG offset = 0; offset < length; offset += datagramLength)
+				{
+					counters->receivesCount++;
+
+					result |= HandleDatagram(receiveIndex, data + offset, length - offset < datagramLength ? length - offset : datagramLength);
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Calls the handler for the received datagram and posts the reply if there is one.
+			/// </summary>
+			/// <param name="receiveIndex">The index of the receive.</param>
+			/// <param name="datagram">A pointer to the datagram within the segment of the receive.</param>
+			/// <param name="length">The length of the datagram.</param>
+			/// <returns><c>true</c> if the reply has been posted deferred; otherwise, <c>false</c>.</returns>
+			BOOL HandleDatagram(ULONG receiveIndex, PCHAR datagram, ULONG length)
+			{
+				auto data = IntPtr(datagram);
+
+				// the handler can not reply if all sends are in flight
+				if (freeSendsCount == 0)
+				{
+					handler(data, length, IntPtr::Zero, 0);
+
+					return FALSE;
+				}
+
+				auto sendIndex = freeSends[freeSendsCount - 1];
+
+				auto sendPoolIndex = sendIndex - receivesCount;
+
+				auto replyLength = handler(data, length, IntPtr(sendPool->GetBufferData(sendPoolIndex)), maxReplyLength);
+
+				if ((replyLength <= 0) || ((ULONG) replyLength > maxReplyLength))
+				{
+					return FALSE;
+				}
+
+				// the reply is sent to the sender of the datagram
+				memcpy(addressPool->GetBufferData(sendIndex), addressPool->GetBufferData(receiveIndex), sizeof(SOCKADDR_INET));
+
+				auto sendBuffer = sendPool->GetBuffer(sendPoolIndex);
+
+				sendBuffer->Length = replyLength;
+
+				if (!pWinsock->RIOSendEx(rioRequestQueue, sendBuffer, 1, nullptr, addressPool->GetBuffer(sendIndex), nullptr, nullptr, RIO_MSG_DEFER, (PVOID) sendIndex))
+				{
+					return FALSE;
+				}
+
+				freeSendsCount--;
+
+				return TRUE;
+			}
+
+			/// <summary>
+			/// Registers the method to use for notification behavior with the completion queue.
+			/// </summary>
+			inline void Notify()
+			{
+				counters->notifyCount++;
+
+				pWinsock->RIONotify(rioCompletionQueue);
+			}
+
+			[System::Security::SuppressUnmanagedCodeSecurity]
+			void ProcessRioOperations()
+			{
+				// the number of bytes transferred during an I/O operation that has completed
+				DWORD numberOfBytes = 0;
+
+				// the completion key value associated with the file handle whose I/O operation has completed
+				ULONG_PTR completionKey = 0;
+
+				// the OVERLAPPED structure that was specified when the completed I/O operation was started.
+				LPOVERLAPPED overlapped = nullptr;
+
+				// array of the Registered IO results
+				RIORESULT rioResults[BatchLength];
+
+				while (true)
+				{
+					Notify();
+
+					// dequeue completion status
+					BOOL dequeueResult = ::GetQueuedCompletionStatus(rioCompletionPort, &numberOfBytes, &completionKey, &overlapped, WSA_INFINITE);
+
+					// check if operation has failed
+					if (dequeueResult == FALSE)
+					{
+						continue;
+					}
+
+					counters->wakeupsCount++;
+
+					ULONG completionsCount;
+
+					BOOL activatedCompletionPort = FALSE;
+
+					while ((completionsCount = pWinsock->RIODequeueCompletion(rioCompletionQueue, rioResults, BatchLength)) > 0)
+					{
+						counters->RecordDequeue(completionsCount);
+
+						BOOL receivesDeferred = FALSE;
+
+						BOOL sendsDeferred = FALSE;
+
+						for (ULONG resultIndex = 0; resultIndex < completionsCount; resultIndex++)
+						{
+							auto rioResult = rioResults[resultIndex];
+
+							auto operationIndex = (ULONG) rioResult.RequestContext;
+
+							// check if the send is completed
+							if (operationIndex >= receivesCount)
+							{
+								counters->sendsCount++;
+
+								counters->bytesSent += rioResult.BytesTransferred;
+
+								freeSends[freeSendsCount++] = operationIndex;
+
+								continue;
+							}
+
+							if (rioResult.Status == 0)
+							{
+								counters->bytesReceived += rioResult.BytesTransferred;
+
+								sendsDeferred |= HandleReceive(operationIndex, rioResult.BytesTransferred);
+							}
+
+							// post receive again, the segments are free as the handler has returned
+							receivesDeferred |= PostReceive(operationIndex, RIO_MSG_DEFER);
+						}
+
+						// commit the operations of the batch by the single call per queue
+						if (receivesDeferred)
+						{
+							pWinsock->RIOReceiveEx(rioRequestQueue, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+						}
+
+						if (sendsDeferred)
+						{
+							pWinsock->RIOSendEx(rioRequestQueue, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+						}
+
+						if (!activatedCompletionPort)
+						{
+							Notify();
+
+							activatedCompletionPort = TRUE;
+						}
+					}
+				}
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Properties
+
+			/// <summary>
+			/// Gets the count of the datagrams received.
+			/// </summary>
+			property UInt64 ReceivedCount
+			{
+				UInt64 get()
+				{
+					return counters->receivesCount;
+				}
+			}
+
+			/// <summary>
+			/// Gets the count of the replies sent.
+			/// </summary>
+			property UInt64 SentCount
+			{
+				UInt64 get()
+				{
+					return counters->sendsCount;
+				}
+			}
+
+			#pragma endregion
+		};
+	}
+}
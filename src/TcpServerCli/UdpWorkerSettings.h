@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Stdafx.h"
+
+using namespace System;
+using namespace System::Net;
+using namespace System::Net::Sockets;
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies the configuration settings of the UDP worker.
+		/// </summary>
+		public ref class UdpWorkerSettings
+		{
+			private:
+
+			#pragma region Fields
+
+			IPEndPoint^ receivePoint;
+
+			UInt32 maxDatagramLength;
+
+			UInt32 receivesCount;
+
+			UInt32 sendsCount;
+
+			UInt32 maxReplyLength;
+
+			UInt32 maxCoalescedReceiveLength;
+
+			UInt32 sendSegmentLength;
+
+			#pragma endregion
+
+			public:
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="UdpWorkerSettings" /> class.
+			/// </summary>
+			UdpWorkerSettings()
+			{
+				maxDatagramLength = 2048;
+
+				receivesCount = 1024;
+
+				sendsCount = 1024;
+			}
+
+			#pragma region Properties
+
+			/// <summary>
+			/// The Internet Protocol address and port on which to receive the datagrams.
+			/// </summary>
+			property IPEndPoint^ ReceivePoint
+			{
+				IPEndPoint^ get()
+				{
+					return receivePoint;
+				}
+
+				void set(IPEndPoint^ value)
+				{
+					if (value == nullptr)
+					{
+						throw gcnew ArgumentNullException("value");
+					}
+
+					if ((value->AddressFamily != AddressFamily::InterNetwork) && (value->AddressFamily != AddressFamily::InterNetworkV6))
+					{
+						throw gcnew ArgumentOutOfRangeException("value.AddressFamily");
+					}
+
+					receivePoint = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum length of the datagram, longer datagrams are truncated.
+			/// </summary>
+			property UInt32 MaxDatagramLength
+			{
+				UInt32 get()
+				{
+					return maxDatagramLength;
+				}
+
+				void set(UInt32 value)
+				{
+					if ((value == 0) || (value > 65536))
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					maxDatagramLength = value;
+				}
+			}
+
+			/// <summary>
+			/// The count of the receives kept outstanding by the worker.
+			/// </summary>
+			/// <remarks>
+			/// Datagrams that arrive when all receives are completed and not yet posted again are dropped by the system.
+			/// </remarks>
+			property UInt32 ReceivesCount
+			{
+				UInt32 get()
+				{
+					return receivesCount;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					receivesCount = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum count of the replies in flight.
+			/// </summary>
+			/// <remarks>
+			/// Replies made when all sends are in flight are dropped.
+			/// </remarks>
+			property UInt32 SendsCount
+			{
+				UInt32 get()
+				{
+					return sendsCount;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value == 0)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					sendsCount = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum length of the reply.
+			/// </summary>
+			/// <remarks>
+			/// If value is zero, the <see cref="MaxDatagramLength" /> is used.
+			/// The reply longer than the datagram requires the <see cref="SendSegmentLength" /> to be set.
+			/// </remarks>
+			property UInt32 MaxReplyLength
+			{
+				UInt32 get()
+				{
+					return maxReplyLength == 0 ? maxDatagramLength : maxReplyLength;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value > 65536)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					maxReplyLength = value;
+				}
+			}
+
+			/// <summary>
+			/// The maximum length of the datagrams coalesced by the system into the single receive.
+			/// </summary>
+			/// <remarks>
+			/// Enables the UDP receive offload: the datagrams of the same sender are received by the single completion and split by the worker.
+			/// If value is zero, the offload is not used.
+			/// </remarks>
+			property UInt32 MaxCoalescedReceiveLength
+			{
+				UInt32 get()
+				{
+					return maxCoalescedReceiveLength;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value > 65536)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					maxCoalescedReceiveLength = value;
+				}
+			}
+
+			/// <summary>
+			/// The length of the datagrams into which the system splits the reply.
+			/// </summary>
+			/// <remarks>
+			/// Enables the UDP send offload: the reply of up to <see cref="MaxReplyLength" /> bytes is sent by the single operation as the datagrams of this length, the last one may be shorter.
+			/// If value is zero, the offload is not used and each reply is the single datagram.
+			/// </remarks>
+			property UInt32 SendSegmentLength
+			{
+				UInt32 get()
+				{
+					return sendSegmentLength;
+				}
+
+				void set(UInt32 value)
+				{
+					if (value > 65536)
+					{
+						throw gcnew ArgumentOutOfRangeException("value");
+					}
+
+					sendSegmentLength = value;
+				}
+			}
+
+			/// <summary>
+			/// The path of the file onto which the statistics of the worker are mapped.
+			/// </summary>
+			/// <remarks>
+			/// If value is <c>null</c>, the statistics are kept in the private memory of the process.
+			/// </remarks>
+			property String^ StatisticsFilePath;
+
+			#pragma endregion
+		};
+	}
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "TcpUpstream.h"
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Keeps the upstream connections of the single worker which are not in use.
+		/// </summary>
+		/// <remarks>
+		/// Each upstream has the stack of the idle connections, which are connected and can be used at once,
+		/// and the stack of the disconnected ones, which have to be connected first.
+		/// Idle connections are taken last in first out, so the recently used connections, which are least likely to be closed by the upstream, are reused.
+		/// Connections are taken by the handlers and returned by the handlers and the worker thread, therefore the stacks are guarded by the lock.
+		/// </remarks>
+		private class UpstreamPool final
+		{
+			private:
+
+			/// <summary>
+			/// Contains the stacks of the single upstream.
+			/// </summary>
+			struct UpstreamStacks
+			{
+				/// <summary>
+				/// The identifiers of the idle connections.
+				/// </summary>
+				ULONG* idle;
+
+				/// <summary>
+				/// The count of the idle connections.
+				/// </summary>
+				ULONG idleCount;
+
+				/// <summary>
+				/// The identifiers of the disconnected connections.
+				/// </summary>
+				ULONG* disconnected;
+
+				/// <summary>
+				/// The count of the disconnected connections.
+				/// </summary>
+				ULONG disconnectedCount;
+			};
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The lock which guards the stacks.
+			/// </summary>
+			SRWLOCK lock;
+
+			/// <summary>
+			/// The count of the upstreams.
+			/// </summary>
+			ULONG upstreamsCount;
+
+			/// <summary>
+			/// A pointer to the memory block, which holds the stacks of all upstreams.
+			/// </summary>
+			LPVOID memoryBlock;
+
+			/// <summary>
+			/// The collection of the stacks, one per upstream.
+			/// </summary>
+			UpstreamStacks* stacks;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="UpstreamPool" /> class.
+			/// </summary>
+			/// <param name="upstreamsCount">The count of the upstreams.</param>
+			/// <param name="memoryBlock">A pointer to the memory block.</param>
+			inline UpstreamPool(ULONG upstreamsCount, LPVOID memoryBlock)
+			{
+				::InitializeSRWLock(&lock);
+
+				this->upstreamsCount = upstreamsCount;
+
+				this->memoryBlock = memoryBlock;
+
+				this->stacks = (UpstreamStacks*) memoryBlock;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="UpstreamPool" /> class, all connections are disconnected.
+			/// </summary>
+			/// <param name="upstreams">A pointer to the collection of the upstreams.</param>
+			/// <param name="upstreamsCount">The count of the upstreams.</param>
+			/// <param name="firstConnectionId">The identifier of the first upstream connection within the worker, the connections of the upstreams follow each other.</param>
+			/// <param name="kernelErrorCode">The error code of the kernel if operation has failed.</param>
+			/// <returns>A pointer to the instance of the class if operation has succeed; otherwise, <c>null</c>.</returns>
+			inline static UpstreamPool* Create(const TcpUpstream* upstreams, ULONG upstreamsCount, ULONG firstConnectionId, DWORD& kernelErrorCode)
+			{
+				ULONG connectionsCount = 0;
+
+				for (ULONG upstreamIndex = 0; upstreamIndex < upstreamsCount; upstreamIndex++)
+				{
+					connectionsCount += upstreams[upstreamIndex].connectionsCount;
+				}
+
+				// the stacks are followed by the identifiers, each connection has a place in both stacks of its upstream
+				auto memoryBlockLength = sizeof(UpstreamStacks) * upstreamsCount + sizeof(ULONG) * connectionsCount * 2;
+
+				// reserve and commit memory block, memory is zeroed by the kernel
+				auto memoryBlock = ::VirtualAlloc(nullptr, memoryBlockLength, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+				// check if operation has failed
+				if (memoryBlock == nullptr)
+				{
+					// get kernel error code
+					kernelErrorCode = ::GetLastError();
+
+					return nullptr;
+				}
+
+				kernelErrorCode = 0;
+
+				auto result = new UpstreamPool(upstreamsCount, memoryBlock);
+
+				auto ids = (ULONG*) (result->stacks + upstreamsCount);
+
+				auto connectionId = firstConnectionId;
+
+				for (ULONG upstreamIndex = 0; upstreamIndex < upstreamsCount; upstreamIndex++)
+				{
+					auto count = upstreams[upstreamIndex].connectionsCount;
+
+					auto upstreamStacks = result->stacks + upstreamIndex;
+
+					upstreamStacks->idle = ids;
+
+					upstreamStacks->disconnected = ids + count;
+
+					// push in reverse order, so the connections are taken in the order of the identifiers
+					for (ULONG index = count; index > 0; index--)
+					{
+						upstreamStacks->disconnected[upstreamStacks->disconnectedCount++] = connectionId + index - 1;
+					}
+
+					connectionId += count;
+
+					ids += count * 2;
+				}
+
+				return result;
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			inline ~UpstreamPool()
+			{
+				// free allocated memory
+				// ignore result
+				::VirtualFree(memoryBlock, 0, MEM_RELEASE);
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Tries to take the connection to the upstream, the idle one is preferred.
+			/// </summary>
+			/// <param name="upstreamIndex">The index of the upstream.</param>
+			/// <param name="connectionId">The identifier of the connection taken.</param>
+			/// <param name="connected">Receives <c>TRUE</c> if the connection is idle; <c>FALSE</c> if it should be connected.</param>
+			/// <returns><c>TRUE</c> if the connection is taken; <c>FALSE</c> if all connections to the upstream are in use.</returns>
+			inline BOOL TryAcquire(ULONG upstreamIndex, ULONG& connectionId, BOOL& connected)
+			{
+				auto upstreamStacks = stacks + upstreamIndex;
+
+				BOOL result = TRUE;
+
+				::AcquireSRWLockExclusive(&lock);
+
+				if (upstreamStacks->idleCount != 0)
+				{
+					connectionId = upstreamStacks->idle[--upstreamStacks->idleCount];
+
+					connected = TRUE;
+				}
+				else if (upstreamStacks->disconnectedCount != 0)
+				{
+					connectionId = upstreamStacks->disconnected[--upstreamStacks->disconnectedCount];
+
+					connected = FALSE;
+				}
+				else
+				{
+					result = FALSE;
+				}
+
+				::ReleaseSRWLockExclusive(&lock);
+
+				return result;
+			}
+
+			/// <summary>
+			/// Returns the connection to the pool.
+			/// </summary>
+			/// <param name="upstreamIndex">The index of the upstream.</param>
+			/// <param name="connectionId">The identifier of the connection.</param>
+			/// <param name="connected"><c>TRUE</c> if the connection is kept alive and can be reused at once; otherwise, <c>FALSE</c>.</param>
+			inline void Release(ULONG upstreamIndex, ULONG connectionId, BOOL connected)
+			{
+				auto upstreamStacks = stacks + upstreamIndex;
+
+				::AcquireSRWLockExclusive(&lock);
+
+				if (connected)
+				{
+					upstreamStacks->idle[upstreamStacks->idleCount++] = connectionId;
+				}
+				else
+				{
+					upstreamStacks->disconnected[upstreamStacks->disconnectedCount++] = connectionId;
+				}
+
+				::ReleaseSRWLockExclusive(&lock);
+			}
+
+			/// <summary>
+			/// Gets the approximate count of the idle connections to the upstream.
+			/// </summary>
+			/// <param name="upstreamIndex">The index of the upstream.</param>
+			inline ULONG GetIdleCount(ULONG upstreamIndex)
+			{
+				return stacks[upstreamIndex].idleCount;
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
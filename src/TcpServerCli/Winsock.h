@@ -17,6 +17,8 @@ namespace SXN
 
 			LPFN_ACCEPTEX pAcceptEx;
 
+			LPFN_CONNECTEX pConnectEx;
+
 			LPFN_DISCONNECTEX pDisconnectEx;
 
 			LPFN_GETACCEPTEXSOCKADDRS pGetAcceptExSockaddrs;
@@ -55,13 +57,16 @@ namespace SXN
 			/// Initializes a new instance of the <see cref="Winsock" /> class.
 			/// </summary>
 			/// <param name="pAcceptEx">A pointer to the AcceptEx function.</param>
+			/// <param name="pConnectEx">A pointer to the ConnectEx function.</param>
 			/// <param name="pDisconnectEx">A pointer to the DisconnectEx function.</param>
 			/// <param name="pGetAcceptExSockaddrs">A pointer to the GetAcceptExSockaddrs function.</param>
 			/// <param name="rioFunctionsTable">A reference to the structure that contains information on the functions that implement the Winsock registered I/O extensions.</param>
-			inline Winsock(LPFN_ACCEPTEX pAcceptEx, LPFN_DISCONNECTEX pDisconnectEx, LPFN_GETACCEPTEXSOCKADDRS pGetAcceptExSockaddrs, RIO_EXTENSION_FUNCTION_TABLE& rioFunctionsTable)
+			inline Winsock(LPFN_ACCEPTEX pAcceptEx, LPFN_CONNECTEX pConnectEx, LPFN_DISCONNECTEX pDisconnectEx, LPFN_GETACCEPTEXSOCKADDRS pGetAcceptExSockaddrs, RIO_EXTENSION_FUNCTION_TABLE& rioFunctionsTable)
 			{
 				this->pAcceptEx = pAcceptEx;
 
+				this->pConnectEx = pConnectEx;
+
 				this->pDisconnectEx = pDisconnectEx;
 
 				this->pGetAcceptExSockaddrs = pGetAcceptExSockaddrs;
@@ -146,6 +151,19 @@ namespace SXN
 					}
 				}
 
+				// get pointer to ConnectEx function
+				LPFN_CONNECTEX pConnectEx;
+				{
+					// get pointer
+					int getResult = GetExtensionFunctionAddress(socket, WSAID_CONNECTEX, &pConnectEx);
+
+					// check if operation has failed
+					if (getResult == SOCKET_ERROR)
+					{
+						return nullptr;
+					}
+				}
+
 				// get pointer to DisconnectEx function
 				LPFN_DISCONNECTEX pDisconnectEx;
 				{
@@ -195,7 +213,24 @@ namespace SXN
 				}
 
 				// compose and return result
-				return new Winsock(pAcceptEx, pDisconnectEx, pGetAcceptExSockaddrs, rioTable);
+				return new Winsock(pAcceptEx, pConnectEx, pDisconnectEx, pGetAcceptExSockaddrs, rioTable);
+			}
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="Winsock" /> class with the specified implementation of the extensions.
+			/// </summary>
+			/// <param name="pAcceptEx">A pointer to the AcceptEx function.</param>
+			/// <param name="pConnectEx">A pointer to the ConnectEx function.</param>
+			/// <param name="pDisconnectEx">A pointer to the DisconnectEx function.</param>
+			/// <param name="pGetAcceptExSockaddrs">A pointer to the GetAcceptExSockaddrs function.</param>
+			/// <param name="rioFunctionsTable">A reference to the structure that contains the functions that implement the registered I/O extensions.</param>
+			/// <returns>A pointer to the instance of the class.</returns>
+			/// <remarks>
+			/// Is used to run the connections over the simulated network, see <c>SimulatedNetwork.h</c>.
+			/// </remarks>
+			static Winsock* Create(LPFN_ACCEPTEX pAcceptEx, LPFN_CONNECTEX pConnectEx, LPFN_DISCONNECTEX pDisconnectEx, LPFN_GETACCEPTEXSOCKADDRS pGetAcceptExSockaddrs, RIO_EXTENSION_FUNCTION_TABLE& rioFunctionsTable)
+			{
+				return new Winsock(pAcceptEx, pConnectEx, pDisconnectEx, pGetAcceptExSockaddrs, rioFunctionsTable);
 			}
 
 			#pragma endregion
@@ -219,6 +254,26 @@ namespace SXN
 				return pAcceptEx(sListenSocket, sAcceptSocket, lpOutputBuffer, dwReceiveDataLength, dwLocalAddressLength, dwRemoteAddressLength, lpdwBytesReceived, lpOverlapped);
 			}
 
+			/// <summary>
+			/// Establishes a connection to the specified foreign address, and optionally sends the first block of data.
+			/// </summary>
+			/// <param name="s">A descriptor that identifies an unconnected, previously bound socket.</param>
+			/// <param name="name">A pointer to the address of the foreign endpoint.</param>
+			/// <param name="namelen">The length, in bytes, of the address.</param>
+			/// <param name="lpSendBuffer">A pointer to the buffer to send after the connection is established, or <c>null</c>.</param>
+			/// <param name="dwSendDataLength">The length, in bytes, of the data to send.</param>
+			/// <param name="lpdwBytesSent">A pointer to the number of bytes sent, used only when the operation completes synchronously.</param>
+			/// <param name="lpOverlapped">A pointer to an <see cref="OVERLAPPED" /> structure used to process the request.</param>
+			/// <returns>
+			/// On success, returns TRUE.
+			/// On failure, the function returns FALSE.
+			/// If a call to the <see cref="WSAGetLastError"/> function returns <c>ERROR_IO_PENDING</c>, the operation initiated successfully and is in progress.
+			/// </returns>
+			inline BOOL ConnectEx(SOCKET s, const sockaddr* name, int namelen, PVOID lpSendBuffer, DWORD dwSendDataLength, LPDWORD lpdwBytesSent, LPOVERLAPPED lpOverlapped)
+			{
+				return pConnectEx(s, name, namelen, lpSendBuffer, dwSendDataLength, lpdwBytesSent, lpOverlapped);
+			}
+
 			/// <summary>
 			/// Closes a connection on a socket, and allows the socket handle to be reused.
 			/// </summary>
@@ -347,6 +402,27 @@ namespace SXN
 				return pRIOReceive(SocketQueue, pData, DataBufferCount, Flags, RequestContext);
 			}
 
+			/// <summary>
+			/// Receives network data on a bound registered I/O UDP socket along with the address of the sender for use with the Winsock registered I/O extensions.
+			/// </summary>
+			/// <param name="SocketQueue">A descriptor that identifies a bound registered I/O UDP socket.</param>
+			/// <param name="pData">A description of the portion of the registered buffer in which to receive data.</param>
+			/// <param name="DataBufferCount">A data buffer count parameter that indicates if data is to be received in the buffer pointed to by the <c>pData</c> parameter.</param>
+			/// <param name="pLocalAddress">A description of the portion of the registered buffer in which to receive the local address, or <c>null</c>.</param>
+			/// <param name="pRemoteAddress">A description of the portion of the registered buffer in which to receive the address of the sender, or <c>null</c>.</param>
+			/// <param name="pControlContext">A description of the portion of the registered buffer in which to receive the control information, or <c>null</c>.</param>
+			/// <param name="pFlags">A description of the portion of the registered buffer in which to receive the flags, or <c>null</c>.</param>
+			/// <param name="Flags">A set of flags that modify the behavior of the function.</param>
+			/// <param name="RequestContext">The request context to associate with this receive operation.</param>
+			/// <returns>
+			/// If no error occurs, returns <c>true</c>.
+			/// Otherwise, a value of <c>false</c> is returned, no completion indication will be queued, and a specific error code can be retrieved by calling the <see cref="WSAGetLastError" /> function.
+			/// </returns>
+			inline BOOL RIOReceiveEx(RIO_RQ SocketQueue, PRIO_BUF pData, ULONG DataBufferCount, PRIO_BUF pLocalAddress, PRIO_BUF pRemoteAddress, PRIO_BUF pControlContext, PRIO_BUF pFlags, DWORD Flags, PVOID RequestContext)
+			{
+				return pRIOReceiveEx(SocketQueue, pData, DataBufferCount, pLocalAddress, pRemoteAddress, pControlContext, pFlags, Flags, RequestContext);
+			}
+
 			/// <summary>
 			/// Registers a <see cref="RIO_BUFFERID" />, a registered buffer descriptor, with a specified buffer for use with the Winsock registered I/O extensions.
 			/// </summary>
@@ -405,6 +481,27 @@ namespace SXN
 				return pRIOSend(SocketQueue, pData, DataBufferCount, Flags, RequestContext);
 			}
 
+			/// <summary>
+			/// Sends network data on a bound registered I/O UDP socket to the specified address for use with the Winsock registered I/O extensions.
+			/// </summary>
+			/// <param name="SocketQueue">A descriptor that identifies a bound registered I/O UDP socket.</param>
+			/// <param name="pData">A description of the portion of the registered buffer from which to send data.</param>
+			/// <param name="DataBufferCount">A data buffer count parameter that indicates if data is to be sent in the buffer pointed to by the <c>pData</c> parameter.</param>
+			/// <param name="pLocalAddress">This parameter is reserved and must be <c>null</c>.</param>
+			/// <param name="pRemoteAddress">A description of the portion of the registered buffer that contains the address of the receiver.</param>
+			/// <param name="pControlContext">A description of the portion of the registered buffer that contains the control information, or <c>null</c>.</param>
+			/// <param name="pFlags">A description of the portion of the registered buffer that contains the flags, or <c>null</c>.</param>
+			/// <param name="Flags">A set of flags that modify the behavior of the function.</param>
+			/// <param name="RequestContext">The request context to associate with this send operation.</param>
+			/// <returns>
+			/// If no error occurs, returns <c>true</c>.
+			/// Otherwise, a value of <c>false</c> is returned, no completion indication will be queued, and a specific error code can be retrieved by calling the <see cref="WSAGetLastError" /> function.
+			/// </returns>
+			inline BOOL RIOSendEx(RIO_RQ SocketQueue, PRIO_BUF pData, DWORD DataBufferCount, PRIO_BUF pLocalAddress, PRIO_BUF pRemoteAddress, PRIO_BUF pControlContext, PRIO_BUF pFlags, DWORD Flags, PVOID RequestContext)
+			{
+				return pRIOSendEx(SocketQueue, pData, DataBufferCount, pLocalAddress, pRemoteAddress, pControlContext, pFlags, Flags, RequestContext);
+			}
+
 			#pragma endregion
 		};
 	}
@@ -6,6 +6,8 @@
 
 #include "TcpWorker.h"
 
+#include "UdpWorker.h"
+
 #include "ReceiveTask.h"
 
 #pragma unmanaged
\ No newline at end of file
@@ -0,0 +1,284 @@
+#pragma once
+
+#include "Stdafx.h"
+
+/// <summary>
+/// The number of bits of the value kept by the bucket of the <see cref="LoadHistogram" />, determines relative precision of about 3%.
+/// </summary>
+#define LOAD_SUB_BUCKET_BITS 5
+
+/// <summary>
+/// The count of the sub buckets within the single power of two.
+/// </summary>
+#define LOAD_SUB_BUCKETS_COUNT (1 << LOAD_SUB_BUCKET_BITS)
+
+/// <summary>
+/// The number of bits of the largest value tracked by the <see cref="LoadHistogram" />, about 18 minutes in nanoseconds.
+/// </summary>
+#define LOAD_VALUE_BITS 40
+
+/// <summary>
+/// The count of the buckets of the <see cref="LoadHistogram" />.
+/// </summary>
+#define LOAD_BUCKETS_COUNT ((LOAD_VALUE_BITS - LOAD_SUB_BUCKET_BITS + 1) * LOAD_SUB_BUCKETS_COUNT)
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Provides the histogram of the latencies, in nanoseconds, with the logarithmic buckets of the constant relative precision.
+		/// </summary>
+		/// <remarks>
+		/// Uses the same bucketing as the <c>LatencyHistogram</c> of the server, so the results of the client and the server are comparable.
+		/// Is written by the single thread, histograms of several threads are merged after the run.
+		/// </remarks>
+		class LoadHistogram final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The collection of the counts of the values within each bucket.
+			/// </summary>
+			ULONG64 buckets[LOAD_BUCKETS_COUNT];
+
+			/// <summary>
+			/// The count of the recorded values.
+			/// </summary>
+			ULONG64 totalCount;
+
+			/// <summary>
+			/// The sum of the recorded values.
+			/// </summary>
+			double totalSum;
+
+			/// <summary>
+			/// The smallest recorded value.
+			/// </summary>
+			ULONG64 minValue;
+
+			/// <summary>
+			/// The largest recorded value.
+			/// </summary>
+			ULONG64 maxValue;
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the index of the bucket that holds the value.
+			/// </summary>
+			inline static ULONG GetBucketIndex(ULONG64 value)
+			{
+				// small values are kept exactly
+				if (value < 2 * LOAD_SUB_BUCKETS_COUNT)
+				{
+					return (ULONG) value;
+				}
+
+				// get index of the most significant bit, 32 bit targets have no 64 bit scan
+				unsigned long topBit;
+
+				if ((value >> 32) != 0)
+				{
+					_BitScanReverse(&topBit, (unsigned long) (value >> 32));
+
+					topBit += 32;
+				}
+				else
+				{
+					_BitScanReverse(&topBit, (unsigned long) value);
+				}
+
+				// check if value is out of range
+				if (topBit >= LOAD_VALUE_BITS)
+				{
+					return LOAD_BUCKETS_COUNT - 1;
+				}
+
+				// keep significant bits only
+				auto shift = topBit - LOAD_SUB_BUCKET_BITS;
+
+				return (ULONG) (shift * LOAD_SUB_BUCKETS_COUNT + (value >> shift));
+			}
+
+			/// <summary>
+			/// Gets the lowest value that is held by the bucket.
+			/// </summary>
+			inline static ULONG64 GetBucketValue(ULONG bucketIndex)
+			{
+				if (bucketIndex < 2 * LOAD_SUB_BUCKETS_COUNT)
+				{
+					return bucketIndex;
+				}
+
+				auto shift = bucketIndex / LOAD_SUB_BUCKETS_COUNT - 1;
+
+				auto subBucket = (ULONG64) (bucketIndex % LOAD_SUB_BUCKETS_COUNT + LOAD_SUB_BUCKETS_COUNT);
+
+				return subBucket << shift;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="LoadHistogram" /> class.
+			/// </summary>
+			inline LoadHistogram()
+			{
+				Reset();
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Removes all recorded values.
+			/// </summary>
+			inline void Reset()
+			{
+				memset(buckets, 0, sizeof(buckets));
+
+				totalCount = 0;
+
+				totalSum = 0;
+
+				minValue = MAXULONG64;
+
+				maxValue = 0;
+			}
+
+			/// <summary>
+			/// Records the value.
+			/// </summary>
+			inline void Record(LONG64 value)
+			{
+				// clock is monotonic, negative values are not expected but are clamped to be safe
+				auto unsignedValue = value < 0 ? 0 : (ULONG64) value;
+
+				buckets[GetBucketIndex(unsignedValue)]++;
+
+				totalCount++;
+
+				totalSum += (double) unsignedValue;
+
+				if (unsignedValue < minValue)
+				{
+					minValue = unsignedValue;
+				}
+
+				if (unsignedValue > maxValue)
+				{
+					maxValue = unsignedValue;
+				}
+			}
+
+			/// <summary>
+			/// Adds the values recorded by the other histogram.
+			/// </summary>
+			inline void Merge(const LoadHistogram& other)
+			{
+				for (auto bucketIndex = 0; bucketIndex < LOAD_BUCKETS_COUNT; bucketIndex++)
+				{
+					buckets[bucketIndex] += other.buckets[bucketIndex];
+				}
+
+				totalCount += other.totalCount;
+
+				totalSum += other.totalSum;
+
+				if (other.minValue < minValue)
+				{
+					minValue = other.minValue;
+				}
+
+				if (other.maxValue > maxValue)
+				{
+					maxValue = other.maxValue;
+				}
+			}
+
+			/// <summary>
+			/// Gets the count of the recorded values.
+			/// </summary>
+			inline ULONG64 GetCount() const
+			{
+				return totalCount;
+			}
+
+			/// <summary>
+			/// Gets the smallest recorded value, or zero if nothing was recorded.
+			/// </summary>
+			inline ULONG64 GetMin() const
+			{
+				return totalCount == 0 ? 0 : minValue;
+			}
+
+			/// <summary>
+			/// Gets the largest recorded value.
+			/// </summary>
+			inline ULONG64 GetMax() const
+			{
+				return maxValue;
+			}
+
+			/// <summary>
+			/// Gets the mean of the recorded values, or zero if nothing was recorded.
+			/// </summary>
+			inline double GetMean() const
+			{
+				return totalCount == 0 ? 0 : totalSum / totalCount;
+			}
+
+			/// <summary>
+			/// Gets the value at the percentile.
+			/// </summary>
+			/// <param name="percentile">The percentile, from 0 to 100.</param>
+			/// <returns>The lowest value of the bucket that holds the percentile, clamped to the recorded range, or zero if nothing was recorded.</returns>
+			inline ULONG64 GetPercentile(double percentile) const
+			{
+				if (totalCount == 0)
+				{
+					return 0;
+				}
+
+				// get rank of the value at the percentile
+				auto rank = (ULONG64) ceil(totalCount * percentile / 100);
+
+				if (rank == 0)
+				{
+					rank = 1;
+				}
+
+				// find the bucket that holds the value
+				ULONG64 cumulativeCount = 0;
+
+				ULONG bucketIndex = 0;
+
+				for (; bucketIndex < LOAD_BUCKETS_COUNT - 1; bucketIndex++)
+				{
+					cumulativeCount += buckets[bucketIndex];
+
+					if (cumulativeCount >= rank)
+					{
+						break;
+					}
+				}
+
+				auto value = GetBucketValue(bucketIndex);
+
+				return value < minValue ? minValue : value > maxValue ? maxValue : value;
+			}
+
+			#pragma endregion
+		};
+	}
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include "Stdafx.h"
+
+/// <summary>
+/// The maximum number of the requests sent over the single connection without waiting for the responses.
+/// </summary>
+#define LOAD_MAX_PIPELINE_DEPTH 64
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Specifies how the requests are issued.
+		/// </summary>
+		enum LoadMode
+		{
+			/// <summary>
+			/// The next request is sent as soon as the response to the previous one is received.
+			/// </summary>
+			Closed,
+
+			/// <summary>
+			/// The requests are sent at the constant rate regardless of the responses.
+			/// </summary>
+			/// <remarks>
+			/// The latency is measured from the time when the request was scheduled to be sent, so the stalls of the server are not hidden by the client waiting for them (coordinated omission).
+			/// </remarks>
+			Open
+		};
+
+		/// <summary>
+		/// Specifies the configuration settings of the load generator.
+		/// </summary>
+		class LoadSettings final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The label of the run, copied into the report.
+			/// </summary>
+			const char* label;
+
+			/// <summary>
+			/// The host name or the address of the server.
+			/// </summary>
+			const char* host;
+
+			/// <summary>
+			/// The port of the server.
+			/// </summary>
+			const char* port;
+
+			/// <summary>
+			/// The count of the threads.
+			/// </summary>
+			ULONG threadsCount;
+
+			/// <summary>
+			/// The count of the connections, split evenly between the threads.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// The duration of the measurement, in seconds.
+			/// </summary>
+			double duration;
+
+			/// <summary>
+			/// The duration of the warm up which is not measured, in seconds.
+			/// </summary>
+			double warmup;
+
+			/// <summary>
+			/// The mode of issuing the requests.
+			/// </summary>
+			LoadMode mode;
+
+			/// <summary>
+			/// The total rate, in requests per second, of the open mode.
+			/// </summary>
+			double rate;
+
+			/// <summary>
+			/// The maximum number of the requests sent over the single connection without waiting for the responses.
+			/// </summary>
+			ULONG pipelineDepth;
+
+			/// <summary>
+			/// The number of the requests after which the connection is closed and opened again, or zero to keep connections open.
+			/// </summary>
+			ULONG churn;
+
+			/// <summary>
+			/// The length of the request, or zero for the shortest request.
+			/// </summary>
+			ULONG requestLength;
+
+			/// <summary>
+			/// The length of the response, or zero to detect the end of the response by the HTTP headers.
+			/// </summary>
+			ULONG responseLength;
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="LoadSettings" /> class with the default settings.
+			/// </summary>
+			inline LoadSettings()
+			{
+				SYSTEM_INFO systemInfo;
+
+				::GetSystemInfo(&systemInfo);
+
+				label = "";
+
+				host = "127.0.0.1";
+
+				port = "5001";
+
+				threadsCount = systemInfo.dwNumberOfProcessors;
+
+				connectionsCount = 64;
+
+				duration = 10;
+
+				warmup = 2;
+
+				mode = Closed;
+
+				rate = 0;
+
+				pipelineDepth = 1;
+
+				churn = 0;
+
+				requestLength = 0;
+
+				responseLength = 0;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Prints the description of the command line options.
+			/// </summary>
+			inline static void PrintUsage()
+			{
+				fprintf(stderr, "Usage: TcpServerLoad [options]\n");
+
+				fprintf(stderr, "  --label <text>          label of the run, copied into the report\n");
+
+				fprintf(stderr, "  --host <address>        host name or address of the server, default 127.0.0.1\n");
+
+				fprintf(stderr, "  --port <port>           port of the server, default 5001\n");
+
+				fprintf(stderr, "  --threads <count>       count of the threads, default count of the processors\n");
+
+				fprintf(stderr, "  --connections <count>   count of the connections, default 64\n");
+
+				fprintf(stderr, "  --duration <seconds>    duration of the measurement, default 10\n");
+
+				fprintf(stderr, "  --warmup <seconds>      duration of the warm up, default 2\n");
+
+				fprintf(stderr, "  --mode closed|open      closed loop or open loop at the constant rate, default closed\n");
+
+				fprintf(stderr, "  --rate <requests>       total requests per second of the open loop\n");
+
+				fprintf(stderr, "  --pipeline <depth>      requests in flight per connection, default 1, maximum %d\n", LOAD_MAX_PIPELINE_DEPTH);
+
+				fprintf(stderr, "  --churn <requests>      reconnect after the number of requests, default 0 keeps connections\n");
+
+				fprintf(stderr, "  --request-size <bytes>  length of the request, default shortest\n");
+
+				fprintf(stderr, "  --response-size <bytes> length of the response, default detected by HTTP headers\n");
+			}
+
+			/// <summary>
+			/// Parses the command line arguments.
+			/// </summary>
+			/// <returns><c>TRUE</c> if arguments are valid; otherwise, <c>FALSE</c>.</returns>
+			inline BOOL Parse(int argc, char* argv[])
+			{
+				for (auto index = 1; index < argc; index++)
+				{
+					auto name = argv[index];
+
+					// each option has the value
+					if (index + 1 == argc)
+					{
+						fprintf(stderr, "Option %s has no value\n", name);
+
+						return FALSE;
+					}
+
+					auto value = argv[++index];
+
+					if (strcmp(name, "--label") == 0)
+					{
+						label = value;
+					}
+					else if (strcmp(name, "--host") == 0)
+					{
+						host = value;
+					}
+					else if (strcmp(name, "--port") == 0)
+					{
+						port = value;
+					}
+					else if (strcmp(name, "--threads") == 0)
+					{
+						threadsCount = strtoul(value, nullptr, 10);
+					}
+					else if (strcmp(name, "--connections") == 0)
+					{
+						connectionsCount = strtoul(value, nullptr, 10);
+					}
+					else if (strcmp(name, "--duration") == 0)
+					{
+						duration = atof(value);
+					}
+					else if (strcmp(name, "--warmup") == 0)
+					{
+						warmup = atof(value);
+					}
+					else if (strcmp(name, "--mode") == 0)
+					{
+						if (strcmp(value, "closed") == 0)
+						{
+							mode = Closed;
+						}
+						else if (strcmp(value, "open") == 0)
+						{
+							mode = Open;
+						}
+						else
+						{
+							fprintf(stderr, "Mode %s is unknown\n", value);
+
+							return FALSE;
+						}
+					}
+					else if (strcmp(name, "--rate") == 0)
+					{
+						rate = atof(value);
+					}
+					else if (strcmp(name, "--pipeline") == 0)
+					{
+						pipelineDepth = strtoul(value, nullptr, 10);
+					}
+					else if (strcmp(name, "--churn") == 0)
+					{
+						churn = strtoul(value, nullptr, 10);
+					}
+					else if (strcmp(name, "--request-size") == 0)
+					{
+						requestLength = strtoul(value, nullptr, 10);
+					}
+					else if (strcmp(name, "--response-size") == 0)
+					{
+						responseLength = strtoul(value, nullptr, 10);
+					}
+					else
+					{
+						fprintf(stderr, "Option %s is unknown\n", name);
+
+						return FALSE;
+					}
+				}
+
+				// check values
+				if ((threadsCount == 0) || (connectionsCount < threadsCount))
+				{
+					fprintf(stderr, "Count of the connections must not be less than count of the threads\n");
+
+					return FALSE;
+				}
+
+				if ((pipelineDepth == 0) || (pipelineDepth > LOAD_MAX_PIPELINE_DEPTH))
+				{
+					fprintf(stderr, "Pipeline depth must be from 1 to %d\n", LOAD_MAX_PIPELINE_DEPTH);
+
+					return FALSE;
+				}
+
+				if ((mode == Open) && (rate <= 0))
+				{
+					fprintf(stderr, "Open mode requires positive rate\n");
+
+					return FALSE;
+				}
+
+				if ((duration <= 0) || (warmup < 0))
+				{
+					fprintf(stderr, "Duration must be positive\n");
+
+					return FALSE;
+				}
+
+				return TRUE;
+			}
+
+			#pragma endregion
+		};
+	}
+}
@@ -0,0 +1,1000 @@
+#pragma once
+
+#include "Stdafx.h"
+#include "LoadSettings.h"
+#include "LoadHistogram.h"
+
+/// <summary>
+/// The length of the buffer that accumulates the responses of the single connection.
+/// </summary>
+#define LOAD_RECEIVE_BUFFER_LENGTH 65536
+
+/// <summary>
+/// The maximum number of the completions dequeued by the worker at once.
+/// </summary>
+#define LOAD_COMPLETIONS_COUNT 256
+
+/// <summary>
+/// The connect operation.
+/// </summary>
+#define LOAD_ACTION_CONNECT 1
+
+/// <summary>
+/// The send operation.
+/// </summary>
+#define LOAD_ACTION_SEND 2
+
+/// <summary>
+/// The receive operation.
+/// </summary>
+#define LOAD_ACTION_RECEIVE 3
+
+namespace SXN
+{
+	namespace Net
+	{
+		class LoadConnection;
+
+		/// <summary>
+		/// Specifies the state of the client connection.
+		/// </summary>
+		enum LoadConnectionState
+		{
+			/// <summary>
+			/// The connection has no socket and should be connected.
+			/// </summary>
+			Idle,
+
+			/// <summary>
+			/// The connect is started.
+			/// </summary>
+			Connecting,
+
+			/// <summary>
+			/// The connection is established.
+			/// </summary>
+			Connected,
+
+			/// <summary>
+			/// The socket is closed, the connection waits for the completions of the operations which are still in flight.
+			/// </summary>
+			Closing
+		};
+
+		/// <summary>
+		/// Contains the overlapped structure together with the operation it belongs to.
+		/// </summary>
+		struct LoadOverlapped
+		{
+			/// <summary>
+			/// The overlapped structure.
+			/// </summary>
+			OVERLAPPED overlapped;
+
+			/// <summary>
+			/// A pointer to the connection.
+			/// </summary>
+			LoadConnection* connection;
+
+			/// <summary>
+			/// The operation, one of the <c>LOAD_ACTION_</c> values.
+			/// </summary>
+			ULONG action;
+		};
+
+		/// <summary>
+		/// Contains the counters of the single worker.
+		/// </summary>
+		struct LoadCounters
+		{
+			/// <summary>
+			/// The count of the responses received within the measurement.
+			/// </summary>
+			ULONG64 responsesCount;
+
+			/// <summary>
+			/// The count of the bytes sent within the measurement.
+			/// </summary>
+			ULONG64 bytesSent;
+
+			/// <summary>
+			/// The count of the bytes received within the measurement.
+			/// </summary>
+			ULONG64 bytesReceived;
+
+			/// <summary>
+			/// The count of the connections established.
+			/// </summary>
+			ULONG64 connectsCount;
+
+			/// <summary>
+			/// The count of the connections which have failed to be established.
+			/// </summary>
+			ULONG64 connectErrorsCount;
+
+			/// <summary>
+			/// The count of the connections closed by the server.
+			/// </summary>
+			ULONG64 closedByServerCount;
+
+			/// <summary>
+			/// The count of the failed operations and malformed responses.
+			/// </summary>
+			ULONG64 errorsCount;
+
+			/// <summary>
+			/// The count of the requests which were sent but have never been answered.
+			/// </summary>
+			ULONG64 lostRequestsCount;
+		};
+
+		/// <summary>
+		/// Provides the client connection that sends the requests and measures the latency of the responses.
+		/// </summary>
+		/// <remarks>
+		/// At most one send and one receive are in flight at once, the pipelined requests are sent by the single gathering send.
+		/// </remarks>
+		class LoadConnection final
+		{
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The state of the connection.
+			/// </summary>
+			LoadConnectionState state;
+
+			/// <summary>
+			/// The descriptor of the socket.
+			/// </summary>
+			SOCKET connectionSocket;
+
+			/// <summary>
+			/// The count of the operations in flight.
+			/// </summary>
+			ULONG operationsCount;
+
+			/// <summary>
+			/// The count of the requests which are sent by the send in flight.
+			/// </summary>
+			ULONG sendingCount;
+
+			/// <summary>
+			/// The index, within the <see cref="startTimes" />, of the oldest request which is not answered.
+			/// </summary>
+			ULONG firstPending;
+
+			/// <summary>
+			/// The count of the requests which are not answered, including the ones which are not sent.
+			/// </summary>
+			ULONG pendingCount;
+
+			/// <summary>
+			/// The count of the requests which are issued but are not sent.
+			/// </summary>
+			ULONG unsentCount;
+
+			/// <summary>
+			/// The count of the requests issued over the current socket.
+			/// </summary>
+			ULONG issuedCount;
+
+			/// <summary>
+			/// The time when the next request of the open mode is scheduled.
+			/// </summary>
+			LONG64 nextScheduled;
+
+			/// <summary>
+			/// The times from which the latencies of the pending requests are measured.
+			/// </summary>
+			LONG64 startTimes[LOAD_MAX_PIPELINE_DEPTH];
+
+			/// <summary>
+			/// The overlapped structure of the connect operation.
+			/// </summary>
+			LoadOverlapped connectOverlapped;
+
+			/// <summary>
+			/// The overlapped structure of the send operation.
+			/// </summary>
+			LoadOverlapped sendOverlapped;
+
+			/// <summary>
+			/// The overlapped structure of the receive operation.
+			/// </summary>
+			LoadOverlapped receiveOverlapped;
+
+			/// <summary>
+			/// The count of the bytes accumulated within the <see cref="receiveBuffer" />.
+			/// </summary>
+			ULONG receivedLength;
+
+			/// <summary>
+			/// The buffer that accumulates the responses.
+			/// </summary>
+			char receiveBuffer[LOAD_RECEIVE_BUFFER_LENGTH];
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Initializes the connection.
+			/// </summary>
+			inline void Initialize(LONG64 firstScheduled)
+			{
+				memset(this, 0, sizeof(LoadConnection));
+
+				state = Idle;
+
+				connectionSocket = INVALID_SOCKET;
+
+				nextScheduled = firstScheduled;
+
+				connectOverlapped.connection = this;
+
+				connectOverlapped.action = LOAD_ACTION_CONNECT;
+
+				sendOverlapped.connection = this;
+
+				sendOverlapped.action = LOAD_ACTION_SEND;
+
+				receiveOverlapped.connection = this;
+
+				receiveOverlapped.action = LOAD_ACTION_RECEIVE;
+			}
+
+			#pragma endregion
+		};
+
+		/// <summary>
+		/// Provides the thread that drives the subset of the client connections through its own completion port.
+		/// </summary>
+		class LoadWorker final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A reference to the settings of the run.
+			/// </summary>
+			const LoadSettings& settings;
+
+			/// <summary>
+			/// The address of the server.
+			/// </summary>
+			const ADDRINFOA* address;
+
+			/// <summary>
+			/// A pointer to the ConnectEx function.
+			/// </summary>
+			LPFN_CONNECTEX pConnectEx;
+
+			/// <summary>
+			/// The request.
+			/// </summary>
+			const char* request;
+
+			/// <summary>
+			/// The length of the request.
+			/// </summary>
+			ULONG requestLength;
+
+			/// <summary>
+			/// The frequency of the high resolution performance counter.
+			/// </summary>
+			LONG64 frequency;
+
+			/// <summary>
+			/// The time when the measurement starts.
+			/// </summary>
+			LONG64 measureStart;
+
+			/// <summary>
+			/// The time when the measurement ends.
+			/// </summary>
+			LONG64 measureEnd;
+
+			/// <summary>
+			/// The interval between the requests of the single connection in the open mode.
+			/// </summary>
+			LONG64 scheduleInterval;
+
+			/// <summary>
+			/// The completion port.
+			/// </summary>
+			HANDLE completionPort;
+
+			/// <summary>
+			/// The count of the connections.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// The collection of the connections.
+			/// </summary>
+			LoadConnection* connections;
+
+			/// <summary>
+			/// The count of the connections in the idle state.
+			/// </summary>
+			ULONG idleCount;
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The histogram of the latencies of the responses, in nanoseconds.
+			/// </summary>
+			LoadHistogram histogram;
+
+			/// <summary>
+			/// The counters of the worker.
+			/// </summary>
+			LoadCounters counters;
+
+			#pragma endregion
+
+			#pragma region Constructor and Destructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="LoadWorker" /> class.
+			/// </summary>
+			/// <param name="settings">The settings of the run.</param>
+			/// <param name="address">The address of the server.</param>
+			/// <param name="pConnectEx">A pointer to the ConnectEx function.</param>
+			/// <param name="request">The request.</param>
+			/// <param name="requestLength">The length of the request.</param>
+			/// <param name="startTime">The time when the run starts.</param>
+			/// <param name="firstConnectionIndex">The index of the first connection of the worker within all connections.</param>
+			/// <param name="connectionsCount">The count of the connections of the worker.</param>
+			inline LoadWorker(const LoadSettings& settings, const ADDRINFOA* address, LPFN_CONNECTEX pConnectEx, const char* request, ULONG requestLength, LONG64 startTime, ULONG firstConnectionIndex, ULONG connectionsCount)
+				: settings(settings)
+			{
+				this->address = address;
+
+				this->pConnectEx = pConnectEx;
+
+				this->request = request;
+
+				this->requestLength = requestLength;
+
+				::QueryPerformanceFrequency((LARGE_INTEGER*) &frequency);
+
+				measureStart = startTime + (LONG64) (settings.warmup * frequency);
+
+				measureEnd = measureStart + (LONG64) (settings.duration * frequency);
+
+				// each connection sends its share of the total rate
+				scheduleInterval = settings.mode == Open ? (LONG64) (frequency * settings.connectionsCount / settings.rate) : 0;
+
+				memset(&counters, 0, sizeof(LoadCounters));
+
+				completionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+
+				this->connectionsCount = connectionsCount;
+
+				connections = (LoadConnection*) ::VirtualAlloc(nullptr, sizeof(LoadConnection) * connectionsCount, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+				for (ULONG index = 0; index < connectionsCount; index++)
+				{
+					// spread the schedules of the connections evenly over the interval
+					auto firstScheduled = startTime + scheduleInterval * (firstConnectionIndex + index) / settings.connectionsCount;
+
+					connections[index].Initialize(firstScheduled);
+				}
+
+				idleCount = connectionsCount;
+			}
+
+			/// <summary>
+			/// Releases all associated resources.
+			/// </summary>
+			/// <remarks>
+			/// Must be called after the thread of the worker has stopped.
+			/// </remarks>
+			inline ~LoadWorker()
+			{
+				for (ULONG index = 0; index < connectionsCount; index++)
+				{
+					if (connections[index].connectionSocket != INVALID_SOCKET)
+					{
+						::closesocket(connections[index].connectionSocket);
+					}
+				}
+
+				// close completion port and ignore result
+				::CloseHandle(completionPort);
+
+				// operations cancelled by the close are not waited for, memory is released on exit of the process
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Checks if the worker has been initialized.
+			/// </summary>
+			inline BOOL IsValid()
+			{
+				return (completionPort != nullptr) && (connections != nullptr);
+			}
+
+			/// <summary>
+			/// The entry point of the thread of the worker.
+			/// </summary>
+			inline static DWORD WINAPI ThreadProc(LPVOID parameter)
+			{
+				((LoadWorker*) parameter)->Run();
+
+				return 0;
+			}
+
+			#pragma endregion
+
+			private:
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the current time in the units of the high resolution performance counter.
+			/// </summary>
+			inline static LONG64 GetTimestamp()
+			{
+				LARGE_INTEGER value;
+
+				::QueryPerformanceCounter(&value);
+
+				return value.QuadPart;
+			}
+
+			/// <summary>
+			/// Checks if the time is within the measurement.
+			/// </summary>
+			inline BOOL IsMeasured(LONG64 time)
+			{
+				return (time >= measureStart) && (time < measureEnd);
+			}
+
+			/// <summary>
+			/// Processes the completions until the end of the measurement.
+			/// </summary>
+			void Run()
+			{
+				OVERLAPPED_ENTRY entries[LOAD_COMPLETIONS_COUNT];
+
+				// the open mode wakes up each millisecond to send the scheduled requests
+				auto waitTime = settings.mode == Open ? 1 : 100;
+
+				while (true)
+				{
+					auto now = GetTimestamp();
+
+					if (now >= measureEnd)
+					{
+						break;
+					}
+
+					// connect idle connections and issue scheduled requests
+					if ((idleCount != 0) || (settings.mode == Open))
+					{
+						for (ULONG index = 0; index < connectionsCount; index++)
+						{
+							auto connection = connections + index;
+
+							if (connection->state == Idle)
+							{
+								Connect(connection);
+							}
+							else if (connection->state == Connected)
+							{
+								Issue(connection, now);
+
+								Send(connection);
+							}
+						}
+					}
+
+					ULONG entriesCount;
+
+					if (!::GetQueuedCompletionStatusEx(completionPort, entries, LOAD_COMPLETIONS_COUNT, &entriesCount, waitTime, FALSE))
+					{
+						continue;
+					}
+
+					for (ULONG entryIndex = 0; entryIndex < entriesCount; entryIndex++)
+					{
+						auto overlapped = (LoadOverlapped*) entries[entryIndex].lpOverlapped;
+
+						// status of the operation is kept by the overlapped structure
+						auto isSuccess = overlapped->overlapped.Internal == 0;
+
+						OnCompletion(overlapped->connection, overlapped->action, isSuccess, entries[entryIndex].dwNumberOfBytesTransferred);
+					}
+				}
+			}
+
+			/// <summary>
+			/// Starts the connect.
+			/// </summary>
+			void Connect(LoadConnection* connection)
+			{
+				idleCount--;
+
+				connection->state = Connecting;
+
+				connection->firstPending = 0;
+
+				connection->pendingCount = 0;
+
+				connection->unsentCount = 0;
+
+				connection->issuedCount = 0;
+
+				connection->receivedLength = 0;
+
+				// create socket
+				connection->connectionSocket = ::WSASocketW(address->ai_family, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+
+				if (connection->connectionSocket == INVALID_SOCKET)
+				{
+					OnConnectFailed(connection);
+
+					return;
+				}
+
+				// ConnectEx requires the socket to be bound
+				SOCKADDR_STORAGE localAddress;
+
+				memset(&localAddress, 0, sizeof(SOCKADDR_STORAGE));
+
+				localAddress.ss_family = (ADDRESS_FAMILY) address->ai_family;
+
+				if (::bind(connection->connectionSocket, (sockaddr*) &localAddress, (int) address->ai_addrlen) == SOCKET_ERROR)
+				{
+					OnConnectFailed(connection);
+
+					return;
+				}
+
+				// associate the socket with the completion port
+				if (::CreateIoCompletionPort((HANDLE) connection->connectionSocket, completionPort, 0, 0) == nullptr)
+				{
+					OnConnectFailed(connection);
+
+					return;
+				}
+
+				memset(&connection->connectOverlapped.overlapped, 0, sizeof(OVERLAPPED));
+
+				if (!pConnectEx(connection->connectionSocket, address->ai_addr, (int) address->ai_addrlen, nullptr, 0, nullptr, &connection->connectOverlapped.overlapped) && (::WSAGetLastError() != ERROR_IO_PENDING))
+				{
+					OnConnectFailed(connection);
+
+					return;
+				}
+
+				connection->operationsCount++;
+			}
+
+			/// <summary>
+			/// Returns the connection which has failed to start the connect to the idle state.
+			/// </summary>
+			void OnConnectFailed(LoadConnection* connection)
+			{
+				counters.connectErrorsCount++;
+
+				if (connection->connectionSocket != INVALID_SOCKET)
+				{
+					::closesocket(connection->connectionSocket);
+
+					connection->connectionSocket = INVALID_SOCKET;
+				}
+
+				connection->state = Idle;
+
+				idleCount++;
+			}
+
+			/// <summary>
+			/// Closes the socket of the connection, the connection becomes idle once all operations in flight are completed.
+			/// </summary>
+			void Close(LoadConnection* connection)
+			{
+				// requests which were sent are never answered
+				counters.lostRequestsCount += connection->pendingCount - connection->unsentCount;
+
+				// in the open mode the unsent requests stay scheduled
+				if (settings.mode == Open)
+				{
+					for (ULONG index = 0; index < connection->unsentCount; index++)
+					{
+						connection->nextScheduled -= scheduleInterval;
+					}
+				}
+
+				::closesocket(connection->connectionSocket);
+
+				connection->connectionSocket = INVALID_SOCKET;
+
+				connection->state = Closing;
+
+				TryRelease(connection);
+			}
+
+			/// <summary>
+			/// Returns the closing connection to the idle state if it has no operations in flight.
+			/// </summary>
+			inline void TryRelease(LoadConnection* connection)
+			{
+				if ((connection->state == Closing) && (connection->operationsCount == 0))
+				{
+					connection->state = Idle;
+
+					idleCount++;
+				}
+			}
+
+			/// <summary>
+			/// Issues the requests allowed by the mode, the pipeline depth and the churn.
+			/// </summary>
+			void Issue(LoadConnection* connection, LONG64 now)
+			{
+				while (connection->pendingCount < settings.pipelineDepth)
+				{
+					// check if connection should be reopened after the current requests
+					if ((settings.churn != 0) && (connection->issuedCount >= settings.churn))
+					{
+						return;
+					}
+
+					LONG64 startTime;
+
+					if (settings.mode == Open)
+					{
+						// check if the next request is due
+						if (connection->nextScheduled > now)
+						{
+							return;
+						}
+
+						// latency is measured from the scheduled time, so the delay caused by the server is not omitted
+						startTime = connection->nextScheduled;
+
+						connection->nextScheduled += scheduleInterval;
+					}
+					else
+					{
+						startTime = now;
+					}
+
+					connection->startTimes[(connection->firstPending + connection->pendingCount) % LOAD_MAX_PIPELINE_DEPTH] = startTime;
+
+					connection->pendingCount++;
+
+					connection->unsentCount++;
+
+					connection->issuedCount++;
+				}
+			}
+
+			/// <summary>
+			/// Starts the send of the issued requests if there is no send in flight.
+			/// </summary>
+			void Send(LoadConnection* connection)
+			{
+				if ((connection->sendingCount != 0) || (connection->unsentCount == 0))
+				{
+					return;
+				}
+
+				// gather all unsent requests into the single send
+				WSABUF buffers[LOAD_MAX_PIPELINE_DEPTH];
+
+				for (ULONG index = 0; index < connection->unsentCount; index++)
+				{
+					buffers[index].buf = (CHAR*) request;
+
+					buffers[index].len = requestLength;
+				}
+
+				connection->sendingCount = connection->unsentCount;
+
+				connection->unsentCount = 0;
+
+				memset(&connection->sendOverlapped.overlapped, 0, sizeof(OVERLAPPED));
+
+				if ((::WSASend(connection->connectionSocket, buffers, connection->sendingCount, nullptr, 0, &connection->sendOverlapped.overlapped, nullptr) == SOCKET_ERROR) && (::WSAGetLastError() != WSA_IO_PENDING))
+				{
+					connection->unsentCount = connection->sendingCount;
+
+					connection->sendingCount = 0;
+
+					counters.errorsCount++;
+
+					Close(connection);
+
+					return;
+				}
+
+				connection->operationsCount++;
+			}
+
+			/// <summary>
+			/// Starts the receive into the free space of the buffer.
+			/// </summary>
+			void Receive(LoadConnection* connection)
+			{
+				WSABUF buffer;
+
+				buffer.buf = connection->receiveBuffer + connection->receivedLength;
+
+				buffer.len = LOAD_RECEIVE_BUFFER_LENGTH - connection->receivedLength;
+
+				DWORD flags = 0;
+
+				memset(&connection->receiveOverlapped.overlapped, 0, sizeof(OVERLAPPED));
+
+				if ((::WSARecv(connection->connectionSocket, &buffer, 1, nullptr, &flags, &connection->receiveOverlapped.overlapped, nullptr) == SOCKET_ERROR) && (::WSAGetLastError() != WSA_IO_PENDING))
+				{
+					counters.errorsCount++;
+
+					Close(connection);
+
+					return;
+				}
+
+				connection->operationsCount++;
+			}
+
+			/// <summary>
+			/// Gets the length of the first response within the buffer.
+			/// </summary>
+			/// <returns>The length of the response if it is received completely; zero if more data is required; <c>MAXULONG</c> if response is malformed.</returns>
+			ULONG GetResponseLength(const char* data, ULONG length)
+			{
+				// check if responses have the fixed length
+				if (settings.responseLength != 0)
+				{
+					return length >= settings.responseLength ? settings.responseLength : 0;
+				}
+
+				// find the end of the headers
+				ULONG headersLength = 0;
+
+				for (ULONG index = 3; index < length; index++)
+				{
+					if ((data[index] == '\n') && (data[index - 1] == '\r') && (data[index - 2] == '\n') && (data[index - 3] == '\r'))
+					{
+						headersLength = index + 1;
+
+						break;
+					}
+				}
+
+				if (headersLength == 0)
+				{
+					return length == LOAD_RECEIVE_BUFFER_LENGTH ? MAXULONG : 0;
+				}
+
+				// find the length of the body
+				ULONG64 contentLength = 0;
+
+				static const char contentLengthName[] = "\r\ncontent-length:";
+
+				const auto nameLength = sizeof(contentLengthName) - 1;
+
+				for (ULONG index = 0; index + nameLength < headersLength; index++)
+				{
+					if (_strnicmp(data + index, contentLengthName, nameLength) == 0)
+					{
+						contentLength = _strtoui64(data + index + nameLength, nullptr, 10);
+
+						break;
+					}
+				}
+
+				auto responseLength = headersLength + contentLength;
+
+				if (responseLength > LOAD_RECEIVE_BUFFER_LENGTH)
+				{
+					return MAXULONG;
+				}
+
+				return length >= responseLength ? (ULONG) responseLength : 0;
+			}
+
+			/// <summary>
+			/// Processes the completion of the operation.
+			/// </summary>
+			void OnCompletion(LoadConnection* connection, ULONG action, BOOL isSuccess, DWORD bytesTransferred)
+			{
+				connection->operationsCount--;
+
+				// check if socket is already closed
+				if (connection->state == Closing)
+				{
+					if (action == LOAD_ACTION_SEND)
+					{
+						connection->sendingCount = 0;
+					}
+
+					TryRelease(connection);
+
+					return;
+				}
+
+				auto now = GetTimestamp();
+
+				switch (action)
+				{
+					case LOAD_ACTION_CONNECT:
+					{
+						if (!isSuccess)
+						{
+							counters.connectErrorsCount++;
+
+							Close(connection);
+
+							return;
+						}
+
+						// update context of the socket and disable Nagle algorithm, ignore results
+						::setsockopt(connection->connectionSocket, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0);
+
+						BOOL noDelay = TRUE;
+
+						::setsockopt(connection->connectionSocket, IPPROTO_TCP, TCP_NODELAY, (const char*) &noDelay, sizeof(BOOL));
+
+						counters.connectsCount++;
+
+						connection->state = Connected;
+
+						Receive(connection);
+
+						break;
+					}
+
+					case LOAD_ACTION_SEND:
+					{
+						auto sentCount = connection->sendingCount;
+
+						connection->sendingCount = 0;
+
+						if (!isSuccess || (bytesTransferred != sentCount * requestLength))
+						{
+							counters.errorsCount++;
+
+							Close(connection);
+
+							return;
+						}
+
+						if (IsMeasured(now))
+						{
+							counters.bytesSent += bytesTransferred;
+						}
+
+						break;
+					}
+
+					case LOAD_ACTION_RECEIVE:
+					{
+						if (!isSuccess)
+						{
+							counters.errorsCount++;
+
+							Close(connection);
+
+							return;
+						}
+
+						if (bytesTransferred == 0)
+						{
+							counters.closedByServerCount++;
+
+							Close(connection);
+
+							return;
+						}
+
+						if (IsMeasured(now))
+						{
+							counters.bytesReceived += bytesTransferred;
+						}
+
+						connection->receivedLength += bytesTransferred;
+
+						if (!OnReceived(connection, now))
+						{
+							counters.errorsCount++;
+
+							Close(connection);
+
+							return;
+						}
+
+						// check if connection should be reopened
+						if ((settings.churn != 0) && (connection->issuedCount >= settings.churn) && (connection->pendingCount == 0))
+						{
+							Close(connection);
+
+							return;
+						}
+
+						Receive(connection);
+
+						if (connection->state != Connected)
+						{
+							return;
+						}
+
+						break;
+					}
+				}
+
+				Issue(connection, now);
+
+				Send(connection);
+			}
+
+			/// <summary>
+			/// Processes the complete responses within the buffer.
+			/// </summary>
+			/// <returns><c>TRUE</c> if responses are valid; otherwise, <c>FALSE</c>.</returns>
+			BOOL OnReceived(LoadConnection* connection, LONG64 now)
+			{
+				ULONG offset = 0;
+
+				while (offset < connection->receivedLength)
+				{
+					auto responseLength = GetResponseLength(connection->receiveBuffer + offset, connection->receivedLength - offset);
+
+					if (responseLength == 0)
+					{
+						break;
+					}
+
+					// check if response is malformed or is not requested
+					if ((responseLength == MAXULONG) || (connection->pendingCount == connection->unsentCount))
+					{
+						return FALSE;
+					}
+
+					auto startTime = connection->startTimes[connection->firstPending];
+
+					connection->firstPending = (connection->firstPending + 1) % LOAD_MAX_PIPELINE_DEPTH;
+
+					connection->pendingCount--;
+
+					if (IsMeasured(now))
+					{
+						counters.responsesCount++;
+
+						histogram.Record((LONG64) ((now - startTime) * 1000000000.0 / frequency));
+					}
+
+					offset += responseLength;
+				}
+
+				// move the incomplete response to the start of the buffer
+				if (offset != 0)
+				{
+					connection->receivedLength -= offset;
+
+					memmove(connection->receiveBuffer, connection->receiveBuffer + offset, connection->receivedLength);
+				}
+
+				return TRUE;
+			}
+
+			#pragma endregion
+		};
+	}
+}
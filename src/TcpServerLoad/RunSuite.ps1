@@ -0,0 +1,105 @@
+<#
+.SYNOPSIS
+	Runs the benchmark suite against each server and compares the results with the baseline.
+
+.DESCRIPTION
+	Each server must be started on the loopback before the suite is run.
+	Each scenario of the suite is run against each server by the TcpServerLoad tool, results are written as JSON array.
+	If the baseline is specified, the run fails when the throughput drops or the 99th percentile of the latency grows by more than the tolerance.
+
+.EXAMPLE
+	.\RunSuite.ps1 -Targets @{ "TcpServerCli" = "127.0.0.1:5001"; "TcpServer" = "127.0.0.1:5002" } -Output results.json -Baseline baseline.json
+#>
+param
+(
+	[Parameter(Mandatory = $true)]
+	[hashtable] $Targets,
+
+	[string] $Tool = (Join-Path $PSScriptRoot "..\..\x64\Release\TcpServerLoad.exe"),
+
+	[string] $Output = "results.json",
+
+	[string] $Baseline,
+
+	[double] $Tolerance = 0.1,
+
+	[int] $Duration = 10,
+
+	[int] $Warmup = 2
+)
+
+$ErrorActionPreference = "Stop"
+
+# the scenarios of the suite
+$scenarios =
+@(
+	@{ Name = "closed-c64-p1"; Arguments = @("--mode", "closed", "--connections", "64", "--pipeline", "1") },
+	@{ Name = "closed-c256-p16"; Arguments = @("--mode", "closed", "--connections", "256", "--pipeline", "16") },
+	@{ Name = "closed-c64-churn1"; Arguments = @("--mode", "closed", "--connections", "64", "--churn", "1") },
+	@{ Name = "closed-c64-req4k"; Arguments = @("--mode", "closed", "--connections", "64", "--request-size", "4096") },
+	@{ Name = "open-c256-r50k"; Arguments = @("--mode", "open", "--connections", "256", "--rate", "50000") }
+)
+
+$results = @()
+
+foreach ($targetName in ($Targets.Keys | Sort-Object))
+{
+	$hostName, $port = $Targets[$targetName] -split ":(?=[^:]+$)"
+
+	foreach ($scenario in $scenarios)
+	{
+		$label = "$targetName/$($scenario.Name)"
+
+		Write-Host "running $label"
+
+		$arguments = @("--label", $label, "--host", $hostName.Trim("[]"), "--port", $port, "--duration", $Duration, "--warmup", $Warmup) + $scenario.Arguments
+
+		$report = & $Tool @arguments | Out-String
+
+		if ($LASTEXITCODE -ne 0)
+		{
+			throw "run $label has failed with code $LASTEXITCODE"
+		}
+
+		$results += $report | ConvertFrom-Json
+	}
+}
+
+ConvertTo-Json -InputObject $results -Depth 4 | Set-Content $Output
+
+# compare with the baseline
+if (-not $Baseline)
+{
+	return
+}
+
+$regressions = @()
+
+$baselineResults = Get-Content $Baseline -Raw | ConvertFrom-Json
+
+foreach ($result in $results)
+{
+	$reference = $baselineResults | Where-Object { $_.label -eq $result.label } | Select-Object -First 1
+
+	if (-not $reference)
+	{
+		continue
+	}
+
+	if ($result.throughput -lt $reference.throughput * (1 - $Tolerance))
+	{
+		$regressions += "$($result.label): throughput $($result.throughput) < $($reference.throughput)"
+	}
+
+	if ($result.latencyMicroseconds.p99 -gt $reference.latencyMicroseconds.p99 * (1 + $Tolerance))
+	{
+		$regressions += "$($result.label): p99 $($result.latencyMicroseconds.p99) us > $($reference.latencyMicroseconds.p99) us"
+	}
+}
+
+if ($regressions.Count -ne 0)
+{
+	$regressions | ForEach-Object { Write-Host $_ }
+
+	exit 1
+}
@@ -0,0 +1,23 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently,
+// but are changed infrequently
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <WinSock2.h>
+
+#include <MSWSock.h>
+
+#include <WS2tcpip.h>
+
+#include <math.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#pragma comment(lib, "Ws2_32.lib")
@@ -0,0 +1,274 @@
+// Generates the load against the server and reports the throughput and the latency percentiles as JSON.
+
+#include "Stdafx.h"
+#include "LoadSettings.h"
+#include "LoadHistogram.h"
+#include "LoadWorker.h"
+
+using namespace SXN::Net;
+
+/// <summary>
+/// Composes the HTTP request of the requested length.
+/// </summary>
+/// <returns>The length of the request.</returns>
+static ULONG ComposeRequest(const LoadSettings& settings, char*& request)
+{
+	char head[256];
+
+	auto headLength = (ULONG) sprintf_s(head, "GET / HTTP/1.1\r\nHost: %s\r\n", settings.host);
+
+	static const char paddingName[] = "X-Padding: ";
+
+	// head, padding header and the empty line
+	auto minPaddedLength = headLength + (ULONG) sizeof(paddingName) - 1 + 4;
+
+	auto length = settings.requestLength > minPaddedLength ? settings.requestLength : headLength + 2;
+
+	request = (char*) malloc(length);
+
+	memcpy(request, head, headLength);
+
+	auto position = headLength;
+
+	// pad the request to the requested length by the ignored header
+	if (length > headLength + 2)
+	{
+		memcpy(request + position, paddingName, sizeof(paddingName) - 1);
+
+		position += sizeof(paddingName) - 1;
+
+		auto paddingLength = length - minPaddedLength;
+
+		memset(request + position, 'x', paddingLength);
+
+		position += paddingLength;
+
+		memcpy(request + position, "\r\n", 2);
+
+		position += 2;
+	}
+
+	memcpy(request + position, "\r\n", 2);
+
+	return length;
+}
+
+/// <summary>
+/// Gets the pointer to the ConnectEx function for the address family.
+/// </summary>
+static LPFN_CONNECTEX GetConnectEx(int addressFamily)
+{
+	auto socket = ::WSASocketW(addressFamily, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+
+	if (socket == INVALID_SOCKET)
+	{
+		return nullptr;
+	}
+
+	GUID extensionId = WSAID_CONNECTEX;
+
+	LPFN_CONNECTEX result = nullptr;
+
+	DWORD bytesReturned;
+
+	::WSAIoctl(socket, SIO_GET_EXTENSION_FUNCTION_POINTER, &extensionId, sizeof(GUID), &result, sizeof(LPFN_CONNECTEX), &bytesReturned, nullptr, nullptr);
+
+	::closesocket(socket);
+
+	return result;
+}
+
+/// <summary>
+/// Prints the report of the run as JSON.
+/// </summary>
+static void PrintReport(const LoadSettings& settings, const LoadCounters& counters, const LoadHistogram& histogram)
+{
+	printf("{\n");
+
+	printf("  \"label\": \"%s\",\n", settings.label);
+
+	printf("  \"target\": \"%s:%s\",\n", settings.host, settings.port);
+
+	printf("  \"mode\": \"%s\",\n", settings.mode == Open ? "open" : "closed");
+
+	printf("  \"rate\": %.0f,\n", settings.rate);
+
+	printf("  \"threads\": %lu,\n", settings.threadsCount);
+
+	printf("  \"connections\": %lu,\n", settings.connectionsCount);
+
+	printf("  \"pipeline\": %lu,\n", settings.pipelineDepth);
+
+	printf("  \"churn\": %lu,\n", settings.churn);
+
+	printf("  \"durationSeconds\": %.3f,\n", settings.duration);
+
+	printf("  \"responses\": %llu,\n", counters.responsesCount);
+
+	printf("  \"throughput\": %.1f,\n", counters.responsesCount / settings.duration);
+
+	printf("  \"bytesSent\": %llu,\n", counters.bytesSent);
+
+	printf("  \"bytesReceived\": %llu,\n", counters.bytesReceived);
+
+	printf("  \"connects\": %llu,\n", counters.connectsCount);
+
+	printf("  \"connectErrors\": %llu,\n", counters.connectErrorsCount);
+
+	printf("  \"closedByServer\": %llu,\n", counters.closedByServerCount);
+
+	printf("  \"errors\": %llu,\n", counters.errorsCount);
+
+	printf("  \"lostRequests\": %llu,\n", counters.lostRequestsCount);
+
+	printf("  \"latencyMicroseconds\": {\n");
+
+	printf("    \"min\": %.3f,\n", histogram.GetMin() / 1000.0);
+
+	printf("    \"mean\": %.3f,\n", histogram.GetMean() / 1000.0);
+
+	printf("    \"p50\": %.3f,\n", histogram.GetPercentile(50) / 1000.0);
+
+	printf("    \"p90\": %.3f,\n", histogram.GetPercentile(90) / 1000.0);
+
+	printf("    \"p99\": %.3f,\n", histogram.GetPercentile(99) / 1000.0);
+
+	printf("    \"p999\": %.3f,\n", histogram.GetPercentile(99.9) / 1000.0);
+
+	printf("    \"max\": %.3f\n", histogram.GetMax() / 1000.0);
+
+	printf("  }\n");
+
+	printf("}\n");
+}
+
+int main(int argc, char* argv[])
+{
+	LoadSettings settings;
+
+	if (!settings.Parse(argc, argv))
+	{
+		LoadSettings::PrintUsage();
+
+		return 1;
+	}
+
+	// initialize Winsock
+	WSADATA data;
+
+	if (::WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		fprintf(stderr, "Winsock startup has failed\n");
+
+		return 2;
+	}
+
+	// resolve address of the server
+	ADDRINFOA hints;
+
+	memset(&hints, 0, sizeof(ADDRINFOA));
+
+	hints.ai_family = AF_UNSPEC;
+
+	hints.ai_socktype = SOCK_STREAM;
+
+	hints.ai_protocol = IPPROTO_TCP;
+
+	PADDRINFOA address;
+
+	if (::getaddrinfo(settings.host, settings.port, &hints, &address) != 0)
+	{
+		fprintf(stderr, "Can not resolve %s:%s, error %d\n", settings.host, settings.port, ::WSAGetLastError());
+
+		return 3;
+	}
+
+	auto pConnectEx = GetConnectEx(address->ai_family);
+
+	if (pConnectEx == nullptr)
+	{
+		fprintf(stderr, "Can not get ConnectEx, error %d\n", ::WSAGetLastError());
+
+		return 4;
+	}
+
+	char* request;
+
+	auto requestLength = ComposeRequest(settings, request);
+
+	// create workers, connections are split evenly
+	LARGE_INTEGER startTime;
+
+	::QueryPerformanceCounter(&startTime);
+
+	auto workers = new LoadWorker*[settings.threadsCount];
+
+	auto threads = new HANDLE[settings.threadsCount];
+
+	ULONG firstConnectionIndex = 0;
+
+	for (ULONG workerIndex = 0; workerIndex < settings.threadsCount; workerIndex++)
+	{
+		auto connectionsCount = settings.connectionsCount / settings.threadsCount + (workerIndex < settings.connectionsCount % settings.threadsCount ? 1 : 0);
+
+		workers[workerIndex] = new LoadWorker(settings, address, pConnectEx, request, requestLength, startTime.QuadPart, firstConnectionIndex, connectionsCount);
+
+		if (!workers[workerIndex]->IsValid())
+		{
+			fprintf(stderr, "Can not initialize worker, error %d\n", ::GetLastError());
+
+			return 5;
+		}
+
+		firstConnectionIndex += connectionsCount;
+	}
+
+	for (ULONG workerIndex = 0; workerIndex < settings.threadsCount; workerIndex++)
+	{
+		threads[workerIndex] = ::CreateThread(nullptr, 0, &LoadWorker::ThreadProc, workers[workerIndex], 0, nullptr);
+	}
+
+	// wait for workers and merge results
+	LoadCounters counters;
+
+	memset(&counters, 0, sizeof(LoadCounters));
+
+	auto histogram = new LoadHistogram();
+
+	for (ULONG workerIndex = 0; workerIndex < settings.threadsCount; workerIndex++)
+	{
+		::WaitForSingleObject(threads[workerIndex], INFINITE);
+
+		::CloseHandle(threads[workerIndex]);
+
+		auto worker = workers[workerIndex];
+
+		histogram->Merge(worker->histogram);
+
+		counters.responsesCount += worker->counters.responsesCount;
+
+		counters.bytesSent += worker->counters.bytesSent;
+
+		counters.bytesReceived += worker->counters.bytesReceived;
+
+		counters.connectsCount += worker->counters.connectsCount;
+
+		counters.connectErrorsCount += worker->counters.connectErrorsCount;
+
+		counters.closedByServerCount += worker->counters.closedByServerCount;
+
+		counters.errorsCount += worker->counters.errorsCount;
+
+		counters.lostRequestsCount += worker->counters.lostRequestsCount;
+
+		delete worker;
+	}
+
+	PrintReport(settings, counters, *histogram);
+
+	::freeaddrinfo(address);
+
+	::WSACleanup();
+
+	return 0;
+}
@@ -0,0 +1,905 @@
+#pragma once
+
+#include "Stdafx.h"
+
+/// <summary>
+/// The count of the results dequeued at once, equals the size of the batch dequeued by the worker.
+/// </summary>
+#define SIMULATED_WORKER_BATCH_LENGTH 1024
+
+/// <summary>
+/// The interval, in microseconds of the simulated time, between the checks of the idle connections.
+/// </summary>
+#define SIMULATED_WORKER_IDLE_INTERVAL 100
+
+#pragma unmanaged
+
+namespace SXN
+{
+	namespace Net
+	{
+		/// <summary>
+		/// Contains the counters of the simulation, which are not published by the server.
+		/// </summary>
+		struct SimulationCounters
+		{
+			/// <summary>
+			/// The count of the requests which have been answered.
+			/// </summary>
+			ULONG64 requestsCount;
+
+			/// <summary>
+			/// The count of the connections closed because of the error or because the client has closed them.
+			/// </summary>
+			ULONG64 closedCount;
+
+			/// <summary>
+			/// The count of the connections closed because they have waited for the next request longer than the keep-alive timeout.
+			/// </summary>
+			ULONG64 idleClosedCount;
+
+			/// <summary>
+			/// The count of the connections closed because the request does not fit the largest receive segment.
+			/// </summary>
+			ULONG64 malformedCount;
+
+			/// <summary>
+			/// The count of the connections disconnected by the server while the receive has been in flight.
+			/// </summary>
+			ULONG64 abortsCount;
+
+			/// <summary>
+			/// The count of the receives that have not completed the request.
+			/// </summary>
+			ULONG64 partialReceivesCount;
+
+			/// <summary>
+			/// The count of the receive segments replaced by the larger ones.
+			/// </summary>
+			ULONG64 growsCount;
+
+			/// <summary>
+			/// The count of the sends that have not transferred the whole response.
+			/// </summary>
+			ULONG64 partialSendsCount;
+
+			/// <summary>
+			/// The count of the late completions dropped because they belong to the previous connection of the slot or the state of the slot does not expect them.
+			/// </summary>
+			ULONG64 lateIgnoredCount;
+
+			/// <summary>
+			/// The count of the late completions dispatched to the next connection of the slot.
+			/// </summary>
+			ULONG64 lateMisattributedCount;
+
+			/// <summary>
+			/// The count of the completions which are neither late nor expected by the state of the slot.
+			/// </summary>
+			ULONG64 unexpectedCount;
+		};
+
+		/// <summary>
+		/// Contains the settings of the simulated worker, which are the settings of the <see cref="IocpWorker" /> it runs like.
+		/// </summary>
+		struct SimulatedWorkerSettings
+		{
+			/// <summary>
+			/// The count of the connections served by the handler.
+			/// </summary>
+			ULONG servedConnectionsCount;
+
+			/// <summary>
+			/// The count of the connections forwarded to the upstream.
+			/// </summary>
+			ULONG forwardedConnectionsCount;
+
+			/// <summary>
+			/// The count of the connections to the upstream.
+			/// </summary>
+			ULONG upstreamConnectionsCount;
+
+			/// <summary>
+			/// The length of the receive segment of the forwarded and the upstream connections, by which the larger size classes are sized.
+			/// </summary>
+			ULONG receiveSegmentLength;
+
+			/// <summary>
+			/// The time, in microseconds of the simulated time, the connection waits for the next request, or zero if it waits without limit.
+			/// </summary>
+			ULONG64 keepAliveTimeout;
+
+			/// <summary>
+			/// The maximum count of the requests served by the single connection, or zero if the count is not limited.
+			/// </summary>
+			ULONG maxKeepAliveRequests;
+
+			/// <summary>
+			/// The maximum number of the connections served at once, or zero if the number is not limited.
+			/// </summary>
+			ULONG maxActiveConnections;
+
+			/// <summary>
+			/// The minimum number of the connections the free buffer segments are enough for, required to admit a connection.
+			/// </summary>
+			ULONG minAvailableBuffers;
+
+			/// <summary>
+			/// The probability of the connection to be disconnected by the server right after the start of the receive.
+			/// </summary>
+			ULONG abortPercent;
+
+			/// <summary>
+			/// A pointer to the response sent to each request.
+			/// </summary>
+			const char* response;
+
+			/// <summary>
+			/// A pointer to the response sent to the refused connection.
+			/// </summary>
+			const char* busyResponse;
+		};
+
+		/// <summary>
+		/// Runs the connections of the single worker over the <see cref="SimulatedNetwork" />.
+		/// </summary>
+		/// <remarks>
+		/// Drives the <see cref="ConnectionLifecycle" /> the <see cref="IocpWorker" /> uses within the single thread: the admission, the rent and the return of the segments,
+		/// the growth of the receive, the keep-alive, the idle close, the refusal and the forwarding are the ones of the server, only the Winsock functions are simulated
+		/// and the handler, which answers each request with the same response, is the minimal one.
+		/// The completions are classified by the <see cref="CompletionDispatch" /> the worker uses, the late completions are detected by the network and counted.
+		/// The overlapped accepts, connects and disconnects are dispatched by their actions, as the accept thread and the worker thread do.
+		/// </remarks>
+		class SimulatedWorker final
+		{
+			private:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// A pointer to the simulated network.
+			/// </summary>
+			SimulatedNetwork* network;
+
+			/// <summary>
+			/// A pointer to the object that provides work with the Winsock extensions over the simulated network.
+			/// </summary>
+			Winsock* winsock;
+
+			/// <summary>
+			/// The completion queue of the Registered I/O operations.
+			/// </summary>
+			RIO_CQ rioCompletionQueue;
+
+			/// <summary>
+			/// The Registered I/O buffer pool.
+			/// </summary>
+			RioSizeClassPool* rioBufferPool;
+
+			/// <summary>
+			/// The storage of the connections.
+			/// </summary>
+			ConnectionTable* connectionTable;
+
+			/// <summary>
+			/// The admission control of the worker.
+			/// </summary>
+			AdmissionControl* admissionControl;
+
+			/// <summary>
+			/// The pool of the connections to the upstream, or <c>null</c> if there are no upstream connections.
+			/// </summary>
+			UpstreamPool* upstreamPool;
+
+			/// <summary>
+			/// The transitions of the slots, which are the ones of the server.
+			/// </summary>
+			ConnectionLifecycle* lifecycle;
+
+			/// <summary>
+			/// The listeners of the served and the forwarded connections.
+			/// </summary>
+			TcpListener listeners[2];
+
+			/// <summary>
+			/// The upstream the forwarded connections are forwarded to.
+			/// </summary>
+			TcpUpstream upstream;
+
+			/// <summary>
+			/// The counters of the worker.
+			/// </summary>
+			WorkerCounters* counters;
+
+			/// <summary>
+			/// The trace ring of the worker.
+			/// </summary>
+			TraceRing* trace;
+
+			/// <summary>
+			/// The count of the slots of the connections.
+			/// </summary>
+			ULONG connectionsCount;
+
+			/// <summary>
+			/// The registered buffer that contains the busy response.
+			/// </summary>
+			PCHAR busyBuffer;
+
+			/// <summary>
+			/// The descriptor of the busy response.
+			/// </summary>
+			RIO_BUF busyResponse;
+
+			/// <summary>
+			/// The collection of the counts of the bytes of the response sent, one per connection.
+			/// </summary>
+			ULONG* sentLengths;
+
+			/// <summary>
+			/// The collection of the flags that indicate whether the connection is kept alive after the response, one per connection.
+			/// </summary>
+			UCHAR* keepAlives;
+
+			/// <summary>
+			/// The response sent to each request.
+			/// </summary>
+			const char* response;
+
+			/// <summary>
+			/// The length of the response.
+			/// </summary>
+			ULONG responseLength;
+
+			/// <summary>
+			/// The time the connection waits for the next request, or zero if it waits without limit.
+			/// </summary>
+			ULONG64 keepAliveTimeout;
+
+			/// <summary>
+			/// The tick count of the last check of the idle connections.
+			/// </summary>
+			ULONG64 idleCheckTime;
+
+			/// <summary>
+			/// The probability of the connection to be disconnected by the server right after the start of the receive.
+			/// </summary>
+			ULONG abortPercent;
+
+			/// <summary>
+			/// The request parsed by the handler.
+			/// </summary>
+			HttpRequest request;
+
+			/// <summary>
+			/// The array to receive the results of the completions.
+			/// </summary>
+			RIORESULT rioResults[SIMULATED_WORKER_BATCH_LENGTH];
+
+			#pragma endregion
+
+			#pragma region Constructor
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="SimulatedWorker" /> class.
+			/// </summary>
+			inline SimulatedWorker()
+			{
+				memset(this, 0, sizeof(SimulatedWorker));
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Gets the tick count of the simulated time, in microseconds, which the <see cref="ConnectionLifecycle" /> measures the idle time with.
+			/// </summary>
+			inline ULONG64 GetTickCount()
+			{
+				return network->GetTime() / 1000;
+			}
+
+			/// <summary>
+			/// Starts the receive of the first request, as the handler does when it starts serving the connection.
+			/// </summary>
+			inline void BeginReceive(TcpConnection* connection)
+			{
+				auto fromState = connection->state;
+
+				auto res = connection->StartRecieve();
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+
+				// the server gives up on the connection while the receive is in flight, as it does on shutdown
+				if (res && (abortPercent != 0) && (network->GetRandom() % 100 < abortPercent))
+				{
+					simulationCounters.abortsCount++;
+
+					lifecycle->Disconnect(connection);
+				}
+			}
+
+			/// <summary>
+			/// Starts the send of the rest of the response.
+			/// </summary>
+			inline void BeginSend(TcpConnection* connection)
+			{
+				auto fromState = connection->state;
+
+				auto sentLength = sentLengths[connection->id];
+
+				BOOL res;
+
+				if (sentLength == 0)
+				{
+					memcpy(lifecycle->GetData(connection->rioSendBuffer), response, responseLength);
+
+					res = connection->StartSend(responseLength);
+				}
+				else
+				{
+					// continue from the first byte which has not been sent
+					RIO_BUF rest = connection->rioSendBuffer;
+
+					rest.Offset += sentLength;
+
+					rest.Length = responseLength - sentLength;
+
+					connection->state = ConnectionState::Sending;
+
+					res = connection->PostSend(&rest, 1, connection->GetRequestContext());
+				}
+
+				trace->Record(connection, fromState, 0, TraceRing::GetError(res));
+			}
+
+			/// <summary>
+			/// Receives the rest of the request, replaces the receive segment with the larger one if the request fills it, as the handler does.
+			/// </summary>
+			inline void ReceiveNext(TcpConnection* connection)
+			{
+				if (!lifecycle->CompactReceive(connection))
+				{
+					lifecycle->ReceiveNext(connection, GetTickCount());
+
+					return;
+				}
+
+				simulationCounters.growsCount++;
+
+				// the handler and the worker thread are the same thread here, so the grow is not posted
+				ConnectionLifecycle::BeginGrowReceive(connection);
+
+				if (!lifecycle->EndGrowReceive(connection, GetTickCount()))
+				{
+					EndReceive(connection, 0, 0);
+				}
+			}
+
+			/// <summary>
+			/// Serves the next request of the data received, or receives the rest of it.
+			/// </summary>
+			inline void ServeRequest(TcpConnection* connection)
+			{
+				auto context = connection->context;
+
+				auto result = lifecycle->ParseRequest(connection, request);
+
+				if (result == HttpParseIncomplete)
+				{
+					if (context->receivedLength != context->consumedLength)
+					{
+						simulationCounters.partialReceivesCount++;
+					}
+
+					ReceiveNext(connection);
+
+					return;
+				}
+
+				if (result == HttpParseError)
+				{
+					simulationCounters.malformedCount++;
+
+					lifecycle->Disconnect(connection);
+
+					return;
+				}
+
+				ConnectionLifecycle::ConsumeRequest(connection, request.headersLength);
+
+				keepAlives[connection->id] = lifecycle->KeepsAlive(connection, request) ? 1 : 0;
+
+				sentLengths[connection->id] = 0;
+
+				BeginSend(connection);
+			}
+
+			/// <summary>
+			/// Handles the end of the receive, the zero bytes or the error close the connection.
+			/// </summary>
+			inline void EndReceive(TcpConnection* connection, ULONG status, ULONG bytesTransferred)
+			{
+				// check if the client has closed or reset the connection
+				if ((status != 0) || (bytesTransferred == 0))
+				{
+					simulationCounters.closedCount++;
+
+					lifecycle->Disconnect(connection);
+
+					return;
+				}
+
+				ServeRequest(connection);
+			}
+
+			/// <summary>
+			/// Handles the end of the send, the connection which is kept alive serves the next request.
+			/// </summary>
+			inline void EndSend(TcpConnection* connection, const RIORESULT& rioResult)
+			{
+				if (rioResult.Status != 0)
+				{
+					simulationCounters.closedCount++;
+
+					lifecycle->Disconnect(connection);
+
+					return;
+				}
+
+				auto sentLength = sentLengths[connection->id] + rioResult.BytesTransferred;
+
+				if (sentLength < responseLength)
+				{
+					simulationCounters.partialSendsCount++;
+
+					sentLengths[connection->id] = sentLength;
+
+					BeginSend(connection);
+
+					return;
+				}
+
+				simulationCounters.requestsCount++;
+
+				if (!keepAlives[connection->id])
+				{
+					lifecycle->Disconnect(connection);
+
+					return;
+				}
+
+				ServeRequest(connection);
+			}
+
+			/// <summary>
+			/// Admits the accepted connection and starts serving it, as the accept thread and the worker thread do.
+			/// </summary>
+			inline void EndAccept(TcpConnection* connection)
+			{
+				if (!lifecycle->Admit(connection))
+				{
+					return;
+				}
+
+				if (!lifecycle->EndAdmit(connection))
+				{
+					return;
+				}
+
+				sentLengths[connection->id] = 0;
+
+				keepAlives[connection->id] = 0;
+
+				BeginReceive(connection);
+			}
+
+			/// <summary>
+			/// Dispatches the completions of the overlapped operations by their actions, as the accept thread and the worker thread do.
+			/// </summary>
+			/// <remarks>
+			/// The connect made for forwarding completes within the <see cref="ConnectionLifecycle" />, the simulation does not acquire the upstream by the handler.
+			/// </remarks>
+			void ProcessOverlapped()
+			{
+				LPOVERLAPPED overlapped;
+
+				while ((overlapped = network->DequeueOverlapped()) != nullptr)
+				{
+					auto operation = (Ovelapped*) overlapped;
+
+					auto connection = connectionTable->GetConnection(operation->connectionId);
+
+					switch (operation->action)
+					{
+						case SOCK_ACTION_ACCEPT:
+						{
+							EndAccept(connection);
+
+							break;
+						}
+
+						case SOCK_ACTION_DISCONNECT:
+						{
+							lifecycle->EndDisconnect(connection, 0);
+
+							break;
+						}
+
+						case SOCK_ACTION_CONNECT:
+						{
+							if (!lifecycle->EndConnect(connection, 0))
+							{
+								simulationCounters.unexpectedCount++;
+							}
+
+							break;
+						}
+
+						default:
+						{
+							simulationCounters.unexpectedCount++;
+
+							break;
+						}
+					}
+				}
+			}
+
+			/// <summary>
+			/// Dispatches the completions of the Registered I/O operations by the rules of the <see cref="CompletionDispatch" />, as the worker does.
+			/// </summary>
+			/// <remarks>
+			/// The simulation does not post the broadcasts and the streams, their completions are unexpected.
+			/// The completions of the forwarding pair which is closing are late by design and are passed to the <see cref="ConnectionLifecycle" />, which waits for them.
+			/// </remarks>
+			void ProcessCompletions()
+			{
+				ULONG completionsCount;
+
+				while ((completionsCount = winsock->RIODequeueCompletion(rioCompletionQueue, rioResults, SIMULATED_WORKER_BATCH_LENGTH)) > 0)
+				{
+					counters->RecordDequeue(completionsCount);
+
+					for (ULONG resultIndex = 0; resultIndex < completionsCount; resultIndex++)
+					{
+						auto& rioResult = rioResults[resultIndex];
+
+						TcpConnection* connection;
+
+						auto kind = CompletionDispatch::Classify(connectionTable, (ULONG) rioResult.RequestContext, connection);
+
+						auto late = SimulatedNetwork::IsLate(rioCompletionQueue, resultIndex);
+
+						if (kind == CompletionForward)
+						{
+							lifecycle->ProcessForward((ULONG) rioResult.RequestContext, rioResult);
+						}
+						else if ((kind == CompletionReceive) || (kind == CompletionSend) || (kind == CompletionRefuse))
+						{
+							// the late completion dispatched to the connection is the fault of the rules
+							if (late)
+							{
+								simulationCounters.lateMisattributedCount++;
+							}
+
+							if (kind == CompletionReceive)
+							{
+								lifecycle->CompleteReceive(connection, rioResult);
+
+								EndReceive(connection, rioResult.Status, rioResult.BytesTransferred);
+							}
+							else if (kind == CompletionSend)
+							{
+								lifecycle->CompleteSend(connection, rioResult);
+
+								EndSend(connection, rioResult);
+							}
+							else
+							{
+								// the busy response is sent, nothing waits for the disconnect
+								lifecycle->ReturnToAccept(connection);
+							}
+						}
+						else if (late && ((kind == CompletionStale) || (kind == CompletionUnexpected)))
+						{
+							simulationCounters.lateIgnoredCount++;
+						}
+						else
+						{
+							simulationCounters.unexpectedCount++;
+						}
+					}
+				}
+			}
+
+			/// <summary>
+			/// Completes the receives of the connections which have waited for the next request longer than the timeout, as the worker does.
+			/// </summary>
+			void CloseIdleConnections(ULONG64 tickCount)
+			{
+				for (ULONG connectionId = 0; connectionId < connectionsCount; connectionId++)
+				{
+					auto connection = connectionTable->GetConnection(connectionId);
+
+					if (lifecycle->ExpireIdle(connection, tickCount))
+					{
+						simulationCounters.idleClosedCount++;
+
+						// the handler sees the connection closed by the client
+						lifecycle->Disconnect(connection);
+					}
+				}
+			}
+
+			/// <summary>
+			/// Creates the connection of the slot and maps it onto the new simulated socket.
+			/// </summary>
+			/// <returns>A pointer to the connection if operation has succeed; otherwise, <c>null</c>.</returns>
+			TcpConnection* CreateConnection(ULONG connectionId, SOCKET listenSocket, int& winsockErrorCode)
+			{
+				auto connectionSocket = network->CreateSocket();
+
+				if (connectionSocket == INVALID_SOCKET)
+				{
+					winsockErrorCode = ::WSAGetLastError();
+
+					return nullptr;
+				}
+
+				auto requestQueue = winsock->RIOCreateRequestQueue(connectionSocket, 24, 1, 40, 2, rioCompletionQueue, rioCompletionQueue, (PVOID) connectionId);
+
+				if (requestQueue == RIO_INVALID_RQ)
+				{
+					winsockErrorCode = ::WSAGetLastError();
+
+					return nullptr;
+				}
+
+				auto connection = connectionTable->GetConnection(connectionId);
+
+				connection->Initialize(*winsock, connectionTable->GetContext(connectionId), listenSocket, connectionSocket, requestQueue, nullptr, connectionId, 0);
+
+				return connection;
+			}
+
+			#pragma endregion
+
+			public:
+
+			#pragma region Fields
+
+			/// <summary>
+			/// The counters of the simulation.
+			/// </summary>
+			SimulationCounters simulationCounters;
+
+			#pragma endregion
+
+			#pragma region Create and Destroy
+
+			/// <summary>
+			/// Initializes a new instance of the <see cref="SimulatedWorker" /> class.
+			/// </summary>
+			/// <param name="network">A pointer to the simulated network, which has a socket for each connection and the listener.</param>
+			/// <param name="settings">The settings of the worker.</param>
+			/// <param name="counters">A pointer to the counters of the worker.</param>
+			/// <param name="trace">A pointer to the trace ring of the worker.</param>
+			/// <param name="kernelErrorCode">The error code of the kernel if operation has failed.</param>
+			/// <param name="winsockErrorCode">The error code of the Winsock if operation has failed.</param>
+			/// <returns>A pointer to the instance of the class if operation has succeed; otherwise, <c>null</c>.</returns>
+			/// <remarks>
+			/// The buffer pool is sized by the <see cref="ConnectionLifecycle" />, as the worker sizes it, so the segments are rented on admit and returned on disconnect.
+			/// </remarks>
+			static SimulatedWorker* Create(SimulatedNetwork* network, const SimulatedWorkerSettings& settings, WorkerCounters* counters, TraceRing* trace, DWORD& kernelErrorCode, int& winsockErrorCode)
+			{
+				kernelErrorCode = 0;
+
+				winsockErrorCode = 0;
+
+				auto result = new SimulatedWorker();
+
+				result->network = network;
+
+				result->winsock = SimulatedNetwork::CreateWinsock();
+
+				result->response = settings.response;
+
+				result->responseLength = (ULONG) strlen(settings.response);
+
+				result->keepAliveTimeout = settings.keepAliveTimeout;
+
+				result->abortPercent = settings.abortPercent;
+
+				result->counters = counters;
+
+				result->trace = trace;
+
+				auto acceptedConnectionsCount = settings.servedConnectionsCount + settings.forwardedConnectionsCount;
+
+				auto connectionsCount = acceptedConnectionsCount + settings.upstreamConnectionsCount;
+
+				result->connectionsCount = connectionsCount;
+
+				counters->slotsCount = connectionsCount;
+
+				// the response is written into the send segment
+				auto sendSegmentLength = ConnectionLifecycle::SmallSegmentLength;
+
+				if (result->responseLength > sendSegmentLength)
+				{
+					winsockErrorCode = WSAEMSGSIZE;
+
+					return nullptr;
+				}
+
+				// completions are dequeued after each step of the network, so the notification is not used
+				RIO_NOTIFICATION_COMPLETION completionSettings;
+
+				completionSettings.Type = RIO_EVENT_COMPLETION;
+
+				completionSettings.Event.EventHandle = nullptr;
+
+				completionSettings.Event.NotifyReset = FALSE;
+
+				result->rioCompletionQueue = result->winsock->RIOCreateCompletionQueue(connectionsCount * 64, &completionSettings);
+
+				// size the pool as the worker does
+				ULONG segmentsCounts[ConnectionLifecycle::SizeClassesCount];
+
+				auto maxReceiveLength = ConnectionLifecycle::GetSegmentsCounts(settings.servedConnectionsCount, settings.forwardedConnectionsCount + settings.upstreamConnectionsCount, settings.receiveSegmentLength, sendSegmentLength, FALSE, segmentsCounts);
+
+				result->rioBufferPool = RioSizeClassPool::Create(*result->winsock, ConnectionLifecycle::GetSegmentLengths(), segmentsCounts, ConnectionLifecycle::SizeClassesCount, kernelErrorCode, winsockErrorCode);
+
+				if (result->rioBufferPool == nullptr)
+				{
+					return nullptr;
+				}
+
+				result->rioBufferPool->SetOwnerThread();
+
+				// the busy response is sent from the buffer shared by the connections, as the server does
+				auto busyResponseLength = (ULONG) strlen(settings.busyResponse);
+
+				result->busyBuffer = new CHAR[busyResponseLength];
+
+				memcpy(result->busyBuffer, settings.busyResponse, busyResponseLength);
+
+				result->busyResponse.BufferId = result->winsock->RIORegisterBuffer(result->busyBuffer, busyResponseLength);
+
+				if (result->busyResponse.BufferId == RIO_INVALID_BUFFERID)
+				{
+					winsockErrorCode = ::WSAGetLastError();
+
+					return nullptr;
+				}
+
+				result->busyResponse.Offset = 0;
+
+				result->busyResponse.Length = busyResponseLength;
+
+				result->connectionTable = ConnectionTable::Create(connectionsCount, kernelErrorCode);
+
+				if (result->connectionTable == nullptr)
+				{
+					return nullptr;
+				}
+
+				result->admissionControl = new AdmissionControl(settings.maxActiveConnections, settings.minAvailableBuffers, 0);
+
+				auto listenSocket = network->CreateSocket();
+
+				// the served connections are accepted by the first listener, the forwarded ones by the second
+				result->listeners[0].socket = listenSocket;
+
+				result->listeners[0].addressFamily = AF_INET;
+
+				result->listeners[0].connectionsCount = settings.servedConnectionsCount;
+
+				result->listeners[0].upstreamIndex = ULONG_MAX;
+
+				result->listeners[1].socket = listenSocket;
+
+				result->listeners[1].addressFamily = AF_INET;
+
+				result->listeners[1].connectionsCount = settings.forwardedConnectionsCount;
+
+				result->listeners[1].upstreamIndex = 0;
+
+				result->upstream.address.si_family = AF_INET;
+
+				result->upstream.addressLength = sizeof(SOCKADDR_IN);
+
+				result->upstream.connectionsCount = settings.upstreamConnectionsCount;
+
+				result->upstream.useFastLoopback = FALSE;
+
+				// the upstream connections follow the accepted ones
+				if (settings.upstreamConnectionsCount != 0)
+				{
+					result->upstreamPool = UpstreamPool::Create(&result->upstream, 1, acceptedConnectionsCount, kernelErrorCode);
+
+					if (result->upstreamPool == nullptr)
+					{
+						return nullptr;
+					}
+				}
+
+				result->lifecycle = new ConnectionLifecycle(result->connectionTable, result->rioBufferPool, result->admissionControl, result->upstreamPool, result->listeners, &result->upstream, counters, trace, &result->busyResponse, settings.receiveSegmentLength, sendSegmentLength, maxReceiveLength, settings.keepAliveTimeout, settings.maxKeepAliveRequests, FALSE);
+
+				result->sentLengths = new ULONG[connectionsCount];
+
+				result->keepAlives = new UCHAR[connectionsCount];
+
+				// initialize connections as the worker does
+				for (ULONG connectionId = 0; connectionId < connectionsCount; connectionId++)
+				{
+					auto connection = result->CreateConnection(connectionId, connectionId < acceptedConnectionsCount ? listenSocket : INVALID_SOCKET, winsockErrorCode);
+
+					if (connection == nullptr)
+					{
+						return nullptr;
+					}
+
+					if (connectionId >= acceptedConnectionsCount)
+					{
+						connection->context->upstreamIndex = 0;
+
+						// the upstream connection keeps its segments, the pool is sized to hold them
+						if (!result->lifecycle->RentSegments(connection, settings.receiveSegmentLength))
+						{
+							kernelErrorCode = ERROR_NOT_ENOUGH_MEMORY;
+
+							return nullptr;
+						}
+
+						continue;
+					}
+
+					connection->context->listenerIndex = connectionId < settings.servedConnectionsCount ? 0 : 1;
+
+					auto acceptResult = connection->StartAccept();
+
+					result->trace->Record(connection, ConnectionState::Disconnected, 0, TraceRing::GetError(acceptResult));
+				}
+
+				return result;
+			}
+
+			#pragma endregion
+
+			#pragma region Methods
+
+			/// <summary>
+			/// Runs the simulation until the simulated time reaches the specified value or there are no operations in flight.
+			/// </summary>
+			/// <param name="endTime">The simulated time, in nanoseconds, to stop at.</param>
+			void Run(ULONG64 endTime)
+			{
+				while ((network->GetTime() < endTime) && (network->AdvanceBatch() != 0))
+				{
+					counters->wakeupsCount++;
+
+					ProcessOverlapped();
+
+					ProcessCompletions();
+
+					// close the connections which wait for the next request too long
+					auto tickCount = GetTickCount();
+
+					if ((keepAliveTimeout != 0) && (tickCount - idleCheckTime >= SIMULATED_WORKER_IDLE_INTERVAL))
+					{
+						idleCheckTime = tickCount;
+
+						CloseIdleConnections(tickCount);
+					}
+				}
+			}
+
+			#pragma endregion
+		};
+	}
+}
+
+#pragma managed
@@ -0,0 +1,14 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently,
+// but are changed infrequently
+
+#pragma once
+
+// the simulation runs the connections of the server over the simulated network
+#include "../TcpServerCli/Stdafx.h"
+
+#include "../TcpServerCli/SimulatedNetwork.h"
+
+#include <stdio.h>
+
+#include <stdlib.h>
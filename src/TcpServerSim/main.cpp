@@ -0,0 +1,375 @@
+// Runs the connections of the server over the deterministic simulated network and reports the rate of the simulation and the ordering faults found.
+
+#include "Stdafx.h"
+#include "SimulatedWorker.h"
+
+#pragma unmanaged
+
+using namespace SXN::Net;
+
+/// <summary>
+/// Contains the options of the run.
+/// </summary>
+struct SimulationOptions
+{
+	SimulationSettings network;
+
+	SimulatedWorkerSettings worker;
+
+	ULONG64 duration;
+
+	ULONG paddingLength;
+
+	const char* tracePath;
+};
+
+/// <summary>
+/// Prints the usage of the tool.
+/// </summary>
+static void PrintUsage()
+{
+	fprintf(stderr, "usage: TcpServerSim [options]\n");
+
+	fprintf(stderr, "  --seed <n>          seed of the run, default 1\n");
+
+	fprintf(stderr, "  --connections <n>   count of the connections, default 1024\n");
+
+	fprintf(stderr, "  --duration <ms>     simulated duration, default 1000\n");
+
+	fprintf(stderr, "  --min-delay <us>    minimal delay of the operation, default 10\n");
+
+	fprintf(stderr, "  --max-delay <us>    maximal delay of the operation, default 100\n");
+
+	fprintf(stderr, "  --partial <%%>       probability of the partial transfer, default 0\n");
+
+	fprintf(stderr, "  --reset <%%>         probability of the reset by the client, default 0\n");
+
+	fprintf(stderr, "  --close <%%>         probability of the close by the client, default 0\n");
+
+	fprintf(stderr, "  --reorder <%%>       probability of the operation to complete after the later ones, default 0\n");
+
+	fprintf(stderr, "  --abort <%%>         probability of the disconnect by the server while the receive is in flight, default 0\n");
+
+	fprintf(stderr, "  --padding <n>       length of the header added to the request, so its receive grows, default 0\n");
+
+	fprintf(stderr, "  --receive <n>       length of the receive segment, default 4096\n");
+
+	fprintf(stderr, "  --keep-alive <us>   time the connection waits for the next request, default 0, without limit\n");
+
+	fprintf(stderr, "  --max-requests <n>  count of the requests served by the connection, default 0, without limit\n");
+
+	fprintf(stderr, "  --max-active <n>    count of the connections served at once, default 0, without limit\n");
+
+	fprintf(stderr, "  --min-buffers <n>   count of the connections the free segments should be enough for to admit, default 0\n");
+
+	fprintf(stderr, "  --forward <n>       count of the connections forwarded to the upstream, default 0\n");
+
+	fprintf(stderr, "  --upstream <n>      count of the connections to the upstream, default 0\n");
+
+	fprintf(stderr, "  --trace <file>      file to save the trace of the transitions into\n");
+}
+
+/// <summary>
+/// Parses the options of the run.
+/// </summary>
+/// <returns><c>true</c> if the options are valid; otherwise, <c>false</c>.</returns>
+static bool ParseOptions(int argc, char* argv[], SimulationOptions& options)
+{
+	memset(&options, 0, sizeof(SimulationOptions));
+
+	options.network.seed = 1;
+
+	options.network.minDelay = 10000;
+
+	options.network.maxDelay = 100000;
+
+	options.worker.servedConnectionsCount = 1024;
+
+	options.worker.receiveSegmentLength = 4096;
+
+	options.duration = 1000000000ULL;
+
+	for (auto argIndex = 1; argIndex < argc; argIndex += 2)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			return false;
+		}
+
+		auto name = argv[argIndex];
+
+		auto value = argv[argIndex + 1];
+
+		auto number = strtoull(value, nullptr, 10);
+
+		if (strcmp(name, "--seed") == 0)
+		{
+			options.network.seed = number;
+		}
+		else if (strcmp(name, "--connections") == 0)
+		{
+			options.worker.servedConnectionsCount = (ULONG) number;
+		}
+		else if (strcmp(name, "--duration") == 0)
+		{
+			options.duration = number * 1000000ULL;
+		}
+		else if (strcmp(name, "--min-delay") == 0)
+		{
+			options.network.minDelay = (ULONG) (number * 1000);
+		}
+		else if (strcmp(name, "--max-delay") == 0)
+		{
+			options.network.maxDelay = (ULONG) (number * 1000);
+		}
+		else if (strcmp(name, "--partial") == 0)
+		{
+			options.network.partialPercent = (ULONG) number;
+		}
+		else if (strcmp(name, "--reset") == 0)
+		{
+			options.network.resetPercent = (ULONG) number;
+		}
+		else if (strcmp(name, "--close") == 0)
+		{
+			options.network.closePercent = (ULONG) number;
+		}
+		else if (strcmp(name, "--reorder") == 0)
+		{
+			options.network.reorderPercent = (ULONG) number;
+		}
+		else if (strcmp(name, "--abort") == 0)
+		{
+			options.worker.abortPercent = (ULONG) number;
+		}
+		else if (strcmp(name, "--padding") == 0)
+		{
+			options.paddingLength = (ULONG) number;
+		}
+		else if (strcmp(name, "--receive") == 0)
+		{
+			options.worker.receiveSegmentLength = (ULONG) number;
+		}
+		else if (strcmp(name, "--keep-alive") == 0)
+		{
+			options.worker.keepAliveTimeout = number;
+		}
+		else if (strcmp(name, "--max-requests") == 0)
+		{
+			options.worker.maxKeepAliveRequests = (ULONG) number;
+		}
+		else if (strcmp(name, "--max-active") == 0)
+		{
+			options.worker.maxActiveConnections = (ULONG) number;
+		}
+		else if (strcmp(name, "--min-buffers") == 0)
+		{
+			options.worker.minAvailableBuffers = (ULONG) number;
+		}
+		else if (strcmp(name, "--forward") == 0)
+		{
+			options.worker.forwardedConnectionsCount = (ULONG) number;
+		}
+		else if (strcmp(name, "--upstream") == 0)
+		{
+			options.worker.upstreamConnectionsCount = (ULONG) number;
+		}
+		else if (strcmp(name, "--trace") == 0)
+		{
+			options.tracePath = value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	auto& worker = options.worker;
+
+	// the forwarded connections need the upstream, the segments are not larger than the largest size class
+	return (worker.servedConnectionsCount + worker.forwardedConnectionsCount != 0) && ((worker.forwardedConnectionsCount == 0) || (worker.upstreamConnectionsCount != 0)) &&
+		(worker.receiveSegmentLength != 0) && (worker.receiveSegmentLength <= ConnectionLifecycle::LargeSegmentLength) &&
+		(options.network.minDelay <= options.network.maxDelay) && (worker.abortPercent <= 100);
+}
+
+/// <summary>
+/// Runs the simulation.
+/// </summary>
+static int RunSimulation(int argc, char* argv[])
+{
+	SimulationOptions options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+
+		return 1;
+	}
+
+	// the padding header makes the request longer than the smallest segment, so the receive grows
+	const char requestStart[] = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\nAccept: text/plain,text/html;q=0.9\r\nConnection: keep-alive\r\n";
+
+	const char paddingStart[] = "X-Padding: ";
+
+	auto requestStartLength = (ULONG) strlen(requestStart);
+
+	auto paddingStartLength = options.paddingLength != 0 ? (ULONG) strlen(paddingStart) : 0;
+
+	auto requestLength = requestStartLength + paddingStartLength + options.paddingLength + (options.paddingLength != 0 ? 2 : 0) + 2;
+
+	auto request = new char[requestLength];
+
+	memcpy(request, requestStart, requestStartLength);
+
+	if (options.paddingLength != 0)
+	{
+		memcpy(request + requestStartLength, paddingStart, paddingStartLength);
+
+		memset(request + requestStartLength + paddingStartLength, 'x', options.paddingLength);
+
+		memcpy(request + requestLength - 4, "\r\n", 2);
+	}
+
+	memcpy(request + requestLength - 2, "\r\n", 2);
+
+	options.network.request = request;
+
+	options.network.requestLength = requestLength;
+
+	// the upstream streams the responses, which the forwarded connections pass to the clients
+	options.network.response = "HTTP/1.1 200 OK\r\nServer:Upstream\r\nContent-Length:0\r\n\r\n";
+
+	options.network.responseLength = (ULONG) strlen(options.network.response);
+
+	options.worker.response = "HTTP/1.1 200 OK\r\nServer:SXN.Ion\r\nContent-Length:0\r\nDate:Sat, 26 Sep 2015 17:45:57 GMT\r\n\r\n";
+
+	options.worker.busyResponse = "HTTP/1.1 503 Service Unavailable\r\nContent-Length:0\r\nConnection:close\r\n\r\n";
+
+	auto connectionsCount = options.worker.servedConnectionsCount + options.worker.forwardedConnectionsCount + options.worker.upstreamConnectionsCount;
+
+	// the network reports the errors through the Winsock, which should be initialized
+	WSADATA data;
+
+	if (::WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		fprintf(stderr, "Winsock startup has failed\n");
+
+		return 2;
+	}
+
+	// each connection holds at most one operation of its own and several late ones, the listener has the socket of its own
+	auto network = SimulatedNetwork::Create(options.network, connectionsCount + 1, connectionsCount * 8);
+
+	DWORD kernelErrorCode;
+
+	int winsockErrorCode = 0;
+
+	auto statisticsRegion = StatisticsRegion::Create(nullptr, 1, kernelErrorCode);
+
+	auto traceRegion = TraceRegion::Create(nullptr, 1, TRACE_DEFAULT_EVENTS_COUNT, kernelErrorCode);
+
+	if ((network == nullptr) || (statisticsRegion == nullptr) || (traceRegion == nullptr))
+	{
+		fprintf(stderr, "Can not initialize simulation, kernel error %lu\n", kernelErrorCode);
+
+		return 3;
+	}
+
+	auto counters = statisticsRegion->GetWorkerCounters(0);
+
+	auto worker = SimulatedWorker::Create(network, options.worker, counters, traceRegion->GetRing(0), kernelErrorCode, winsockErrorCode);
+
+	if (worker == nullptr)
+	{
+		fprintf(stderr, "Can not initialize worker, kernel error %lu, winsock error %d\n", kernelErrorCode, winsockErrorCode);
+
+		return 4;
+	}
+
+	LARGE_INTEGER frequency, startTime, endTime;
+
+	::QueryPerformanceFrequency(&frequency);
+
+	::QueryPerformanceCounter(&startTime);
+
+	worker->Run(options.duration);
+
+	::QueryPerformanceCounter(&endTime);
+
+	auto seconds = (double) (endTime.QuadPart - startTime.QuadPart) / frequency.QuadPart;
+
+	auto& simulationCounters = worker->simulationCounters;
+
+	printf("{\n");
+
+	printf("  \"seed\": %llu,\n", options.network.seed);
+
+	printf("  \"connections\": %lu,\n", connectionsCount);
+
+	printf("  \"simulatedSeconds\": %.3f,\n", network->GetTime() / 1e9);
+
+	printf("  \"wallSeconds\": %.3f,\n", seconds);
+
+	printf("  \"accepts\": %llu,\n", counters->acceptsCount);
+
+	printf("  \"acceptsPerSecond\": %.0f,\n", counters->acceptsCount / seconds);
+
+	printf("  \"completions\": %llu,\n", counters->completionsCount);
+
+	printf("  \"completionsPerSecond\": %.0f,\n", counters->completionsCount / seconds);
+
+	printf("  \"requests\": %llu,\n", simulationCounters.requestsCount);
+
+	printf("  \"refusals\": %llu,\n", counters->refusalsCount);
+
+	printf("  \"bufferRefusals\": %llu,\n", counters->bufferRefusalsCount);
+
+	printf("  \"forwardRefusals\": %llu,\n", counters->forwardRefusalsCount);
+
+	printf("  \"closed\": %llu,\n", simulationCounters.closedCount);
+
+	printf("  \"idleClosed\": %llu,\n", simulationCounters.idleClosedCount);
+
+	printf("  \"malformed\": %llu,\n", simulationCounters.malformedCount);
+
+	printf("  \"aborts\": %llu,\n", simulationCounters.abortsCount);
+
+	printf("  \"partialReceives\": %llu,\n", simulationCounters.partialReceivesCount);
+
+	printf("  \"grows\": %llu,\n", simulationCounters.growsCount);
+
+	printf("  \"partialSends\": %llu,\n", simulationCounters.partialSendsCount);
+
+	printf("  \"lateIgnored\": %llu,\n", simulationCounters.lateIgnoredCount);
+
+	printf("  \"lateMisattributed\": %llu,\n", simulationCounters.lateMisattributedCount);
+
+	printf("  \"unexpected\": %llu\n", simulationCounters.unexpectedCount);
+
+	printf("}\n");
+
+	// save the trace, so the faults can be followed by the TcpServerTrace tool
+	if (options.tracePath != nullptr)
+	{
+		wchar_t tracePath[MAX_PATH];
+
+		size_t convertedCount;
+
+		mbstowcs_s(&convertedCount, tracePath, options.tracePath, _TRUNCATE);
+
+		if (!traceRegion->Save(tracePath, kernelErrorCode))
+		{
+			fprintf(stderr, "Can not save trace, kernel error %lu\n", kernelErrorCode);
+		}
+	}
+
+	// faults of the ordering fail the run
+	return (simulationCounters.lateMisattributedCount != 0) || (simulationCounters.unexpectedCount != 0) ? 5 : 0;
+}
+
+#pragma managed
+
+int main(int argc, char* argv[])
+{
+	return RunSimulation(argc, argv);
+}
@@ -0,0 +1,216 @@
+// Decodes the trace file written by the TcpServerCli.
+//
+// Usage:
+//   TcpServerTrace dump <file> [worker]
+//   TcpServerTrace timeline <file> <worker> <slot> [generation]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "../TcpServerCli/TraceFormat.h"
+
+using namespace SXN::Net;
+
+/// <summary>
+/// The names of the states of the connection, in the order of the <c>ConnectionState</c> enumeration.
+/// </summary>
+static const char* stateNames[] = { "Disconnected", "Accepting", "Accepted", "Receiving", "Received", "Sending", "Sent", "Disconnecting", "Refusing", "Connecting", "Connected", "Idle", "Forwarding", "Streaming" };
+
+/// <summary>
+/// Contains the event together with its index.
+/// </summary>
+struct IndexedEvent
+{
+	int64_t index;
+
+	TraceEvent value;
+};
+
+/// <summary>
+/// Gets the name of the state.
+/// </summary>
+static const char* GetStateName(uint8_t state)
+{
+	return state < sizeof(stateNames) / sizeof(stateNames[0]) ? stateNames[state] : "Unknown";
+}
+
+/// <summary>
+/// Reads the valid events of the ring of the worker, ordered by index.
+/// </summary>
+/// <returns>The count of the events which are torn or overwritten.</returns>
+static size_t ReadRing(FILE* file, const TraceHeader& header, uint32_t workerId, std::vector<IndexedEvent>& events)
+{
+	auto ringLength = sizeof(TraceRingHeader) + (uint64_t) header.eventLength * header.eventsCount;
+
+	// seek to the ring of the worker
+	// 64 bit offsets are required for large rings
+#ifdef _WIN32
+	_fseeki64(file, header.headerLength + ringLength * workerId, SEEK_SET);
+#else
+	fseeko(file, header.headerLength + ringLength * workerId, SEEK_SET);
+#endif
+
+	TraceRingHeader ringHeader;
+
+	if (fread(&ringHeader, sizeof(TraceRingHeader), 1, file) != 1)
+	{
+		return 0;
+	}
+
+	std::vector<TraceEvent> ring(header.eventsCount);
+
+	if (fread(ring.data(), sizeof(TraceEvent), header.eventsCount, file) != header.eventsCount)
+	{
+		return 0;
+	}
+
+	// the ring contains the latest eventsCount events before nextIndex
+	int64_t lastIndex = ringHeader.nextIndex;
+
+	int64_t firstIndex = lastIndex > header.eventsCount ? lastIndex - header.eventsCount : 0;
+
+	size_t invalidCount = 0;
+
+	for (auto index = firstIndex; index < lastIndex; index++)
+	{
+		auto& value = ring[(size_t) (index & (header.eventsCount - 1))];
+
+		// check if event is completely written and belongs to this index
+		if (value.sequence != (uint32_t) (index + 1))
+		{
+			invalidCount++;
+
+			continue;
+		}
+
+		IndexedEvent item = { index, value };
+
+		events.push_back(item);
+	}
+
+	// events of the different threads may be published out of the order of the timestamps
+	std::stable_sort(events.begin(), events.end(), [](const IndexedEvent& left, const IndexedEvent& right) { return left.value.timestamp < right.value.timestamp; });
+
+	return invalidCount;
+}
+
+/// <summary>
+/// Prints the event.
+/// </summary>
+static void PrintEvent(const TraceHeader& header, uint32_t workerId, const IndexedEvent& item)
+{
+	// get time since start of the trace in microseconds
+	auto time = ((double) item.value.timestamp - (double) header.startTimestamp) * 1000000.0 / (double) header.timestampFrequency;
+
+	printf("%14.3f us  worker %3u  slot %6u  gen %5u  %-13s -> %-13s  bytes %8u  error %u\n", time, workerId, item.value.slot, item.value.generation, GetStateName(item.value.fromState), GetStateName(item.value.toState), item.value.bytes, item.value.error);
+}
+
+static int PrintUsage()
+{
+	fprintf(stderr, "Usage:\n");
+
+	fprintf(stderr, "  TcpServerTrace dump <file> [worker]\n");
+
+	fprintf(stderr, "  TcpServerTrace timeline <file> <worker> <slot> [generation]\n");
+
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		return PrintUsage();
+	}
+
+	auto command = argv[1];
+
+	auto isDump = strcmp(command, "dump") == 0;
+
+	auto isTimeline = strcmp(command, "timeline") == 0;
+
+	if ((!isDump && !isTimeline) || (isTimeline && (argc < 5)))
+	{
+		return PrintUsage();
+	}
+
+	auto file = fopen(argv[2], "rb");
+
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Can not open file %s\n", argv[2]);
+
+		return 2;
+	}
+
+	TraceHeader header;
+
+	// check the header
+	if ((fread(&header, sizeof(TraceHeader), 1, file) != 1) || (header.signature != TRACE_SIGNATURE) || (header.version != TRACE_VERSION) || (header.eventLength != sizeof(TraceEvent)) || (header.eventsCount == 0) || ((header.eventsCount & (header.eventsCount - 1)) != 0))
+	{
+		fprintf(stderr, "File %s is not a trace file of the version %d\n", argv[2], TRACE_VERSION);
+
+		fclose(file);
+
+		return 3;
+	}
+
+	printf("process %u, workers %u, events per worker %u, frequency %llu\n", header.processId, header.workersCount, header.eventsCount, (unsigned long long) header.timestampFrequency);
+
+	// get range of the workers
+	uint32_t firstWorkerId = 0;
+
+	uint32_t lastWorkerId = header.workersCount;
+
+	if (argc > 3)
+	{
+		firstWorkerId = (uint32_t) strtoul(argv[3], nullptr, 10);
+
+		lastWorkerId = firstWorkerId + 1;
+
+		if (firstWorkerId >= header.workersCount)
+		{
+			fprintf(stderr, "Worker %u is out of range\n", firstWorkerId);
+
+			fclose(file);
+
+			return 4;
+		}
+	}
+
+	auto slot = isTimeline ? (uint32_t) strtoul(argv[4], nullptr, 10) : 0;
+
+	auto filterGeneration = isTimeline && (argc > 5);
+
+	auto generation = filterGeneration ? (uint16_t) strtoul(argv[5], nullptr, 10) : 0;
+
+	for (auto workerId = firstWorkerId; workerId < lastWorkerId; workerId++)
+	{
+		std::vector<IndexedEvent> events;
+
+		auto invalidCount = ReadRing(file, header, workerId, events);
+
+		if (invalidCount != 0)
+		{
+			printf("worker %u: %zu events are torn or overwritten\n", workerId, invalidCount);
+		}
+
+		for (auto& item : events)
+		{
+			// check if event belongs to the requested connection
+			if (isTimeline && ((item.value.slot != slot) || (filterGeneration && (item.value.generation != generation))))
+			{
+				continue;
+			}
+
+			PrintEvent(header, workerId, item);
+		}
+	}
+
+	fclose(file);
+
+	return 0;
+}